@@ -448,6 +448,7 @@ void A_SkelMissile(actionargs_t *actionargs)
    
    mo->x += mo->momx;
    mo->y += mo->momy;
+   P_RefreshBlockThing(mo);
    mo->backupPosition();
    P_SetTarget<Mobj>(&mo->tracer, actor->target);  // killough 11/98
 }
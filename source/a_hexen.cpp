@@ -776,6 +776,7 @@ void A_WraithFX3(Mobj *actor)
       
       mo->x += (P_Random(pr_wraithfx3) - 128) << 11;
       mo->y += (P_Random(pr_wraithfx3) - 128) << 11;
+      P_RefreshBlockThing(mo);
       mo->z += (P_Random(pr_wraithfx3) << 10);
       P_SetTarget<Mobj>(&mo->target, actor);
    }
@@ -816,6 +817,7 @@ void A_WraithFX4(Mobj *actor)
       mo = P_SpawnMobj(actor->x, actor->y, actor->z, thingType1);
       mo->x += (P_Random(pr_wraithfx4b) - 128) << 12;
       mo->y += (P_Random(pr_wraithfx4b) - 128) << 12;
+      P_RefreshBlockThing(mo);
       mo->z += (P_Random(pr_wraithfx4b) << 10);
       P_SetTarget(&mo->target, actor);
    }
@@ -824,6 +826,7 @@ void A_WraithFX4(Mobj *actor)
       mo = P_SpawnMobj(actor->x, actor->y, actor->z, thingType2);
       mo->x += (P_Random(pr_wraithfx4c) - 128) << 11;
       mo->y += (P_Random(pr_wraithfx4c) - 128) << 11;
+      P_RefreshBlockThing(mo);
       mo->z += (P_Random(pr_wraithfx4c) << 10);
       P_SetTarget<Mobj>(&mo->target, actor);
    }
@@ -419,6 +419,7 @@ void A_BoltSpark(actionargs_t *actionargs)
       Mobj *spark = P_SpawnMobj(bolt->x, bolt->y, bolt->z, tnum);
       spark->x += P_SubRandom(pr_boltspark) * PO2(10);
       spark->y += P_SubRandom(pr_boltspark) * PO2(10);
+      P_RefreshBlockThing(spark);
    }
 }
 
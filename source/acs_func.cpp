@@ -1795,6 +1795,9 @@ static void ACS_setLineBlocking(int tag, int block)
          break;
       }
    }
+
+   // BLOCKALL lines stop sight checks
+   P_InvalidateSightCache();
 }
 
 //
@@ -2123,8 +2126,8 @@ void ACS_SetThingProp(Mobj *thing, uint32_t var, uint32_t val)
    case ACS_TP_SigilPieces:  break;
    case ACS_TP_TID:          P_RemoveThingTID(thing); P_AddThingTID(thing, val); break;
    case ACS_TP_Type:         break;
-   case ACS_TP_X:            thing->x = val; break;
-   case ACS_TP_Y:            thing->y = val; break;
+   case ACS_TP_X:            thing->x = val; P_RefreshBlockThing(thing); break;
+   case ACS_TP_Y:            thing->y = val; P_RefreshBlockThing(thing); break;
    case ACS_TP_Z:            thing->z = val; break;
    }
 }
@@ -0,0 +1,601 @@
+//
+// The Eternity Engine
+// Copyright (C) 2018 James Haley et al.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see http://www.gnu.org/licenses/
+//
+// Additional terms and conditions compatible with the GPLv3 apply. See the
+// file COPYING-EE for details.
+//
+// Purpose: Spatial index of level lines for the automap, with simplified
+//  line sets for zoomed-out views.
+//
+// The automap used to clip every line in the level each frame. Lines are
+// now bucketed into a uniform grid, so only those near the visible window
+// are looked at. For each coarser detail level, chains of connected lines
+// which share sectors, flags and special are simplified with the
+// Douglas-Peucker algorithm, and indexed in the same way.
+//
+
+#include "z_zone.h"
+
+#include <float.h>
+
+#include "am_index.h"
+#include "m_compare.h"
+#include "polyobj.h"
+#include "r_defs.h"
+#include "r_state.h"
+
+// error tolerance of each detail level, in map units
+static const double am_lodtolerance[AM_NUMLODS] = { 0.0, 8.0, 32.0, 128.0 };
+
+// largest on-screen error, in pixels, that a detail level may introduce
+#define AM_LODMAXERROR 1.0
+
+// aim for about this many lines per grid cell
+#define AM_LINESPERCELL 8
+
+// but never smaller cells than this, in map units
+#define AM_MINCELLSIZE 128.0
+
+// nor more cells than this
+#define AM_MAXCELLS (1 << 20)
+
+struct amlodlevel_t
+{
+   amseg_t      *segs;
+   int           numsegs;
+   int          *cellstart; // offsets into cellsegs; numcells + 1 entries
+   int          *cellsegs;  // segment numbers, grouped by cell
+   unsigned int *stamps;    // query that last visited each segment
+};
+
+static amlodlevel_t am_lods[AM_NUMLODS];
+static bool         am_indexvalid;
+
+// grid geometry, shared by all detail levels
+static double am_gridx, am_gridy; // lower left corner
+static double am_cellsize;
+static int    am_gridw, am_gridh;
+
+// static lines in chain order; segments refer to runs of this table
+static line_t **am_chainlines;
+
+// polyobject lines move, so they are kept out of the grid
+static amseg_t *am_polysegs;
+static int      am_numpolysegs;
+
+static unsigned int am_querystamp;
+
+//
+// AM_ClearLineIndex
+//
+// Frees the index. It is rebuilt the next time the automap needs it. Called
+// when a new level is set up.
+//
+void AM_ClearLineIndex()
+{
+   for(amlodlevel_t &level : am_lods)
+   {
+      if(level.segs)
+         efree(level.segs);
+      if(level.cellstart)
+         efree(level.cellstart);
+      if(level.cellsegs)
+         efree(level.cellsegs);
+      if(level.stamps)
+         efree(level.stamps);
+      level = amlodlevel_t();
+   }
+
+   if(am_chainlines)
+      efree(am_chainlines);
+   if(am_polysegs)
+      efree(am_polysegs);
+
+   am_chainlines  = NULL;
+   am_polysegs    = NULL;
+   am_numpolysegs = 0;
+   am_querystamp  = 0;
+   am_indexvalid  = false;
+}
+
+//
+// AM_linesCompatible
+//
+// True if two lines will always be drawn in the same colour, so that they
+// may be merged at coarse detail levels.
+//
+static bool AM_linesCompatible(const line_t &a, const line_t &b)
+{
+   return a.frontsector == b.frontsector && a.backsector == b.backsector &&
+          (a.flags & ~ML_MAPPED) == (b.flags & ~ML_MAPPED) &&
+          a.special == b.special && a.extflags == b.extflags &&
+          !memcmp(a.args, b.args, sizeof(a.args));
+}
+
+//
+// AM_cellRange
+//
+// Returns the range of grid cells overlapped by a box, clamped to the grid.
+//
+static void AM_cellRange(double x1, double y1, double x2, double y2,
+                         int &cx1, int &cy1, int &cx2, int &cy2)
+{
+   cx1 = static_cast<int>((emin(x1, x2) - am_gridx) / am_cellsize);
+   cx2 = static_cast<int>((emax(x1, x2) - am_gridx) / am_cellsize);
+   cy1 = static_cast<int>((emin(y1, y2) - am_gridy) / am_cellsize);
+   cy2 = static_cast<int>((emax(y1, y2) - am_gridy) / am_cellsize);
+
+   cx1 = eclamp(cx1, 0, am_gridw - 1);
+   cx2 = eclamp(cx2, 0, am_gridw - 1);
+   cy1 = eclamp(cy1, 0, am_gridh - 1);
+   cy2 = eclamp(cy2, 0, am_gridh - 1);
+}
+
+//
+// AM_simplifyChain
+//
+// Douglas-Peucker simplification of the points of a chain. Sets keep[i] for
+// each point that must be retained for the result to stay within tolerance.
+// stack must have room for 2 * numpts entries.
+//
+static void AM_simplifyChain(const double *px, const double *py, int numpts,
+                             double tolerance, bool *keep, int *stack)
+{
+   double tol2 = tolerance * tolerance;
+   int    sp   = 0;
+
+   for(int i = 0; i < numpts; i++)
+      keep[i] = false;
+
+   keep[0] = keep[numpts - 1] = true;
+
+   stack[sp++] = 0;
+   stack[sp++] = numpts - 1;
+
+   while(sp)
+   {
+      int b = stack[--sp];
+      int a = stack[--sp];
+
+      double dx   = px[b] - px[a];
+      double dy   = py[b] - py[a];
+      double len2 = dx * dx + dy * dy;
+      double maxd = -1.0;
+      int    maxi = -1;
+
+      for(int i = a + 1; i < b; i++)
+      {
+         double ex = px[i] - px[a];
+         double ey = py[i] - py[a];
+         double d;
+
+         if(len2 > 0.0)
+         {
+            // distance to the segment, not to its supporting line
+            double t = eclamp((ex * dx + ey * dy) / len2, 0.0, 1.0);
+            ex -= t * dx;
+            ey -= t * dy;
+         }
+         d = ex * ex + ey * ey;
+
+         if(d > maxd)
+         {
+            maxd = d;
+            maxi = i;
+         }
+      }
+
+      if(maxi >= 0 && maxd > tol2)
+      {
+         keep[maxi] = true;
+         stack[sp++] = a;
+         stack[sp++] = maxi;
+         stack[sp++] = maxi;
+         stack[sp++] = b;
+      }
+   }
+}
+
+//
+// AM_buildLOD
+//
+// Builds the segments of one detail level from the chain table, and buckets
+// them into the grid.
+//
+static void AM_buildLOD(int lod, const int *chainfirst, int numchains,
+                        int numchainlines)
+{
+   amlodlevel_t &level = am_lods[lod];
+
+   // a level never has more segments than there are lines
+   level.segs    = estructalloc(amseg_t, emax(numchainlines, 1));
+   level.numsegs = 0;
+
+   double *px    = emalloc(double *, (numchainlines + 1) * sizeof(double));
+   double *py    = emalloc(double *, (numchainlines + 1) * sizeof(double));
+   bool   *keep  = emalloc(bool *,   (numchainlines + 1) * sizeof(bool));
+   int    *stack = emalloc(int *,    (numchainlines + 1) * 2 * sizeof(int));
+
+   for(int c = 0; c < numchains; c++)
+   {
+      int      first  = chainfirst[c];
+      int      n      = chainfirst[c + 1] - first;
+      line_t **clines = am_chainlines + first;
+
+      for(int i = 0; i < n; i++)
+      {
+         px[i] = clines[i]->v1->fx;
+         py[i] = clines[i]->v1->fy;
+      }
+      px[n] = clines[n - 1]->v2->fx;
+      py[n] = clines[n - 1]->v2->fy;
+
+      if(lod)
+         AM_simplifyChain(px, py, n + 1, am_lodtolerance[lod], keep, stack);
+      else
+      {
+         for(int i = 0; i <= n; i++)
+            keep[i] = true;
+      }
+
+      for(int a = 0; a < n; )
+      {
+         int b = a + 1;
+
+         while(!keep[b])
+            ++b;
+
+         amseg_t &seg = level.segs[level.numsegs++];
+         seg.x1        = px[a];
+         seg.y1        = py[a];
+         seg.x2        = px[b];
+         seg.y2        = py[b];
+         seg.line      = clines[a];
+         seg.firstline = first + a;
+         seg.numlines  = b - a;
+         seg.mapped    = false;
+
+         a = b;
+      }
+   }
+
+   efree(stack);
+   efree(keep);
+   efree(py);
+   efree(px);
+
+   // bucket into the grid
+   int numcells = am_gridw * am_gridh;
+   int cx1, cy1, cx2, cy2;
+
+   level.cellstart = ecalloc(int *, numcells + 1, sizeof(int));
+   level.stamps    = ecalloc(unsigned int *, emax(level.numsegs, 1),
+                             sizeof(unsigned int));
+
+   for(int s = 0; s < level.numsegs; s++)
+   {
+      const amseg_t &seg = level.segs[s];
+
+      AM_cellRange(seg.x1, seg.y1, seg.x2, seg.y2, cx1, cy1, cx2, cy2);
+
+      for(int cy = cy1; cy <= cy2; cy++)
+      {
+         for(int cx = cx1; cx <= cx2; cx++)
+            ++level.cellstart[cy * am_gridw + cx + 1];
+      }
+   }
+
+   for(int i = 0; i < numcells; i++)
+      level.cellstart[i + 1] += level.cellstart[i];
+
+   int *fill = emalloc(int *, numcells * sizeof(int));
+   memcpy(fill, level.cellstart, numcells * sizeof(int));
+
+   level.cellsegs = emalloc(int *, emax(level.cellstart[numcells], 1) * sizeof(int));
+
+   for(int s = 0; s < level.numsegs; s++)
+   {
+      const amseg_t &seg = level.segs[s];
+
+      AM_cellRange(seg.x1, seg.y1, seg.x2, seg.y2, cx1, cy1, cx2, cy2);
+
+      for(int cy = cy1; cy <= cy2; cy++)
+      {
+         for(int cx = cx1; cx <= cx2; cx++)
+            level.cellsegs[fill[cy * am_gridw + cx]++] = s;
+      }
+   }
+
+   efree(fill);
+}
+
+//
+// AM_buildLineIndex
+//
+// Sorts the static lines of the level into chains, sets up the grid, and
+// builds every detail level.
+//
+static void AM_buildLineIndex()
+{
+   AM_ClearLineIndex();
+
+   // find the polyobject lines, which are handled separately
+   bool *ispoly = ecalloc(bool *, emax(numlines, 1), sizeof(bool));
+
+   for(int i = 0; i < numPolyObjects; i++)
+   {
+      for(int j = 0; j < PolyObjects[i].numLines; j++)
+      {
+         int linenum = static_cast<int>(PolyObjects[i].lines[j] - lines);
+
+         if(!ispoly[linenum])
+         {
+            ispoly[linenum] = true;
+            ++am_numpolysegs;
+         }
+      }
+   }
+
+   am_polysegs = estructalloc(amseg_t, emax(am_numpolysegs, 1));
+   am_numpolysegs = 0;
+
+   for(int i = 0; i < numlines; i++)
+   {
+      if(ispoly[i])
+      {
+         amseg_t &seg = am_polysegs[am_numpolysegs++];
+         seg.line      = &lines[i];
+         seg.firstline = -1;
+         seg.numlines  = 1;
+      }
+   }
+
+   // link each line to the next one in a chain, through vertices shared by
+   // exactly two compatible lines
+   int *next = emalloc(int *, emax(numlines, 1) * sizeof(int));
+   int *prev = emalloc(int *, emax(numlines, 1) * sizeof(int));
+
+   for(int i = 0; i < numlines; i++)
+      next[i] = prev[i] = -1;
+
+   for(int i = 0; i < numlines; i++)
+   {
+      if(ispoly[i])
+         continue;
+
+      // find the other line at the end of this one, if there is just one
+      int vnum = static_cast<int>(lines[i].v2 - vertexes);
+      int deg  = 0;
+      int j    = i;
+
+      for(int k = vertexlineoffs[vnum]; k < vertexlineoffs[vnum + 1]; k++)
+      {
+         const line_t *line = vertexlines[k];
+         int linenum = static_cast<int>(line - lines);
+
+         if(ispoly[linenum])
+            continue;
+         deg += line->v1 == line->v2 ? 2 : 1;
+         if(linenum != i)
+            j = linenum;
+      }
+
+      if(deg != 2)
+         continue;
+
+      if(j != i && lines[j].v1 == lines[i].v2 &&
+         AM_linesCompatible(lines[i], lines[j]))
+      {
+         next[i] = j;
+         prev[j] = i;
+      }
+   }
+
+   // walk the chains into the chain table; open chains first, from their
+   // heads, then whatever is left, which can only be closed loops
+   bool *visited    = ecalloc(bool *, emax(numlines, 1), sizeof(bool));
+   int  *chainfirst = emalloc(int *, (numlines + 1) * sizeof(int));
+   int   numchains  = 0;
+   int   pos        = 0;
+
+   am_chainlines = emalloc(line_t **, emax(numlines, 1) * sizeof(line_t *));
+
+   for(int pass = 0; pass < 2; pass++)
+   {
+      for(int i = 0; i < numlines; i++)
+      {
+         if(ispoly[i] || visited[i] || (!pass && prev[i] != -1))
+            continue;
+
+         chainfirst[numchains++] = pos;
+
+         for(int j = i; j != -1 && !visited[j]; j = next[j])
+         {
+            visited[j] = true;
+            am_chainlines[pos++] = &lines[j];
+         }
+      }
+   }
+   chainfirst[numchains] = pos;
+
+   efree(visited);
+   efree(prev);
+   efree(next);
+   efree(ispoly);
+
+   // size the grid to the static lines
+   double minx =  DBL_MAX, miny =  DBL_MAX;
+   double maxx = -DBL_MAX, maxy = -DBL_MAX;
+
+   for(int i = 0; i < pos; i++)
+   {
+      const vertex_t *const verts[2] = { am_chainlines[i]->v1, am_chainlines[i]->v2 };
+
+      for(const vertex_t *v : verts)
+      {
+         minx = emin(minx, static_cast<double>(v->fx));
+         miny = emin(miny, static_cast<double>(v->fy));
+         maxx = emax(maxx, static_cast<double>(v->fx));
+         maxy = emax(maxy, static_cast<double>(v->fy));
+      }
+   }
+
+   if(!pos)
+      minx = miny = maxx = maxy = 0.0;
+
+   double w = emax(maxx - minx, 1.0);
+   double h = emax(maxy - miny, 1.0);
+
+   am_cellsize = sqrt(w * h / emax(pos / AM_LINESPERCELL, 1));
+   am_cellsize = emax(am_cellsize, AM_MINCELLSIZE);
+
+   while((w / am_cellsize + 1) * (h / am_cellsize + 1) > AM_MAXCELLS)
+      am_cellsize *= 2.0;
+
+   am_gridx = minx;
+   am_gridy = miny;
+   am_gridw = static_cast<int>(w / am_cellsize) + 1;
+   am_gridh = static_cast<int>(h / am_cellsize) + 1;
+
+   for(int lod = 0; lod < AM_NUMLODS; lod++)
+      AM_buildLOD(lod, chainfirst, numchains, pos);
+
+   efree(chainfirst);
+
+   am_indexvalid = true;
+}
+
+//
+// AM_LineIndexLOD
+//
+// Returns the coarsest detail level whose error stays under a pixel at the
+// given automap scale.
+//
+int AM_LineIndexLOD(double scale_mtof)
+{
+   for(int lod = AM_NUMLODS - 1; lod > 0; lod--)
+   {
+      if(am_lodtolerance[lod] * scale_mtof <= AM_LODMAXERROR)
+         return lod;
+   }
+
+   return 0;
+}
+
+//
+// AM_QueryLineIndex
+//
+// Calls func once for every segment of the given detail level which may
+// intersect the box, and for every polyobject line.
+//
+void AM_QueryLineIndex(int lod, double x1, double y1, double x2, double y2,
+                       amsegfunc_t func, void *data)
+{
+   if(!am_indexvalid)
+      AM_buildLineIndex();
+
+   amlodlevel_t &level = am_lods[eclamp(lod, 0, AM_NUMLODS - 1)];
+
+   // each query has its own stamp, so that a segment spanning several cells
+   // is only reported once
+   if(++am_querystamp == 0)
+   {
+      for(amlodlevel_t &l : am_lods)
+         memset(l.stamps, 0, emax(l.numsegs, 1) * sizeof(unsigned int));
+      am_querystamp = 1;
+   }
+
+   if(x2 >= am_gridx && y2 >= am_gridy &&
+      x1 <= am_gridx + am_gridw * am_cellsize &&
+      y1 <= am_gridy + am_gridh * am_cellsize)
+   {
+      int cx1, cy1, cx2, cy2;
+
+      AM_cellRange(x1, y1, x2, y2, cx1, cy1, cx2, cy2);
+
+      for(int cy = cy1; cy <= cy2; cy++)
+      {
+         for(int cx = cx1; cx <= cx2; cx++)
+         {
+            int cell = cy * am_gridw + cx;
+
+            for(int i = level.cellstart[cell]; i < level.cellstart[cell + 1]; i++)
+            {
+               int s = level.cellsegs[i];
+
+               if(level.stamps[s] == am_querystamp)
+                  continue;
+               level.stamps[s] = am_querystamp;
+
+               func(level.segs[s], data);
+            }
+         }
+      }
+   }
+
+   for(int i = 0; i < am_numpolysegs; i++)
+   {
+      amseg_t &seg = am_polysegs[i];
+
+      seg.x1 = seg.line->v1->fx;
+      seg.y1 = seg.line->v1->fy;
+      seg.x2 = seg.line->v2->fx;
+      seg.y2 = seg.line->v2->fy;
+
+      func(seg, data);
+   }
+}
+
+//
+// AM_SegMapped
+//
+// Returns an amsegmapped_e value telling how many of the lines merged into
+// a segment the player has seen.
+//
+int AM_SegMapped(amseg_t &seg)
+{
+   if(seg.mapped)
+      return AM_SEGMAPPED;
+
+   int count = 0;
+
+   for(int i = 0; i < seg.numlines; i++)
+   {
+      if(AM_SegLine(seg, i)->flags & ML_MAPPED)
+         ++count;
+   }
+
+   if(count < seg.numlines)
+      return count ? AM_SEGPARTMAPPED : AM_SEGUNMAPPED;
+
+   // lines are never unmapped during a level
+   seg.mapped = true;
+   return AM_SEGMAPPED;
+}
+
+//
+// AM_SegLine
+//
+// Returns line i of the lines merged into a segment, in chain order.
+//
+const line_t *AM_SegLine(const amseg_t &seg, int i)
+{
+   return seg.firstline < 0 ? seg.line : am_chainlines[seg.firstline + i];
+}
+
+// EOF
+
@@ -0,0 +1,70 @@
+//
+// The Eternity Engine
+// Copyright (C) 2018 James Haley et al.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see http://www.gnu.org/licenses/
+//
+// Additional terms and conditions compatible with the GPLv3 apply. See the
+// file COPYING-EE for details.
+//
+// Purpose: Spatial index of level lines for the automap, with simplified
+//  line sets for zoomed-out views.
+//
+
+#ifndef AM_INDEX_H__
+#define AM_INDEX_H__
+
+struct line_t;
+
+// number of detail levels; level 0 holds every line unchanged
+#define AM_NUMLODS 4
+
+//
+// amseg_t
+//
+// A line as the automap draws it. At level 0 each segment is one linedef. At
+// coarser levels, runs of connected lines that would always be drawn in the
+// same colour are merged into segments that stay within the level's error
+// tolerance of the original lines.
+//
+struct amseg_t
+{
+   double  x1, y1, x2, y2; // end points in map coordinates
+   line_t *line;           // representative line; decides colour and group
+   int     firstline;      // first of the merged lines in the chain table
+   int     numlines;       // number of lines merged into this segment
+   bool    mapped;         // cached: every merged line has been seen
+};
+
+// how much of a segment the player has seen
+enum amsegmapped_e
+{
+   AM_SEGUNMAPPED,   // none of its lines
+   AM_SEGPARTMAPPED, // some of its lines; they must be drawn one by one
+   AM_SEGMAPPED      // all of its lines
+};
+
+typedef void (*amsegfunc_t)(amseg_t &seg, void *data);
+
+void AM_ClearLineIndex();
+int  AM_LineIndexLOD(double scale_mtof);
+void AM_QueryLineIndex(int lod, double x1, double y1, double x2, double y2,
+                       amsegfunc_t func, void *data);
+int  AM_SegMapped(amseg_t &seg);
+const line_t *AM_SegLine(const amseg_t &seg, int i);
+
+#endif
+
+// EOF
+
@@ -26,6 +26,7 @@
 #include "z_zone.h"
 #include "i_system.h"
 
+#include "am_index.h"
 #include "am_map.h"
 #include "c_io.h"
 #include "c_runcmd.h"
@@ -101,6 +102,9 @@ int map_secret_after;
 bool am_drawnodelines;
 bool am_dynasegs_bysubsec;
 
+// use simplified line sets when zoomed out
+bool am_lod = true;
+
 // haleyjd 07/07/04: removed key_map* variables
 
 // scale on entry
@@ -1241,6 +1245,24 @@ static bool AM_clipMline(mline_t *ml, fline_t *fl)
 // haleyjd 06/12/09: this macro is now shared by Bresenham and Wu
 #define PUTDOT(xx,yy,cc) *(VBADDRESS(&vbscreen, xx, yy)) = (cc)
 
+//
+// AM_fillRun
+//
+// Fills a horizontal run of pixels between two inclusive x coordinates, given
+// in either order.
+//
+static void AM_fillRun(int x1, int x2, int y, int color)
+{
+   if(x1 > x2)
+   {
+      int tmp = x1;
+      x1 = x2;
+      x2 = tmp;
+   }
+
+   memset(VBADDRESS(&vbscreen, x1, y), color, x2 - x1 + 1);
+}
+
 //
 // AM_drawFline()
 //
@@ -1286,15 +1308,23 @@ static void AM_drawFline(fline_t *fl, int color )
    
    if(ax > ay)
    {
+      // x-major: pixels on the same row form a run, which is filled at once
+      int runx = x;
+
       d = ay - ax/2;
       while(1)
       {
-         PUTDOT(x, y, color);
-         if(x == fl->b.x) return;
+         if(x == fl->b.x)
+         {
+            AM_fillRun(runx, x, y, color);
+            return;
+         }
          if(d >= 0)
          {
+            AM_fillRun(runx, x, y, color);
             y += sy;
             d -= ax;
+            runx = x + sx;
          }
          x += sx;
          d += ay;
@@ -1302,36 +1332,61 @@ static void AM_drawFline(fline_t *fl, int color )
    }
    else
    {
+      // y-major: step down the column through the frame buffer directly
+      byte *dest  = VBADDRESS(&vbscreen, x, y);
+      int   ystep = sy * vbscreen.pitch;
+
       d = ax - ay/2;
       while(1)
       {
-         PUTDOT(x, y, color);
+         *dest = color;
          if(y == fl->b.y) return;
          if(d >= 0)
          {
-            x += sx;
+            dest += sx;
             d -= ay;
          }
+         dest += ystep;
          y += sy;
          d += ax;
       }
    }
 }
 
+// foreground RGB of the current Wu line colour at each weight
+static unsigned int am_wufg[65];
+static int          am_wucolor = -1;
+
+//
+// AM_setWuColor
+//
+// Looks up the blending values of a colour once for all the lines drawn in
+// it, rather than once per pixel.
+//
+static void AM_setWuColor(int color)
+{
+   if(color == am_wucolor)
+      return;
+
+   for(int weight = 0; weight <= 64; weight++)
+      am_wufg[weight] = Col2RGB8[weight][color];
+
+   am_wucolor = color;
+}
+
 //
 // AM_putWuDot
 //
-// haleyjd 06/13/09: Pixel plotter for Wu line drawing.
+// haleyjd 06/13/09: Pixel plotter for Wu line drawing. Draws in the colour
+// last set with AM_setWuColor.
 //
-static void AM_putWuDot(int x, int y, int color, int weight)
+static void AM_putWuDot(int x, int y, int weight)
 {
    byte *dest = VBADDRESS(&vbscreen, x, y);
-   unsigned int *fg2rgb = Col2RGB8[weight];
-   unsigned int *bg2rgb = Col2RGB8[64 - weight];
    unsigned int fg, bg;
 
-   fg = fg2rgb[color];
-   bg = bg2rgb[*dest];
+   fg = am_wufg[weight];
+   bg = Col2RGB8[64 - weight][*dest];
    fg = (fg + bg) | 0x1f07c1f;
    *dest = RGB32k[0][0][fg & (fg >> 15)];
 }
@@ -1384,6 +1439,8 @@ static void AM_drawFlineWu(fline_t *fl, int color)
       return;
    }
 
+   AM_setWuColor(color);
+
    // draw first pixel
    PUTDOT(fl->a.x, fl->a.y, color);
 
@@ -1409,9 +1466,9 @@ static void AM_drawFlineWu(fline_t *fl, int color)
          y += 1; // advance y
 
          // the trick is in the trig!
-         AM_putWuDot(x, y, color, 
+         AM_putWuDot(x, y, 
                      finecosine[erroracc >> wu_fineshift] >> wu_fixedshift);
-         AM_putWuDot(x + xdir, y, color, 
+         AM_putWuDot(x + xdir, y, 
                      finesine[erroracc >> wu_fineshift] >> wu_fixedshift);
       }
    }
@@ -1434,9 +1491,9 @@ static void AM_drawFlineWu(fline_t *fl, int color)
          x += xdir; // advance x
 
          // the trick is in the trig!
-         AM_putWuDot(x, y, color, 
+         AM_putWuDot(x, y, 
                      finecosine[erroracc >> wu_fineshift] >> wu_fixedshift);
-         AM_putWuDot(x, y + 1, color, 
+         AM_putWuDot(x, y + 1, 
                      finesine[erroracc >> wu_fineshift] >> wu_fixedshift);
       }
    }
@@ -1469,6 +1526,95 @@ static void AM_drawMline(mline_t *ml, int color)
       AM_drawFlineWu(&fl, color); // draws it on frame buffer using fb coords
 }
 
+//
+// Line batching
+//
+// Walls are clipped as they are found, but drawn afterward grouped by colour,
+// so that each colour's blending values are looked up only once.
+//
+
+struct ambatchline_t
+{
+   fline_t fl;
+   int     color;
+};
+
+static ambatchline_t *am_batch;
+static int           *am_batchorder;
+static int            am_numbatch;
+static int            am_maxbatch;
+
+//
+// AM_batchMline
+//
+// Like AM_drawMline, but defers drawing until the next AM_flushLines.
+//
+static void AM_batchMline(mline_t *ml, int color)
+{
+   fline_t fl;
+
+   if(color == -1)  // jff 4/3/98 allow not drawing any sort of line
+      return;       // by setting its color to -1
+   if(color == 247) // jff 4/3/98 if color is 247 (xparent), use black
+      color = 0;
+
+   if(!AM_clipMline(ml, &fl))
+      return;
+
+   if(am_numbatch == am_maxbatch)
+   {
+      am_maxbatch   = am_maxbatch ? am_maxbatch * 2 : 1024;
+      am_batch      = erealloc(ambatchline_t *, am_batch, 
+                               am_maxbatch * sizeof(ambatchline_t));
+      am_batchorder = erealloc(int *, am_batchorder, am_maxbatch * sizeof(int));
+   }
+
+   am_batch[am_numbatch].fl    = fl;
+   am_batch[am_numbatch].color = color;
+   ++am_numbatch;
+}
+
+//
+// AM_flushLines
+//
+// Draws the batched lines, one colour at a time, in the order in which the
+// colours were first used.
+//
+static void AM_flushLines()
+{
+   int count[256];
+   int start[256];
+   int colors[256];
+   int numcolors = 0;
+
+   memset(count, 0, sizeof(count));
+
+   for(int i = 0; i < am_numbatch; i++)
+   {
+      int c = am_batch[i].color & 0xff;
+
+      if(!count[c]++)
+         colors[numcolors++] = c;
+   }
+
+   for(int i = 0, offset = 0; i < numcolors; i++)
+   {
+      start[colors[i]] = offset;
+      offset += count[colors[i]];
+   }
+
+   for(int i = 0; i < am_numbatch; i++)
+      am_batchorder[start[am_batch[i].color & 0xff]++] = i;
+
+   for(int i = 0; i < am_numbatch; i++)
+   {
+      ambatchline_t &bl = am_batch[am_batchorder[i]];
+      AM_drawFlineWu(&bl.fl, bl.color);
+   }
+
+   am_numbatch = 0;
+}
+
 //
 // AM_drawGrid()
 //
@@ -1675,8 +1821,10 @@ inline static bool AM_dontDraw(const line_t &line)
 }
 
 //
-// Determines visible lines, draws them.
-// This is LineDef based, not LineSeg based.
+// AM_wallColor
+//
+// Returns the color a line is drawn with, or -1 if it is not drawn at all.
+// seen is true if the line has been seen or IDDT has been used.
 //
 // jff 1/5/98 many changes in this routine
 // backward compatibility not needed, so just changes, no ifs
@@ -1690,184 +1838,269 @@ inline static bool AM_dontDraw(const line_t &line)
 // jff 4/3/98 changed mapcolor_xxxx=0 as control to disable feature
 // jff 4/3/98 changed mapcolor_xxxx=-1 to disable drawing line completely
 //
-static void AM_drawWalls()
+static int AM_wallColor(const line_t *line, bool seen)
 {
-   int i;
-   static mline_t l;
-   
-   int plrgroup = plr->mo->groupid;
-
-   // Draw overlay lines first so they will not obscure the (more important)
-   // normal map lines
-   if(mapportal_overlay && useportalgroups)
+   // if line has been seen or IDDT has been used
+   if(seen)
    {
-      for(i = 0; i < numlines; ++i)
-      {
-         const line_t *line = &lines[i];
-
-         if(line->frontsector->groupid == plrgroup)
-            continue;
-
-         l.a.x = line->v1->fx;
-         l.a.y = line->v1->fy;
-         l.b.x = line->v2->fx;
-         l.b.y = line->v2->fy;
-
-         auto link = P_GetLinkOffset(line->frontsector->groupid, plrgroup);
-
-         l.a.x += M_FixedToDouble(link->x);
-         l.a.y += M_FixedToDouble(link->y);
-         l.b.x += M_FixedToDouble(link->x);
-         l.b.y += M_FixedToDouble(link->y);
-
-         // if line has been seen or IDDT has been used
-         if(ddt_cheating || (line->flags & ML_MAPPED))
+      // check for DONTDRAW flag; those lines are only visible
+      // if using the IDDT cheat.
+      if(AM_dontDraw(*line) && !ddt_cheating)
+         return -1;
+
+      if(!line->backsector) // 1S lines
+      {            
+         if(AM_drawAsExitLine(line))
          {
-            // check for DONTDRAW flag; those lines are only visible
-            // if using the IDDT cheat.
-            if(AM_dontDraw(*line) && !ddt_cheating)
-               continue;
-
-            if(!line->backsector ||
-               AM_differentFloor(*line) || AM_differentCeiling(*line))
-            {
-               AM_drawMline(&l, mapcolor_prtl);
-            }
+            //jff 4/23/98 add exit lines to automap
+            return mapcolor_exit; // exit line
+         }            
+         else if(AM_drawAs1sSecret(line))
+         {
+            // jff 1/10/98 add new color for 1S secret sector boundary
+            return mapcolor_secr; // line bounding secret sector
          }
-         else if(plr->powers[pw_allmap]) // computermap visible lines
+         else if(AM_drawAsLockedDoor(line))
          {
-            // now draw the lines only visible because the player has computermap
-            if(!AM_dontDraw(*line)) // invisible flag lines do not show
-            {
-               if(!line->backsector ||
-                  AM_differentFloor(*line) || AM_differentCeiling(*line))
-               {
-                  AM_drawMline(&l, mapcolor_prtl);
-               }
-            }
-         } // end else if      
+            int lockColor;
+            if((lockColor = AM_DoorColor(line)) >= 0)
+               return lockColor ? lockColor : mapcolor_cchg;
+            return -1;
+         }
+         else                     //jff 2/16/98 fixed bug
+            return mapcolor_wall; // special was cleared
       }
-   }
-
-   // draw the unclipped visible portions of all lines
-   for(i = 0; i < numlines; i++)
-   {
-      const line_t *line = &lines[i];
-
-      l.a.x = line->v1->fx;
-      l.a.y = line->v1->fy;
-      l.b.x = line->v2->fx;
-      l.b.y = line->v2->fy;
-
-      if(mapportal_overlay && useportalgroups)
+      else // 2S lines
       {
-         if(line->frontsector && line->frontsector->groupid != plrgroup)
-            continue;
-
-         if(line->frontsector)
+         // jff 1/10/98 add color change for all teleporter types
+         if(AM_drawAsTeleporter(line))
+         { 
+            // teleporters
+            return mapcolor_tele;
+         }
+         else if(AM_drawAsExitLine(line))
          {
-            linkoffset_t *link = P_GetLinkOffset(line->frontsector->groupid, plrgroup);
-
-            l.a.x += M_FixedToDouble(link->x);
-            l.a.y += M_FixedToDouble(link->y);
-            l.b.x += M_FixedToDouble(link->x);
-            l.b.y += M_FixedToDouble(link->y);
+            //jff 4/23/98 add exit lines to automap
+            return mapcolor_exit;
          }
-      }
-
-      // if line has been seen or IDDT has been used
-      if(ddt_cheating || (line->flags & ML_MAPPED))
-      {
-         // check for DONTDRAW flag; those lines are only visible
-         // if using the IDDT cheat.
-         if(AM_dontDraw(*line) && !ddt_cheating)
-            continue;
-
-         if(!line->backsector) // 1S lines
-         {            
-            if(AM_drawAsExitLine(line))
-            {
-               //jff 4/23/98 add exit lines to automap
-               AM_drawMline(&l, mapcolor_exit); // exit line
-            }            
-            else if(AM_drawAs1sSecret(line))
-            {
-               // jff 1/10/98 add new color for 1S secret sector boundary
-               AM_drawMline(&l, mapcolor_secr); // line bounding secret sector
-            }
-            else if(AM_drawAsLockedDoor(line))
+         else if(AM_drawAsLockedDoor(line))
+         {
+            //jff 1/5/98 this clause implements showing keyed doors
+            if(AM_isDoorClosed(line))
             {
                int lockColor;
                if((lockColor = AM_DoorColor(line)) >= 0)
-                  AM_drawMline(&l, lockColor ? lockColor : mapcolor_cchg);
+                  return lockColor ? lockColor : mapcolor_cchg;
+               return -1;
             }
-            else                                //jff 2/16/98 fixed bug
-               AM_drawMline(&l, mapcolor_wall); // special was cleared
+            else
+               return mapcolor_cchg; // open keyed door
          }
-         else // 2S lines
+         else if(line->flags & ML_SECRET)    // secret door
          {
-            // jff 1/10/98 add color change for all teleporter types
-            if(AM_drawAsTeleporter(line))
-            { 
-               // teleporters
-               AM_drawMline(&l, mapcolor_tele);
-            }
-            else if(AM_drawAsExitLine(line))
-            {
-               //jff 4/23/98 add exit lines to automap
-               AM_drawMline(&l, mapcolor_exit);
-            }
-            else if(AM_drawAsLockedDoor(line))
-            {
-               //jff 1/5/98 this clause implements showing keyed doors
-               if(AM_isDoorClosed(line))
-               {
-                  int lockColor;
-                  if((lockColor = AM_DoorColor(line)) >= 0)
-                     AM_drawMline(&l, lockColor ? lockColor : mapcolor_cchg);
-               }
-               else
-                  AM_drawMline(&l, mapcolor_cchg); // open keyed door
-            }
-            else if(line->flags & ML_SECRET)    // secret door
-            {
-               AM_drawMline(&l, mapcolor_wall);      // wall color
-            }
-            else if(AM_drawAsClosedDoor(line))
-            {
-               AM_drawMline(&l, mapcolor_clsd); // non-secret closed door
-            } 
-            else if(AM_drawAs2sSecret(line))
-            {
-               AM_drawMline(&l, mapcolor_secr); // line bounding secret sector
-            } 
-            else if(AM_differentFloor(*line))
-            {
-               AM_drawMline(&l, mapcolor_fchg); // floor level change
-            }
-            else if(AM_differentCeiling(*line))
-            {
-               AM_drawMline(&l, mapcolor_cchg); // ceiling level change
-            }
-            else if(mapcolor_flat && ddt_cheating)
-            { 
-               AM_drawMline(&l, mapcolor_flat); // 2S lines that appear only in IDDT
-            }
+            return mapcolor_wall;      // wall color
          }
-      } 
-      else if(plr->powers[pw_allmap]) // computermap visible lines
+         else if(AM_drawAsClosedDoor(line))
+         {
+            return mapcolor_clsd; // non-secret closed door
+         } 
+         else if(AM_drawAs2sSecret(line))
+         {
+            return mapcolor_secr; // line bounding secret sector
+         } 
+         else if(AM_differentFloor(*line))
+         {
+            return mapcolor_fchg; // floor level change
+         }
+         else if(AM_differentCeiling(*line))
+         {
+            return mapcolor_cchg; // ceiling level change
+         }
+         else if(mapcolor_flat && ddt_cheating)
+         { 
+            return mapcolor_flat; // 2S lines that appear only in IDDT
+         }
+      }
+   } 
+   else if(plr->powers[pw_allmap]) // computermap visible lines
+   {
+      // now draw the lines only visible because the player has computermap
+      if(!AM_dontDraw(*line)) // invisible flag lines do not show
       {
-         // now draw the lines only visible because the player has computermap
-         if(!AM_dontDraw(*line)) // invisible flag lines do not show
+         if(mapcolor_flat || !line->backsector ||
+            AM_differentFloor(*line) || AM_differentCeiling(*line))
          {
-            if(mapcolor_flat || !line->backsector ||
-               AM_differentFloor(*line) || AM_differentCeiling(*line))
-            {
-               AM_drawMline(&l, mapcolor_unsn);
-            }
+            return mapcolor_unsn;
          }
-      } // end else if
-   } // end for
+      }
+   } // end else if
+
+   return -1;
+}
+
+//
+// AM_overlayColor
+//
+// Returns the color a line from another portal group is drawn with, or -1
+// if it is not drawn.
+//
+static int AM_overlayColor(const line_t *line, bool seen)
+{
+   // if line has been seen or IDDT has been used
+   if(seen)
+   {
+      // check for DONTDRAW flag; those lines are only visible
+      // if using the IDDT cheat.
+      if(AM_dontDraw(*line) && !ddt_cheating)
+         return -1;
+
+      if(!line->backsector ||
+         AM_differentFloor(*line) || AM_differentCeiling(*line))
+      {
+         return mapcolor_prtl;
+      }
+   }
+   else if(plr->powers[pw_allmap]) // computermap visible lines
+   {
+      // now draw the lines only visible because the player has computermap
+      if(!AM_dontDraw(*line)) // invisible flag lines do not show
+      {
+         if(!line->backsector ||
+            AM_differentFloor(*line) || AM_differentCeiling(*line))
+         {
+            return mapcolor_prtl;
+         }
+      }
+   } // end else if
+
+   return -1;
+}
+
+// parameters of one line index query made by AM_drawWalls
+struct amwallquery_t
+{
+   double dx, dy;   // portal link offset added to each line
+   int    groupid;  // only lines in front of this group; -1 for all
+   bool   overlay;  // lines belong to another portal group
+};
+
+//
+// AM_drawWallLine
+//
+// Picks the color of a line, or of a segment standing for it, and batches
+// it for drawing.
+//
+static void AM_drawWallLine(const amwallquery_t *query, const line_t *line, bool seen,
+                            double x1, double y1, double x2, double y2)
+{
+   mline_t l;
+   int     color;
+
+   if(query->overlay)
+      color = AM_overlayColor(line, seen);
+   else
+      color = AM_wallColor(line, seen);
+
+   if(color == -1)
+      return;
+
+   l.a.x = x1 + query->dx;
+   l.a.y = y1 + query->dy;
+   l.b.x = x2 + query->dx;
+   l.b.y = y2 + query->dy;
+
+   AM_batchMline(&l, color);
+}
+
+//
+// AM_drawWallSeg
+//
+// Called for each segment the line index returns. A segment merging lines
+// the player has only partly seen is drawn as its original lines instead,
+// so that the unseen ones don't show as seen.
+//
+static void AM_drawWallSeg(amseg_t &seg, void *data)
+{
+   const amwallquery_t *query = static_cast<amwallquery_t *>(data);
+   const line_t        *line  = seg.line;
+
+   if(query->groupid >= 0 && line->frontsector &&
+      line->frontsector->groupid != query->groupid)
+      return;
+
+   int mapped = ddt_cheating ? AM_SEGMAPPED : AM_SegMapped(seg);
+
+   if(mapped != AM_SEGPARTMAPPED)
+   {
+      AM_drawWallLine(query, line, mapped == AM_SEGMAPPED, seg.x1, seg.y1, seg.x2, seg.y2);
+      return;
+   }
+
+   for(int i = 0; i < seg.numlines; i++)
+   {
+      line = AM_SegLine(seg, i);
+      AM_drawWallLine(query, line, !!(line->flags & ML_MAPPED),
+                      line->v1->fx, line->v1->fy, line->v2->fx, line->v2->fy);
+   }
+}
+
+//
+// AM_queryWalls
+//
+// Draws the lines in front of a portal group, or all lines if groupid is -1,
+// that fall within the window.
+//
+static void AM_queryWalls(int lod, int groupid, int plrgroup, bool overlay)
+{
+   amwallquery_t query;
+
+   query.dx      = 0.0;
+   query.dy      = 0.0;
+   query.groupid = groupid;
+   query.overlay = overlay;
+
+   if(groupid >= 0)
+   {
+      linkoffset_t *link = P_GetLinkOffset(groupid, plrgroup);
+
+      query.dx = M_FixedToDouble(link->x);
+      query.dy = M_FixedToDouble(link->y);
+   }
+
+   // lines are shifted by the link offset, so look up the window shifted the
+   // opposite way
+   AM_QueryLineIndex(lod, m_x - query.dx, m_y - query.dy, 
+                     m_x2 - query.dx, m_y2 - query.dy, AM_drawWallSeg, &query);
+   AM_flushLines();
+}
+
+//
+// Determines visible lines, draws them.
+// This is LineDef based, not LineSeg based.
+//
+// Only lines near the window are visited, through the line index. When
+// zoomed out far enough, simplified lines are drawn in place of the real
+// ones.
+//
+static void AM_drawWalls()
+{
+   int plrgroup = plr->mo->groupid;
+   int lod      = am_lod ? AM_LineIndexLOD(scale_mtof) : 0;
+
+   if(mapportal_overlay && useportalgroups)
+   {
+      // Draw overlay lines first so they will not obscure the (more 
+      // important) normal map lines
+      for(int groupid = 0; groupid < P_PortalGroupCount(); groupid++)
+      {
+         if(groupid != plrgroup)
+            AM_queryWalls(lod, groupid, plrgroup, true);
+      }
+
+      AM_queryWalls(lod, plrgroup, plrgroup, false);
+   }
+   else
+      AM_queryWalls(lod, -1, plrgroup, false);
 }
 
 
@@ -2308,6 +2541,8 @@ void AM_Drawer()
       return;
 
    AM_clearFB(mapcolor_back);       //jff 1/5/98 background default color
+
+   am_wucolor = -1; // the palette may have changed
    
    if(automap_grid)                 // killough 2/28/98: change var name
       AM_drawGrid(mapcolor_grid);   //jff 1/7/98 grid default color
@@ -2341,6 +2576,9 @@ CONSOLE_VARIABLE(am_drawnodelines, am_drawnodelines, 0) {}
 VARIABLE_TOGGLE(am_dynasegs_bysubsec, NULL, yesno);
 CONSOLE_VARIABLE(am_dynasegs_bysubsec, am_dynasegs_bysubsec, 0) {}
 
+VARIABLE_TOGGLE(am_lod, NULL, onoff);
+CONSOLE_VARIABLE(am_lod, am_lod, 0) {}
+
 //----------------------------------------------------------------------------
 //
 // $Log: am_map.c,v $
@@ -54,6 +54,7 @@
 #include "e_fonts.h"
 #include "m_qstr.h"
 #include "v_block.h"
+#include "v_dirty.h"
 #include "v_misc.h"
 #include "v_patchfmt.h"
 
@@ -93,6 +94,14 @@ static FILE *console_log = NULL;
 static VBuffer cback;
 static bool cbackneedfree = false;
 
+// The backdrop with the visible text composed on top of it. Text is only
+// rendered again when something visible changes.
+static VBuffer  ccache;
+static VBuffer  ccache43;        // 4:3 sub-surface matching subscreen43
+static bool     ccacheneedfree = false;
+static bool     ccachevalid    = false;
+static unsigned ccachesig;       // state the composed image shows
+
 vfont_t *c_font;
 char *c_fontname;
 
@@ -132,6 +141,8 @@ void C_InitBackdrop()
 
    V_InitVBuffer(&cback, video.width, video.height, video.bitdepth);
    V_SetScaling(&cback, SCREENWIDTH, SCREENHEIGHT);
+
+   ccachevalid = false;
    
    if((lumpnum = W_CheckNumForName(lumpname)) < 0)
       return;
@@ -452,37 +463,94 @@ bool C_Responder(event_t *ev)
 // complicate the scrolling logic.
 //
 
-void C_Drawer(void)
+//
+// C_initComposeCache
+//
+// Allocates the buffer the console is composed in, at the current video size.
+//
+static void C_initComposeCache()
 {
-   int y;
-   int count;
-   int real_height;
-   static int oldscreenheight = 0;
-   static int oldscreenwidth = 0;
+   if(ccacheneedfree)
+   {
+      V_FreeVBuffer(&ccache43);
+      V_FreeVBuffer(&ccache);
+   }
+   else
+      ccacheneedfree = true;
 
-   if(!consoleactive) 
-      return;   // dont draw if not active
+   V_InitVBuffer(&ccache, video.width, video.height, video.bitdepth);
+   V_SetScaling(&ccache, SCREENWIDTH, SCREENHEIGHT);
 
-   // Check for change in screen res
-   // SoM: Check width too.
-   if(oldscreenheight != video.height || oldscreenwidth != video.width)
+   V_InitSubVBuffer(&ccache43, &ccache, subscreen43.subx, subscreen43.suby, 
+                    subscreen43.width, subscreen43.height);
+   V_SetScaling(&ccache43, SCREENWIDTH, SCREENHEIGHT);
+
+   ccachevalid = false;
+}
+
+//
+// C_inputPrompt
+//
+// Returns the prompt shown in front of the input line.
+//
+static const char *C_inputPrompt()
+{
+   if(gamestate == GS_LEVEL && !strcasecmp(players[0].name, "quasar"))
+      return altprompt;
+   else
+      return inputprompt;
+}
+
+//
+// C_visibleSignature
+//
+// Hashes everything that determines what the console shows.
+//
+static unsigned int C_visibleSignature(int real_height)
+{
+   unsigned int sig = V_HASHSEED;
+   int y, count;
+
+   sig = V_HashState(sig, Console.current_height);
+   sig = V_HashState(sig, real_height);
+   sig = V_HashState(sig, message_pos);
+   sig = V_HashState(sig, message_last);
+   sig = V_HashState(sig, Console.showprompt);
+   sig = V_HashState(sig, c_font);
+   sig = V_HashString(sig, C_inputPrompt());
+   sig = V_HashString(sig, input_point);
+
+   // same walk as in C_composeConsole
+   y = Console.current_height - 
+         ((Console.showprompt && message_pos == message_last) ? c_font->absh : 0) - 1;
+   count = message_pos;
+
+   while(1)
    {
-      C_InitBackdrop();       // re-init to the new screen size
-      oldscreenheight = video.height;
-      oldscreenwidth = video.width;
+      y -= c_font->absh;
+
+      if(--count < 0) break;
+      if(y <= -c_font->absh) break;
+
+      sig = V_HashString(sig, messages[count]);
    }
 
-   // fullscreen console for fullscreen mode
-   if(gamestate == GS_CONSOLE)
-      Console.current_height = cback.scaled ? SCREENHEIGHT : cback.height;
+   return sig;
+}
 
-   real_height = 
-      cback.scaled ? cback.y2lookup[Console.current_height - 1] + 1 : 
-                     Console.current_height;
+//
+// C_composeConsole
+//
+// Draws the backdrop and the visible text into the compose buffer.
+//
+static void C_composeConsole(int real_height)
+{
+   int y;
+   int count;
 
    // draw backdrop
    // SoM: use the VBuffer
-   V_BlitVBuffer(&vbscreen, 0, 0, &cback, 0, 
+   V_BlitVBuffer(&ccache, 0, 0, &cback, 0, 
                  cback.height - real_height, cback.width, real_height);
 
    //////////////////////////////////////////////////////////////////////
@@ -506,7 +574,7 @@ void C_Drawer(void)
       if(y <= -c_font->absh) break; // past top of screen?
       
       // draw this line
-      V_FontWriteText(c_font, messages[count], 1, y);
+      V_FontWriteText(c_font, messages[count], 1, y, &ccache43);
    }
 
    //////////////////////////////////
@@ -523,18 +591,66 @@ void C_Drawer(void)
       // if we are scrolled back, dont draw the input line
       if(message_pos == message_last)
       {
-         const char *a_prompt;
-         if(gamestate == GS_LEVEL && !strcasecmp(players[0].name, "quasar"))
-            a_prompt = altprompt;
-         else
-            a_prompt = inputprompt;
-
          psnprintf(tempstr, sizeof(tempstr), 
-                   "%s%s_", a_prompt, input_point);
+                   "%s%s_", C_inputPrompt(), input_point);
       }
       
       V_FontWriteText(c_font, tempstr, 1, 
-                      Console.current_height - c_font->absh - 1);
+                      Console.current_height - c_font->absh - 1, &ccache43);
+   }
+}
+
+void C_Drawer(void)
+{
+   int real_height;
+   bool changed = false;
+   static int oldscreenheight = 0;
+   static int oldscreenwidth = 0;
+
+   if(!consoleactive) 
+      return;   // dont draw if not active
+
+   // Check for change in screen res
+   // SoM: Check width too.
+   if(oldscreenheight != video.height || oldscreenwidth != video.width)
+   {
+      C_InitBackdrop();       // re-init to the new screen size
+      C_initComposeCache();
+      oldscreenheight = video.height;
+      oldscreenwidth = video.width;
+   }
+
+   // fullscreen console for fullscreen mode
+   if(gamestate == GS_CONSOLE)
+      Console.current_height = cback.scaled ? SCREENHEIGHT : cback.height;
+
+   real_height = 
+      cback.scaled ? cback.y2lookup[Console.current_height - 1] + 1 : 
+                     Console.current_height;
+
+   // render the text again only if something visible has changed
+   unsigned int sig = C_visibleSignature(real_height);
+
+   if(!ccachevalid || sig != ccachesig)
+   {
+      C_composeConsole(real_height);
+      ccachesig   = sig;
+      ccachevalid = true;
+      changed     = true;
+   }
+
+   // When the console is all there is, the screen still shows it unless 
+   // something else has been drawn on top. Otherwise it has to be put back
+   // over whatever was drawn underneath it this frame.
+   if(gamestate == GS_CONSOLE)
+   {
+      if(changed || V_IsDirty(&vbscreen, 0, 0, SCREENWIDTH, Console.current_height))
+         V_BlitVBuffer(&vbscreen, 0, 0, &ccache, 0, 0, ccache.width, real_height);
+   }
+   else
+   {
+      V_BlitVBuffer(&vbscreen, 0, 0, &ccache, 0, 0, ccache.width, real_height);
+      V_MarkDirty(&vbscreen, 0, 0, SCREENWIDTH, Console.current_height);
    }
 }
 
@@ -1049,5 +1165,7 @@ static void Egg()
                    FC_BROWN "my hair looks much too\n"
                    "dark in this pic.\n"
                    "oh well, have fun!\n-- fraggle", 160, 168, &cback);
+
+   ccachevalid = false;
 }
 // EOF
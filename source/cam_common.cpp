@@ -67,17 +67,16 @@
 #include "r_portal.h"
 #include "r_state.h"
 
-#define VALID_ISSET(set, i) ((set)[(i) >> 3] & (1 << ((i) & 7)))
-#define VALID_SET(set, i) ((set)[(i) >> 3] |= 1 << ((i) & 7))
-
 //
-// Constructor. Initializes dynamic structures
+// Constructor. Starts a new search in the thread's traverse context. All
+// lines are gathered before any callback runs, so a traverser started from
+// a callback can safely reuse the same context.
 //
 PathTraverser::PathTraverser(const PTDef &indef, void *incontext) :
-   trace(), def(indef), context(incontext), portalguard()
+   trace(), def(indef), context(incontext), visit(P_TraverseVisit()), 
+   portalguard()
 {
-   VALID_ALLOC(validlines, ::numlines);
-   VALID_ALLOC(validpolys, ::numPolyObjects);
+   visit.begin();
 }
 
 
@@ -147,9 +146,11 @@ bool PathTraverser::blockThingsIterator(int x, int y)
       return true;
    }
 
-   Mobj *thing = blocklinks[y * bmapwidth + x];
-   for(; thing; thing = thing->bnext)
+   BlockThingCursor cursor(x, y);
+   const blockthing_t *bt;
+   while((bt = cursor.next()))
    {
+      Mobj *thing = bt->mo;
 
       fixed_t   x1, y1;
       fixed_t   x2, y2;
@@ -206,8 +207,6 @@ bool PathTraverser::checkLine(size_t linenum)
    int s1, s2;
    divline_t dl;
 
-   VALID_SET(validlines, linenum);
-
    if(def.flags & CAM_REQUIRELINEPORTALS && !(ld->pflags & PS_PASSABLE))
       return true;
 
@@ -289,18 +288,16 @@ bool PathTraverser::blockLinesIterator(int x, int y)
       int polynum = eindex(po - PolyObjects);
 
       // if polyobj hasn't been checked
-      if(!VALID_ISSET(validpolys, polynum))
+      if(visit.visitPoly(polynum))
       {
-         VALID_SET(validpolys, polynum);
-
          for(int i = 0; i < po->numLines; ++i)
          {
             int linenum = eindex(po->lines[i] - lines);
 
-            if(VALID_ISSET(validlines, linenum))
+            if(!visit.visitLine(linenum))
                continue; // line has already been checked
 
-            if(!checkLine(po->lines[i] - ::lines))
+            if(!checkLine(linenum))
                return false;
          }
       }
@@ -325,7 +322,7 @@ bool PathTraverser::blockLinesIterator(int x, int y)
       if(linenum >= numlines)
          continue;
 
-      if(VALID_ISSET(validlines, linenum))
+      if(!visit.visitLine(linenum))
          continue; // line has already been checked
 
       if(!checkLine(linenum))
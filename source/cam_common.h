@@ -24,9 +24,7 @@
 
 #include "m_collection.h"
 #include "p_maputl.h"
-
-#define VALID_ALLOC(set, n) ((set) = ecalloc(byte *, 1, (((n) + 7) & ~7) / 8))
-#define VALID_FREE(set) efree(set)
+#include "p_visit.h"
 
 //
 // PathTraverser setup
@@ -53,11 +51,6 @@ class PathTraverser
 public:
    bool traverse(fixed_t cx, fixed_t cy, fixed_t tx, fixed_t ty);
    PathTraverser(const PTDef &indef, void *incontext);
-   ~PathTraverser()
-   {
-      VALID_FREE(validlines);
-      VALID_FREE(validpolys);
-   }
 
    divline_t trace;
 private:
@@ -68,8 +61,7 @@ private:
 
    const PTDef def;
    void *const context;
-   byte *validlines;
-   byte *validpolys;
+   VisitContext &visit; // lines and polyobjects already checked
    struct
    {
       bool hitpblock;
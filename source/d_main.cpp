@@ -80,6 +80,7 @@
 #include "s_sound.h"
 #include "st_stuff.h"
 #include "v_block.h"
+#include "v_dirty.h"
 #include "v_font.h"
 #include "v_misc.h"
 #include "v_patchfmt.h"
@@ -547,6 +548,10 @@ void D_DrawWings()
       {
          unsigned int bottom   = SCREENHEIGHT - 1;
          unsigned int statbarh = static_cast<unsigned int>(GameModeInfo->StatusBar->height);
+
+         // nothing has been drawn over the wings since they were last erased
+         if(!V_IsDirty(&vbscreen, 0, bottom - statbarh, SCREENWIDTH, statbarh + 1))
+            return;
          
          int ycoord      = vbscreen.y1lookup[bottom - statbarh];
          int blockheight = vbscreen.y2lookup[bottom] - ycoord + 1;
@@ -555,7 +560,7 @@ void D_DrawWings()
          R_VideoEraseScaled(vbscreen.width - wingwidth, ycoord, wingwidth, blockheight);
       }
    }
-   else
+   else if(gamestate != GS_CONSOLE) // the console backdrop covers the wings
    {
       V_ColorBlock(&vbscreen, GameModeInfo->blackIndex, 0, 0, wingwidth, vbscreen.height);
       V_ColorBlock(&vbscreen, GameModeInfo->blackIndex, vbscreen.width - wingwidth,
@@ -578,6 +583,7 @@ static void D_Display()
    {
       R_ExecuteSetViewSize();
       R_FillBackScreen(scaledwindow);       // redraw backscreen
+      V_MarkAllDirty();
    }
 
    // save the current screen if about to wipe
@@ -590,6 +596,12 @@ static void D_Display()
    // created by drawing patches 4:3 in higher aspect ratios.
    D_DrawWings();
 
+   // anything other than the level view or the console may have drawn 
+   // anywhere
+   if((gamestate != GS_LEVEL && gamestate != GS_CONSOLE) || 
+      gamestate != oldgamestate || inwipe)
+      V_MarkAllDirty();
+
    // haleyjd: optimization for fullscreen menu drawing -- no
    // need to do all this if the menus are going to cover it up :)
    if(!MN_CheckFullScreen())
@@ -604,11 +616,17 @@ static void D_Display()
          if(automapactive)
          {
             AM_Drawer();
+
+            // the automap covers the view border
+            V_MarkDirty(&vbscreen, 0, 0, SCREENWIDTH, 
+                        SCREENHEIGHT - GameModeInfo->StatusBar->height);
          }
          else
          {
             R_DrawViewBorder();    // redraw border
             R_RenderPlayerView(&players[displayplayer], camera);
+            V_MarkDirty(&vbscreen, scaledwindow.x, scaledwindow.y, 
+                        scaledwindow.width, scaledwindow.height);
          }
          
          ST_Drawer(scaledwindow.height == SCREENHEIGHT);  // killough 11/98
@@ -649,6 +667,8 @@ static void D_Display()
          int y = 4 + (automapactive ? 0 : scaledwindow.y);
          
          V_DrawPatch(x, y, &subscreen43, patch);
+         V_MarkDirty(&subscreen43, x - patch->leftoffset, y - patch->topoffset,
+                     patch->width, patch->height);
       }
 
       if(inwipe)
@@ -698,6 +718,8 @@ static void D_Display()
       C_Drawer();
 
    } // if(!MN_CheckFullScreen())
+   else
+      V_MarkAllDirty();
 
    // menus go directly to the screen
    MN_Drawer();         // menu is drawn even on top of everything
@@ -705,17 +727,27 @@ static void D_Display()
    
    //sf : now system independent
    if(v_ticker)
+   {
       V_FPSDrawer();
+      V_MarkAllDirty();
+   }
 
    if(d_drawfps)
+   {
       D_showDrawnFPS();
+      V_MarkAllDirty();
+   }
 
 #ifdef INSTRUMENTED
    if(printstats)
+   {
       D_showMemStats();
+      V_MarkAllDirty();
+   }
 #endif
    
    I_FinishUpdate();              // page flip or blit buffer
+   V_DirtyEndFrame();
 
    i_haltimer.EndDisplay();
 }
@@ -846,6 +846,38 @@ void TryRunTics()
    while(!d_fastrefresh && realtics <= 0 && !game_advanced);
 }
 
+//
+// D_RunHeadlessTics
+//
+// Runs up to count game tics straight away, without waiting for time to pass
+// or for ticcmds, and returns how many were run. Only for demo playback,
+// where the ticcmds come from the demo; stops early if playback ends. The
+// local command stream is moved up to the new gametic so that RunGameTics
+// can carry on from there.
+//
+int D_RunHeadlessTics(int count)
+{
+   int ran = 0;
+
+   while(ran < count && demoplayback && !advancedemo)
+   {
+      G_Ticker();
+      gametic++;
+      ++ran;
+   }
+
+   int tic = gametic / ticdup;
+
+   if(maketic < tic)
+      maketic = tic;
+   if(nettics[0] < tic)
+      nettics[0] = tic;
+   if(resendto[0] < tic)
+      resendto[0] = tic;
+
+   return ran;
+}
+
 /////////////////////////////////////////////////////
 //
 // Console Commands
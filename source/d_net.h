@@ -182,6 +182,9 @@ void D_QuitNetGame();
 // how many ticks to run?
 void TryRunTics();
 
+// run game tics at once during demo playback, for seeking
+int D_RunHeadlessTics(int count);
+
 extern bool d_fastrefresh;
 extern bool d_interpolate;
 extern bool opensocket;
@@ -766,13 +766,11 @@ fixed_t E_SectorFloorClip(sector_t *sector)
 //
 // Executes particle terrain hits.
 //
-void E_PtclTerrainHit(particle_t *p)
+void E_PtclTerrainHit(const sector_t *sector, fixed_t x, fixed_t y, fixed_t z)
 {
    ETerrain *terrain = NULL;
    ETerrainSplash *splash = NULL;
    Mobj *mo = NULL;
-   fixed_t x, y, z;
-   sector_t *sector = NULL;
 
    // particles could never hit terrain before v3.33
    if(demo_version < 333 || comp[comp_terrain])
@@ -784,8 +782,6 @@ void E_PtclTerrainHit(particle_t *p)
    if(netgame || demoplayback || demorecording)
       return;
 
-   sector = p->subsector->sector;
-
    // override with sector terrain if one is specified
    if(!(terrain = sector->floorterrain))
       terrain = TerrainTypes[sector->floorpic];
@@ -797,10 +793,6 @@ void E_PtclTerrainHit(particle_t *p)
    if(!(splash = terrain->splash))
       return;
 
-   x = p->x;
-   y = p->y;
-   z = p->z;
-
    // low mass splash -- always when possible.
    if(splash->smallclass != -1)
    {
@@ -35,7 +35,6 @@
 #include "m_fixed.h"
 
 class  Mobj;
-struct particle_t;
 struct sector_t;
 
 #ifdef NEED_EDF_DEFINITIONS
@@ -104,7 +103,7 @@ ETerrain *E_GetTerrainTypeForPt(fixed_t x, fixed_t y, int pos);
 fixed_t   E_SectorFloorClip(sector_t *sector);
 bool      E_HitWater(Mobj *thing, sector_t *sector);
 bool      E_HitFloor(Mobj *thing);
-void      E_PtclTerrainHit(particle_t *);
+void      E_PtclTerrainHit(const sector_t *sector, fixed_t x, fixed_t y, fixed_t z);
 
 #endif
 
@@ -36,6 +36,7 @@
 #include "e_ttypes.h"
 #include "e_udmf.h"
 #include "m_compare.h"
+#include "m_parallel.h"
 #include "p_scroll.h"
 #include "p_setup.h"
 #include "p_spec.h"
@@ -47,6 +48,11 @@
 #include "w_wad.h"
 #include "z_auto.h"
 
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define E_UDMF_SSE2
+#include <emmintrin.h>
+#endif
+
 // SOME CONSTANTS
 static const char DEFAULT_default[] = "@default";
 static const char DEFAULT_flat[] = "@flat";
@@ -132,12 +138,12 @@ void UDMFParser::loadSectors(UDMFSetupSettings &setupSettings) const
             (E_NormalizeFlatAngle(us.rotationceiling) *  PI / 180.0f);
 
          int scrolltype = E_StrToNumLinear(udmfscrolltypes, NUMSCROLLTYPES,
-                                           us.scroll_floor_type.constPtr());
+                                           us.scroll_floor_type);
          if(scrolltype != NUMSCROLLTYPES && (us.scroll_floor_x || us.scroll_floor_y))
             P_SpawnFloorUDMF(i, scrolltype, us.scroll_floor_x, us.scroll_floor_y);
 
          scrolltype = E_StrToNumLinear(udmfscrolltypes, NUMSCROLLTYPES,
-                                       us.scroll_ceil_type.constPtr());
+                                       us.scroll_ceil_type);
          if(scrolltype != NUMSCROLLTYPES && (us.scroll_ceil_x || us.scroll_ceil_y))
             P_SpawnCeilingUDMF(i, scrolltype, us.scroll_ceil_x, us.scroll_ceil_y);
 
@@ -158,7 +164,7 @@ void UDMFParser::loadSectors(UDMFSetupSettings &setupSettings) const
          // Damage
          ss->damage = us.damageamount;
          ss->damagemask = us.damageinterval;
-         ss->damagemod = E_DamageTypeNumForName(us.damagetype.constPtr());
+         ss->damagemod = E_DamageTypeNumForName(us.damagetype);
          // If the following flags are true for the current sector, then set the
          // appropriate damageflags to true, otherwise don't set them.
          ss->damageflags |= us.damage_endgodmode ? SDMG_ENDGODMODE : 0;
@@ -167,10 +173,10 @@ void UDMFParser::loadSectors(UDMFSetupSettings &setupSettings) const
          ss->leakiness = eclamp(us.leakiness, 0, 256);
 
          // Terrain types
-         if(us.floorterrain.strCaseCmp(DEFAULT_flat))
-            ss->floorterrain = E_TerrainForName(us.floorterrain.constPtr());
-         if (us.ceilingterrain.strCaseCmp(DEFAULT_flat))
-            ss->ceilingterrain = E_TerrainForName(us.ceilingterrain.constPtr());
+         if(strcasecmp(us.floorterrain, DEFAULT_flat))
+            ss->floorterrain = E_TerrainForName(us.floorterrain);
+         if(strcasecmp(us.ceilingterrain, DEFAULT_flat))
+            ss->ceilingterrain = E_TerrainForName(us.ceilingterrain);
 
          // Lights
          ss->floorlightdelta = static_cast<int16_t>(us.lightfloor);
@@ -191,9 +197,9 @@ void UDMFParser::loadSectors(UDMFSetupSettings &setupSettings) const
          ss->floorheight = us.heightfloor << FRACBITS;
          ss->ceilingheight = us.heightceiling << FRACBITS;
       }
-      ss->floorpic = R_FindFlat(us.texturefloor.constPtr());
+      ss->floorpic = R_FindFlat(us.texturefloor);
       P_SetSectorCeilingPic(ss,
-                            R_FindFlat(us.textureceiling.constPtr()));
+                            R_FindFlat(us.textureceiling));
       ss->lightlevel = us.lightlevel;
       ss->special = us.special;
       ss->tag = us.identifier;
@@ -204,19 +210,19 @@ void UDMFParser::loadSectors(UDMFSetupSettings &setupSettings) const
       //
       if(mNamespace == namespace_Eternity)
       {
-         if(us.colormaptop.strCaseCmp(DEFAULT_default))
+         if(strcasecmp(us.colormaptop, DEFAULT_default))
          {
-            ss->topmap    = R_ColormapNumForName(us.colormaptop.constPtr());
+            ss->topmap    = R_ColormapNumForName(us.colormaptop);
             setupSettings.setSectorFlag(i, UDMF_SECTOR_INIT_COLOR_TOP);
          }
-         if(us.colormapmid.strCaseCmp(DEFAULT_default))
+         if(strcasecmp(us.colormapmid, DEFAULT_default))
          {
-            ss->midmap    = R_ColormapNumForName(us.colormapmid.constPtr());
+            ss->midmap    = R_ColormapNumForName(us.colormapmid);
             setupSettings.setSectorFlag(i, UDMF_SECTOR_INIT_COLOR_MIDDLE);
          }
-         if(us.colormapbottom.strCaseCmp(DEFAULT_default))
+         if(strcasecmp(us.colormapbottom, DEFAULT_default))
          {
-            ss->bottommap = R_ColormapNumForName(us.colormapbottom.constPtr());
+            ss->bottommap = R_ColormapNumForName(us.colormapbottom);
             setupSettings.setSectorFlag(i, UDMF_SECTOR_INIT_COLOR_BOTTOM);
          }
 
@@ -230,9 +236,9 @@ void UDMFParser::loadSectors(UDMFSetupSettings &setupSettings) const
          ss->f_pflags |= us.portal_floor_disabled ? PF_DISABLED : 0;
          ss->f_pflags |= us.portal_floor_nopass ? PF_NOPASS : 0;
          ss->f_pflags |= us.portal_floor_norender ? PF_NORENDER : 0;
-         if(!us.portal_floor_overlaytype.strCaseCmp(RENDERSTYLE_translucent))
+         if(!strcasecmp(us.portal_floor_overlaytype, RENDERSTYLE_translucent))
             ss->f_pflags |= PS_OVERLAY;
-         else if(!us.portal_floor_overlaytype.strCaseCmp(RENDERSTYLE_add))
+         else if(!strcasecmp(us.portal_floor_overlaytype, RENDERSTYLE_add))
             ss->f_pflags |= PS_OBLENDFLAGS; // PS_OBLENDFLAGS is PS_OVERLAY | PS_ADDITIVE
          ss->f_pflags |= us.portal_floor_useglobaltex ? PS_USEGLOBALTEX : 0;
          ss->f_pflags |= us.portal_floor_attached ? PF_ATTACHEDPORTAL : 0;
@@ -246,9 +252,9 @@ void UDMFParser::loadSectors(UDMFSetupSettings &setupSettings) const
          ss->c_pflags |= us.portal_ceil_disabled ? PF_DISABLED : 0;
          ss->c_pflags |= us.portal_ceil_nopass ? PF_NOPASS : 0;
          ss->c_pflags |= us.portal_ceil_norender ? PF_NORENDER : 0;
-         if(!us.portal_ceil_overlaytype.strCaseCmp(RENDERSTYLE_translucent))
+         if(!strcasecmp(us.portal_ceil_overlaytype, RENDERSTYLE_translucent))
             ss->c_pflags |= PS_OVERLAY;
-         else if(!us.portal_ceil_overlaytype.strCaseCmp(RENDERSTYLE_add))
+         else if(!strcasecmp(us.portal_ceil_overlaytype, RENDERSTYLE_add))
             ss->c_pflags |= PS_OBLENDFLAGS; // PS_OBLENDFLAGS is PS_OVERLAY | PS_ADDITIVE
          ss->c_pflags |= us.portal_ceil_useglobaltex ? PS_USEGLOBALTEX : 0;
          ss->c_pflags |= us.portal_ceil_attached ? PF_ATTACHEDPORTAL : 0;
@@ -259,14 +265,14 @@ void UDMFParser::loadSectors(UDMFSetupSettings &setupSettings) const
          ss->ceiling_yscale = static_cast<float>(us.yscaleceiling);
 
          // Sound sequences
-         if(!us.soundsequence.empty())
+         if(*us.soundsequence)
          {
             char *endptr = nullptr;
-            long number = strtol(us.soundsequence.constPtr(), &endptr, 10);
-            if(endptr == us.soundsequence.constPtr())
+            long number = strtol(us.soundsequence, &endptr, 10);
+            if(endptr == us.soundsequence)
             {
                // We got a string then
-               const ESoundSeq_t *seq = E_SequenceForName(us.soundsequence.constPtr());
+               const ESoundSeq_t *seq = E_SequenceForName(us.soundsequence);
                if(seq)
                   ss->sndSeqID = seq->index;
             }
@@ -385,7 +391,7 @@ bool UDMFParser::loadLinedefs(UDMFSetupSettings &setupSettings)
          uld.sidefront < 0 || uld.sidefront >= numsides ||
          uld.sideback < -1 || uld.sideback >= numsides)
       {
-         mLine = uld.errorline;
+         setErrorPos(uld.errorpos);
          mColumn = 1;
          mError = "Vertex or sidedef overflow";
          return false;
@@ -401,13 +407,13 @@ bool UDMFParser::loadLinedefs(UDMFSetupSettings &setupSettings)
       if(mNamespace == namespace_Eternity)
       {
          ld->alpha = uld.alpha;
-         if(!uld.renderstyle.strCaseCmp(RENDERSTYLE_add))
+         if(!strcasecmp(uld.renderstyle, RENDERSTYLE_add))
             ld->extflags |= EX_ML_ADDITIVE;
-         if(!uld.tranmap.empty())
+         if(*uld.tranmap)
          {
-            if(uld.tranmap != "TRANMAP")
+            if(strcmp(uld.tranmap, "TRANMAP"))
             {
-               int special = W_CheckNumForName(uld.tranmap.constPtr());
+               int special = W_CheckNumForName(uld.tranmap);
                if(special < 0 || W_LumpLength(special) != 65536)
                   ld->tranlump = 0;
                else
@@ -443,15 +449,15 @@ bool UDMFParser::loadSidedefs2()
       }
       if(usd.sector < 0 || usd.sector >= numsectors)
       {
-         mLine = usd.errorline;
+         setErrorPos(usd.errorpos);
          mColumn = 1;
          mError = "Sector overflow";
          return false;
       }
       sd->sector = &sectors[usd.sector];
-      P_SetupSidedefTextures(*sd, usd.texturebottom.constPtr(),
-                             usd.texturemiddle.constPtr(),
-                             usd.texturetop.constPtr());
+      P_SetupSidedefTextures(*sd, usd.texturebottom,
+                             usd.texturemiddle,
+                             usd.texturetop);
    }
    return true;
 }
@@ -854,6 +860,399 @@ static void registerAllKeys()
    called = true;
 }
 
+//
+// Looks up a key token. Keys are short, so one that doesn't fit the buffer
+// can't be a known one anyway.
+//
+static const keytoken_t *findKey(const char *text, size_t length)
+{
+   char name[64];
+
+   if(length >= sizeof(name))
+      return nullptr;
+   memcpy(name, text, length);
+   name[length] = '\0';
+   return gTokenTable.objectForKey(name);
+}
+
+//==============================================================================
+//
+// Scanning helpers. These work directly on the TEXTMAP text, and the ones run
+// over every character look at 16 of them at a time where SSE2 is available.
+//
+//==============================================================================
+
+//
+// Returns the index of the lowest set bit of a non-zero mask
+//
+static inline int firstBit(unsigned int mask)
+{
+   int bit = 0;
+   while(!(mask & 1))
+   {
+      mask >>= 1;
+      ++bit;
+   }
+   return bit;
+}
+
+//
+// Returns the first character from p on that isn't whitespace, or end
+//
+static char *skipSpace(char *p, const char *end)
+{
+   // most tokens are only a single space apart
+   if(p != end && !ectype::isSpace(*p))
+      return p;
+
+#ifdef E_UDMF_SSE2
+   const __m128i space = _mm_set1_epi8(' ');
+   const __m128i tab   = _mm_set1_epi8('\t');
+   const __m128i four  = _mm_set1_epi8(4);   // '\t' to '\r' are whitespace
+
+   while(end - p >= 16)
+   {
+      __m128i chars = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+      __m128i ctrl  = _mm_sub_epi8(chars, tab);
+      __m128i white = _mm_or_si128(_mm_cmpeq_epi8(chars, space),
+                                   _mm_cmpeq_epi8(_mm_min_epu8(ctrl, four), ctrl));
+      unsigned int mask = ~unsigned(_mm_movemask_epi8(white)) & 0xffff;
+
+      if(mask)
+         return p + firstBit(mask);
+      p += 16;
+   }
+#endif
+
+   while(p != end && ectype::isSpace(*p))
+      ++p;
+   return p;
+}
+
+//
+// Skips the comment starting at p. Returns the position right after it, end
+// if it's never closed, or just past p if there's no comment after all.
+// One-line comments stop at their newline, which is left as whitespace.
+//
+static char *skipComment(char *p, char *end)
+{
+   if(end - p < 2)
+      return p + 1;
+
+   if(p[1] == '/')
+   {
+      auto eol = static_cast<char *>(memchr(p + 2, '\n', end - p - 2));
+      return eol ? eol : end;
+   }
+   if(p[1] == '*')
+   {
+      p += 2;
+      while((p = static_cast<char *>(memchr(p, '*', end - p))) && end - p >= 2)
+      {
+         if(p[1] == '/')
+            return p + 2;
+         ++p;
+      }
+      return end;
+   }
+   return p + 1;
+}
+
+//
+// Given the start of a string's contents, returns its closing quote, or end
+// if there is none
+//
+static char *findStringEnd(char *p, char *end)
+{
+   while(p != end && *p != '"')
+   {
+      if(*p == '\\' && ++p == end)
+         break;
+      ++p;
+   }
+   return p;
+}
+
+//
+// Returns the first '"', '/' or '}' from p on, or end
+//
+static char *findBlockMark(char *p, char *end)
+{
+#ifdef E_UDMF_SSE2
+   const __m128i quote = _mm_set1_epi8('"');
+   const __m128i slash = _mm_set1_epi8('/');
+   const __m128i brace = _mm_set1_epi8('}');
+
+   while(end - p >= 16)
+   {
+      __m128i chars = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+      __m128i marks = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(chars, quote),
+                                                _mm_cmpeq_epi8(chars, slash)),
+                                   _mm_cmpeq_epi8(chars, brace));
+      unsigned int mask = unsigned(_mm_movemask_epi8(marks));
+
+      if(mask)
+         return p + firstBit(mask);
+      p += 16;
+   }
+#endif
+
+   while(p != end && *p != '"' && *p != '/' && *p != '}')
+      ++p;
+   return p;
+}
+
+//
+// Finds the '}' closing the block whose contents start at p. Nothing but
+// strings and comments can hide a '}', so only those need to be stepped over;
+// the contents are checked properly once the block itself is read. Returns
+// end if the block isn't closed.
+//
+static char *findBlockEnd(char *p, char *end)
+{
+   while((p = findBlockMark(p, end)) != end && *p != '}')
+   {
+      if(*p == '"')
+      {
+         p = findStringEnd(p + 1, end);
+         if(p != end)
+            ++p;
+      }
+      else
+         p = skipComment(p, end);
+   }
+   return p;
+}
+
+//
+// Reads a number at p. Returns the position after it, or p itself if there
+// is no number there. Plain decimal integers, by far the most common kind in
+// a TEXTMAP, are converted directly; anything else goes through strtod.
+//
+static char *scanNumber(char *p, double &number)
+{
+   char *digits = p + (*p == '-' || *p == '+');
+   char *q = digits;
+   int64_t value = 0;
+
+   // only digits, '.' and the "inf" or "nan" of strtod can follow the sign
+   if(!ectype::isDigit(*digits) && *digits != '.' && ectype::toUpper(*digits) != 'I' &&
+      ectype::toUpper(*digits) != 'N')
+   {
+      return p;
+   }
+
+   while(ectype::isDigit(*q) && q - digits < 15)
+      value = value * 10 + (*q++ - '0');
+
+   if(q != digits && !ectype::isDigit(*q) && *q != '.' && *q != 'e' && *q != 'E' &&
+      *q != 'x' && *q != 'X')
+   {
+      number = static_cast<double>(*p == '-' ? -value : value);
+      return q;
+   }
+
+   number = strtod(p, &q);
+   return q;
+}
+
+//==============================================================================
+//
+// Tokens and readers
+//
+//==============================================================================
+
+//
+// Case-insensitive comparison of the token text
+//
+bool UDMFParser::Token::textIs(const char *str) const
+{
+   return !strncasecmp(text, str, length) && !str[length];
+}
+
+//
+// Copies the token text, with escapes resolved
+//
+void UDMFParser::Token::getText(qstring &out) const
+{
+   out.clear();
+   for(size_t i = 0; i < length; ++i)
+   {
+      if(escaped && text[i] == '\\' && ++i == length)
+         break;
+      out.Putc(text[i]);
+   }
+}
+
+//
+// Resolves escapes in place and terminates the text, so that it can be kept
+// as a C string. This writes over mData, so it may only be done to a value
+// that has been read for good.
+//
+const char *UDMFParser::Token::terminate()
+{
+   char *out = text + length;
+
+   if(escaped)
+   {
+      out = text;
+      for(size_t i = 0; i < length; ++i)
+      {
+         if(text[i] == '\\' && ++i == length)
+            break;
+         *out++ = text[i];
+      }
+      // Blank what's left, so that newlines aren't counted twice when
+      // locating errors
+      for(char *c = out; c < text + length; ++c)
+         *c = ' ';
+      escaped = false;
+   }
+
+   *out = '\0';   // the closing quote, if not a leftover
+   length = out - text;
+   return text;
+}
+
+//
+// Reads a line or block item
+//
+UDMFParser::readresult_e UDMFParser::Reader::readItem()
+{
+   Token token;
+   if(!next(token))
+      return result_Eof;
+
+   if(token.type == Token::type_Symbol && token.symbol == '}')
+   {
+      if(inblock)
+      {
+         inblock = false;
+         return result_BlockExit;
+      }
+      // not in block: error
+      error = "Unexpected '}'";
+      return result_Error;
+   }
+
+   if(token.type != Token::type_Keyword)
+   {
+      error = "Expected a keyword";
+      return result_Error;
+   }
+   key = token;
+
+   if(!next(token) || token.type != Token::type_Symbol ||
+      (token.symbol != '=' && token.symbol != '{'))
+   {
+      error = "Expected '=' or '{'";
+      return result_Error;
+   }
+
+   if(token.symbol == '=')
+   {
+      // assignment
+      if(!next(token) || (token.type != Token::type_Keyword &&
+         token.type != Token::type_String && token.type != Token::type_Number))
+      {
+         error = "Expected a number, string or true/false";
+         return result_Error;
+      }
+
+      if(token.type == Token::type_Keyword && !token.textIs("true") &&
+         !token.textIs("false"))
+      {
+         error = "Identifier can only be true or false";
+         return result_Error;
+      }
+      value = token;
+
+      if(!next(token) || token.type != Token::type_Symbol ||
+         token.symbol != ';')
+      {
+         error = "Expected ; after assignment";
+         return result_Error;
+      }
+
+      return result_Assignment;
+   }
+   else  // {
+   {
+      // block
+      if(!inblock)
+      {
+         inblock = true;
+         return result_BlockEntry;
+      }
+      else
+      {
+         error = "Blocks cannot be nested";
+         return result_Error;
+      }
+   }
+}
+
+//
+// Gets the next token. Returns false if EOF. It will not return false if
+// there's something to return
+//
+bool UDMFParser::Reader::next(Token &token)
+{
+   // Skip all leading whitespace and comments
+   for(;;)
+   {
+      pos = skipSpace(pos, end);
+      if(pos == end)
+         return false;
+      if(*pos != '/' || pos + 1 == end || (pos[1] != '/' && pos[1] != '*'))
+         break;
+      pos = skipComment(pos, end);
+   }
+
+   // now we're clear from whitespaces and comments
+
+   // Check for number
+   double number;
+   char *result = scanNumber(pos, number);
+   if(result > pos)  // we have something
+   {
+      token.type = Token::type_Number;
+      token.number = number;
+      pos = result;
+      return true;
+   }
+
+   // Check for string. Escapes are only resolved if the string gets used.
+   if(*pos == '"')
+   {
+      token.type = Token::type_String;
+      token.text = pos + 1;
+      pos = findStringEnd(token.text, end);
+      token.length = pos - token.text;
+      token.escaped = memchr(token.text, '\\', token.length) != nullptr;
+      if(pos != end)
+         ++pos;   // skip the quote
+      return true;
+   }
+
+   // keyword: start with a letter or _
+   if(ectype::isAlpha(*pos) || *pos == '_')
+   {
+      token.type = Token::type_Keyword;
+      token.text = pos;
+      while(pos != end && (ectype::isAlnum(*pos) || *pos == '_'))
+         ++pos;
+      token.length = pos - token.text;
+      return true;
+   }
+
+   // symbol. Just put one character
+   token.type = Token::type_Symbol;
+   token.symbol = *pos++;
+
+   return true;
+}
+
 //
 // Looks for "ee_compat = true;" in the TEXTMAP in order to accept unknown name-
 // spaces as Eternity-compatible. Useful to support arbitrary namespaces which
@@ -863,38 +1262,37 @@ static void registerAllKeys()
 bool UDMFParser::checkForCompatibilityFlag(qstring nstext)
 {
    // ano - read over the file looking for `ee_compat="true"`
+   Reader reader(mData.getBuffer(), mData.getBuffer() + mData.length());
    readresult_e result;
    bool eecompatfound = false;
-   // nstext needs to be copied, as contents of it gets overwritten before it's used.
-   qstring nstextcopy(nstext);
 
-   while((result = readItem()) != result_Eof)
+   while((result = reader.readItem()) != result_Eof)
    {
       if(result == result_Error)
       {
+         setErrorPos(reader.pos - mData.constPtr());
          mError = "UDMF error while checking unsupported namespace '";
-         mError << nstextcopy;
+         mError << nstext;
          mError << "'";
          return false;
       }
 
       if(result == result_Assignment &&
-         !mInBlock &&
-         mKey.strCaseCmp("ee_compat") == 0 &&
-         mValue.type == Token::type_Keyword &&
-         ectype::toUpper(mValue.text[0]) == 'T')
+         !reader.inblock &&
+         reader.key.textIs("ee_compat") &&
+         reader.value.type == Token::type_Keyword &&
+         ectype::toUpper(reader.value.text[0]) == 'T')
       {
          eecompatfound = true;
-         break; // while ((result = readItem()) != result_Eof)
+         break; // while ((result = reader.readItem()) != result_Eof)
       }
    } // while
 
-   reset(); // make sure to reset the cursor after we find the field
-
    if(!eecompatfound)
    {
+      setErrorPos(0);
       mError = "Unsupported namespace '";
-      mError << nstextcopy;
+      mError << nstext;
       mError << "'";
       return false;
    }
@@ -903,10 +1301,17 @@ bool UDMFParser::checkForCompatibilityFlag(qstring nstext)
    return true;
 }
 
+// Number of blocks given to a worker thread at a time
+#define BLOCKS_PER_RANGE 512
+
 //
 // Tries to parse a UDMF TEXTMAP document. If it fails, it returns false and
 // you can check the error message with error()
 //
+// The top level is read here, but blocks are only skipped over. Their
+// contents are read afterwards, spread over the worker threads, straight
+// into item arrays which are sized for them by then.
+//
 bool UDMFParser::parse(WadDirectory &setupwad, int lump)
 {
    {
@@ -919,402 +1324,512 @@ bool UDMFParser::parse(WadDirectory &setupwad, int lump)
       setData(data, setupwad.lumpLength(lump));
    }
 
-   readresult_e result = readItem();
+   char *data = mData.getBuffer();
+   Reader reader(data, data + mData.length());
+
+   readresult_e result = reader.readItem();
    if(result == result_Error)
+   {
+      setErrorPos(reader.pos - data);
+      mError = reader.error;
       return false;
-   if(result != result_Assignment || mKey.strCaseCmp("namespace") ||
-      mValue.type != Token::type_String)
+   }
+   if(result != result_Assignment || !reader.key.textIs("namespace") ||
+      reader.value.type != Token::type_String)
    {
+      setErrorPos(reader.pos - data);
       mError = "TEXTMAP must begin with a namespace assignment";
       return false;
    }
 
    // Set namespace
-   if(!mValue.text.strCaseCmp("eternity"))
+   qstring nstext;
+   reader.value.getText(nstext);
+   if(!nstext.strCaseCmp("eternity"))
       mNamespace = namespace_Eternity;
-   else if(!mValue.text.strCaseCmp("heretic"))
+   else if(!nstext.strCaseCmp("heretic"))
       mNamespace = namespace_Heretic;
-   else if(!mValue.text.strCaseCmp("hexen"))
+   else if(!nstext.strCaseCmp("hexen"))
       mNamespace = namespace_Hexen;
-   else if(!mValue.text.strCaseCmp("strife"))
+   else if(!nstext.strCaseCmp("strife"))
       mNamespace = namespace_Strife;
-   else if(!mValue.text.strCaseCmp("doom"))
+   else if(!nstext.strCaseCmp("doom"))
       mNamespace = namespace_Doom;
-   else if(!checkForCompatibilityFlag(mValue.text))
+   else if(!checkForCompatibilityFlag(nstext))
       return false;
 
-   // Gamestuff. Must be null when out of block and only one be set when in
-   // block
-   ULinedef *linedef = nullptr;
-   USidedef *sidedef = nullptr;
-   uvertex_t *vertex = nullptr;
-   USector *sector = nullptr;
-   uthing_t *thing = nullptr;
-
    registerAllKeys();   // now it's the time
 
-   while((result = readItem()) != result_Eof)
+   static const char *const blocknames[block_Other] =
+   {
+      "linedef", "sidedef", "vertex", "sector", "thing"
+   };
+   int counts[NUMBLOCKKINDS] = {};
+   const char *error = nullptr;
+   size_t errorpos = 0;
+
+   while((result = reader.readItem()) != result_Eof)
    {
       if(result == result_Error)
-         return false;
-      if(result == result_BlockEntry)
       {
-         // we're now in some block. Alloc stuff
-         if(!mBlockName.strCaseCmp("linedef"))
-         {
-            linedef = &mLinedefs.addNew();
-            linedef->errorline = mLine;
-            linedef->renderstyle = RENDERSTYLE_translucent;
-         }
-         else if(!mBlockName.strCaseCmp("sidedef"))
-         {
-            sidedef = &mSidedefs.addNew();
-            sidedef->texturetop = "-";
-            sidedef->texturebottom = "-";
-            sidedef->texturemiddle = "-";
-            sidedef->errorline = mLine;
-         }
-         else if(!mBlockName.strCaseCmp("vertex"))
-            vertex = &mVertices.addNew();
-         else if(!mBlockName.strCaseCmp("sector"))
-            sector = &mSectors.addNew();
-         else if(!mBlockName.strCaseCmp("thing"))
+         // Blocks before this point get read all the same, since an error in
+         // them would have come first.
+         error = reader.error;
+         errorpos = reader.pos - data;
+         break;
+      }
+      if(result != result_BlockEntry)
+         continue;
+
+      udmfblock_t &block = mBlocks.addNew();
+      block.kind = block_Other;
+      for(int kind = 0; kind < block_Other; ++kind)
+      {
+         if(reader.key.textIs(blocknames[kind]))
          {
-            thing = &mThings.addNew();
-            thing->health = 1.0;
+            block.kind = static_cast<blockkind_e>(kind);
+            break;
          }
-         continue;
       }
-      if(result == result_Assignment && mInBlock)
+      block.index = counts[block.kind]++;
+      block.start = reader.pos;
+
+      reader.pos = findBlockEnd(reader.pos, reader.end);
+      if(reader.pos != reader.end)
+         ++reader.pos;
+      reader.inblock = false;
+      block.end = reader.pos;
+   }
+
+   mLinedefs.resize(counts[block_Linedef]);
+   mSidedefs.resize(counts[block_Sidedef]);
+   mVertices.resize(counts[block_Vertex]);
+   mSectors.resize(counts[block_Sector]);
+   mThings.resize(counts[block_Thing]);
+
+   int numblocks = static_cast<int>(mBlocks.getLength());
+   M_ParallelFor((numblocks + BLOCKS_PER_RANGE - 1) / BLOCKS_PER_RANGE, readBlockRange,
+                 this);
+
+   // Report whichever error comes first in the text
+   for(const udmfblock_t &block : mBlocks)
+   {
+      if(block.error)
       {
+         error = block.error;
+         errorpos = block.errorpos;
+         break;
+      }
+   }
+   mBlocks.clear();
 
-#define REQUIRE_INT(obj, field, flag) case t_##field: requireInt(obj->field, obj->flag); break
-#define READ_NUMBER(obj, field) case t_##field: readNumber(obj->field); break
-#define READ_BOOL(obj, field) case t_##field: readBool(obj->field); break
-#define READ_STRING(obj, field) case t_##field: readString(obj->field); break
-#define READ_FIXED(obj, field) case t_##field: readFixed(obj->field); break
-#define REQUIRE_FIXED(obj, field, flag) case t_##field: requireFixed(obj->field, obj->flag); break
+   if(error)
+   {
+      setErrorPos(errorpos);
+      mError = error;
+      return false;
+   }
 
-         const keytoken_t *kt = gTokenTable.objectForKey(mKey.constPtr());
-         if(kt)
-         {
-            if(linedef)
-            {
-               switch(kt->token)
-               {
-                  case t_id: readNumber(linedef->identifier); break;
-                  REQUIRE_INT(linedef, v1, v1set);
-                  REQUIRE_INT(linedef, v2, v2set);
-                  REQUIRE_INT(linedef, sidefront, sfrontset);
-                  READ_NUMBER(linedef, sideback);
-                  READ_BOOL(linedef, blocking);
-                  READ_BOOL(linedef, blockmonsters);
-                  READ_BOOL(linedef, twosided);
-                  READ_BOOL(linedef, dontpegtop);
-                  READ_BOOL(linedef, dontpegbottom);
-                  READ_BOOL(linedef, secret);
-                  READ_BOOL(linedef, blocksound);
-                  READ_BOOL(linedef, dontdraw);
-                  READ_BOOL(linedef, mapped);
-                  case t_passuse:
-                        readBool(linedef->passuse);
-                     break;
-                  case t_translucent:
-                        readBool(linedef->translucent);
-                     break;
-                  case t_jumpover:
-                        readBool(linedef->jumpover);
-                     break;
-                  case t_blockfloaters:
-                        readBool(linedef->blockfloaters);
-                     break;
-                  READ_NUMBER(linedef, special);
-                  case t_arg0: readNumber(linedef->arg[0]); break;
-                  case t_arg1: readNumber(linedef->arg[1]); break;
-                  case t_arg2: readNumber(linedef->arg[2]); break;
-                  case t_arg3: readNumber(linedef->arg[3]); break;
-                  case t_arg4: readNumber(linedef->arg[4]); break;
-                  READ_BOOL(linedef, playercross);
-                  READ_BOOL(linedef, playeruse);
-                  READ_BOOL(linedef, monstercross);
-                  READ_BOOL(linedef, monsteruse);
-                  READ_BOOL(linedef, impact);
-                  READ_BOOL(linedef, playerpush);
-                  READ_BOOL(linedef, monsterpush);
-                  READ_BOOL(linedef, missilecross);
-                  READ_BOOL(linedef, repeatspecial);
-                  READ_BOOL(linedef, polycross);
-
-                  READ_BOOL(linedef, midtex3d);
-                  READ_BOOL(linedef, midtex3dimpassible);
-                  READ_BOOL(linedef, firstsideonly);
-                  READ_BOOL(linedef, blockeverything);
-                  READ_BOOL(linedef, zoneboundary);
-                  READ_BOOL(linedef, clipmidtex);
-                  READ_BOOL(linedef, lowerportal);
-                  READ_BOOL(linedef, upperportal);
-                  READ_NUMBER(linedef, portal);
-                  READ_NUMBER(linedef, alpha);
-                  READ_STRING(linedef, renderstyle);
-                  READ_STRING(linedef, tranmap);
-                  default:
-                     break;
-               }
+   return true;
+}
 
-            }
-            else if(sidedef)
-            {
-               switch(kt->token)
-               {
-                  case t_offsetx:
-                     if(mNamespace == namespace_Eternity)
-                        readFixed(sidedef->offsetx);
-                     else
-                        readNumber(sidedef->offsetx);
-                     break;
-                  case t_offsety:
-                     if(mNamespace == namespace_Eternity)
-                        readFixed(sidedef->offsety);
-                     else
-                        readNumber(sidedef->offsety);
-                     break;
-                  READ_STRING(sidedef, texturetop);
-                  READ_STRING(sidedef, texturebottom);
-                  READ_STRING(sidedef, texturemiddle);
-                  REQUIRE_INT(sidedef, sector, sset);
-                  default:
-                     break;
-               }
-            }
-            else if(vertex)
-            {
-               if(kt->token == t_x)
-                  requireFixed(vertex->x, vertex->xset);
-               else if(kt->token == t_y)
-                  requireFixed(vertex->y, vertex->yset);
-            }
-            else if(sector)
-            {
-               switch(kt->token)
-               {
-                  case t_texturefloor:
-                     requireString(sector->texturefloor, sector->tfloorset);
-                     break;
-                  case t_textureceiling:
-                     requireString(sector->textureceiling, sector->tceilset);
-                     break;
-                  READ_NUMBER(sector, lightlevel);
-                  READ_NUMBER(sector, special);
-                  case t_id:
-                     readNumber(sector->identifier);
-                     break;
-                  case t_heightfloor:
-                     if(mNamespace != namespace_Eternity)
-                        readNumber(sector->heightfloor);
-                     else
-                        readFixed(sector->heightfloor);
-                     break;
-                  case t_heightceiling:
-                     if(mNamespace != namespace_Eternity)
-                        readNumber(sector->heightceiling);
-                     else
-                        readFixed(sector->heightceiling);
-                  default:
-                     break;
-               }
-               if(mNamespace == namespace_Eternity)
-               {
-                  switch(kt->token)
-                  {
-                     READ_FIXED(sector, xpanningfloor);
-                     READ_FIXED(sector, ypanningfloor);
-                     READ_FIXED(sector, xpanningceiling);
-                     READ_FIXED(sector, ypanningceiling);
-                     READ_NUMBER(sector, xscaleceiling);
-                     READ_NUMBER(sector, xscalefloor);
-                     READ_NUMBER(sector, yscaleceiling);
-                     READ_NUMBER(sector, yscalefloor);
-                     READ_NUMBER(sector, rotationfloor);
-                     READ_NUMBER(sector, rotationceiling);
-
-                     READ_NUMBER(sector, scroll_ceil_x);
-                     READ_NUMBER(sector, scroll_ceil_y);
-                     READ_STRING(sector, scroll_ceil_type);
-
-                     READ_NUMBER(sector, scroll_floor_x);
-                     READ_NUMBER(sector, scroll_floor_y);
-                     READ_STRING(sector, scroll_floor_type);
-
-                     READ_BOOL(sector, secret);
-                     READ_NUMBER(sector, friction);
-
-                     READ_NUMBER(sector, lightfloor);
-                     READ_NUMBER(sector, lightceiling);
-                     READ_BOOL(sector, lightfloorabsolute);
-                     READ_BOOL(sector, lightceilingabsolute);
-
-                     READ_STRING(sector, colormaptop);
-                     READ_STRING(sector, colormapmid);
-                     READ_STRING(sector, colormapbottom);
-
-                     READ_NUMBER(sector, leakiness);
-                     READ_NUMBER(sector, damageamount);
-                     READ_NUMBER(sector, damageinterval);
-                     READ_BOOL(sector, damage_endgodmode);
-                     READ_BOOL(sector, damage_exitlevel);
-                     READ_BOOL(sector, damageterraineffect);
-                     READ_STRING(sector, damagetype);
-
-                     READ_STRING(sector, floorterrain);
-                     READ_STRING(sector, ceilingterrain);
-
-                     READ_NUMBER(sector, floorid);
-                     READ_NUMBER(sector, ceilingid);
-                     READ_NUMBER(sector, attachfloor);
-                     READ_NUMBER(sector, attachceiling);
-
-                     READ_STRING(sector, soundsequence);
-
-                     READ_STRING(sector, portal_floor_overlaytype);
-                     READ_NUMBER(sector, alphafloor);
-                     READ_BOOL(sector, portal_floor_blocksound);
-                     READ_BOOL(sector, portal_floor_disabled);
-                     READ_BOOL(sector, portal_floor_nopass);
-                     READ_BOOL(sector, portal_floor_norender);
-                     READ_BOOL(sector, portal_floor_useglobaltex);
-                     READ_BOOL(sector, portal_floor_attached);
-
-                     READ_STRING(sector, portal_ceil_overlaytype);
-                     READ_NUMBER(sector, alphaceiling);
-                     READ_BOOL(sector, portal_ceil_blocksound);
-                     READ_BOOL(sector, portal_ceil_disabled);
-                     READ_BOOL(sector, portal_ceil_nopass);
-                     READ_BOOL(sector, portal_ceil_norender);
-                     READ_BOOL(sector, portal_ceil_useglobaltex);
-                     READ_BOOL(sector, portal_ceil_attached);
-
-                     READ_NUMBER(sector, portalceiling);
-                     READ_NUMBER(sector, portalfloor);
-                     default:
-                        break;
-                  }
-               }
-            }
-            else if(thing)
-            {
-               switch(kt->token)
-               {
-                  case t_id: readNumber(thing->identifier); break;
-                  REQUIRE_FIXED(thing, x, xset);
-                  REQUIRE_FIXED(thing, y, yset);
-                  READ_FIXED(thing, height);
-                  READ_NUMBER(thing, angle);
-                  REQUIRE_INT(thing, type, typeset);
-                  READ_BOOL(thing, skill1);
-                  READ_BOOL(thing, skill2);
-                  READ_BOOL(thing, skill3);
-                  READ_BOOL(thing, skill4);
-                  READ_BOOL(thing, skill5);
-                  READ_BOOL(thing, ambush);
-                  READ_BOOL(thing, single);
-                  READ_BOOL(thing, dm);
-                  READ_BOOL(thing, coop);
-                  case t_friend:
-                        readBool(thing->friendly);
-                     break;
-                  READ_BOOL(thing, dormant);
-                  READ_BOOL(thing, class1);
-                  READ_BOOL(thing, class2);
-                  READ_BOOL(thing, class3);
-                  READ_BOOL(thing, standing);
-                  READ_BOOL(thing, strifeally);
-                  READ_BOOL(thing, translucent);
-                  READ_BOOL(thing, invisible);
-                  case t_special:
-                        readNumber(thing->special);
-                     break;
-                  case t_arg0:
-                        readNumber(thing->arg[0]);
-                     break;
-                  case t_arg1:
-                        readNumber(thing->arg[1]);
-                     break;
-                  case t_arg2:
-                        readNumber(thing->arg[2]);
-                     break;
-                  case t_arg3:
-                        readNumber(thing->arg[3]);
-                     break;
-                  case t_arg4:
-                        readNumber(thing->arg[4]);
-                     break;
-                  default:
-                     break;
-               }
-               if(mNamespace == namespace_Eternity)
-               {
-                  switch(kt->token)
-                  {
-                     READ_NUMBER(thing, health);
-                     default:
-                        break;
-                  }
-               }
-            }
-         }
-         continue;
+//
+// Worker thread job: reads one range of blocks
+//
+void UDMFParser::readBlockRange(int index, int worker, void *data)
+{
+   auto parser = static_cast<UDMFParser *>(data);
+   size_t first = static_cast<size_t>(index) * BLOCKS_PER_RANGE;
+   size_t last = emin(first + BLOCKS_PER_RANGE, parser->mBlocks.getLength());
+
+   for(size_t i = first; i < last; ++i)
+      parser->readBlock(parser->mBlocks[i]);
+}
+
+//
+// Reads a block into its item. Only the block's own stretch of mData and its
+// own item get touched, so blocks can be read on any thread and in any order.
+// Errors are kept in the block.
+//
+void UDMFParser::readBlock(udmfblock_t &block)
+{
+   // Gamestuff. Only the one of the block's kind gets set
+   ULinedef *linedef = nullptr;
+   USidedef *sidedef = nullptr;
+   uvertex_t *vertex = nullptr;
+   USector *sector = nullptr;
+   uthing_t *thing = nullptr;
+
+   // Items start out zeroed, so only set what defaults otherwise
+   switch(block.kind)
+   {
+   case block_Linedef:
+      linedef = &mLinedefs[block.index];
+      linedef->identifier = -1;
+      linedef->sideback = -1;
+      linedef->alpha = 1;
+      linedef->renderstyle = RENDERSTYLE_translucent;
+      linedef->tranmap = "";
+      linedef->errorpos = block.start - mData.constPtr();
+      break;
+   case block_Sidedef:
+      sidedef = &mSidedefs[block.index];
+      sidedef->texturetop = "-";
+      sidedef->texturebottom = "-";
+      sidedef->texturemiddle = "-";
+      sidedef->errorpos = block.start - mData.constPtr();
+      break;
+   case block_Vertex:
+      vertex = &mVertices[block.index];
+      break;
+   case block_Sector:
+      sector = &mSectors[block.index];
+      sector->xscalefloor = 1.0;
+      sector->yscalefloor = 1.0;
+      sector->xscaleceiling = 1.0;
+      sector->yscaleceiling = 1.0;
+      sector->scroll_ceil_type = "none";
+      sector->scroll_floor_type = "none";
+      sector->friction = -1;
+      sector->damageinterval = 32;
+      sector->damagetype = "Unknown";
+      sector->floorterrain = DEFAULT_flat;
+      sector->ceilingterrain = DEFAULT_flat;
+      sector->colormaptop = DEFAULT_default;
+      sector->colormapmid = DEFAULT_default;
+      sector->colormapbottom = DEFAULT_default;
+      sector->texturefloor = "";
+      sector->textureceiling = "";
+      sector->lightlevel = 160;
+      sector->soundsequence = "";
+      sector->portal_ceil_overlaytype = "none";
+      sector->alphaceiling = 1.0;
+      sector->portal_floor_overlaytype = "none";
+      sector->alphafloor = 1.0;
+      break;
+   case block_Thing:
+      thing = &mThings[block.index];
+      thing->health = 1.0;
+      break;
+   default:
+      break;
+   }
+
+   Reader reader(block.start, block.end);
+   Token &value = reader.value;
+   readresult_e result;
+
+   reader.inblock = true;
+   while((result = reader.readItem()) != result_Eof)
+   {
+      if(result == result_Error)
+      {
+         block.error = reader.error;
+         block.errorpos = reader.pos - mData.constPtr();
+         return;
       }
       if(result == result_BlockExit)
+         break;
+
+#define REQUIRE_INT(obj, field, flag) \
+   case t_##field: requireInt(value, obj->field, obj->flag); break
+#define READ_NUMBER(obj, field) case t_##field: readNumber(value, obj->field); break
+#define READ_BOOL(obj, field) case t_##field: readBool(value, obj->field); break
+#define READ_STRING(obj, field) case t_##field: readString(value, obj->field); break
+#define READ_FIXED(obj, field) case t_##field: readFixed(value, obj->field); break
+#define REQUIRE_FIXED(obj, field, flag) \
+   case t_##field: requireFixed(value, obj->field, obj->flag); break
+
+      const keytoken_t *kt = findKey(reader.key.text, reader.key.length);
+      if(kt)
       {
          if(linedef)
          {
-            if(!linedef->v1set || !linedef->v2set || !linedef->sfrontset)
+            switch(kt->token)
             {
-               mError = "Incompletely defined linedef";
-               return false;
+               case t_id: readNumber(value, linedef->identifier); break;
+               REQUIRE_INT(linedef, v1, v1set);
+               REQUIRE_INT(linedef, v2, v2set);
+               REQUIRE_INT(linedef, sidefront, sfrontset);
+               READ_NUMBER(linedef, sideback);
+               READ_BOOL(linedef, blocking);
+               READ_BOOL(linedef, blockmonsters);
+               READ_BOOL(linedef, twosided);
+               READ_BOOL(linedef, dontpegtop);
+               READ_BOOL(linedef, dontpegbottom);
+               READ_BOOL(linedef, secret);
+               READ_BOOL(linedef, blocksound);
+               READ_BOOL(linedef, dontdraw);
+               READ_BOOL(linedef, mapped);
+               case t_passuse:
+                     readBool(value, linedef->passuse);
+                  break;
+               case t_translucent:
+                     readBool(value, linedef->translucent);
+                  break;
+               case t_jumpover:
+                     readBool(value, linedef->jumpover);
+                  break;
+               case t_blockfloaters:
+                     readBool(value, linedef->blockfloaters);
+                  break;
+               READ_NUMBER(linedef, special);
+               case t_arg0: readNumber(value, linedef->arg[0]); break;
+               case t_arg1: readNumber(value, linedef->arg[1]); break;
+               case t_arg2: readNumber(value, linedef->arg[2]); break;
+               case t_arg3: readNumber(value, linedef->arg[3]); break;
+               case t_arg4: readNumber(value, linedef->arg[4]); break;
+               READ_BOOL(linedef, playercross);
+               READ_BOOL(linedef, playeruse);
+               READ_BOOL(linedef, monstercross);
+               READ_BOOL(linedef, monsteruse);
+               READ_BOOL(linedef, impact);
+               READ_BOOL(linedef, playerpush);
+               READ_BOOL(linedef, monsterpush);
+               READ_BOOL(linedef, missilecross);
+               READ_BOOL(linedef, repeatspecial);
+               READ_BOOL(linedef, polycross);
+
+               READ_BOOL(linedef, midtex3d);
+               READ_BOOL(linedef, midtex3dimpassible);
+               READ_BOOL(linedef, firstsideonly);
+               READ_BOOL(linedef, blockeverything);
+               READ_BOOL(linedef, zoneboundary);
+               READ_BOOL(linedef, clipmidtex);
+               READ_BOOL(linedef, lowerportal);
+               READ_BOOL(linedef, upperportal);
+               READ_NUMBER(linedef, portal);
+               READ_NUMBER(linedef, alpha);
+               READ_STRING(linedef, renderstyle);
+               READ_STRING(linedef, tranmap);
+               default:
+                  break;
             }
-            linedef = nullptr;
+
          }
          else if(sidedef)
          {
-            if(!sidedef->sset)
+            switch(kt->token)
             {
-               mError = "Incompletely defined sidedef";
-               return false;
+               case t_offsetx:
+                  if(mNamespace == namespace_Eternity)
+                     readFixed(value, sidedef->offsetx);
+                  else
+                     readNumber(value, sidedef->offsetx);
+                  break;
+               case t_offsety:
+                  if(mNamespace == namespace_Eternity)
+                     readFixed(value, sidedef->offsety);
+                  else
+                     readNumber(value, sidedef->offsety);
+                  break;
+               READ_STRING(sidedef, texturetop);
+               READ_STRING(sidedef, texturebottom);
+               READ_STRING(sidedef, texturemiddle);
+               REQUIRE_INT(sidedef, sector, sset);
+               default:
+                  break;
             }
-            sidedef = nullptr;
          }
          else if(vertex)
          {
-            if(!vertex->xset || !vertex->yset)
-            {
-               mError = "Incompletely defined vertex";
-               return false;
-            }
-            vertex = nullptr;
+            if(kt->token == t_x)
+               requireFixed(value, vertex->x, vertex->xset);
+            else if(kt->token == t_y)
+               requireFixed(value, vertex->y, vertex->yset);
          }
          else if(sector)
          {
-            if(!sector->tfloorset || !sector->tceilset)
+            switch(kt->token)
             {
-               mError = "Incompletely defined sector";
-               return false;
+               case t_texturefloor:
+                  requireString(value, sector->texturefloor, sector->tfloorset);
+                  break;
+               case t_textureceiling:
+                  requireString(value, sector->textureceiling, sector->tceilset);
+                  break;
+               READ_NUMBER(sector, lightlevel);
+               READ_NUMBER(sector, special);
+               case t_id:
+                  readNumber(value, sector->identifier);
+                  break;
+               case t_heightfloor:
+                  if(mNamespace != namespace_Eternity)
+                     readNumber(value, sector->heightfloor);
+                  else
+                     readFixed(value, sector->heightfloor);
+                  break;
+               case t_heightceiling:
+                  if(mNamespace != namespace_Eternity)
+                     readNumber(value, sector->heightceiling);
+                  else
+                     readFixed(value, sector->heightceiling);
+               default:
+                  break;
+            }
+            if(mNamespace == namespace_Eternity)
+            {
+               switch(kt->token)
+               {
+                  READ_FIXED(sector, xpanningfloor);
+                  READ_FIXED(sector, ypanningfloor);
+                  READ_FIXED(sector, xpanningceiling);
+                  READ_FIXED(sector, ypanningceiling);
+                  READ_NUMBER(sector, xscaleceiling);
+                  READ_NUMBER(sector, xscalefloor);
+                  READ_NUMBER(sector, yscaleceiling);
+                  READ_NUMBER(sector, yscalefloor);
+                  READ_NUMBER(sector, rotationfloor);
+                  READ_NUMBER(sector, rotationceiling);
+
+                  READ_NUMBER(sector, scroll_ceil_x);
+                  READ_NUMBER(sector, scroll_ceil_y);
+                  READ_STRING(sector, scroll_ceil_type);
+
+                  READ_NUMBER(sector, scroll_floor_x);
+                  READ_NUMBER(sector, scroll_floor_y);
+                  READ_STRING(sector, scroll_floor_type);
+
+                  READ_BOOL(sector, secret);
+                  READ_NUMBER(sector, friction);
+
+                  READ_NUMBER(sector, lightfloor);
+                  READ_NUMBER(sector, lightceiling);
+                  READ_BOOL(sector, lightfloorabsolute);
+                  READ_BOOL(sector, lightceilingabsolute);
+
+                  READ_STRING(sector, colormaptop);
+                  READ_STRING(sector, colormapmid);
+                  READ_STRING(sector, colormapbottom);
+
+                  READ_NUMBER(sector, leakiness);
+                  READ_NUMBER(sector, damageamount);
+                  READ_NUMBER(sector, damageinterval);
+                  READ_BOOL(sector, damage_endgodmode);
+                  READ_BOOL(sector, damage_exitlevel);
+                  READ_BOOL(sector, damageterraineffect);
+                  READ_STRING(sector, damagetype);
+
+                  READ_STRING(sector, floorterrain);
+                  READ_STRING(sector, ceilingterrain);
+
+                  READ_NUMBER(sector, floorid);
+                  READ_NUMBER(sector, ceilingid);
+                  READ_NUMBER(sector, attachfloor);
+                  READ_NUMBER(sector, attachceiling);
+
+                  READ_STRING(sector, soundsequence);
+
+                  READ_STRING(sector, portal_floor_overlaytype);
+                  READ_NUMBER(sector, alphafloor);
+                  READ_BOOL(sector, portal_floor_blocksound);
+                  READ_BOOL(sector, portal_floor_disabled);
+                  READ_BOOL(sector, portal_floor_nopass);
+                  READ_BOOL(sector, portal_floor_norender);
+                  READ_BOOL(sector, portal_floor_useglobaltex);
+                  READ_BOOL(sector, portal_floor_attached);
+
+                  READ_STRING(sector, portal_ceil_overlaytype);
+                  READ_NUMBER(sector, alphaceiling);
+                  READ_BOOL(sector, portal_ceil_blocksound);
+                  READ_BOOL(sector, portal_ceil_disabled);
+                  READ_BOOL(sector, portal_ceil_nopass);
+                  READ_BOOL(sector, portal_ceil_norender);
+                  READ_BOOL(sector, portal_ceil_useglobaltex);
+                  READ_BOOL(sector, portal_ceil_attached);
+
+                  READ_NUMBER(sector, portalceiling);
+                  READ_NUMBER(sector, portalfloor);
+                  default:
+                     break;
+               }
             }
-            sector = nullptr;
          }
          else if(thing)
          {
-            if(!thing->xset || !thing->yset || !thing->typeset)
+            switch(kt->token)
             {
-               mError = "Incompletely defined thing";
-               return false;
+               case t_id: readNumber(value, thing->identifier); break;
+               REQUIRE_FIXED(thing, x, xset);
+               REQUIRE_FIXED(thing, y, yset);
+               READ_FIXED(thing, height);
+               READ_NUMBER(thing, angle);
+               REQUIRE_INT(thing, type, typeset);
+               READ_BOOL(thing, skill1);
+               READ_BOOL(thing, skill2);
+               READ_BOOL(thing, skill3);
+               READ_BOOL(thing, skill4);
+               READ_BOOL(thing, skill5);
+               READ_BOOL(thing, ambush);
+               READ_BOOL(thing, single);
+               READ_BOOL(thing, dm);
+               READ_BOOL(thing, coop);
+               case t_friend:
+                     readBool(value, thing->friendly);
+                  break;
+               READ_BOOL(thing, dormant);
+               READ_BOOL(thing, class1);
+               READ_BOOL(thing, class2);
+               READ_BOOL(thing, class3);
+               READ_BOOL(thing, standing);
+               READ_BOOL(thing, strifeally);
+               READ_BOOL(thing, translucent);
+               READ_BOOL(thing, invisible);
+               case t_special:
+                     readNumber(value, thing->special);
+                  break;
+               case t_arg0:
+                     readNumber(value, thing->arg[0]);
+                  break;
+               case t_arg1:
+                     readNumber(value, thing->arg[1]);
+                  break;
+               case t_arg2:
+                     readNumber(value, thing->arg[2]);
+                  break;
+               case t_arg3:
+                     readNumber(value, thing->arg[3]);
+                  break;
+               case t_arg4:
+                     readNumber(value, thing->arg[4]);
+                  break;
+               default:
+                  break;
+            }
+            if(mNamespace == namespace_Eternity)
+            {
+               switch(kt->token)
+               {
+                  READ_NUMBER(thing, health);
+                  default:
+                     break;
+               }
             }
-            thing = nullptr;
          }
       }
    }
 
-   return true;
+   // an unclosed block at the end of the text is left as it is
+   if(result != result_BlockExit)
+      return;
+
+   const char *incomplete = nullptr;
+   if(linedef && (!linedef->v1set || !linedef->v2set || !linedef->sfrontset))
+      incomplete = "Incompletely defined linedef";
+   else if(sidedef && !sidedef->sset)
+      incomplete = "Incompletely defined sidedef";
+   else if(vertex && (!vertex->xset || !vertex->yset))
+      incomplete = "Incompletely defined vertex";
+   else if(sector && (!sector->tfloorset || !sector->tceilset))
+      incomplete = "Incompletely defined sector";
+   else if(thing && (!thing->xset || !thing->yset || !thing->typeset))
+      incomplete = "Incompletely defined thing";
+
+   if(incomplete)
+   {
+      block.error = incomplete;
+      block.errorpos = reader.pos - mData.constPtr();
+   }
 }
 
 //
@@ -1363,18 +1878,13 @@ void UDMFParser::setData(const char *data, size_t size)
 //
 void UDMFParser::reset()
 {
-   mPos = 0;
    mLine = 1;
    mColumn = 1;
    mError.clear();
 
-   mKey.clear();
-   mValue.clear();
-   mInBlock = false;
-   mBlockName.clear();
-
    // Game stuff
    mNamespace = namespace_Doom;  // default to Doom
+   mBlocks.makeEmpty();
    mLinedefs.makeEmpty();
    mSidedefs.makeEmpty();
    mVertices.makeEmpty();
@@ -1382,24 +1892,45 @@ void UDMFParser::reset()
    mThings.makeEmpty();
 }
 
+//
+// Sets the error location from an offset into the TEXTMAP. Lines and columns
+// aren't tracked while scanning, since they're only needed on error.
+//
+void UDMFParser::setErrorPos(size_t pos)
+{
+   const char *data = mData.constPtr();
+
+   mLine = 1;
+   mColumn = 1;
+   for(size_t i = 0; i < pos; ++i)
+   {
+      if(data[i] == '\n')
+      {
+         mColumn = 1;
+         mLine++;
+      }
+      else
+         mColumn++;
+   }
+}
+
 //
 // Passes a fixed_t
 //
-void UDMFParser::readFixed(fixed_t &target) const
+void UDMFParser::readFixed(const Token &value, fixed_t &target)
 {
-   if(mValue.type == Token::type_Number)
-      target = M_DoubleToFixed(mValue.number);
+   if(value.type == Token::type_Number)
+      target = M_DoubleToFixed(value.number);
 }
 
 //
 // Passes a float to an object and flags a required element
 //
-void UDMFParser::requireFixed(fixed_t &target,
-                              bool &flagtarget) const
+void UDMFParser::requireFixed(const Token &value, fixed_t &target, bool &flagtarget)
 {
-   if(mValue.type == Token::type_Number)
+   if(value.type == Token::type_Number)
    {
-      target = M_DoubleToFixed(mValue.number);
+      target = M_DoubleToFixed(value.number);
       flagtarget = true;
    }
 }
@@ -1407,32 +1938,32 @@ void UDMFParser::requireFixed(fixed_t &target,
 //
 // Requires an int
 //
-void UDMFParser::requireInt(int &target, bool &flagtarget) const
+void UDMFParser::requireInt(const Token &value, int &target, bool &flagtarget)
 {
-   if(mValue.type == Token::type_Number)
+   if(value.type == Token::type_Number)
    {
-      target = static_cast<int>(mValue.number);
+      target = static_cast<int>(value.number);
       flagtarget = true;
    }
 }
 
 //
-// Reads a string
+// Reads a string. The target points into mData from then on.
 //
-void UDMFParser::readString(qstring &target) const
+void UDMFParser::readString(Token &value, const char *&target)
 {
-   if(mValue.type == Token::type_String)
-      target = mValue.text;
+   if(value.type == Token::type_String)
+      target = value.terminate();
 }
 
 //
 // Passes a string
 //
-void UDMFParser::requireString(qstring &target, bool &flagtarget) const
+void UDMFParser::requireString(Token &value, const char *&target, bool &flagtarget)
 {
-   if(mValue.type == Token::type_String)
+   if(value.type == Token::type_String)
    {
-      target = mValue.text;
+      target = value.terminate();
       flagtarget = true;
    }
 }
@@ -1440,11 +1971,11 @@ void UDMFParser::requireString(qstring &target, bool &flagtarget) const
 //
 // Passes a boolean
 //
-void UDMFParser::readBool(bool &target) const
+void UDMFParser::readBool(const Token &value, bool &target)
 {
-   if(mValue.type == Token::type_Keyword)
+   if(value.type == Token::type_Keyword)
    {
-      target = ectype::toUpper(mValue.text[0]) == 'T';
+      target = ectype::toUpper(value.text[0]) == 'T';
    }
 }
 
@@ -1452,241 +1983,13 @@ void UDMFParser::readBool(bool &target) const
 // Passes a number (float/double/int)
 //
 template<typename T>
-void UDMFParser::readNumber(T &target) const
-{
-   if(mValue.type == Token::type_Number)
-   {
-      target = static_cast<T>(mValue.number);
-   }
-
-}
-
-//
-// Reads a line or block item. Returns false on error
-//
-UDMFParser::readresult_e UDMFParser::readItem()
-{
-   Token token;
-   if(!next(token))
-      return result_Eof;
-
-   if(token.type == Token::type_Symbol && token.symbol == '}')
-   {
-      if(mInBlock)
-      {
-         mInBlock = false;
-         mKey = mBlockName; // preserve the name into "key"
-         mBlockName.clear();
-         return result_BlockExit;
-      }
-      // not in block: error
-      mError = "Unexpected '}'";
-      return result_Error;
-   }
-
-   if(token.type != Token::type_Keyword)
-   {
-      mError = "Expected a keyword";
-      return result_Error;
-   }
-   mKey = token.text;
-
-   if(!next(token) || token.type != Token::type_Symbol ||
-      (token.symbol != '=' && token.symbol != '{'))
-   {
-      mError = "Expected '=' or '{'";
-      return result_Error;
-   }
-
-   if(token.symbol == '=')
-   {
-      // assignment
-      if(!next(token) || (token.type != Token::type_Keyword &&
-         token.type != Token::type_String && token.type != Token::type_Number))
-      {
-         mError = "Expected a number, string or true/false";
-         return result_Error;
-      }
-
-      if(token.type == Token::type_Keyword && token.text.strCaseCmp("true") &&
-         token.text.strCaseCmp("false"))
-      {
-         mError = "Identifier can only be true or false";
-         return result_Error;
-      }
-      mValue = token;
-
-      if(!next(token) || token.type != Token::type_Symbol ||
-         token.symbol != ';')
-      {
-         mError = "Expected ; after assignment";
-         return result_Error;
-      }
-
-      return result_Assignment;
-   }
-   else  // {
-   {
-      // block
-      if(!mInBlock)
-      {
-         mInBlock = true;
-         mBlockName = mKey;
-         return result_BlockEntry;
-      }
-      else
-      {
-         mError = "Blocks cannot be nested";
-         return result_Error;
-      }
-   }
-}
-
-//
-// Gets the next token from mData. Returns false if EOF. It will not return
-// false if there's something to return
-//
-bool UDMFParser::next(Token &token)
+void UDMFParser::readNumber(const Token &value, T &target)
 {
-   // Skip all leading whitespace
-   bool checkWhite = true;
-   size_t size = mData.length();
-
-   while(checkWhite)
+   if(value.type == Token::type_Number)
    {
-      checkWhite = false;  // reset it unless someone else restores it
-
-      while(mPos != size && ectype::isSpace(mData[mPos]))
-         addPos(1);
-      if(mPos == size)
-         return false;
-
-      // Skip comments
-      if(mData[mPos] == '/' && mPos + 1 < size && mData[mPos + 1] == '/')
-      {
-         addPos(2);
-         // one line comment
-         while(mPos != size && mData[mPos] != '\n')
-            addPos(1);
-         if(mPos == size)
-            return false;
-
-         // If here, we hit an "enter"
-         addPos(1);
-         if(mPos == size)
-            return false;
-
-         checkWhite = true;   // look again for whitespaces if reached here
-      }
-
-      if(mData[mPos] == '/' && mPos + 1 < size && mData[mPos + 1] == '*')
-      {
-         addPos(2);
-         while(mPos + 1 < size && (mData[mPos] != '*' || mData[mPos + 1] != '/'))
-            addPos(1);
-         if(mPos + 1 >= size)
-         {
-            addPos(1);
-            return false;
-         }
-         if(mData[mPos] == '*' && mData[mPos + 1] == '/')
-            addPos(2);
-         if(mPos == size)
-            return false;
-         checkWhite = true;
-      }
+      target = static_cast<T>(value.number);
    }
 
-   // now we're clear from whitespaces and comments
-
-   // Check for number
-   char *result = nullptr;
-   double number = strtod(&mData[mPos], &result);
-   if(result > &mData[mPos])  // we have something
-   {
-      // copy it
-      token.type = Token::type_Number;
-      token.number = number;
-      addPos(result - mData.constPtr() - mPos);
-      return true;
-   }
-
-   // Check for string
-   if(mData[mPos] == '"')
-   {
-      addPos(1);
-
-      // we entered a string
-      // find the next string
-      token.type = Token::type_String;
-
-      // we must escape things here
-      token.text.clear();
-      bool escape = false;
-      while(mPos != size)
-      {
-         if(!escape)
-         {
-            if(mData[mPos] == '\\')
-               escape = true;
-            else if(mData[mPos] == '"')
-            {
-               addPos(1);     // skip the quote
-               return true;   // we're done
-            }
-            else
-               token.text.Putc(mData[mPos]);
-         }
-         else
-         {
-            token.text.Putc(mData[mPos]);
-            escape = false;
-         }
-         addPos(1);
-      }
-      return true;
-   }
-
-   // keyword: start with a letter or _
-   if(ectype::isAlpha(mData[mPos]) || mData[mPos] == '_')
-   {
-      token.type = Token::type_Keyword;
-      token.text.clear();
-      while(mPos != size &&
-            (ectype::isAlnum(mData[mPos]) || mData[mPos] == '_'))
-      {
-         token.text.Putc(mData[mPos]);
-         addPos(1);
-      }
-      return true;
-   }
-
-   // symbol. Just put one character
-   token.type = Token::type_Symbol;
-   token.symbol = mData[mPos];
-   addPos(1);
-
-   return true;
-}
-
-//
-// Increases position by given amount. Updates line and column accordingly.
-//
-void UDMFParser::addPos(size_t amount)
-{
-   for(size_t i = 0; i < amount; i++)
-   {
-      if(mPos == mData.length())
-         return;
-      if(mData[mPos] == '\n')
-      {
-         mColumn = 1;
-         mLine++;
-      }
-      else
-         mColumn++;
-      mPos++;
-   }
 }
 
 // EOF
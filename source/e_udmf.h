@@ -169,12 +169,6 @@ public:
    
    UDMFParser() : mLine(1), mColumn(1)
    {
-      static ULinedef linedef;
-      mLinedefs.setPrototype(&linedef);
-      static USector sector;
-      mSectors.setPrototype(&sector);
-      static USidedef sidedef;
-      mSidedefs.setPrototype(&sidedef);
    }
 
    enum namespace_e
@@ -205,6 +199,10 @@ public:
 
 private:
 
+   //
+   // Tokens don't own their text: keywords and strings point straight into
+   // mData, so nothing is copied while scanning.
+   //
    class Token
    {
    public:
@@ -218,7 +216,9 @@ private:
 
       type_e type;
       double number;
-      qstring text;
+      char *text;       // keyword or string contents, not terminated
+      size_t length;
+      bool escaped;     // string contents still hold backslash escapes
       char symbol;
 
       Token()
@@ -230,9 +230,15 @@ private:
       {
          type = type_Keyword;
          number = 0;
-         text.clear();
+         text = nullptr;
+         length = 0;
+         escaped = false;
          symbol = 0;
       }
+
+      bool textIs(const char *str) const;
+      void getText(qstring &out) const;
+      const char *terminate();
    };
 
    enum readresult_e
@@ -244,10 +250,34 @@ private:
       result_Error
    };
 
-   // NOTE: some of these are classes because they contain non-POD objects (e.g.
-   // qstring
+   //
+   // Reads tokens and items from a stretch of mData. Holds all of the scan
+   // state, so that separate readers can run at once over separate blocks.
+   //
+   class Reader
+   {
+   public:
+      char *pos;
+      char *end;
+      Token key;
+      Token value;
+      bool inblock;
+      const char *error;   // set along with result_Error
+
+      Reader(char *start, char *pend)
+         : pos(start), end(pend), inblock(false), error(nullptr)
+      {
+      }
 
-   class ULinedef : public ZoneObject
+      bool next(Token &token);
+      readresult_e readItem();
+   };
+
+   // Map items. These are kept as plain data so that they can be sized up front
+   // and filled in by worker threads. Strings point either into mData or at
+   // constant defaults.
+
+   class ULinedef
    {
    public:
       int identifier;   // tag
@@ -270,7 +300,7 @@ private:
 
       // auxiliary fields
       bool v1set, v2set, sfrontset; // (mandatory field internal flags)
-      int errorline;                // parsing error (not a property)
+      size_t errorpos;              // parsing error (not a property)
 
       // Eternity
       bool midtex3d;             // 3dmidtex
@@ -283,13 +313,8 @@ private:
       bool upperportal;          // upper part acts as a portal extension
       int portal;
       float alpha;               // opacity ratio
-      qstring renderstyle;       // zdoomish renderstyle (add, translucent)
-      qstring tranmap;           // boomish translucency lump
-      
-
-      ULinedef() : identifier(-1), sideback(-1), alpha(1)
-      {
-      }
+      const char *renderstyle;   // zdoomish renderstyle (add, translucent)
+      const char *tranmap;       // boomish translucency lump
    };
 
    class USidedef
@@ -298,19 +323,15 @@ private:
       int offsetx;
       int offsety;
 
-      qstring texturetop;
-      qstring texturebottom;
-      qstring texturemiddle;
+      const char *texturetop;
+      const char *texturebottom;
+      const char *texturemiddle;
 
       int sector;
 
       bool sset;
 
-      int errorline;
-
-      USidedef() : offsetx(0), offsety(0), sector(0), sset(false), errorline(0)
-      {
-      }
+      size_t errorpos;
    };
 
    struct uvertex_t
@@ -319,7 +340,7 @@ private:
       bool xset, yset;
    };
 
-   class USector : public ZoneObject
+   class USector
    {
    public:
       int heightfloor;
@@ -338,11 +359,11 @@ private:
       // Brand new UDMF scroller properties
       double scroll_ceil_x;
       double scroll_ceil_y;
-      qstring scroll_ceil_type;
+      const char *scroll_ceil_type;
 
       double scroll_floor_x;
       double scroll_floor_y;
-      qstring scroll_floor_type;
+      const char *scroll_floor_type;
 
       bool secret;
       int friction;
@@ -353,21 +374,21 @@ private:
       bool damage_endgodmode;
       bool damage_exitlevel;
       bool damageterraineffect;
-      qstring damagetype;
-      qstring floorterrain;
-      qstring ceilingterrain;
+      const char *damagetype;
+      const char *floorterrain;
+      const char *ceilingterrain;
 
       int lightfloor;
       int lightceiling;
       bool lightfloorabsolute;
       bool lightceilingabsolute;
 
-      qstring colormaptop;
-      qstring colormapmid;
-      qstring colormapbottom;
+      const char *colormaptop;
+      const char *colormapmid;
+      const char *colormapbottom;
 
-      qstring texturefloor;
-      qstring textureceiling;
+      const char *texturefloor;
+      const char *textureceiling;
       int lightlevel;
       int special;
       int identifier;
@@ -375,7 +396,7 @@ private:
       int floorid, ceilingid;
       int attachfloor, attachceiling;
 
-      qstring soundsequence;
+      const char *soundsequence;
 
       bool tfloorset, tceilset;
 
@@ -385,7 +406,8 @@ private:
       bool         portal_ceil_nopass;
       bool         portal_ceil_blocksound;
       bool         portal_ceil_useglobaltex;
-      qstring      portal_ceil_overlaytype; // OVERLAY and ADDITIVE consolidated into a single property
+      // OVERLAY and ADDITIVE consolidated into a single property
+      const char  *portal_ceil_overlaytype;
       bool         portal_ceil_attached;
       double       alphaceiling;
 
@@ -395,22 +417,13 @@ private:
       bool         portal_floor_nopass;
       bool         portal_floor_blocksound;
       bool         portal_floor_useglobaltex;
-      qstring      portal_floor_overlaytype; // OVERLAY and ADDITIVE consolidated into a single property
+      // OVERLAY and ADDITIVE consolidated into a single property
+      const char  *portal_floor_overlaytype;
       bool         portal_floor_attached;
       double       alphafloor;
 
       int          portalceiling;   // floor portal id
       int          portalfloor;     // floor portal id
-
-      USector() : xscalefloor(1.0), yscalefloor(1.0), xscaleceiling(1.0), yscaleceiling(1.0),
-         scroll_ceil_type("none"), scroll_floor_type("none"), friction(-1), damageinterval(32),
-         damagetype("Unknown"), floorterrain("@flat"), ceilingterrain("@flat"),
-         colormaptop("@default"), colormapmid("@default"), colormapbottom("@default"),
-         lightlevel(160),
-         portal_ceil_overlaytype("none"), alphaceiling(1.0),
-         portal_floor_overlaytype("none"), alphafloor(1.0)
-      {
-      }
    };
 
    struct uthing_t
@@ -432,42 +445,59 @@ private:
       bool xset, yset, typeset;
    };
 
+   enum blockkind_e
+   {
+      block_Linedef,
+      block_Sidedef,
+      block_Vertex,
+      block_Sector,
+      block_Thing,
+      block_Other,   // unknown block: only checked for syntax
+      NUMBLOCKKINDS
+   };
+
+   //
+   // A top-level block, located by the serial pass and filled in later by
+   // one of the worker threads.
+   //
+   struct udmfblock_t
+   {
+      blockkind_e kind;
+      int index;           // into the item collection of its kind
+      char *start;         // just past the '{'
+      char *end;           // just past the '}', or end of data
+      const char *error;   // first error found while reading it, if any
+      size_t errorpos;
+   };
+
    void setData(const char *data, size_t size);
    void reset();
-
-   void readFixed(fixed_t &target) const;
-   void requireFixed(fixed_t &target, bool &flagtarget) const;
-   void requireInt(int &target, bool &flagtarget) const;
-   void readString(qstring &target) const;
-   void requireString(qstring &target, bool &flagtarget) const;
-   void readBool(bool &target) const;
+   void setErrorPos(size_t pos);
+
+   static void readFixed(const Token &value, fixed_t &target);
+   static void requireFixed(const Token &value, fixed_t &target, bool &flagtarget);
+   static void requireInt(const Token &value, int &target, bool &flagtarget);
+   static void readString(Token &value, const char *&target);
+   static void requireString(Token &value, const char *&target, bool &flagtarget);
+   static void readBool(const Token &value, bool &target);
    template<typename T>
-   void readNumber(T &target) const;
-
-   readresult_e readItem();
+   static void readNumber(const Token &value, T &target);
 
-   bool next(Token &token);
-   void addPos(size_t amount);
-
-   bool eof() const { return mPos == mData.length(); }
+   void readBlock(udmfblock_t &block);
+   static void readBlockRange(int index, int worker, void *data);
 
    qstring mData;
-   size_t mPos;
    int mLine; // for locating errors. 1-based
    int mColumn;
    qstring mError;
 
-   qstring mKey;
-   Token mValue;
-   bool mInBlock;
-   qstring mBlockName;
-
    // Game stuff
    namespace_e mNamespace;
-   Collection<ULinedef> mLinedefs;
-   Collection<USidedef> mSidedefs;
+   PODCollection<udmfblock_t> mBlocks;
+   PODCollection<ULinedef> mLinedefs;
+   PODCollection<USidedef> mSidedefs;
    PODCollection<uvertex_t> mVertices;
-   Collection<USector> mSectors;
+   PODCollection<USector> mSectors;
    PODCollection<uthing_t> mThings;
 };
 
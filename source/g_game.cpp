@@ -77,6 +77,7 @@
 #include "p_maputl.h"
 #include "p_saveg.h"
 #include "p_setup.h"
+#include "p_snapshot.h"
 #include "p_tick.h"
 #include "p_user.h"
 #include "hu_stuff.h"
@@ -1363,6 +1364,8 @@ void G_DoPlayDemo(void)
    
    gameaction = ga_nothing;
 
+   P_ClearSnapshots();
+
    G_DemoStartMessage(basename);
    
    if(timingdemo)
@@ -1483,6 +1486,25 @@ static void G_ReadDemoTiccmd(ticcmd_t *cmd)
    }
 }
 
+//
+// G_DemoOffset
+//
+// Position of the next ticcmd in the demo being played back, so that demo
+// snapshots can rewind it.
+//
+size_t G_DemoOffset()
+{
+   return demo_p - demobuffer;
+}
+
+//
+// G_SetDemoOffset
+//
+void G_SetDemoOffset(size_t offset)
+{
+   demo_p = demobuffer + offset;
+}
+
 //
 // G_ReadDemoContinueTiccmd
 //
@@ -2068,7 +2090,12 @@ WadDirectory *d_dir;
 static void G_DoLoadGame(void)
 {
    gameaction = ga_nothing;
-   P_LoadGame(savename);
+   P_ClearSnapshots();
+
+   if(hub_changelevel)
+      P_DoLoadHubLevel(); // hub levels are kept in memory
+   else
+      P_LoadGame(savename);
 }
 
 //
@@ -2121,6 +2148,9 @@ void G_Ticker()
          G_DoReborn(i);
    }
 
+   // report a save the background writer has finished with
+   P_FinishSaveWrite(false);
+
    // do things to change the game state
    while (gameaction != ga_nothing)
    {
@@ -2321,6 +2351,9 @@ void G_Ticker()
          break;
       }
    }
+
+   // keep the rewind history
+   P_SnapshotTicker();
 }
 
 //
@@ -2982,6 +3015,7 @@ void G_DoNewGame()
    GameType = DefaultGameType;    // haleyjd  4/10/03
    dmflags  = default_dmflags;    // haleyjd  4/15/03
    basetic  = gametic;            // killough 9/29/98
+   P_ClearSnapshots();
    
    G_InitNew(d_skill, d_mapname);
    gameaction = ga_nothing;
@@ -3738,6 +3772,7 @@ bool G_CheckDemoStatus()
       // haleyjd 01/08/11: refactored so that stopping netdemos doesn't cause
       // access violations by leaving the game in "netgame" mode.
       Z_ChangeTag(demobuffer, PU_CACHE);
+      P_ClearSnapshots();    // they rewind into demobuffer
       G_ReloadDefaults();    // killough 3/1/98
       netgame = false;       // killough 3/29/98
 
@@ -44,6 +44,7 @@
 #include "p_chase.h"
 #include "r_draw.h"
 #include "r_patch.h"
+#include "v_dirty.h"
 #include "v_font.h"
 #include "v_misc.h"
 #include "v_patchfmt.h"
@@ -86,6 +87,9 @@ void HU_FragsDrawer(void)
       && !hu_showfrags) || GameType != gt_dm || automapactive)
       return;
 
+   // the scoreboard covers most of the screen
+   V_MarkAllDirty();
+
    // "frags"
 
    // haleyjd 04/08/10: draw more intelligently
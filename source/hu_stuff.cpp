@@ -63,6 +63,7 @@
 #include "r_state.h"
 #include "s_sound.h"
 #include "st_stuff.h"
+#include "v_dirty.h"
 #include "v_font.h"
 #include "v_misc.h"
 #include "v_patchfmt.h"
@@ -441,7 +442,10 @@ void HUDMessageWidget::drawer()
 
       V_FontWriteTextEx(vtd);
 
-      vtd.y += V_FontStringHeight(hud_font, msg);
+      int height = V_FontStringHeight(hud_font, msg);
+      V_MarkDirty(&subscreen43, 0, vtd.y, SCREENWIDTH, height);
+
+      vtd.y += height;
    }
 }
 
@@ -563,6 +567,8 @@ void HUDPatchWidget::drawer()
    patch = PatchLoader::CacheName(wGlobalDir, patchname, PU_CACHE);
 
    V_DrawPatchTL(x, y, &subscreen43, patch, color, tl_level);
+   V_MarkDirty(&subscreen43, x - patch->leftoffset, y - patch->topoffset,
+               patch->width, patch->height);
 }
 
 //
@@ -738,6 +744,7 @@ void HUDTextWidget::drawer()
       height = V_FontStringHeight(font, message);
 
       V_DrawBox(x - 4, y - 4, width + 8, height + 8);
+      V_MarkDirty(&subscreen43, x - 4, y - 4, width + 8, height + 8);
    }
 
    if(message && (!cleartic || leveltime < cleartic))
@@ -758,6 +765,8 @@ void HUDTextWidget::drawer()
          vdt.flags = VTXT_NORMAL;
 
       V_FontWriteTextEx(vdt);
+      V_MarkDirty(&subscreen43, x, y, V_FontStringWidth(font, message), 
+                  V_FontStringHeight(font, message));
    }
 }
 
@@ -1000,6 +1009,9 @@ void HUDCrossHairWidget::drawer()
       V_DrawPatchTL(drawx, drawy, &subscreen43, patch, pal, FTRANLEVEL);
    else
       V_DrawPatchTranslated(drawx, drawy, &subscreen43, patch, pal, false);
+
+   V_MarkDirty(&subscreen43, drawx - patch->leftoffset, drawy - patch->topoffset,
+               w, h);
 }
 
 //
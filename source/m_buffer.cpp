@@ -24,6 +24,7 @@
 
 #include "z_zone.h"
 #include "i_system.h"
+#include "../zlib/zlib.h"
 #include "m_buffer.h"
 #include "m_swap.h"
 
@@ -173,6 +174,42 @@ bool OutBuffer::createFile(const char *filename, size_t pLen, int pEndian)
    return true;
 }
 
+//
+// Sets up buffered output to a growable block of memory instead of a file.
+// Use releaseMemory to take the data once everything has been written.
+//
+bool OutBuffer::createMemory(size_t pLen, int pEndian)
+{
+   initBuffer(pLen, pEndian);
+
+   memsize = 0;
+   ownFile = false;
+
+   return true;
+}
+
+//
+// Flushes memory output and hands the written data over to the caller, who
+// becomes responsible for freeing it with efree. The buffer is closed.
+//
+byte *OutBuffer::releaseMemory(size_t &size)
+{
+   byte *data;
+
+   flush();
+
+   data = mem;
+   size = memsize;
+
+   mem      = nullptr;
+   memsize  = 0;
+   memalloc = 0;
+
+   close();
+
+   return data;
+}
+
 //
 // Call to flush the contents of the buffer to the output file. This will be
 // called automatically before the file is closed, but must be called explicitly
@@ -180,7 +217,20 @@ bool OutBuffer::createFile(const char *filename, size_t pLen, int pEndian)
 //
 bool OutBuffer::flush()
 {
-   if(idx)
+   if(idx && !f)
+   {
+      // memory output; grow the destination geometrically
+      if(memsize + idx > memalloc)
+      {
+         while(memsize + idx > memalloc)
+            memalloc = memalloc ? memalloc * 2 : len * 4;
+         mem = erealloc(byte *, mem, memalloc);
+      }
+      memcpy(mem + memsize, buffer, idx);
+      memsize += idx;
+      idx = 0;
+   }
+   else if(idx)
    {
       if(fwrite(buffer, sizeof(byte), idx, f) < idx)
       {
@@ -211,6 +261,14 @@ void OutBuffer::close()
    }
       
    BufferedFileBase::close();
+
+   if(mem)
+   {
+      efree(mem);
+      mem = nullptr;
+   }
+   memsize  = 0;
+   memalloc = 0;
 }
 
 //
@@ -362,11 +420,82 @@ bool InBuffer::openExisting(FILE *pf, int pEndian)
    return true;
 }
 
+//
+// Reads from a block of memory instead of a file. The data is not copied, so
+// it must stay valid until the buffer is closed.
+//
+bool InBuffer::openMemory(const byte *data, size_t size, int pEndian)
+{
+   if(!data)
+      return false;
+
+   mem     = data;
+   memsize = size;
+   mempos  = 0;
+   endian  = pEndian;
+   ownFile = false;
+
+   return true;
+}
+
+//
+// Opens a file for input through zlib. Files written with gzip compression
+// are decompressed as they are read; any other file is read as it is.
+//
+bool InBuffer::openCompressed(const char *filename, int pEndian)
+{
+   if(!(gz = gzopen(filename, "rb")))
+      return false;
+
+   endian  = pEndian;
+   ownFile = false;
+
+   return true;
+}
+
+InBuffer::~InBuffer()
+{
+   if(gz)
+      gzclose(gz);
+}
+
+//
+// Overrides BufferedFileBase::close() to also detach from memory or zlib
+// input.
+//
+void InBuffer::close()
+{
+   BufferedFileBase::close();
+
+   if(gz)
+   {
+      gzclose(gz);
+      gz = nullptr;
+   }
+
+   mem     = nullptr;
+   memsize = 0;
+   mempos  = 0;
+}
+
 //
 // Seeks inside the file via fseek, and then clears the internal buffer.
 //
 int InBuffer::seek(long offset, int origin)
 {
+   if(mem)
+   {
+      long base = origin == SEEK_CUR ? long(mempos) :
+                  origin == SEEK_END ? long(memsize) : 0;
+
+      if(base + offset < 0 || size_t(base + offset) > memsize)
+         return -1;
+      mempos = size_t(base + offset);
+      return 0;
+   }
+   if(gz)
+      return gzseek(gz, offset, origin) < 0 ? -1 : 0;
+
    return fseek(f, offset, origin);
 }
 
@@ -376,6 +505,20 @@ int InBuffer::seek(long offset, int origin)
 //
 size_t InBuffer::read(void *dest, size_t size)
 {
+   if(mem)
+   {
+      if(size > memsize - mempos)
+         size = memsize - mempos;
+      memcpy(dest, mem + mempos, size);
+      mempos += size;
+      return size;
+   }
+   if(gz)
+   {
+      int amt = gzread(gz, dest, unsigned(size));
+      return amt < 0 ? 0 : size_t(amt);
+   }
+
    return fread(dest, 1, size, f);
 }
 
@@ -384,6 +527,9 @@ size_t InBuffer::read(void *dest, size_t size)
 //
 int InBuffer::skip(size_t skipAmt)
 {
+   if(mem || gz)
+      return seek(static_cast<long>(skipAmt), SEEK_CUR);
+
    return fseek(f, static_cast<long>(skipAmt), SEEK_CUR);
 }
 
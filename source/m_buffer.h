@@ -111,8 +111,25 @@ public:
 //
 class OutBuffer : public BufferedFileBase
 {
+protected:
+   byte  *mem;      // memory destination, instead of a file
+   size_t memsize;  // bytes flushed to mem
+   size_t memalloc; // allocated size of mem
+
 public:
+   OutBuffer() : BufferedFileBase(), mem(nullptr), memsize(0), memalloc(0)
+   {
+   }
+
+   ~OutBuffer()
+   {
+      if(mem)
+         efree(mem);
+   }
+
    bool createFile(const char *filename, size_t pLen, int pEndian);
+   bool createMemory(size_t pLen, int pEndian);
+   byte *releaseMemory(size_t &size);
    bool flush();
    void close();
 
@@ -134,13 +151,24 @@ public:
 //
 class InBuffer : public BufferedFileBase
 {
+protected:
+   const byte *mem;     // memory source, instead of a file
+   size_t      memsize;
+   size_t      mempos;
+   void       *gz;      // zlib gzFile source, instead of a file
+
 public:
-   InBuffer() : BufferedFileBase()
+   InBuffer() : BufferedFileBase(), mem(nullptr), memsize(0), mempos(0), gz(nullptr)
    {
    }
 
+   ~InBuffer();
+
    bool openFile(const char *filename, int pEndian);
    bool openExisting(FILE *f, int pEndian);
+   bool openMemory(const byte *data, size_t size, int pEndian);
+   bool openCompressed(const char *filename, int pEndian);
+   void close();
 
    int    seek(long offset, int origin);
    size_t read(void *dest, size_t size);
@@ -802,7 +802,7 @@ default_t defaults[] =
    
    DEFAULT_INT("r_columnengine",&r_column_engine_num, NULL, 
                1, 0, NUMCOLUMNENGINES - 1, default_t::wad_no, 
-               "0 = normal, 1 = optimized quad cache"),
+               "0 = normal, 1 = optimized quad cache, 2 = transposed walls"),
    
    DEFAULT_INT("r_spanengine",&r_span_engine_num, NULL,
                0, 0, NUMSPANENGINES - 1, default_t::wad_no, 
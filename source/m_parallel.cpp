@@ -0,0 +1,221 @@
+//
+// The Eternity Engine
+// Copyright (C) 2018 James Haley et al.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see http://www.gnu.org/licenses/
+//
+// Additional terms and conditions compatible with the GPLv3 apply. See the
+// file COPYING-EE for details.
+//
+// Purpose: Worker threads for splitting independent work across CPU cores.
+//
+//  A fixed pool of threads is started the first time it is needed. The
+//  calling thread takes part in each job, and does not return until every
+//  item has been processed, so callers see no concurrency outside of their
+//  work function. Items are handed out one at a time from a shared counter,
+//  which balances uneven items without any tuning.
+//
+
+#include "z_zone.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+#include "m_argv.h"
+#include "m_compare.h"
+#include "m_parallel.h"
+
+static int numworkers; // 0 until the pool has been started
+
+static std::thread workers[M_MAXWORKERS]; // helper threads, from index 1
+
+static std::mutex               jobmutex;
+static std::condition_variable  jobstart;
+static std::condition_variable  jobdone;
+
+// current job
+static parallelfunc_t   jobfunc;
+static void            *jobdata;
+static int              jobcount;
+static std::atomic<int> jobnext;
+static int              jobgeneration; // bumped for every job
+static int              jobrunning;    // helpers still working on the job
+static bool             jobactive;     // true while a job is running
+static bool             jobquit;       // set to make the helpers return
+
+// worker index of the running thread
+static thread_local int curworker;
+
+//
+// M_runItems
+//
+// Takes items from the current job until there are none left.
+//
+static void M_runItems(int worker)
+{
+   int index;
+
+   while((index = jobnext.fetch_add(1)) < jobcount)
+      jobfunc(index, worker, jobdata);
+}
+
+//
+// M_workerLoop
+//
+// Body of each helper thread: waits for a job, takes part in it, and
+// reports back when the shared counter runs out. Returns once told to quit.
+//
+static void M_workerLoop(int worker)
+{
+   int seen = 0;
+
+   curworker = worker;
+
+   for(;;)
+   {
+      {
+         std::unique_lock<std::mutex> lock(jobmutex);
+         jobstart.wait(lock, [&seen] { return jobgeneration != seen || jobquit; });
+         if(jobquit)
+            return;
+         seen = jobgeneration;
+      }
+
+      M_runItems(worker);
+
+      {
+         std::lock_guard<std::mutex> lock(jobmutex);
+         if(--jobrunning == 0)
+            jobdone.notify_one();
+      }
+   }
+}
+
+//
+// M_startWorkers
+//
+// Decides on the number of workers and starts the helper threads. The
+// -workers command line parameter overrides the number of hardware threads;
+// 1 disables threading.
+//
+static void M_startWorkers()
+{
+   int p;
+
+   numworkers = int(std::thread::hardware_concurrency());
+
+   if((p = M_CheckParm("-workers")) && p < myargc - 1)
+      numworkers = atoi(myargv[p + 1]);
+
+   numworkers = eclamp(numworkers, 1, M_MAXWORKERS);
+
+   for(int i = 1; i < numworkers; i++)
+      workers[i] = std::thread(M_workerLoop, i);
+}
+
+//
+// M_StopWorkers
+//
+// Tells the helper threads to quit and waits for them, so that none is
+// left waiting on the job mutex when it is destroyed at exit. Any jobs
+// started afterward run on the calling thread alone. Does nothing when
+// called from a helper thread, which cannot wait on itself.
+//
+void M_StopWorkers()
+{
+   if(numworkers <= 1 || curworker)
+      return;
+
+   {
+      std::lock_guard<std::mutex> lock(jobmutex);
+      jobquit = true;
+   }
+   jobstart.notify_all();
+
+   for(int i = 1; i < numworkers; i++)
+      workers[i].join();
+
+   numworkers = 1;
+}
+
+//
+// M_WorkerCount
+//
+// Returns the number of threads a parallel job may be spread over, which
+// is also the bound on the worker index passed to work functions.
+//
+int M_WorkerCount()
+{
+   if(!numworkers)
+      M_startWorkers();
+
+   return numworkers;
+}
+
+//
+// M_CurrentWorker
+//
+// Returns the worker index of the running thread; 0 for the main thread.
+//
+int M_CurrentWorker()
+{
+   return curworker;
+}
+
+//
+// M_ParallelFor
+//
+// Calls func for every index in [0, count), spread across the worker pool,
+// and returns once all calls have finished. Work functions must not touch
+// shared state without their own synchronization. Jobs are started from
+// the main thread; one started from inside a work function runs serially
+// on the calling thread instead.
+//
+void M_ParallelFor(int count, parallelfunc_t func, void *data)
+{
+   if(count <= 0)
+      return;
+
+   if(M_WorkerCount() == 1 || count == 1 || jobactive)
+   {
+      for(int i = 0; i < count; i++)
+         func(i, curworker, data);
+      return;
+   }
+
+   {
+      std::lock_guard<std::mutex> lock(jobmutex);
+      jobactive  = true;
+      jobfunc    = func;
+      jobdata    = data;
+      jobcount   = count;
+      jobnext    = 0;
+      jobrunning = numworkers - 1;
+      ++jobgeneration;
+   }
+   jobstart.notify_all();
+
+   M_runItems(0);
+
+   {
+      std::unique_lock<std::mutex> lock(jobmutex);
+      jobdone.wait(lock, [] { return jobrunning == 0; });
+      jobactive = false;
+   }
+}
+
+// EOF
+
@@ -0,0 +1,47 @@
+//
+// The Eternity Engine
+// Copyright (C) 2018 James Haley et al.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see http://www.gnu.org/licenses/
+//
+// Additional terms and conditions compatible with the GPLv3 apply. See the
+// file COPYING-EE for details.
+//
+// Purpose: Worker threads for splitting independent work across CPU cores.
+//
+
+#ifndef M_PARALLEL_H__
+#define M_PARALLEL_H__
+
+// most threads the pool will use, including the calling thread
+#define M_MAXWORKERS 16
+
+//
+// parallelfunc_t
+//
+// Processes item index of a parallel job. worker identifies the thread
+// running it, from 0 to M_WorkerCount() - 1, so that callers can keep
+// per-thread scratch data without locking.
+//
+typedef void (*parallelfunc_t)(int index, int worker, void *data);
+
+int  M_WorkerCount();
+int  M_CurrentWorker();
+void M_ParallelFor(int count, parallelfunc_t func, void *data);
+void M_StopWorkers();
+
+#endif
+
+// EOF
+
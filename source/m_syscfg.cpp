@@ -43,6 +43,7 @@
 #include "mn_menus.h"
 #include "s_sound.h"
 #include "s_sndseq.h"
+#include "v_dirty.h"
 #include "w_wad.h"
 #include "w_levels.h"
 
@@ -240,6 +241,9 @@ static default_t sysdefaults[] =
    DEFAULT_BOOL("d_interpolate", &d_interpolate, NULL, true, default_t::wad_no,
                 "1 to activate frame interpolation (smooth rendering)"),
 
+   DEFAULT_BOOL("v_dirtyrects", &v_dirtyrects, NULL, true, default_t::wad_no,
+                "1 to redraw static screen areas only when they change"),
+
    DEFAULT_BOOL("i_forcefeedback", &i_forcefeedback, NULL, true, default_t::wad_no,
                 "1 to enable force feedback through gamepads where supported"),
 
@@ -57,6 +57,7 @@
 #include "r_draw.h"
 #include "r_patch.h"
 #include "s_sound.h"
+#include "v_dirty.h"
 #include "v_font.h"
 #include "v_misc.h"
 #include "v_patchfmt.h"
@@ -751,7 +752,10 @@ void MN_Drawer()
    {
       // alternate drawer
       if(current_menuwidget->drawer)
+      {
          current_menuwidget->drawer();
+         V_MarkAllDirty();
+      }
       return;
    }
 
@@ -760,6 +764,7 @@ void MN_Drawer()
       return;
  
    MN_DrawMenu(current_menu);
+   V_MarkAllDirty();
 }
 
 static void MN_ShowContents(void);
@@ -28,6 +28,7 @@
 //-----------------------------------------------------------------------------
 
 #include "z_zone.h"
+#include "../zlib/zlib.h"
 
 #include "hal/i_gamepads.h"
 
@@ -1348,7 +1349,7 @@ static void MN_ReadSaveStrings()
       char *name = NULL;    // killough 3/22/98
       size_t len;
       char description[SAVESTRINGSIZE+1]; // sf
-      FILE *fp;  // killough 11/98: change to use stdio
+      gzFile fp;  // killough 11/98: change to use stdio; now zlib, for compressed saves
 
       len = M_StringAlloca(&name, 2, 26, basesavegame, savegamename);
 
@@ -1360,7 +1361,7 @@ static void MN_ReadSaveStrings()
       // if(savegamenames[i])
       //  Z_Free(savegamenames[i]);
 
-      fp = fopen(name,"rb");
+      fp = gzopen(name, "rb");
       if(!fp)
       {   // Ty 03/27/98 - externalized:
          // haleyjd
@@ -1371,13 +1372,13 @@ static void MN_ReadSaveStrings()
       }
 
       memset(description, 0, sizeof(description));
-      if(fread(description, SAVESTRINGSIZE, 1, fp) < 1)
+      if(gzread(fp, description, SAVESTRINGSIZE) < SAVESTRINGSIZE)
          doom_printf("%s", FC_ERROR "Warning: savestring read failed");
       if(savegamenames[i])
          Z_Free(savegamenames[i]);
       savegamenames[i] = Z_Strdup(description, PU_STATIC, 0);  // haleyjd
       savegamepresent[i] = true;
-      fclose(fp);
+      gzclose(fp);
    }
 }
 
@@ -39,6 +39,7 @@
 #include "d_mod.h"
 #include "doomstat.h"
 #include "e_args.h"
+#include "e_exdata.h"
 #include "e_lib.h"
 #include "e_player.h"
 #include "e_sound.h"
@@ -48,6 +49,7 @@
 #include "ev_specials.h"
 #include "g_game.h"
 #include "m_bbox.h"
+#include "m_compare.h"
 #include "metaapi.h"
 #include "p_anim.h"      // haleyjd
 #include "p_enemy.h"
@@ -61,6 +63,7 @@
 #include "p_setup.h"
 #include "p_spec.h"
 #include "p_tick.h"
+#include "p_visit.h"
 #include "r_defs.h"
 #include "r_main.h"
 #include "r_pcheck.h"
@@ -83,28 +86,146 @@ static Mobj *current_actor;
 //
 
 //
-// P_RecursiveSound
+// Sound propagation
 //
-// Called by P_NoiseAlert.
-// Recursively traverse adjacent sectors,
-// sound blocking lines cut off traversal.
+// Whether sound passes each line is kept in soundlines, so that noise alerts
+// don't need P_LineOpening. The entries follow sector heights through
+// P_UpdateSoundLines. Lines whose opening also depends on portal state are
+// marked SL_LIVE and are still checked with P_LineOpening every time.
 //
-// killough 5/5/98: reformatted, cleaned up
+
+enum
+{
+   SL_CLOSED, // no opening
+   SL_OPEN,   // an opening sound can pass
+   SL_LIVE    // opening depends on portals; ask P_LineOpening
+};
+
+static byte *soundlines;   // per line; freed with the level
+
+// sectors waiting to spread a sound, with the sound-blocking lines crossed
+struct soundqueue_t
+{
+   sector_t *sec;
+   int       soundblocks;
+};
+
+static soundqueue_t *soundqueue;   // room for every sector twice
+static int           soundqueuelen;
+
+//
+// P_soundLineState
 //
-static void P_RecursiveSound(sector_t *sec, int soundblocks,
-                             Mobj *soundtarget)
+// Works out what P_LineOpening with no thing would say about sound passing
+// a line, without touching the clip globals.
+//
+static byte P_soundLineState(const line_t *line)
+{
+   if(line->sidenum[1] == -1)
+      return SL_CLOSED;
+
+   if((line->intflags & MLI_1SPORTALLINE && line->beyondportalline) ||
+      (line->extflags & (EX_ML_UPPERPORTAL | EX_ML_LOWERPORTAL)))
+      return SL_LIVE;
+
+   const sector_t *front = line->frontsector;
+   const sector_t *back  = line->backsector;
+
+   fixed_t opentop = front->ceilingheight < back->ceilingheight ?
+      front->ceilingheight : back->ceilingheight;
+   fixed_t openbottom = front->floorheight > back->floorheight ?
+      front->floorheight : back->floorheight;
+
+   return opentop - openbottom > 0 ? SL_OPEN : SL_CLOSED;
+}
+
+//
+// P_InitSoundLines
+//
+// Works out the sound state of every line, once specials have set up the
+// level's portals.
+//
+void P_InitSoundLines()
+{
+   soundlines = (byte *)(Z_Malloc(emax(numlines, 1), PU_LEVEL, (void **)&soundlines));
+
+   for(int i = 0; i < numlines; i++)
+      soundlines[i] = P_soundLineState(&lines[i]);
+}
+
+//
+// P_UpdateSoundLines
+//
+// Called when a sector's floor or ceiling height changes, to update the
+// lines around it.
+//
+void P_UpdateSoundLines(const sector_t *sec)
+{
+   if(!soundlines)
+      return;
+
+   for(int i = 0; i < sec->linecount; i++)
+   {
+      const line_t *line = sec->lines[i];
+      soundlines[line - lines] = P_soundLineState(line);
+   }
+}
+
+//
+// P_soundLineOpen
+//
+// True if sound can pass through a 2S line.
+//
+static bool P_soundLineOpen(const line_t *line)
+{
+   byte state = soundlines ? soundlines[line - lines] : SL_LIVE;
+
+   if(state == SL_LIVE)
+   {
+      P_LineOpening(line, NULL);
+      return clip.openrange > 0;
+   }
+
+   return state == SL_OPEN;
+}
+
+//
+// P_soundEnter
+//
+// Floods sound into a sector and queues it to spread further, unless it
+// has already been reached through as few sound-blocking lines.
+//
+static void P_soundEnter(sector_t *sec, int soundblocks, Mobj *soundtarget)
 {
-   int i;
-   
    // wake up all monsters in this sector
-   if(sec->validcount == validcount &&
+   VisitContext &visit = P_SearchVisit();
+   int secnum = eindex(sec - sectors);
+
+   if(visit.sectorVisited(secnum) &&
       sec->soundtraversed <= soundblocks+1)
       return;             // already flooded
 
-   sec->validcount = validcount;
+   visit.markSector(secnum);
    sec->soundtraversed = soundblocks+1;
    P_SetTarget<Mobj>(&sec->soundtarget, soundtarget);    // killough 11/98
 
+   // soundtraversed only ever drops from 2 to 1, so no sector is queued more
+   // than twice
+   soundqueue_t &entry = soundqueue[soundqueuelen++];
+   entry.sec         = sec;
+   entry.soundblocks = soundblocks;
+}
+
+//
+// P_soundSpread
+//
+// Passes sound on from a sector to its neighbors.
+// Sound blocking lines cut off traversal.
+//
+// killough 5/5/98: reformatted, cleaned up
+//
+static void P_soundSpread(sector_t *sec, int soundblocks, Mobj *soundtarget)
+{
 #ifdef R_LINKEDPORTALS
    if(sec->f_pflags & PS_PASSSOUND)
    {
@@ -120,7 +241,7 @@ static void P_RecursiveSound(sector_t *sec, int soundblocks,
                             ((check->v1->y + check->v2->y) / 2) 
                              + R_FPLink(sec)->deltay)->sector;
 
-      P_RecursiveSound(other, soundblocks, soundtarget);
+      P_soundEnter(other, soundblocks, soundtarget);
    }
    
    if(sec->c_pflags & PS_PASSSOUND)
@@ -137,11 +258,11 @@ static void P_RecursiveSound(sector_t *sec, int soundblocks,
                             ((check->v1->y + check->v2->y) / 2) 
                              + R_CPLink(sec)->deltay)->sector;
 
-      P_RecursiveSound(other, soundblocks, soundtarget);
+      P_soundEnter(other, soundblocks, soundtarget);
    }
 #endif
 
-   for(i=0; i<sec->linecount; i++)
+   for(int i = 0; i < sec->linecount; i++)
    {
       sector_t *other;
       line_t *check = sec->lines[i];
@@ -155,23 +276,21 @@ static void P_RecursiveSound(sector_t *sec, int soundblocks,
          R_PointInSubsector(((check->v1->x + check->v2->x) / 2) + check->portal->data.link.deltax,
                             ((check->v1->y + check->v2->y) / 2) + check->portal->data.link.deltay)->sector;
 
-         P_RecursiveSound(iother, soundblocks, soundtarget);
+         P_soundEnter(iother, soundblocks, soundtarget);
       }
 #endif
       if(!(check->flags & ML_TWOSIDED))
          continue;
 
-      P_LineOpening(check, NULL);
-      
-      if(clip.openrange <= 0)
+      if(!P_soundLineOpen(check))
          continue;       // closed door
 
       other=sides[check->sidenum[sides[check->sidenum[0]].sector==sec]].sector;
       
       if(!(check->flags & ML_SOUNDBLOCK))
-         P_RecursiveSound(other, soundblocks, soundtarget);
+         P_soundEnter(other, soundblocks, soundtarget);
       else if(!soundblocks)
-         P_RecursiveSound(other, 1, soundtarget);
+         P_soundEnter(other, 1, soundtarget);
    }
 }
 
@@ -181,10 +300,33 @@ static void P_RecursiveSound(sector_t *sec, int soundblocks,
 // If a monster yells at a player,
 // it will alert other monsters to the player.
 //
+// Sound spreads from the emitter's sector breadth first. A sector is
+// flooded again only when sound reaches it through fewer sound-blocking
+// lines, so every sector ends up with the same soundtraversed and
+// soundtarget as the old recursive flood left.
+//
 void P_NoiseAlert(Mobj *target, Mobj *emitter)
 {
-   validcount++;
-   P_RecursiveSound(emitter->subsector->sector, 0, target);
+   if(!soundqueue)
+   {
+      soundqueue = (soundqueue_t *)(Z_Malloc(emax(numsectors, 1) * 2 * sizeof(*soundqueue),
+                                             PU_LEVEL, (void **)&soundqueue));
+   }
+
+   soundqueuelen = 0;
+   P_SearchVisit().begin();
+   P_soundEnter(emitter->subsector->sector, 0, target);
+
+   for(int i = 0; i < soundqueuelen; i++)
+   {
+      const soundqueue_t &entry = soundqueue[i];
+
+      // skip if the sector has since been reached more directly
+      if(entry.sec->soundtraversed - 1 < entry.soundblocks)
+         continue;
+
+      P_soundSpread(entry.sec, entry.soundblocks, target);
+   }
 }
 
 //
@@ -844,7 +986,7 @@ static fixed_t P_AvoidDropoff(Mobj *actor)
 
    // check lines
 
-   validcount++;
+   P_SearchVisit().begin();
    for(bx = xl; bx <= xh; ++bx)
    {
       // all contacted lines
@@ -32,6 +32,8 @@
 #include "info.h"
 #include "m_random.h"
 
+struct sector_t;
+
 enum 
 {
    DI_EAST,
@@ -62,6 +64,8 @@ void P_NewChaseDir(Mobj *actor);
 bool P_SmartMove(Mobj *actor);
 
 void P_NoiseAlert (Mobj *target, Mobj *emmiter);
+void P_InitSoundLines();
+void P_UpdateSoundLines(const sector_t *sec);
 void P_SpawnBrainTargets();     // killough 3/26/98: spawn icon landings
 void P_SpawnSorcSpots();        // haleyjd 11/19/02: spawn dsparil spots
 
@@ -37,8 +37,11 @@
 //----------------------------------------------------------------------------
 
 #include "z_zone.h"
+#include "i_system.h"
+#include "../zlib/zlib.h"
 
 #include "c_io.h"
+#include "c_runcmd.h"
 #include "d_event.h"
 #include "doomstat.h"
 #include "d_io.h"       // SoM 3/14/2002: strncasecmp
@@ -50,14 +53,23 @@
 #include "p_spec.h"
 #include "r_defs.h"
 #include "r_state.h"
+#include "v_misc.h"
 
 #define MAXHUBLEVELS 128
 
+// Visited hub levels are kept in memory as compressed savegames. If
+// p_hubmemory is set, levels beyond that many kilobytes are moved out to
+// temporary files, least recently left first.
+
 typedef struct hublevel_s hublevel_t;
 struct hublevel_s
 {
    char levelname[8];
-   char *tmpfile;        // temporary file holding the saved level
+   byte *data;           // compressed saved level, while in memory
+   size_t size;          // compressed size
+   size_t rawsize;       // uncompressed size
+   char *tmpfile;        // temporary file holding the level, once moved out
+   int lastused;         // when the level was last left
 };
 
 extern char gamemapname[9];
@@ -69,6 +81,10 @@ bool hub_changelevel = false;
 hublevel_t hub_levels[MAXHUBLEVELS];
 int num_hub_levels;
 
+int p_hubmemory;                 // memory cap in KB; 0 for none
+static int hubclock;             // counts level changes, for lastused
+static hublevel_t *hubtoload;    // level for P_DoLoadHubLevel
+
 // sf: my own tmpnam (djgpp one doesn't work as i want it)
 
 char *temp_hubfile(void)
@@ -76,24 +92,42 @@ char *temp_hubfile(void)
    static int tmpfilenum = 0;
    char *new_tmpfilename;
    
-   new_tmpfilename = emalloc(char *, 10);
+   new_tmpfilename = emalloc(char *, 16);
    
    sprintf(new_tmpfilename, "smmu%i.tmp", tmpfilenum++);
    
    return new_tmpfilename;  
 }
 
+//
+// P_freeHubLevel
+//
+// Drops the saved copy of a hub level, in memory or on disk.
+//
+static void P_freeHubLevel(hublevel_t *hublevel)
+{
+   if(hublevel->data)
+   {
+      efree(hublevel->data);
+      hublevel->data = NULL;
+   }
+   if(hublevel->tmpfile)
+   {
+      remove(hublevel->tmpfile);
+      efree(hublevel->tmpfile);
+      hublevel->tmpfile = NULL;
+   }
+}
+
 void P_ClearHubs(void)
 {
    int i;
    
    for(i=0; i<num_hub_levels; i++)
-   {
-      if(hub_levels[i].tmpfile)
-         remove(hub_levels[i].tmpfile);
-   }
+      P_freeHubLevel(&hub_levels[i]);
    
    num_hub_levels = 0;
+   hubtoload = NULL;
 
 #if 0
    // clear the hub_script
@@ -136,10 +170,91 @@ static hublevel_t *HublevelForName(char *name)
 
 static hublevel_t *AddHublevel(char *levelname)
 {
-   strncpy(hub_levels[num_hub_levels].levelname, levelname, 8);
-   hub_levels[num_hub_levels].tmpfile = NULL;
+   hublevel_t *hublevel = &hub_levels[num_hub_levels++];
+
+   memset(hublevel, 0, sizeof(*hublevel));
+   strncpy(hublevel->levelname, levelname, 8);
    
-   return &hub_levels[num_hub_levels++];
+   return hublevel;
+}
+
+//
+// P_spillHubLevel
+//
+// Moves a level's compressed data out to a temporary file.
+//
+static bool P_spillHubLevel(hublevel_t *hublevel)
+{
+   char *tmpfile = temp_hubfile();
+   FILE *f;
+   bool  ok;
+
+   if(!(f = fopen(tmpfile, "wb")))
+   {
+      efree(tmpfile);
+      return false;
+   }
+
+   ok = (fwrite(hublevel->data, 1, hublevel->size, f) == hublevel->size);
+   if(fclose(f))
+      ok = false;
+
+   if(!ok)
+   {
+      remove(tmpfile);
+      efree(tmpfile);
+      return false;
+   }
+
+   efree(hublevel->data);
+   hublevel->data    = NULL;
+   hublevel->tmpfile = tmpfile;
+   return true;
+}
+
+//
+// P_limitHubMemory
+//
+// Spills levels to disk until those left in memory fit within p_hubmemory.
+// The level just saved is kept, as it's the one most likely to be needed.
+//
+static void P_limitHubMemory(hublevel_t *keep)
+{
+   size_t total = 0;
+   int i;
+
+   if(!p_hubmemory)
+      return;
+
+   for(i=0; i<num_hub_levels; i++)
+   {
+      if(hub_levels[i].data)
+         total += hub_levels[i].size;
+   }
+
+   while(total > size_t(p_hubmemory) * 1024)
+   {
+      hublevel_t *oldest = NULL;
+
+      for(i=0; i<num_hub_levels; i++)
+      {
+         hublevel_t *hl = &hub_levels[i];
+
+         if(hl != keep && hl->data && (!oldest || hl->lastused < oldest->lastused))
+            oldest = hl;
+      }
+
+      if(!oldest)
+         break;
+
+      size_t size = oldest->size;
+      if(!P_spillHubLevel(oldest))
+      {
+         C_Printf(FC_ERROR "Could not move hub level to disk\n");
+         break;
+      }
+      total -= size;
+   }
 }
 
 // save the current level in the hub
@@ -148,18 +263,32 @@ static void SaveHubLevel(void)
 {
    static char hubdesc[] = "smmu hubs";
    hublevel_t *hublevel;
+   byte *raw;
+   size_t rawsize;
+   uLongf size;
    
    hublevel = HublevelForName(levelmapname);
    
    // create new hublevel if not been there yet
    if(!hublevel)
       hublevel = AddHublevel(levelmapname);
-   
-   // allocate a temp. filename for save
-   if(!hublevel->tmpfile)
-      hublevel->tmpfile = temp_hubfile();
-   
-   P_SaveCurrentLevel(hublevel->tmpfile, hubdesc);
+
+   raw = P_SaveGameToMemory(hubdesc, rawsize);
+
+   P_freeHubLevel(hublevel);
+
+   size = compressBound(uLong(rawsize));
+   hublevel->data = emalloc(byte *, size);
+   if(compress2(hublevel->data, &size, raw, uLong(rawsize), Z_BEST_SPEED) != Z_OK)
+      I_Error("SaveHubLevel: could not compress level %s\n", levelmapname);
+   efree(raw);
+
+   hublevel->data     = erealloc(byte *, hublevel->data, size);
+   hublevel->size     = size;
+   hublevel->rawsize  = rawsize;
+   hublevel->lastused = ++hubclock;
+
+   P_limitHubMemory(hublevel);
 }
 
 static void LoadHubLevel(char *levelname)
@@ -168,7 +297,7 @@ static void LoadHubLevel(char *levelname)
    
    hublevel = HublevelForName(levelname);
    
-   if(!hublevel)
+   if(!hublevel || (!hublevel->data && !hublevel->tmpfile))
    {
       // load level normally
       G_SetGameMapName(levelname);
@@ -176,14 +305,77 @@ static void LoadHubLevel(char *levelname)
    }
    else
    {
-      // found saved level: reload
-      G_LoadGame(hublevel->tmpfile, 0, 0);
+      // found saved level: reload from memory through P_DoLoadHubLevel
+      hubtoload = hublevel;
+      G_LoadGame(levelname, 0, 0);
       hub_changelevel = true;
    }
    
    wipegamestate = gamestate;
 }
 
+//
+// P_readHubFile
+//
+// Reads a spilled level's compressed data back in.
+//
+static byte *P_readHubFile(hublevel_t *hublevel)
+{
+   byte *data = emalloc(byte *, hublevel->size);
+   FILE *f;
+   bool  ok = false;
+
+   if((f = fopen(hublevel->tmpfile, "rb")))
+   {
+      ok = (fread(data, 1, hublevel->size, f) == hublevel->size);
+      fclose(f);
+   }
+
+   if(!ok)
+   {
+      efree(data);
+      return NULL;
+   }
+
+   return data;
+}
+
+//
+// P_DoLoadHubLevel
+//
+// Called in place of P_LoadGame when G_LoadGame was told to go back to a
+// hub level.
+//
+void P_DoLoadHubLevel(void)
+{
+   hublevel_t *hublevel = hubtoload;
+   byte *packed, *raw;
+   uLongf rawsize;
+
+   hubtoload = NULL;
+
+   if(!hublevel)
+      I_Error("P_DoLoadHubLevel: no hub level to load\n");
+
+   if(!(packed = hublevel->data) && !(packed = P_readHubFile(hublevel)))
+      I_Error("P_DoLoadHubLevel: could not read %s\n", hublevel->tmpfile);
+
+   rawsize = uLongf(hublevel->rawsize);
+   raw     = emalloc(byte *, rawsize);
+
+   if(uncompress(raw, &rawsize, packed, uLong(hublevel->size)) != Z_OK ||
+      rawsize != hublevel->rawsize)
+   {
+      I_Error("P_DoLoadHubLevel: hub level is corrupt\n");
+   }
+
+   if(packed != hublevel->data)
+      efree(packed);
+
+   P_LoadGameFromMemory(raw, rawsize);
+   efree(raw);
+}
+
 void P_HubChangeLevel(char *levelname)
 {
    hub_changelevel = true;
@@ -292,5 +484,8 @@ void P_RestorePlayerPosition(void)
    P_SetThingPosition(save_player->mo);
 }
 
+VARIABLE_INT(p_hubmemory, NULL, 0, 1024*1024, NULL);
+CONSOLE_VARIABLE(p_hubmemory, p_hubmemory, 0) {}
+
 // EOF
 
@@ -37,6 +37,7 @@ void P_SavePlayerPosition(player_t *player, int sectag);
 void P_RestorePlayerPosition();
 
 void P_HubReborn();
+void P_DoLoadHubLevel();
 
 extern bool hub_changelevel;
 
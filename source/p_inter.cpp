@@ -1790,6 +1790,7 @@ void P_RaiseCorpse(Mobj *corpse, const Mobj *raiser)
       // fix Ghost bug
       corpse->height = P_ThingInfoHeight(info);
       corpse->radius = info->radius;
+      P_RefreshBlockThing(corpse);
    }                                                  // phares
 
    // killough 7/18/98: 
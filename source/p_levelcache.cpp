@@ -0,0 +1,464 @@
+//
+// The Eternity Engine
+// Copyright (C) 2018 James Haley et al.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see http://www.gnu.org/licenses/
+//
+// Additional terms and conditions compatible with the GPLv3 apply. See the
+// file COPYING-EE for details.
+//
+// Purpose: On-disk cache of level data derived during P_SetupLevel.
+//
+//  Some of what P_SetupLevel works out from a map's lumps is expensive on
+//  large levels and comes out the same every time: a generated blockmap,
+//  the sector bounding boxes and sound zones, and the vertex positions left
+//  by slime trail removal. The first time a level is set up, each of these
+//  is appended to a file as a section once computed. Later loads of the
+//  same level read the sections back, in the same order, instead of
+//  computing them.
+//
+//  The file is named by a hash of the map's lumps, its ExtraData and the
+//  settings the derived data depends on, so a changed map or setting just
+//  misses. Only data without pointers is kept; anything that refers to
+//  thinkers, specials or portals is still built on every load.
+//
+
+#include "z_zone.h"
+
+#include "c_io.h"
+#include "doomstat.h"
+#include "e_udmf.h"
+#include "hal/i_directory.h"
+#include "m_argv.h"
+#include "m_fixed.h"
+#include "m_hash.h"
+#include "m_qstr.h"
+#include "m_utils.h"
+#include "p_info.h"
+#include "p_levelcache.h"
+#include "p_nodebuild.h"
+#include "p_setup.h"
+#include "r_defs.h"
+#include "r_state.h"
+#include "v_misc.h"
+#include "w_wad.h"
+
+// bump when the layout or the computation of any section changes
+#define LEVELCACHE_VERSION 1
+
+static const char levelCacheMagic[8] = { 'E', 'E', 'L', 'E', 'V', 'E', 'L', 'C' };
+
+enum
+{
+   LCS_BLOCKMAP = 1,
+   LCS_SECTORS,
+   LCS_VERTEXES
+};
+
+enum
+{
+   LC_OFF,     // no cache for this level
+   LC_READING, // sections come from the file
+   LC_WRITING  // sections are being collected for the file
+};
+
+//
+// lcsector_t
+//
+// Cached data of one sector.
+//
+struct lcsector_t
+{
+   fixed_t box[4];
+   int32_t soundzone;
+};
+
+static int     cachestate;
+static qstring cachepath;
+static byte   *cachedata;   // file contents, or sections collected so far
+static size_t  cachelength;
+static size_t  cachealloc;
+static size_t  cachepos;    // read position
+
+//
+// P_levelCacheReset
+//
+static void P_levelCacheReset()
+{
+   if(cachedata)
+      efree(cachedata);
+   cachedata   = NULL;
+   cachelength = 0;
+   cachealloc  = 0;
+   cachepos    = 0;
+   cachestate  = LC_OFF;
+}
+
+//
+// P_levelCachePath
+//
+// Works out the file for the level whose header is at lumpnum.
+//
+static void P_levelCachePath(WadDirectory &dir, int lumpnum, const maplumpindex_t &mgla)
+{
+   HashData hash(HashData::SHA1);
+   int32_t  settings[4] =
+   {
+      LEVELCACHE_VERSION, full_demo_version, r_blockmap, P_ForceNodeBuild()
+   };
+   int      lastlump = lumpnum + ML_BLOCKMAP;
+
+   hash.addData(reinterpret_cast<const uint8_t *>(settings), sizeof(settings));
+
+   const int maplumps[] =
+   {
+      mgla.segs, mgla.ssectors, mgla.nodes, mgla.reject, mgla.blockmap, mgla.behavior
+   };
+
+   // every map lump lies between the header and the last one P_CheckLevel found
+   for(int ln : maplumps)
+   {
+      if(ln > lastlump)
+         lastlump = ln;
+   }
+   if(lastlump >= dir.getNumLumps())
+      lastlump = dir.getNumLumps() - 1;
+
+   for(int ln = lumpnum + 1; ln <= lastlump; ln++)
+   {
+      int size = dir.lumpLength(ln);
+
+      hash.addData(reinterpret_cast<const uint8_t *>(dir.getLumpInfo()[ln]->name), 8);
+      if(size > 0)
+      {
+         hash.addData(static_cast<const uint8_t *>(dir.cacheLumpNum(ln, PU_CACHE)),
+                      uint32_t(size));
+      }
+   }
+
+   // ExtraData can mark lines as sound zone boundaries
+   if(LevelInfo.extraData)
+   {
+      int ln = W_CheckNumForName(LevelInfo.extraData);
+
+      if(ln >= 0 && wGlobalDir.lumpLength(ln) > 0)
+      {
+         hash.addData(static_cast<const uint8_t *>(wGlobalDir.cacheLumpNum(ln, PU_CACHE)),
+                      uint32_t(wGlobalDir.lumpLength(ln)));
+      }
+   }
+   hash.wrapUp();
+
+   char *digest = hash.digestToString();
+
+   cachepath = usergamepath;
+   cachepath.pathConcatenate("cache");
+   I_CreateDirectory(cachepath);
+   cachepath.pathConcatenate(digest);
+   cachepath += ".lvc";
+
+   efree(digest);
+}
+
+//
+// P_OpenLevelCache
+//
+// Called before a level's lumps are loaded. Reads its cache file if there
+// is one, or else starts collecting sections for it.
+//
+void P_OpenLevelCache(WadDirectory &dir, int lumpnum, const maplumpindex_t &mgla)
+{
+   int32_t version;
+   int     length;
+
+   P_levelCacheReset();
+
+   if(M_CheckParm("-nolevelcache"))
+      return;
+
+   P_levelCachePath(dir, lumpnum, mgla);
+
+   length = M_ReadFile(cachepath.constPtr(), &cachedata);
+   if(length >= int(sizeof(levelCacheMagic) + sizeof(version)))
+      memcpy(&version, cachedata + sizeof(levelCacheMagic), sizeof(version));
+
+   if(length < int(sizeof(levelCacheMagic) + sizeof(version)) ||
+      memcmp(cachedata, levelCacheMagic, sizeof(levelCacheMagic)) ||
+      version != LEVELCACHE_VERSION)
+   {
+      // missing or out of date
+      P_levelCacheReset();
+      cachestate = LC_WRITING;
+      return;
+   }
+
+   cachelength = size_t(length);
+   cachepos    = sizeof(levelCacheMagic) + sizeof(version);
+   cachestate  = LC_READING;
+}
+
+//
+// P_CloseLevelCache
+//
+// Called once the level is set up. Writes out the sections collected if
+// there was no cache file.
+//
+void P_CloseLevelCache()
+{
+   if(cachestate == LC_WRITING && cachelength)
+   {
+      size_t headerlen = sizeof(levelCacheMagic) + sizeof(int32_t);
+      byte  *buffer    = emalloc(byte *, headerlen + cachelength);
+      int32_t version  = LEVELCACHE_VERSION;
+
+      memcpy(buffer, levelCacheMagic, sizeof(levelCacheMagic));
+      memcpy(buffer + sizeof(levelCacheMagic), &version, sizeof(version));
+      memcpy(buffer + headerlen, cachedata, cachelength);
+
+      if(!M_WriteFile(cachepath.constPtr(), buffer, headerlen + cachelength))
+         C_Printf(FC_ERROR "P_CloseLevelCache: could not write %s\n",
+                  cachepath.constPtr());
+
+      efree(buffer);
+   }
+
+   P_levelCacheReset();
+}
+
+//=============================================================================
+//
+// Sections
+//
+// Each one is a tag, an item count and the items. Anything unexpected while
+// reading drops the cache for the rest of the level.
+//
+
+//
+// P_readSection
+//
+// Returns the items of the next section if it has the given tag and count,
+// or NULL. A count of -1 accepts any count and returns it.
+//
+static const byte *P_readSection(int tag, int &count, size_t itemsize)
+{
+   int32_t header[2];
+
+   if(cachestate != LC_READING)
+      return NULL;
+
+   if(cachelength - cachepos >= sizeof(header))
+   {
+      memcpy(header, cachedata + cachepos, sizeof(header));
+
+      size_t datalen = size_t(header[1]) * itemsize;
+
+      if(header[0] == tag && header[1] >= 0 && (count < 0 || header[1] == count) &&
+         cachelength - cachepos - sizeof(header) >= datalen)
+      {
+         const byte *data = cachedata + cachepos + sizeof(header);
+
+         cachepos += sizeof(header) + datalen;
+         count = header[1];
+         return data;
+      }
+   }
+
+   // remove it so that the next load writes a good one
+   C_Printf(FC_ERROR "Level cache %s is invalid\n", cachepath.constPtr());
+   remove(cachepath.constPtr());
+   P_levelCacheReset();
+   return NULL;
+}
+
+//
+// P_writeSection
+//
+// Appends a section header, and returns where count items of the given size
+// should be written, or NULL if nothing is being collected.
+//
+static byte *P_writeSection(int tag, int count, size_t itemsize)
+{
+   int32_t header[2] = { tag, count };
+   size_t  needed    = cachelength + sizeof(header) + size_t(count) * itemsize;
+
+   if(cachestate != LC_WRITING)
+      return NULL;
+
+   if(needed > cachealloc)
+   {
+      cachealloc = needed > cachealloc * 2 ? needed : cachealloc * 2;
+      cachedata  = erealloc(byte *, cachedata, cachealloc);
+   }
+
+   memcpy(cachedata + cachelength, header, sizeof(header));
+
+   byte *data = cachedata + cachelength + sizeof(header);
+   cachelength = needed;
+   return data;
+}
+
+//
+// P_CachedBlockMap
+//
+// Sets up a generated blockmap from the cache, in place of P_CreateBlockMap.
+//
+bool P_CachedBlockMap()
+{
+   int count = -1;
+   const byte *data = P_readSection(LCS_BLOCKMAP, count, sizeof(int32_t));
+
+   if(!data || count < 4)
+      return false;
+
+   blockmaplump = static_cast<int *>(Z_Malloc(sizeof(*blockmaplump) * count, PU_LEVEL,
+                                              NULL));
+   memcpy(blockmaplump, data, sizeof(*blockmaplump) * count);
+
+   bmaporgx    = blockmaplump[0] << FRACBITS;
+   bmaporgy    = blockmaplump[1] << FRACBITS;
+   bmapwidth   = blockmaplump[2];
+   bmapheight  = blockmaplump[3];
+   skipblstart = true;
+
+   return true;
+}
+
+//
+// P_CacheBlockMap
+//
+// Adds the count entries of a freshly generated blockmaplump. P_CreateBlockMap
+// leaves the four header words unused, so the origin and size go there.
+//
+void P_CacheBlockMap(int count)
+{
+   int32_t *data =
+      reinterpret_cast<int32_t *>(P_writeSection(LCS_BLOCKMAP, count, sizeof(int32_t)));
+
+   if(!data)
+      return;
+
+   memcpy(data, blockmaplump, sizeof(*blockmaplump) * count);
+   data[0] = bmaporgx >> FRACBITS;
+   data[1] = bmaporgy >> FRACBITS;
+   data[2] = bmapwidth;
+   data[3] = bmapheight;
+}
+
+//
+// P_CachedSectorData
+//
+// Sets up the sector bounding boxes and sound zone numbers from the cache.
+// The soundzones array itself is left to the caller.
+//
+bool P_CachedSectorData()
+{
+   int count = numsectors + 1;
+   const byte *data = P_readSection(LCS_SECTORS, count, sizeof(lcsector_t));
+
+   if(!data)
+      return false;
+
+   const lcsector_t *items = reinterpret_cast<const lcsector_t *>(data);
+
+   pSectorBoxes  = estructalloctag(sectorbox_t, numsectors, PU_LEVEL);
+   numsoundzones = items[0].soundzone;
+
+   for(int i = 0; i < numsectors; i++)
+   {
+      memcpy(pSectorBoxes[i].box, items[i + 1].box, sizeof(pSectorBoxes[i].box));
+      sectors[i].soundzone = items[i + 1].soundzone;
+   }
+
+   return true;
+}
+
+//
+// P_CacheSectorData
+//
+// Adds the sector bounding boxes and sound zones. The first item only holds
+// the number of zones.
+//
+void P_CacheSectorData()
+{
+   lcsector_t *items =
+      reinterpret_cast<lcsector_t *>(P_writeSection(LCS_SECTORS, numsectors + 1,
+                                                    sizeof(lcsector_t)));
+
+   if(!items)
+      return;
+
+   memset(items, 0, sizeof(*items));
+   items[0].soundzone = numsoundzones;
+
+   for(int i = 0; i < numsectors; i++)
+   {
+      memcpy(items[i + 1].box, pSectorBoxes[i].box, sizeof(items[i + 1].box));
+      items[i + 1].soundzone = sectors[i].soundzone;
+   }
+}
+
+//
+// P_CachedVertexes
+//
+// Moves the vertexes to where slime trail removal left them.
+//
+bool P_CachedVertexes()
+{
+   int count = numvertexes;
+   const byte *data = P_readSection(LCS_VERTEXES, count, 2 * sizeof(fixed_t));
+
+   if(!data)
+      return false;
+
+   const fixed_t *coords = reinterpret_cast<const fixed_t *>(data);
+
+   for(int i = 0; i < numvertexes; i++)
+   {
+      vertex_t &v = vertexes[i];
+
+      if(v.x != coords[2 * i] || v.y != coords[2 * i + 1])
+      {
+         v.x  = coords[2 * i];
+         v.y  = coords[2 * i + 1];
+         v.fx = M_FixedToFloat(v.x);
+         v.fy = M_FixedToFloat(v.y);
+      }
+   }
+
+   return true;
+}
+
+//
+// P_CacheVertexes
+//
+// Adds the vertex positions after slime trail removal.
+//
+void P_CacheVertexes()
+{
+   fixed_t *coords =
+      reinterpret_cast<fixed_t *>(P_writeSection(LCS_VERTEXES, numvertexes,
+                                                 2 * sizeof(fixed_t)));
+
+   if(!coords)
+      return;
+
+   for(int i = 0; i < numvertexes; i++)
+   {
+      coords[2 * i]     = vertexes[i].x;
+      coords[2 * i + 1] = vertexes[i].y;
+   }
+}
+
+// EOF
+
@@ -0,0 +1,43 @@
+//
+// The Eternity Engine
+// Copyright (C) 2018 James Haley et al.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see http://www.gnu.org/licenses/
+//
+// Additional terms and conditions compatible with the GPLv3 apply. See the
+// file COPYING-EE for details.
+//
+// Purpose: On-disk cache of level data derived during P_SetupLevel.
+//
+
+#ifndef P_LEVELCACHE_H__
+#define P_LEVELCACHE_H__
+
+class  WadDirectory;
+struct maplumpindex_t;
+
+void P_OpenLevelCache(WadDirectory &dir, int lumpnum, const maplumpindex_t &mgla);
+void P_CloseLevelCache();
+
+bool P_CachedBlockMap();
+void P_CacheBlockMap(int count);
+bool P_CachedSectorData();
+void P_CacheSectorData();
+bool P_CachedVertexes();
+void P_CacheVertexes();
+
+#endif
+
+// EOF
+
@@ -54,6 +54,8 @@
 #include "p_spec.h"
 #include "p_tick.h"
 #include "p_user.h"
+#include "p_visit.h"
+#include "polyobj.h"
 #include "r_defs.h"
 #include "r_main.h"
 #include "r_portal.h"
@@ -454,7 +456,7 @@ bool P_TeleportMove(Mobj *thing, fixed_t x, fixed_t y, bool boss)
    // SoM 09/07/02: 3dsides monster fix
    clip.touch3dside = 0;
    
-   validcount++;
+   P_SearchVisit().begin();
    clip.numspechit = 0;
    
    // stomp on any things contacted
@@ -1158,7 +1160,7 @@ bool Check_Sides(Mobj *actor, int x, int y, mobjtype_t type)
 
    // xl->xh, yl->yh determine the mapblock set to search
 
-   validcount++; // prevents checking same line twice
+   P_SearchVisit().begin(); // prevents checking same line twice
    for(bx = xl ; bx <= xh ; bx++)
       for (by = yl ; by <= yh ; by++)
          if(!P_BlockLinesIterator(bx,by,PIT_CrossLine, R_NOGROUP, &type))
@@ -1236,7 +1238,7 @@ bool P_CheckPosition(Mobj *thing, fixed_t x, fixed_t y, PODCollection<line_t *>
    clip.floorpic = newsubsec->sector->floorpic;
    // SoM: 09/07/02: 3dsides monster fix
    clip.touch3dside = 0;
-   validcount++;
+   P_SearchVisit().begin();
    clip.numspechit = 0;
 
    if(clip.thing->flags & MF_NOCLIP)
@@ -1259,7 +1261,7 @@ bool P_CheckPosition(Mobj *thing, fixed_t x, fixed_t y, PODCollection<line_t *>
    {
       for(by = yl; by <= yh; by++)
       {
-         if(!P_BlockThingsIterator(bx, by, PIT_CheckThing))
+         if(!P_BlockThingsInBox(bx, by, clip.bbox, PIT_CheckThing))
             return false;
       }
    }
@@ -2004,7 +2006,7 @@ void P_ApplyTorque(Mobj *mo)
    int flags = mo->intflags; //Remember the current state, for gear-change
 
    clip.thing = mo;
-   validcount++; // prevents checking same line twice
+   P_SearchVisit().begin(); // prevents checking same line twice
 
    P_TransPortalBlockWalker(clip.bbox, mo->groupid, true, nullptr, 
       [](int x, int y, int groupid, void *data) -> bool
@@ -2618,6 +2620,7 @@ static bool PIT_ChangeSector(Mobj *thing, void *context)
       }
       thing->flags &= ~MF_SOLID;
       thing->height = thing->radius = 0;
+      P_RefreshBlockThing(thing);
       return true;      // keep checking
    }
 
@@ -2756,6 +2759,9 @@ bool P_CheckSector(sector_t *sector, int crunch, int amt, int floorOrCeil)
 
 msecnode_t *headsecnode = NULL;
 
+// sector nodes allocated together when the freelist runs out
+#define SECNODEBLOCK 128
+
 // sf: fix annoying crash on restarting levels
 //
 //      This crash occurred because the msecnode_t's are allocated as
@@ -2785,32 +2791,46 @@ void P_FreeSecNodeList(void)
    headsecnode = NULL; // this is all thats needed to fix the bug
 }
 
+//
+// P_PutSecnode
+//
+// Returns a node to the freelist.
+//
+static void P_PutSecnode(msecnode_t *node)
+{
+   node->m_snext = headsecnode;
+   headsecnode = node;
+}
+
 //
 // P_GetSecnode
 //
 // Retrieves a node from the freelist. The calling routine should make sure it
 // sets all fields properly.
 //
+// Nodes are allocated SECNODEBLOCK at a time, so that the nodes of the
+// things in an area tend to share cache lines when P_ChangeSector walks
+// them.
+//
 // killough 11/98: reformatted
 //
 static msecnode_t *P_GetSecnode(void)
 {
    msecnode_t *node;
 
-   return headsecnode ?
-   node = headsecnode, headsecnode = node->m_snext, node :
-      (msecnode_t *)(Z_Malloc(sizeof *node, PU_LEVEL, NULL)); 
-}
+   // refill the freelist a block at a time, so that nodes sit together
+   if(!headsecnode)
+   {
+      msecnode_t *block =
+         (msecnode_t *)(Z_Malloc(SECNODEBLOCK * sizeof *node, PU_LEVEL, NULL));
 
-//
-// P_PutSecnode
-//
-// Returns a node to the freelist.
-//
-static void P_PutSecnode(msecnode_t *node)
-{
-   node->m_snext = headsecnode;
-   headsecnode = node;
+      for(int i = SECNODEBLOCK; i--; )
+         P_PutSecnode(&block[i]);
+   }
+
+   node = headsecnode;
+   headsecnode = node->m_snext;
+   return node;
 }
 
 //
@@ -2921,6 +2941,63 @@ void P_DelSeclist(msecnode_t *node)
       node = P_DelSecnode(node);
 }
 
+//
+// Sector list reuse
+//
+// Most moves don't bring a thing near any line, and its sector list stays
+// the one sector it is in. When P_CreateSecNodeList finds no line at all
+// within SECNODEMARGIN of the thing's box, it remembers that area, and
+// the blocks it searched, in the thing. While the thing stays inside that
+// area in the same sector, the search could only find the same list again,
+// so it is skipped.
+//
+
+// distance around a thing's box that must be clear of lines
+#define SECNODEMARGIN (32*FRACUNIT)
+
+static fixed_t secnodeclearbox[4]; // area being checked by PIT_GetSectors
+static bool    secnodesnear;       // a line was found in secnodeclearbox
+
+//
+// P_secNodeListClear
+//
+// True if the thing's sector list can be kept as it is, being in the same
+// sector and inside the area last found clear of lines, with the same
+// blocks to search.
+//
+static bool P_secNodeListClear(const Mobj *thing, const fixed_t *bbox, int xl, int xh,
+                               int yl, int yh)
+{
+   const msecnode_t *list = thing->old_sectorlist;
+
+   if(!thing->secnodeclear || !list || list->m_tnext ||
+      list->m_sector != thing->subsector->sector)
+      return false;
+
+   if(bbox[BOXLEFT]   < thing->secnodebox[BOXLEFT]   ||
+      bbox[BOXRIGHT]  > thing->secnodebox[BOXRIGHT]  ||
+      bbox[BOXBOTTOM] < thing->secnodebox[BOXBOTTOM] ||
+      bbox[BOXTOP]    > thing->secnodebox[BOXTOP])
+      return false;
+
+   if(xl != thing->secnodeblocks[0] || xh != thing->secnodeblocks[1] ||
+      yl != thing->secnodeblocks[2] || yh != thing->secnodeblocks[3])
+      return false;
+
+   // polyobjects move, so their lines can't be counted on to stay away
+   for(int bx = xl; bx <= xh; bx++)
+   {
+      for(int by = yl; by <= yh; by++)
+      {
+         if(bx >= 0 && by >= 0 && bx < bmapwidth && by < bmapheight &&
+            polyblocklinks[by * bmapwidth + bx])
+            return false;
+      }
+   }
+
+   return true;
+}
+
 //
 // PIT_GetSectors
 //
@@ -2940,6 +3017,13 @@ static bool PIT_GetSectors(line_t *ld, polyobj_s *po, void *context)
    bbox[BOXLEFT] = pClip->bbox[BOXLEFT] + link->x;
    bbox[BOXTOP] = pClip->bbox[BOXTOP] + link->y;
    bbox[BOXBOTTOM] = pClip->bbox[BOXBOTTOM] + link->y;
+
+   // note lines near enough to spoil the clear area around the thing
+   if(!(secnodeclearbox[BOXRIGHT]  + link->x <= ld->bbox[BOXLEFT]   ||
+        secnodeclearbox[BOXLEFT]   + link->x >= ld->bbox[BOXRIGHT]  ||
+        secnodeclearbox[BOXTOP]    + link->y <= ld->bbox[BOXBOTTOM] ||
+        secnodeclearbox[BOXBOTTOM] + link->y >= ld->bbox[BOXTOP]))
+      secnodesnear = true;
    
    if(bbox[BOXRIGHT]  <= ld->bbox[BOXLEFT]   ||
       bbox[BOXLEFT]   >= ld->bbox[BOXRIGHT]  ||
@@ -3026,9 +3110,14 @@ static bool PIT_GetSectors(line_t *ld, polyobj_s *po, void *context)
 // haleyjd 04/16/2010: rewritten to use clip stack for saving global clipping
 // variables when required
 //
+// Outside of portal maps, the search is skipped while the thing stays in an
+// area found clear of lines; see P_secNodeListClear.
+//
 msecnode_t *P_CreateSecNodeList(Mobj *thing, fixed_t x, fixed_t y)
 {
    msecnode_t *node, *list;
+   bool keptlist = false;      // old list kept without a search
+   bool searchedlines = false; // classic search made; may record a clear area
 
    if(demo_version < 200 || demo_version >= 329)
       P_PushClipStack();
@@ -3051,7 +3140,7 @@ msecnode_t *P_CreateSecNodeList(Mobj *thing, fixed_t x, fixed_t y)
    pClip->bbox[BOXRIGHT]  = x + thing->radius;
    pClip->bbox[BOXLEFT]   = x - thing->radius;
 
-   validcount++; // used to make sure we only process a line once
+   P_SearchVisit().begin(); // used to make sure we only process a line once
 
    pClip->sector_list = thing->old_sectorlist;
 
@@ -3108,14 +3197,41 @@ msecnode_t *P_CreateSecNodeList(Mobj *thing, fixed_t x, fixed_t y)
       int yl = (pClip->bbox[BOXBOTTOM] - bmaporgy) >> MAPBLOCKSHIFT;
       int yh = (pClip->bbox[BOXTOP   ] - bmaporgy) >> MAPBLOCKSHIFT;
 
-      for(int bx = xl; bx <= xh; bx++)
+      if(P_secNodeListClear(thing, pClip->bbox, xl, xh, yl, yh))
+      {
+         // nothing could have changed; keep the one node
+         list = pClip->sector_list;
+         list->m_thing = thing;
+         keptlist = true;
+      }
+      else
       {
-         for(int by = yl; by <= yh; by++)
-            P_BlockLinesIterator(bx, by, PIT_GetSectors);
+         secnodeclearbox[BOXTOP]    = pClip->bbox[BOXTOP]    + SECNODEMARGIN;
+         secnodeclearbox[BOXBOTTOM] = pClip->bbox[BOXBOTTOM] - SECNODEMARGIN;
+         secnodeclearbox[BOXRIGHT]  = pClip->bbox[BOXRIGHT]  + SECNODEMARGIN;
+         secnodeclearbox[BOXLEFT]   = pClip->bbox[BOXLEFT]   - SECNODEMARGIN;
+
+         // don't trust an area that wrapped around the edge of the map
+         secnodesnear = secnodeclearbox[BOXTOP]    < pClip->bbox[BOXTOP]    ||
+                        secnodeclearbox[BOXBOTTOM] > pClip->bbox[BOXBOTTOM] ||
+                        secnodeclearbox[BOXRIGHT]  < pClip->bbox[BOXRIGHT]  ||
+                        secnodeclearbox[BOXLEFT]   > pClip->bbox[BOXLEFT];
+
+         for(int bx = xl; bx <= xh; bx++)
+         {
+            for(int by = yl; by <= yh; by++)
+               P_BlockLinesIterator(bx, by, PIT_GetSectors);
+         }
+
+         // Add the sector of the (x,y) point to sector_list.
+         list = P_AddSecnode(thing->subsector->sector, thing, pClip->sector_list);
       }
 
-      // Add the sector of the (x,y) point to sector_list.
-      list = P_AddSecnode(thing->subsector->sector, thing, pClip->sector_list);
+      thing->secnodeblocks[0] = xl;
+      thing->secnodeblocks[1] = xh;
+      thing->secnodeblocks[2] = yl;
+      thing->secnodeblocks[3] = yh;
+      searchedlines = !keptlist;
    }
 
    // Now delete any nodes that won't be used. These are the ones where
@@ -3133,6 +3249,21 @@ msecnode_t *P_CreateSecNodeList(Mobj *thing, fixed_t x, fixed_t y)
          node = node->m_tnext;
    }
 
+   // remember the area clear of lines, if any, for the next move
+   if(searchedlines)
+   {
+      thing->secnodeclear = !secnodesnear && list && !list->m_tnext;
+      if(thing->secnodeclear)
+      {
+         thing->secnodebox[BOXTOP]    = secnodeclearbox[BOXTOP];
+         thing->secnodebox[BOXBOTTOM] = secnodeclearbox[BOXBOTTOM];
+         thing->secnodebox[BOXRIGHT]  = secnodeclearbox[BOXRIGHT];
+         thing->secnodebox[BOXLEFT]   = secnodeclearbox[BOXLEFT];
+      }
+   }
+   else if(!keptlist)
+      thing->secnodeclear = false;
+
   /* cph -
    * This is the strife we get into for using global variables. 
    *  clip.thing is being used by several different functions calling
@@ -97,6 +97,8 @@ bool P_TeleportMoveStrict(Mobj *thing, fixed_t x, fixed_t y, bool boss);
 //
 
 bool P_CheckSight(Mobj *t1, Mobj *t2);
+void P_InvalidateSightCache();
+void P_ClearSightCache();
 void P_UseLines(player_t *player);
 
 // killough 8/2/98: add 'mask' argument to prevent friends autoaiming at others
@@ -59,6 +59,7 @@
 #include "p_portalcross.h"
 #include "p_sector.h"
 #include "p_setup.h"
+#include "p_visit.h"
 #include "r_main.h"
 #include "r_pcheck.h"
 
@@ -280,18 +281,13 @@ Mobj *P_GetThingUnder(Mobj *mo)
 static bool P_SBlockThingsIterator(int x, int y, bool (*func)(Mobj *), 
                                    Mobj *actor, int groupid = R_NOGROUP)
 {
-   Mobj *mobj;
+   BlockThingCursor cursor(x, y, actor);
+   const blockthing_t *bt;
 
-   if(x < 0 || y < 0 || x >= bmapwidth || y >= bmapheight)
-      return true;
-   
-   if(actor == NULL)
-      mobj = blocklinks[y * bmapwidth + x];
-   else
-      mobj = actor->bnext;
-
-   for(; mobj; mobj = mobj->bnext)
+   while((bt = cursor.next()))
    {
+      Mobj *mobj = bt->mo;
+
       if(groupid != R_NOGROUP && mobj->groupid != R_NOGROUP && 
          groupid != mobj->groupid)
       {
@@ -639,7 +635,7 @@ bool P_CheckPosition3D(Mobj *thing, fixed_t x, fixed_t y, PODCollection<line_t *
    clip.floorpic = bottomsector->floorpic;
    // SoM: 09/07/02: 3dsides monster fix
    clip.touch3dside = 0;
-   validcount++;
+   P_SearchVisit().begin();
    
    clip.numspechit = 0;
 
@@ -1059,6 +1055,7 @@ static void P_DoCrunch(Mobj *thing)
       }
       thing->flags &= ~MF_SOLID;
       thing->height = thing->radius = 0;
+      P_RefreshBlockThing(thing);
       return;
    }
 
@@ -36,6 +36,7 @@
 #include "p_maputl.h"
 #include "p_portalclip.h"
 #include "p_setup.h"
+#include "p_visit.h"
 #include "polyobj.h"
 #include "r_data.h"
 #include "r_main.h"
@@ -518,6 +519,157 @@ void P_LogThingPosition(Mobj *mo, const char *caller)
 #define P_LogThingPosition(a, b)
 #endif
 
+//=============================================================================
+//
+// Blockmap thing storage
+//
+// Each blockmap cell keeps a compact array of the things in it, with their
+// position and size copied in when they are linked. Things know the index
+// of their entry, so unlinking only empties it; the order things were
+// linked in, which demos depend on, is kept. Empty entries are squeezed out
+// when they fill half of a full array, unless a cursor is open on the cell.
+// Open cursors are kept on a stack.
+//
+
+// most recently opened cursor; per thread, since read-only searches may run
+// on worker threads
+static thread_local BlockThingCursor *blockcursors;
+
+//
+// P_useBlockCache
+//
+// Old demos were recorded against the live values of things that were
+// resized without relinking, so only newer ones may use the copies in
+// blockthing_t to skip things.
+//
+static bool P_useBlockCache()
+{
+   return full_demo_version >= make_full_version(401, 1);
+}
+
+//
+// BlockThingCursor::cellOpen
+//
+// True if a cursor is open on the cell, so that its entries must stay put.
+//
+bool BlockThingCursor::cellOpen(int cellnum)
+{
+   for(const BlockThingCursor *cur = blockcursors; cur; cur = cur->prev)
+   {
+      if(cur->cell == cellnum)
+         return true;
+   }
+   return false;
+}
+
+//
+// P_compactBlockCell
+//
+// Squeezes the empty entries out of a cell, keeping the order of the rest.
+//
+static void P_compactBlockCell(blockcell_t &cell)
+{
+   int count = 0;
+
+   for(int i = 0; i < cell.numthings; i++)
+   {
+      if(!cell.things[i].mo)
+         continue;
+      cell.things[count] = cell.things[i];
+      cell.things[count].mo->blockindex = count;
+      ++count;
+   }
+
+   cell.numthings  = count;
+   cell.numremoved = 0;
+}
+
+//
+// P_linkBlockThing
+//
+// Appends a thing to a blockmap cell.
+//
+static void P_linkBlockThing(Mobj *thing, int cellnum)
+{
+   blockcell_t &cell = blockthings[cellnum];
+
+   // squeeze out empty entries once they fill half the array, so that each
+   // compaction is paid for by as many unlinks
+   if(cell.numthings == cell.maxthings && cell.numremoved &&
+      cell.numremoved * 2 >= cell.numthings && !BlockThingCursor::cellOpen(cellnum))
+      P_compactBlockCell(cell);
+
+   if(cell.numthings == cell.maxthings)
+   {
+      cell.maxthings = cell.maxthings ? cell.maxthings * 2 : 4;
+      cell.things = static_cast<blockthing_t *>
+         (Z_Realloc(cell.things, cell.maxthings * sizeof(blockthing_t), PU_LEVEL,
+                    nullptr));
+   }
+
+   blockthing_t &bt = cell.things[cell.numthings];
+   bt.mo     = thing;
+   bt.x      = thing->x;
+   bt.y      = thing->y;
+   bt.radius = thing->radius;
+
+   thing->blockcell  = cellnum + 1;
+   thing->blockindex = cell.numthings++;
+}
+
+//
+// BlockThingCursor::BlockThingCursor
+//
+// Opens a cursor on the cell at (x, y). If after is given, the walk starts
+// with the thing visited after it instead; if it is no longer in the cell,
+// there is nothing left to visit.
+//
+BlockThingCursor::BlockThingCursor(int x, int y, const Mobj *after)
+   : prev(blockcursors), cell(-1), index(0)
+{
+   blockcursors = this;
+
+   if(x < 0 || y < 0 || x >= bmapwidth || y >= bmapheight)
+      return;
+
+   cell  = y * bmapwidth + x;
+   index = blockthings[cell].numthings;
+
+   if(after)
+      index = (after->blockcell == cell + 1) ? after->blockindex : 0;
+}
+
+//
+// BlockThingCursor::~BlockThingCursor
+//
+BlockThingCursor::~BlockThingCursor()
+{
+   blockcursors = prev;
+}
+
+//
+// BlockThingCursor::next
+//
+// Returns the next thing in the cell, or nullptr when there are no more.
+// The pointer is only good until something is linked into or unlinked from
+// the cell.
+//
+const blockthing_t *BlockThingCursor::next()
+{
+   if(cell < 0)
+      return nullptr;
+
+   const blockcell_t &bc = blockthings[cell];
+
+   while(index > 0)
+   {
+      const blockthing_t *bt = &bc.things[--index];
+      if(bt->mo)
+         return bt;
+   }
+   return nullptr;
+}
+
 //
 // P_UnsetThingPosition
 // Unlinks a thing from block map and sectors.
@@ -558,21 +710,20 @@ void P_UnsetThingPosition(Mobj *thing)
       thing->touching_sectorlist = NULL; // to be restored by P_SetThingPosition
    }
 
-   if(!(thing->flags & MF_NOBLOCKMAP))
+   if(thing->blockcell)
    {
-      // inert things don't need to be in blockmap
-      
-      // killough 8/11/98: simpler scheme using pointers-to-pointers for prev
-      // pointers, allows head node pointers to be treated like everything else
-      //
-      // Also more robust, since it doesn't depend on current position for
-      // unlinking. Old method required computing head node based on position
-      // at time of unlinking, assuming it was the same position as during
-      // linking.
-      
-      Mobj *bnext, **bprev = thing->bprev;
-      if(bprev && (*bprev = bnext = thing->bnext))  // unlink from block map
-         bnext->bprev = bprev;
+      // unlink from the cell it was linked into, which doesn't depend on its
+      // current position; the entry is left empty so the rest keep their order
+      int cellnum = thing->blockcell - 1;
+      blockcell_t &cell = blockthings[cellnum];
+
+      cell.things[thing->blockindex].mo = nullptr;
+
+      // start over once the cell is empty
+      if(++cell.numremoved == cell.numthings && !BlockThingCursor::cellOpen(cellnum))
+         cell.numthings = cell.numremoved = 0;
+
+      thing->blockcell = 0;
    }
 }
 
@@ -634,25 +785,30 @@ void P_SetThingPosition(Mobj *thing)
       int blocky = (thing->y - bmaporgy) >> MAPBLOCKSHIFT;
       
       if(blockx >= 0 && blockx < bmapwidth && blocky >= 0 && blocky < bmapheight)
-      {
-         // killough 8/11/98: simpler scheme using pointer-to-pointer prev
-         // pointers, allows head nodes to be treated like everything else
-
-         Mobj **link = &blocklinks[blocky*bmapwidth+blockx];
-         Mobj *bnext = *link;
-         if((thing->bnext = bnext))
-            bnext->bprev = &thing->bnext;
-         thing->bprev = link;
-         *link = thing;
-      }
+         P_linkBlockThing(thing, blocky * bmapwidth + blockx);
       else        // thing is off the map
-      {
-         thing->bnext = NULL;
-         thing->bprev = NULL;
-      }
+         thing->blockcell = 0;
    }
 }
 
+//
+// P_RefreshBlockThing
+//
+// Copies a thing's position and radius into its blockmap entry again. For
+// code that moves or resizes a thing without relinking it; the thing stays
+// in the cell it was linked into.
+//
+void P_RefreshBlockThing(const Mobj *thing)
+{
+   if(!thing->blockcell)
+      return;
+
+   blockthing_t &bt = blockthings[thing->blockcell - 1].things[thing->blockindex];
+   bt.x      = thing->x;
+   bt.y      = thing->y;
+   bt.radius = thing->radius;
+}
+
 // killough 3/15/98:
 //
 // A fast function for testing intersections between things and linedefs.
@@ -703,9 +859,9 @@ bool ThingIsOnLine(const Mobj *t, const line_t *l)
 
 //
 // P_BlockLinesIterator
-// The validcount flags are used to avoid checking lines
+// The search visit marks are used to avoid checking lines
 // that are marked in multiple mapblocks,
-// so increment validcount before the first call
+// so call P_SearchVisit().begin() before the first call
 // to P_BlockLinesIterator, then make one or more calls
 // to it.
 //
@@ -722,6 +878,8 @@ bool P_BlockLinesIterator(int x, int y, bool func(line_t*, polyobj_t*, void *),
    
    if(x < 0 || y < 0 || x >= bmapwidth || y >= bmapheight)
       return true;
+
+   VisitContext &visit = P_SearchVisit();
    offset = y * bmapwidth + x;
 
    // haleyjd 02/22/06: consider polyobject lines
@@ -731,16 +889,14 @@ bool P_BlockLinesIterator(int x, int y, bool func(line_t*, polyobj_t*, void *),
    {
       polyobj_t *po = (*plink)->po;
 
-      if(po->validcount != validcount) // if polyobj hasn't been checked
+      if(visit.visitPoly(eindex(po - PolyObjects))) // if polyobj hasn't been checked
       {
          int i;
-         po->validcount = validcount;
          
          for(i = 0; i < po->numLines; ++i)
          {
-            if(po->lines[i]->validcount == validcount) // line has been checked
+            if(!visit.visitLine(eindex(po->lines[i] - lines))) // line has been checked
                continue;
-            po->lines[i]->validcount = validcount;
             if(!func(po->lines[i], po, context))
                return false;
          }
@@ -777,9 +933,8 @@ bool P_BlockLinesIterator(int x, int y, bool func(line_t*, polyobj_t*, void *),
       // ioanch 20160111: check groupid
       if(groupid != R_NOGROUP && groupid != ld->frontsector->groupid)
          continue;
-      if(ld->validcount == validcount)
+      if(!visit.visitLine(*list))
          continue;       // line has already been checked
-      ld->validcount = validcount;
       if(!func(ld, nullptr, context))
          return false;
    }
@@ -795,21 +950,45 @@ bool P_BlockLinesIterator(int x, int y, bool func(line_t*, polyobj_t*, void *),
 bool P_BlockThingsIterator(int x, int y, int groupid, bool (*func)(Mobj *, void *),
                            void *context)
 {
-   if(!(x < 0 || y < 0 || x >= bmapwidth || y >= bmapheight))
+   BlockThingCursor cursor(x, y);
+   const blockthing_t *bt;
+
+   while((bt = cursor.next()))
    {
-      Mobj *mobj = blocklinks[y * bmapwidth + x];
+      Mobj *mobj = bt->mo;
 
-      for(; mobj; mobj = mobj->bnext)
-      {
-         // ioanch: if mismatching group id (in case it's declared), skip
-         if(groupid != R_NOGROUP && mobj->groupid != R_NOGROUP && 
-            groupid != mobj->groupid)
-         {
-            continue;   // ignore objects from wrong groupid
-         }
-         if(!func(mobj, context))
-            return false;
-      }
+      // ioanch: if mismatching group id (in case it's declared), skip
+      if(groupid != R_NOGROUP && mobj->groupid != R_NOGROUP && groupid != mobj->groupid)
+         continue;   // ignore objects from wrong groupid
+      if(!func(mobj, context))
+         return false;
+   }
+   return true;
+}
+
+//
+// P_BlockThingsInBox
+//
+// Like P_BlockThingsIterator, but skips things whose box lies entirely
+// outside of bbox without calling func. Only for callers that would reject
+// such things themselves.
+//
+bool P_BlockThingsInBox(int x, int y, const fixed_t *bbox, bool (*func)(Mobj *, void *),
+                        void *context)
+{
+   if(!P_useBlockCache())
+      return P_BlockThingsIterator(x, y, R_NOGROUP, func, context);
+
+   BlockThingCursor cursor(x, y);
+   const blockthing_t *bt;
+
+   while((bt = cursor.next()))
+   {
+      if(bt->x + bt->radius <= bbox[BOXLEFT]   || bt->x - bt->radius >= bbox[BOXRIGHT] ||
+         bt->y + bt->radius <= bbox[BOXBOTTOM] || bt->y - bt->radius >= bbox[BOXTOP])
+         continue;
+      if(!func(bt->mo, context))
+         return false;
    }
    return true;
 }
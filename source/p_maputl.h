@@ -98,6 +98,59 @@ struct intercept_t
 
 typedef bool (*traverser_t)(intercept_t *in, void *context);
 
+//
+// blockthing_t
+//
+// One thing linked into a blockmap cell. Position and size are copied in when
+// the thing is linked, so that box searches can reject it without touching
+// the Mobj itself. Code that changes them without relinking the thing must
+// call P_RefreshBlockThing.
+//
+struct blockthing_t
+{
+   Mobj    *mo;
+   fixed_t  x, y, radius;
+};
+
+//
+// blockcell_t
+//
+// Things in one blockmap cell, oldest first. Searches visit them newest
+// first, in the same order the old intrusive lists did. Unlinked things
+// leave an entry with a null mo behind until the array is compacted.
+//
+struct blockcell_t
+{
+   blockthing_t *things;
+   int           numthings;  // entries in use, including empty ones
+   int           maxthings;
+   int           numremoved; // empty entries
+};
+
+//
+// BlockThingCursor
+//
+// Walks the things in a blockmap cell, newest first. Things may be linked
+// and unlinked anywhere while a cursor is open: removed things are skipped,
+// and things linked after the cursor was opened are not visited, as was the
+// case for the old lists.
+//
+class BlockThingCursor
+{
+protected:
+   BlockThingCursor *prev;  // next older open cursor
+   int               cell;  // cell index; -1 if off the map
+   int               index; // index of the entry last returned
+
+public:
+   BlockThingCursor(int x, int y, const Mobj *after = nullptr);
+   ~BlockThingCursor();
+
+   const blockthing_t *next();
+
+   static bool cellOpen(int cellnum);
+};
+
 fixed_t P_AproxDistance(fixed_t dx, fixed_t dy);
 int     P_PointOnLineSide(fixed_t x, fixed_t y, const line_t *line);
 int     P_PointOnDivlineSide(fixed_t x, fixed_t y, const divline_t *line);
@@ -118,10 +171,13 @@ void    P_LineOpening (const line_t *linedef, const Mobj *mo,
 
 void P_UnsetThingPosition(Mobj *thing);
 void P_SetThingPosition(Mobj *thing);
+void P_RefreshBlockThing(const Mobj *thing);
 bool P_BlockLinesIterator (int x, int y, bool func(line_t *, polyobj_s *, void *),
                            int groupid = R_NOGROUP, void *context = nullptr);
 bool P_BlockThingsIterator(int x, int y, int groupid, bool (*func)(Mobj *, void *),
                            void *context = nullptr);
+bool P_BlockThingsInBox(int x, int y, const fixed_t *bbox, bool (*func)(Mobj *, void *),
+                        void *context = nullptr);
 inline static bool P_BlockThingsIterator(int x, int y, bool func(Mobj *, void *),
                                          void *context = nullptr)
 {
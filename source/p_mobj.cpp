@@ -56,12 +56,14 @@
 #include "p_map.h"
 #include "p_maputl.h"
 #include "p_map3d.h"
+#include "p_mobjpool.h"
 #include "p_partcl.h"
 #include "p_portal.h"
 #include "p_portalcross.h"
 #include "p_saveg.h"
 #include "p_sector.h"
 #include "p_skin.h"
+#include "p_thinkprof.h"
 #include "p_tick.h"
 #include "p_spec.h"    // haleyjd 04/05/99: TerrainTypes
 #include "p_user.h"
@@ -324,7 +326,14 @@ bool P_SetMobjState(Mobj* mobj, statenum_t state)
          actionargs.args       = st->args;
          actionargs.pspr       = NULL;
 
-         st->action(&actionargs);
+         if(p_thinkprof)
+         {
+            int64_t start = P_ProfileClock();
+            st->action(&actionargs);
+            P_ProfileAction(st->action, start);
+         }
+         else
+            st->action(&actionargs);
       }
 
       // haleyjd 05/20/02: run particle events
@@ -1337,6 +1346,24 @@ bool Mobj::shouldApplyTorque()
 // Mobj RTTI Proxy Type
 IMPLEMENT_THINKER_TYPE(Mobj)
 
+//
+// Mobj::operator new
+//
+// Takes a slot from the Mobj pool instead of making a zone block.
+//
+void *Mobj::operator new (size_t size)
+{
+   return P_MobjPoolAlloc(size);
+}
+
+//
+// Mobj::operator delete
+//
+void Mobj::operator delete (void *p)
+{
+   P_MobjPoolFree(p);
+}
+
 //
 // Routine to check mobj projection, from wherever the coordinates might change
 //
@@ -2917,6 +2944,7 @@ bool P_CheckMissileSpawn(Mobj* th)
    th->y = pos.y;
    th->z += th->momz >> 1;
    th->groupid = newgroupid;
+   P_RefreshBlockThing(th);
 
    // killough 8/12/98: for non-missile objects (e.g. grenades)
    if(!(th->flags & MF_MISSILE) && demo_version >= 203)
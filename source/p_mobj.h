@@ -109,7 +109,7 @@ struct subsector_t;
 // The sound code uses the x,y, and subsector fields
 // to do stereo positioning of any sound effited by the Mobj.
 //
-// The play simulation uses the blocklinks, x,y,z, radius, height
+// The play simulation uses the blockmap, x,y,z, radius, height
 // to determine when Mobjs are touching each other,
 // touching lines in the map, or hit by trace lines (gunshots,
 // lines of sight, etc).
@@ -224,6 +224,10 @@ public:
    virtual void serialize(SaveArchive &arc) override;
    virtual void deSwizzle() override;
 
+   // Mobjs live in their own slab pool, rather than on the zone heap
+   void *operator new (size_t size);
+   void  operator delete (void *p);
+
    // Methods
    void backupPosition();
    void copyPosition(const Mobj *other);
@@ -231,6 +235,33 @@ public:
    
    // Data members
 
+   // Fields read on every tic by movement and state code come first, so that
+   // they share the cache lines holding the position.
+
+   // Momentums, used to update position.
+   fixed_t momx;
+   fixed_t momy;
+   fixed_t momz;
+
+   // The closest interval over all contacted Sectors.
+   fixed_t floorz;
+   fixed_t ceilingz;
+
+   // killough 11/98: the lowest floor over all contacted Sectors.
+   fixed_t dropoffz;
+
+   // For movement checking.
+   fixed_t radius;
+   fixed_t height; 
+
+   int           tics;   // state tic counter
+   state_t      *state;
+   unsigned int  flags;
+   unsigned int  flags2;    // haleyjd 04/09/99: I know, kill me now
+   unsigned int  flags3;    // haleyjd 11/03/02
+   unsigned int  flags4;    // haleyjd 09/13/09
+   int           intflags;  // killough 9/15/98: internal flags
+
    // More list: links in sector (if needed)
    Mobj  *snext;
    Mobj **sprev; // killough 8/10/98: change to ptr-to-ptr
@@ -245,28 +276,12 @@ public:
    int         frame;  // might be ORed with FF_FULLBRIGHT
 
    // Interaction info, by BLOCKMAP.
-   // Links in blocks (if needed).
-   Mobj  *bnext;
-   Mobj **bprev; // killough 8/11/98: change to ptr-to-ptr
+   // Block the thing is linked into (if needed), plus one; 0 if none.
+   int blockcell;
+   int blockindex; // entry in the block's thing array
 
    subsector_t *subsector;
 
-   // The closest interval over all contacted Sectors.
-   fixed_t floorz;
-   fixed_t ceilingz;
-
-   // killough 11/98: the lowest floor over all contacted Sectors.
-   fixed_t dropoffz;
-
-   // For movement checking.
-   fixed_t radius;
-   fixed_t height; 
-
-   // Momentums, used to update position.
-   fixed_t momx;
-   fixed_t momy;
-   fixed_t momz;
-
    // If == validcount, already checked.
    int validcount;
 
@@ -282,14 +297,7 @@ public:
       int            bfgcount;
    } extradata;
 
-   int           tics;   // state tic counter
-   state_t      *state;
-   unsigned int  flags;
-   unsigned int  flags2;    // haleyjd 04/09/99: I know, kill me now
-   unsigned int  flags3;    // haleyjd 11/03/02
-   unsigned int  flags4;    // haleyjd 09/13/09
-   int           intflags;  // killough 9/15/98: internal flags
-   int           health;
+   int health;
 
    // Movement direction, movement generation (zig-zagging).
    int16_t movedir;        // 0-7
@@ -340,6 +348,12 @@ public:
    msecnode_t *touching_sectorlist;                 // phares 3/14/98
    msecnode_t *old_sectorlist;                      // haleyjd 04/16/10
 
+   // area around the thing found clear of lines when touching_sectorlist was
+   // last built, and the blocks searched; see P_CreateSecNodeList
+   fixed_t secnodebox[4];
+   int     secnodeblocks[4];
+   bool    secnodeclear;
+
    // SEE WARNING ABOVE ABOUT POINTER FIELDS!!!
 
    // New Fields for Eternity -- haleyjd
@@ -577,7 +591,7 @@ enum mobjflags_e : unsigned int
    MF_SOLID        = 0x00000002, // Blocks.    
    MF_SHOOTABLE    = 0x00000004, // Can be hit.    
    MF_NOSECTOR     = 0x00000008, // Don't use the sector links (invisible but touchable).
-   MF_NOBLOCKMAP   = 0x00000010, // Don't use the blocklinks (inert but displayable)
+   MF_NOBLOCKMAP   = 0x00000010, // Don't use the blockmap (inert but displayable)
    MF_AMBUSH       = 0x00000020, // Not to be activated by sound, deaf monster.    
    MF_JUSTHIT      = 0x00000040, // Will try to attack right back.
    MF_JUSTATTACKED = 0x00000080, // Will take at least one step before attacking.
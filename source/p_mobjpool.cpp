@@ -0,0 +1,235 @@
+//
+// The Eternity Engine
+// Copyright (C) 2018 James Haley et al.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see http://www.gnu.org/licenses/
+//
+// Additional terms and conditions compatible with the GPLv3 apply. See the
+// file COPYING-EE for details.
+//
+// Purpose: Slab pool for map objects.
+//
+//  Mobjs used to be separate zone blocks, each with its own header, spread
+//  over the heap in whatever order the allocator found room. They now live
+//  in fixed-size slots carved out of large PU_LEVEL slabs. Every slot is
+//  aligned to a cache line, and a new object always takes the lowest free
+//  slot of the lowest slab. Since objects can't be moved once spawned (raw
+//  pointers to them are kept everywhere), this is what keeps the live set
+//  packed: holes left by dead objects get refilled first, and slabs at the
+//  end of the list drain and are given back while a level winds down.
+//
+//  Pooled objects are not on the ZoneObject tag chains, so the pool destroys
+//  whatever is left of them itself before the level is freed.
+//
+
+#include "z_zone.h"
+#include "i_system.h"
+
+#include "c_io.h"
+#include "c_runcmd.h"
+#include "p_mobj.h"
+#include "p_mobjpool.h"
+
+// slots per slab, and the number of 64-bit words in its free mask
+#define MOBJ_SLABSLOTS 128
+#define MOBJ_SLABWORDS (MOBJ_SLABSLOTS / 64)
+
+// size of one slot, rounded up to whole cache lines
+static const size_t mobjslotsize =
+   (sizeof(Mobj) + MOBJ_SLOTALIGN - 1) & ~size_t(MOBJ_SLOTALIGN - 1);
+
+//
+// mobjslab_t
+//
+// Header kept at the start of each slab's zone block, ahead of its slots.
+//
+struct mobjslab_t
+{
+   byte    *slots;                    // first slot, cache line aligned
+   uint64_t freemask[MOBJ_SLABWORDS]; // set bits are free slots
+   int      numfree;                  // number of set bits
+};
+
+static mobjslab_t **mobjslabs;   // slabs in allocation order
+static int          nummobjslabs;
+static int          maxmobjslabs;
+static int          firstfreeslab; // no slab below this one has room
+static int          numemptyslabs; // slabs with every slot free
+
+//
+// P_newMobjSlab
+//
+// Adds an empty slab to the end of the list.
+//
+static mobjslab_t *P_newMobjSlab()
+{
+   byte       *block;
+   mobjslab_t *slab;
+   uintptr_t   slots;
+
+   block = static_cast<byte *>(Z_Malloc(sizeof(mobjslab_t) + MOBJ_SLOTALIGN - 1 +
+                                        MOBJ_SLABSLOTS * mobjslotsize, PU_LEVEL, NULL));
+   slab  = reinterpret_cast<mobjslab_t *>(block);
+   slots = reinterpret_cast<uintptr_t>(block + sizeof(mobjslab_t));
+   slots = (slots + MOBJ_SLOTALIGN - 1) & ~uintptr_t(MOBJ_SLOTALIGN - 1);
+
+   slab->slots   = reinterpret_cast<byte *>(slots);
+   slab->numfree = MOBJ_SLABSLOTS;
+   for(uint64_t &word : slab->freemask)
+      word = ~uint64_t(0);
+
+   if(nummobjslabs == maxmobjslabs)
+   {
+      maxmobjslabs = maxmobjslabs ? maxmobjslabs * 2 : 16;
+      mobjslabs = erealloc(mobjslab_t **, mobjslabs, maxmobjslabs * sizeof(*mobjslabs));
+   }
+   mobjslabs[nummobjslabs++] = slab;
+   ++numemptyslabs;
+
+   return slab;
+}
+
+//
+// P_MobjPoolAlloc
+//
+// Returns zeroed memory for a new Mobj from the lowest free slot.
+//
+void *P_MobjPoolAlloc(size_t size)
+{
+   mobjslab_t *slab = NULL;
+   byte       *slot;
+
+   if(size > mobjslotsize)
+      I_Error("P_MobjPoolAlloc: %u byte object does not fit a slot\n", unsigned(size));
+
+   while(firstfreeslab < nummobjslabs && !mobjslabs[firstfreeslab]->numfree)
+      ++firstfreeslab;
+   if(firstfreeslab < nummobjslabs)
+      slab = mobjslabs[firstfreeslab];
+   else
+      slab = P_newMobjSlab();
+
+   if(slab->numfree == MOBJ_SLABSLOTS)
+      --numemptyslabs;
+
+   for(int w = 0; w < MOBJ_SLABWORDS; w++)
+   {
+      uint64_t word = slab->freemask[w];
+      int      bit  = 0;
+
+      if(!word)
+         continue;
+      while(!(word & 0xff))
+         word >>= 8, bit += 8;
+      while(!(word & 1))
+         word >>= 1, ++bit;
+
+      slab->freemask[w] &= ~(uint64_t(1) << bit);
+      --slab->numfree;
+
+      // objects rely on being zero-filled, as Z_Calloc used to do for them
+      slot = slab->slots + (w * 64 + bit) * mobjslotsize;
+      memset(slot, 0, mobjslotsize);
+      return slot;
+   }
+
+   I_Error("P_MobjPoolAlloc: slab free count is corrupt\n");
+}
+
+//
+// P_MobjPoolFree
+//
+// Returns a slot to its slab. A slab that empties is given back to the zone
+// unless it is the only empty one left, so that one object spawning and
+// dying over and over at a slab boundary doesn't keep reallocating it.
+//
+void P_MobjPoolFree(void *p)
+{
+   byte *ptr = static_cast<byte *>(p);
+
+   if(!ptr)
+      return;
+
+   for(int i = 0; i < nummobjslabs; i++)
+   {
+      mobjslab_t *slab = mobjslabs[i];
+      int         index;
+
+      if(ptr < slab->slots || ptr >= slab->slots + MOBJ_SLABSLOTS * mobjslotsize)
+         continue;
+
+      index = int((ptr - slab->slots) / mobjslotsize);
+      slab->freemask[index / 64] |= uint64_t(1) << (index % 64);
+      if(i < firstfreeslab)
+         firstfreeslab = i;
+
+      if(++slab->numfree == MOBJ_SLABSLOTS && ++numemptyslabs > 1)
+      {
+         memmove(mobjslabs + i, mobjslabs + i + 1,
+                 (nummobjslabs - i - 1) * sizeof(*mobjslabs));
+         --nummobjslabs;
+         --numemptyslabs;
+         Z_Free(slab);
+      }
+      return;
+   }
+
+   I_Error("P_MobjPoolFree: %p is not a pooled object\n", p);
+}
+
+//
+// P_MobjPoolFreeLevel
+//
+// Destroys every Mobj still alive and frees all slabs. Must be called just
+// before Z_FreeTags frees the rest of the level's objects.
+//
+void P_MobjPoolFreeLevel()
+{
+   for(int i = 0; i < nummobjslabs; i++)
+   {
+      mobjslab_t *slab = mobjslabs[i];
+
+      for(int s = 0; s < MOBJ_SLABSLOTS; s++)
+      {
+         if(!(slab->freemask[s / 64] & (uint64_t(1) << (s % 64))))
+            reinterpret_cast<Mobj *>(slab->slots + s * mobjslotsize)->~Mobj();
+      }
+      Z_Free(slab);
+   }
+
+   nummobjslabs  = 0;
+   firstfreeslab = 0;
+   numemptyslabs = 0;
+}
+
+//
+// p_mobjpool
+//
+// Reports how full the Mobj pool is.
+//
+CONSOLE_COMMAND(p_mobjpool, 0)
+{
+   int numfree = 0;
+
+   for(int i = 0; i < nummobjslabs; i++)
+      numfree += mobjslabs[i]->numfree;
+
+   int capacity = nummobjslabs * MOBJ_SLABSLOTS;
+
+   C_Printf("Mobj pool: %d slabs, %d of %d slots used (%u bytes each)\n",
+            nummobjslabs, capacity - numfree, capacity, unsigned(mobjslotsize));
+}
+
+// EOF
+
@@ -0,0 +1,848 @@
+//
+// The Eternity Engine
+// Copyright (C) 2018 James Haley et al.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see http://www.gnu.org/licenses/
+//
+// Additional terms and conditions compatible with the GPLv3 apply. See the
+// file COPYING-EE for details.
+//
+// Purpose: Node builder for levels without usable nodes.
+//
+//  Builds a BSP tree for the loaded level in the same way as the classic
+//  node builders (and R_BuildDynaBSP): every line gives a seg for each of
+//  its sides, and the seg set is split recursively by the partition line
+//  that splits the fewest segs and best balances the two sides, until the
+//  remaining segs form a convex subsector. Trying a partition against a
+//  large seg set is the expensive part, so the candidates for a node are
+//  spread over the worker threads.
+//
+//  The result is written as ZDoom extended (XNOD) nodes, except that the
+//  partition lines are kept in fixed point as in XGL3 nodes, so that lines
+//  between fractional vertexes, as UDMF levels often have, can divide the
+//  level too. It is cached on disk under a hash of the level's geometry.
+//
+
+#include "z_zone.h"
+
+#include "c_io.h"
+#include "doomdata.h"
+#include "doomstat.h"
+#include "hal/i_directory.h"
+#include "m_argv.h"
+#include "m_bbox.h"
+#include "m_binary.h"
+#include "m_buffer.h"
+#include "m_collection.h"
+#include "m_compare.h"
+#include "m_fixed.h"
+#include "m_hash.h"
+#include "m_parallel.h"
+#include "m_qstr.h"
+#include "m_utils.h"
+#include "p_nodebuild.h"
+#include "r_defs.h"
+#include "r_state.h"
+#include "v_misc.h"
+
+// bump when the builder changes, to invalidate cached nodes
+#define NODEBUILD_VERSION 2
+
+// distance in map units within which a point counts as on a partition line
+#define BSP_EPSILON (1.0 / 1024.0)
+
+// pieces shorter than this aren't split off a seg; the whole seg goes to
+// the side its other end is on
+#define BSP_MINSPLIT (1.0 / 16.0)
+
+// split weighting factor, as for dynaseg BSPs
+#define BSP_FACTOR 17
+
+// most partitions tried for a node before falling back to trying them all
+#define BSP_MAXCANDIDATES 256
+
+// below this many seg checks for a node, candidates aren't spread over the
+// worker threads
+#define BSP_PARALLELWORK 65536
+
+// candidate ranges handed out per worker, to even out pruning luck
+#define BSP_CHUNKSPERWORKER 4
+#define BSP_MAXCHUNKS (M_MAXWORKERS * BSP_CHUNKSPERWORKER)
+
+// fractional partition directions are scaled up to about this length in
+// fixed point, as R_PointOnSide only uses the whole units of them
+#define BSP_FRACPARTLEN (1 << 29)
+
+// failsafe against degenerate geometry; a level needing a deeper tree
+// fails to build rather than getting a non-convex subsector
+#define BSP_MAXDEPTH 1024
+
+enum
+{
+   BSP_RIGHT,
+   BSP_LEFT,
+   BSP_SPLIT
+};
+
+//
+// bspvertex_t
+//
+struct bspvertex_t
+{
+   fixed_t x, y;
+};
+
+//
+// bspseg_t
+//
+struct bspseg_t
+{
+   int    v1, v2;  // indices into bspbuild_t::vertexes
+   int    linenum;
+   int    side;    // 0 if it runs along its line, 1 if against it
+   double x1, y1;  // v1 and v2 in map units
+   double x2, y2;
+   double len;
+};
+
+//
+// bsppart_t
+//
+// A partition line, taken from the line of a seg and pointing the same way
+// as the seg, so that the seg's front is on the right.
+//
+struct bsppart_t
+{
+   fixed_t x, y, dx, dy;     // as written to the node
+   double  fx, fy, fdx, fdy; // in map units
+   double  len;
+};
+
+//
+// bspnode_t
+//
+// A node as written out, with a fixed-point partition line.
+//
+struct bspnode_t
+{
+   fixed_t  x, y, dx, dy;
+   int16_t  bbox[2][4];
+   uint32_t children[2];
+};
+
+//
+// bspbuild_t
+//
+struct bspbuild_t
+{
+   PODCollection<bspvertex_t> vertexes; // the level's, then those from splits
+   PODCollection<bspseg_t>    segs;
+   PODCollection<int>         ssegs;    // seg numbers in subsector order
+   PODCollection<uint32_t>    sscounts; // seg count of each subsector
+   PODCollection<bspnode_t>   nodes;
+   int                       *linestamp; // node a line was last a candidate for
+   int                        stamp;
+   bool                       nonconvex; // a subsector was left non-convex
+};
+
+//
+// bspchoice_t
+//
+// Partition candidates for one node, shared with the workers.
+//
+struct bspchoice_t
+{
+   const bspbuild_t *bsp;
+   const int        *set;       // segs to divide
+   int               count;
+   const bsppart_t  *parts;     // candidates
+   int               numparts;
+   int               numchunks;
+   int               bestcost[BSP_MAXCHUNKS];
+   int               bestpart[BSP_MAXCHUNKS];
+};
+
+//=============================================================================
+//
+// Partitions
+//
+
+//
+// P_bspMakePartition
+//
+// Works out the partition line along a seg. Fails if its length doesn't fit
+// in a fixed-point node. Only the direction of dx and dy matters, so
+// fractional ones are scaled up to keep it when the fraction is dropped.
+//
+static bool P_bspMakePartition(const bspseg_t &seg, bsppart_t &part)
+{
+   const line_t &line = lines[seg.linenum];
+   fixed_t x1 = line.v1->x, y1 = line.v1->y, x2 = line.v2->x, y2 = line.v2->y;
+
+   if(seg.side)
+   {
+      fixed_t tx = x1, ty = y1;
+      x1 = x2, y1 = y2;
+      x2 = tx, y2 = ty;
+   }
+
+   int64_t dx = int64_t(x2) - x1, dy = int64_t(y2) - y1;
+
+   if((dx | dy) & (FRACUNIT - 1))
+   {
+      int64_t scale = BSP_FRACPARTLEN / emax(dx < 0 ? -dx : dx, dy < 0 ? -dy : dy);
+
+      if(scale > 1)
+      {
+         dx *= scale;
+         dy *= scale;
+      }
+   }
+
+   if(dx < INT32_MIN || dx > INT32_MAX || dy < INT32_MIN || dy > INT32_MAX || (!dx && !dy))
+      return false;
+
+   part.x   = x1;
+   part.y   = y1;
+   part.dx  = fixed_t(dx);
+   part.dy  = fixed_t(dy);
+   part.fx  = M_FixedToDouble(part.x);
+   part.fy  = M_FixedToDouble(part.y);
+   part.fdx = M_FixedToDouble(part.dx);
+   part.fdy = M_FixedToDouble(part.dy);
+   part.len = sqrt(part.fdx * part.fdx + part.fdy * part.fdy);
+   return true;
+}
+
+//
+// P_bspPointSide
+//
+// Distance of a point from a partition line; positive on the right.
+//
+static inline double P_bspPointSide(const bsppart_t &part, double x, double y)
+{
+   return (part.fdy * (x - part.fx) - part.fdx * (y - part.fy)) / part.len;
+}
+
+//
+// P_bspClassify
+//
+// Works out which side of a partition line a seg is on, or if it must be
+// split. Segs on the line go to the side they face. a and b are set to the
+// distances of the seg's ends.
+//
+static int P_bspClassify(const bsppart_t &part, const bspseg_t &seg, double &a, double &b)
+{
+   a = P_bspPointSide(part, seg.x1, seg.y1);
+   b = P_bspPointSide(part, seg.x2, seg.y2);
+
+   if(a < BSP_EPSILON && a > -BSP_EPSILON)
+      a = 0.0;
+   if(b < BSP_EPSILON && b > -BSP_EPSILON)
+      b = 0.0;
+
+   if(a == 0.0 && b == 0.0)
+   {
+      double dot = (seg.x2 - seg.x1) * part.fdx + (seg.y2 - seg.y1) * part.fdy;
+      return dot >= 0.0 ? BSP_RIGHT : BSP_LEFT;
+   }
+   if(a >= 0.0 && b >= 0.0)
+      return BSP_RIGHT;
+   if(a <= 0.0 && b <= 0.0)
+      return BSP_LEFT;
+
+   // ends on opposite sides; don't split off slivers
+   double t = a / (a - b);
+
+   if(t * seg.len < BSP_MINSPLIT)
+      return b > 0.0 ? BSP_RIGHT : BSP_LEFT;
+   if((1.0 - t) * seg.len < BSP_MINSPLIT)
+      return a > 0.0 ? BSP_RIGHT : BSP_LEFT;
+
+   return BSP_SPLIT;
+}
+
+//
+// P_bspPartitionCost
+//
+// Scores a partition for a set of segs; lower is better. Returns INT_MAX if
+// it leaves the left side empty, or once the cost goes over bestcost.
+//
+// Credit to Raphael Quinet and DEU, and to Lee Killough for the pruning,
+// as for dynaseg BSPs.
+//
+static int P_bspPartitionCost(const bspbuild_t &bsp, const bsppart_t &part,
+                              const int *set, int count, int bestcost)
+{
+   int cost = 0, rights = 0, lefts = 0, splits = 0;
+   double a, b;
+
+   // add one seg worth of cost to non-orthogonal lines
+   if(part.dx && part.dy)
+      cost += BSP_FACTOR;
+
+   for(int i = 0; i < count; i++)
+   {
+      switch(P_bspClassify(part, bsp.segs[set[i]], a, b))
+      {
+      case BSP_RIGHT:
+         ++rights;
+         break;
+      case BSP_LEFT:
+         ++lefts;
+         break;
+      default:
+         ++splits;
+         if((cost += BSP_FACTOR) > bestcost)
+            return INT_MAX;
+         break;
+      }
+   }
+
+   // the seg the partition came from is always on the right
+   if(!lefts && !splits)
+      return INT_MAX;
+
+   cost += rights > lefts ? rights - lefts : lefts - rights;
+   return cost;
+}
+
+//
+// P_bspTryChunk
+//
+// M_ParallelFor callback; finds the best candidate in one range of them.
+//
+static void P_bspTryChunk(int chunk, int worker, void *data)
+{
+   bspchoice_t &choice = *static_cast<bspchoice_t *>(data);
+   int first = int(int64_t(choice.numparts) * chunk / choice.numchunks);
+   int last  = int(int64_t(choice.numparts) * (chunk + 1) / choice.numchunks);
+   int bestcost = INT_MAX, bestpart = -1;
+
+   for(int i = first; i < last; i++)
+   {
+      int cost = P_bspPartitionCost(*choice.bsp, choice.parts[i], choice.set, choice.count,
+                                    bestcost);
+      if(cost < bestcost)
+      {
+         bestcost = cost;
+         bestpart = i;
+      }
+   }
+
+   choice.bestcost[chunk] = bestcost;
+   choice.bestpart[chunk] = bestpart;
+}
+
+//
+// P_bspBestPartition
+//
+// Returns the candidate with the lowest cost, the first one if several tie,
+// or -1 if none of them divides the set. The outcome doesn't depend on how
+// the work was spread.
+//
+static int P_bspBestPartition(bspchoice_t &choice)
+{
+   int bestcost = INT_MAX, bestpart = -1;
+
+   if(int64_t(choice.numparts) * choice.count < BSP_PARALLELWORK)
+      choice.numchunks = 1;
+   else
+   {
+      choice.numchunks = M_WorkerCount() * BSP_CHUNKSPERWORKER;
+      if(choice.numchunks > choice.numparts)
+         choice.numchunks = choice.numparts;
+   }
+
+   if(choice.numchunks == 1)
+      P_bspTryChunk(0, 0, &choice);
+   else
+      M_ParallelFor(choice.numchunks, P_bspTryChunk, &choice);
+
+   for(int i = 0; i < choice.numchunks; i++)
+   {
+      if(choice.bestcost[i] < bestcost)
+      {
+         bestcost = choice.bestcost[i];
+         bestpart = choice.bestpart[i];
+      }
+   }
+
+   return bestpart;
+}
+
+//
+// P_bspChoosePartition
+//
+// Picks the partition for a node. Returns false if no line divides the
+// set, which means it is convex, unless some line couldn't be made into a
+// partition; that leaves bsp.nonconvex set.
+//
+static bool P_bspChoosePartition(bspbuild_t &bsp, const PODCollection<int> &set,
+                                 bsppart_t &best)
+{
+   bspchoice_t choice;
+   bsppart_t  *parts = estructalloc(bsppart_t, set.getLength());
+   int         numparts = 0, numfailed = 0, result;
+
+   // one candidate per line, since all of its segs give the same partition
+   ++bsp.stamp;
+   for(int segnum : set)
+   {
+      const bspseg_t &seg = bsp.segs[segnum];
+
+      if(bsp.linestamp[seg.linenum] == bsp.stamp)
+         continue;
+      bsp.linestamp[seg.linenum] = bsp.stamp;
+
+      if(P_bspMakePartition(seg, parts[numparts]))
+         ++numparts;
+      else
+         ++numfailed;
+   }
+
+   choice.bsp   = &bsp;
+   choice.set   = set.begin();
+   choice.count = int(set.getLength());
+
+   // try a spread of the candidates first
+   if(numparts > BSP_MAXCANDIDATES)
+   {
+      bsppart_t sample[BSP_MAXCANDIDATES];
+
+      for(int i = 0; i < BSP_MAXCANDIDATES; i++)
+         sample[i] = parts[int64_t(i) * numparts / BSP_MAXCANDIDATES];
+
+      choice.parts    = sample;
+      choice.numparts = BSP_MAXCANDIDATES;
+      if((result = P_bspBestPartition(choice)) >= 0)
+      {
+         best = sample[result];
+         efree(parts);
+         return true;
+      }
+   }
+
+   choice.parts    = parts;
+   choice.numparts = numparts;
+   if(numparts && (result = P_bspBestPartition(choice)) >= 0)
+      best = parts[result];
+   else
+      result = -1;
+
+   if(result < 0 && numfailed)
+      bsp.nonconvex = true;
+
+   efree(parts);
+   return result >= 0;
+}
+
+//=============================================================================
+//
+// Tree Building
+//
+
+//
+// P_bspSetSeg
+//
+// Fills in the coordinates of a seg from its vertexes.
+//
+static void P_bspSetSeg(bspbuild_t &bsp, bspseg_t &seg)
+{
+   const bspvertex_t &v1 = bsp.vertexes[seg.v1];
+   const bspvertex_t &v2 = bsp.vertexes[seg.v2];
+
+   seg.x1  = M_FixedToDouble(v1.x);
+   seg.y1  = M_FixedToDouble(v1.y);
+   seg.x2  = M_FixedToDouble(v2.x);
+   seg.y2  = M_FixedToDouble(v2.y);
+   seg.len = sqrt((seg.x2 - seg.x1) * (seg.x2 - seg.x1) +
+                  (seg.y2 - seg.y1) * (seg.y2 - seg.y1));
+}
+
+//
+// P_bspDivide
+//
+// Sorts a set of segs to the two sides of a partition line, splitting the
+// ones that cross it.
+//
+static void P_bspDivide(bspbuild_t &bsp, const bsppart_t &part, const PODCollection<int> &set,
+                        PODCollection<int> &rights, PODCollection<int> &lefts)
+{
+   double a, b;
+
+   for(int segnum : set)
+   {
+      int side = P_bspClassify(part, bsp.segs[segnum], a, b);
+
+      if(side == BSP_RIGHT)
+         rights.add(segnum);
+      else if(side == BSP_LEFT)
+         lefts.add(segnum);
+      else
+      {
+         bspseg_t    &seg = bsp.segs[segnum];
+         double       t   = a / (a - b);
+         bspvertex_t &nv  = bsp.vertexes.addNew();
+         int          newseg = int(bsp.segs.getLength());
+
+         nv.x = M_DoubleToFixed(seg.x1 + t * (seg.x2 - seg.x1));
+         nv.y = M_DoubleToFixed(seg.y1 + t * (seg.y2 - seg.y1));
+
+         // the new seg runs from the split to the old end
+         bspseg_t split = seg;
+         split.v1 = int(bsp.vertexes.getLength() - 1);
+         seg.v2   = split.v1;
+         P_bspSetSeg(bsp, seg);
+         P_bspSetSeg(bsp, split);
+         bsp.segs.add(split);
+
+         if(a > 0.0)
+         {
+            rights.add(segnum);
+            lefts.add(newseg);
+         }
+         else
+         {
+            lefts.add(segnum);
+            rights.add(newseg);
+         }
+      }
+   }
+}
+
+//
+// P_bspBounds
+//
+// Bounding box of a set of segs, rounded out to whole map units. Nodes
+// can't hold any more than 16 bits of them.
+//
+static void P_bspBounds(const bspbuild_t &bsp, const PODCollection<int> &set,
+                        int16_t bbox[4])
+{
+   double box[4] = { -32768.0, 32767.0, 32767.0, -32768.0 };
+
+   for(int segnum : set)
+   {
+      const bspseg_t &seg = bsp.segs[segnum];
+
+      box[BOXTOP]    = emax(box[BOXTOP],    emax(seg.y1, seg.y2));
+      box[BOXBOTTOM] = emin(box[BOXBOTTOM], emin(seg.y1, seg.y2));
+      box[BOXLEFT]   = emin(box[BOXLEFT],   emin(seg.x1, seg.x2));
+      box[BOXRIGHT]  = emax(box[BOXRIGHT],  emax(seg.x1, seg.x2));
+   }
+
+   bbox[BOXTOP]    = int16_t(emin(ceil(box[BOXTOP]),     32767.0));
+   bbox[BOXBOTTOM] = int16_t(emax(floor(box[BOXBOTTOM]), -32768.0));
+   bbox[BOXLEFT]   = int16_t(emax(floor(box[BOXLEFT]),   -32768.0));
+   bbox[BOXRIGHT]  = int16_t(emin(ceil(box[BOXRIGHT]),    32767.0));
+}
+
+//
+// P_bspBuild
+//
+// Primary recursive node building routine. Returns the node or subsector
+// made for the set, which is emptied, and sets its bounding box. Sets
+// bsp.nonconvex if a subsector had to be made from a set that isn't convex.
+//
+static uint32_t P_bspBuild(bspbuild_t &bsp, PODCollection<int> &set, int depth,
+                           int16_t bbox[4])
+{
+   bsppart_t part;
+   bool      divide;
+
+   P_bspBounds(bsp, set, bbox);
+
+   // once one subsector is broken, the rest of the tree isn't worth building
+   divide = !bsp.nonconvex && P_bspChoosePartition(bsp, set, part);
+   if(divide && depth >= BSP_MAXDEPTH)
+   {
+      bsp.nonconvex = true;
+      divide = false;
+   }
+
+   if(!divide)
+   {
+      // convex: make a subsector
+      for(int segnum : set)
+         bsp.ssegs.add(segnum);
+      bsp.sscounts.add(uint32_t(set.getLength()));
+      set.clear();
+
+      return uint32_t(bsp.sscounts.getLength() - 1) | NF_SUBSECTOR;
+   }
+
+   PODCollection<int> rights, lefts;
+   bspnode_t node;
+
+   P_bspDivide(bsp, part, set, rights, lefts);
+   set.clear();
+
+   node.x  = part.x;
+   node.y  = part.y;
+   node.dx = part.dx;
+   node.dy = part.dy;
+   node.children[0] = P_bspBuild(bsp, rights, depth + 1, node.bbox[0]);
+   node.children[1] = P_bspBuild(bsp, lefts,  depth + 1, node.bbox[1]);
+
+   // children come before their parents, so the root is the last node
+   bsp.nodes.add(node);
+   return uint32_t(bsp.nodes.getLength() - 1);
+}
+
+//
+// P_bspInitSegs
+//
+// Makes a seg for each side of every line, and returns the whole set.
+//
+static void P_bspInitSegs(bspbuild_t &bsp, PODCollection<int> &set)
+{
+   for(int i = 0; i < numvertexes; i++)
+   {
+      bspvertex_t &v = bsp.vertexes.addNew();
+      v.x = vertexes[i].x;
+      v.y = vertexes[i].y;
+   }
+
+   for(int i = 0; i < numlines; i++)
+   {
+      const line_t &line = lines[i];
+
+      if(line.v1->x == line.v2->x && line.v1->y == line.v2->y)
+         continue;
+
+      for(int side = 0; side < 2; side++)
+      {
+         if(line.sidenum[side] == -1)
+            continue;
+
+         bspseg_t &seg = bsp.segs.addNew();
+         seg.linenum = i;
+         seg.side    = side;
+         seg.v1      = eindex((side ? line.v2 : line.v1) - vertexes);
+         seg.v2      = eindex((side ? line.v1 : line.v2) - vertexes);
+         P_bspSetSeg(bsp, seg);
+
+         set.add(int(bsp.segs.getLength() - 1));
+      }
+   }
+}
+
+//
+// P_bspWriteNodes
+//
+// Writes the tree out as XNOD nodes with XGL3 partition lines.
+//
+static byte *P_bspWriteNodes(const bspbuild_t &bsp, size_t &length)
+{
+   OutBuffer out;
+
+   out.createMemory(65536, BufferedFileBase::LENDIAN);
+
+   out.write("XNOD", 4);
+
+   out.writeUint32(uint32_t(numvertexes));
+   out.writeUint32(uint32_t(bsp.vertexes.getLength() - numvertexes));
+   for(size_t i = numvertexes; i < bsp.vertexes.getLength(); i++)
+   {
+      out.writeSint32(bsp.vertexes[i].x);
+      out.writeSint32(bsp.vertexes[i].y);
+   }
+
+   out.writeUint32(uint32_t(bsp.sscounts.getLength()));
+   for(uint32_t count : bsp.sscounts)
+      out.writeUint32(count);
+
+   out.writeUint32(uint32_t(bsp.ssegs.getLength()));
+   for(int segnum : bsp.ssegs)
+   {
+      const bspseg_t &seg = bsp.segs[segnum];
+
+      out.writeUint32(uint32_t(seg.v1));
+      out.writeUint32(uint32_t(seg.v2));
+      out.writeUint16(uint16_t(seg.linenum));
+      out.writeUint8(uint8_t(seg.side));
+   }
+
+   out.writeUint32(uint32_t(bsp.nodes.getLength()));
+   for(const bspnode_t &node : bsp.nodes)
+   {
+      out.writeSint32(node.x);
+      out.writeSint32(node.y);
+      out.writeSint32(node.dx);
+      out.writeSint32(node.dy);
+      for(int i = 0; i < 2; i++)
+      {
+         for(int j = 0; j < 4; j++)
+            out.writeSint16(node.bbox[i][j]);
+      }
+      out.writeUint32(node.children[0]);
+      out.writeUint32(node.children[1]);
+   }
+
+   return out.releaseMemory(length);
+}
+
+//=============================================================================
+//
+// Cache
+//
+
+//
+// P_bspCachePath
+//
+// Works out the file nodes for the current level are cached in, keyed by a
+// hash of the geometry they are built from.
+//
+static void P_bspCachePath(qstring &path)
+{
+   HashData hash(HashData::SHA1);
+   int32_t header[3] = { NODEBUILD_VERSION, numvertexes, numlines };
+
+   hash.addData(reinterpret_cast<const uint8_t *>(header), sizeof(header));
+
+   for(int i = 0; i < numvertexes; i++)
+   {
+      int32_t data[2] = { vertexes[i].x, vertexes[i].y };
+      hash.addData(reinterpret_cast<const uint8_t *>(data), sizeof(data));
+   }
+
+   for(int i = 0; i < numlines; i++)
+   {
+      const line_t &line = lines[i];
+      int32_t data[4] =
+      {
+         eindex(line.v1 - vertexes), eindex(line.v2 - vertexes),
+         line.sidenum[0] != -1, line.sidenum[1] != -1
+      };
+
+      hash.addData(reinterpret_cast<const uint8_t *>(data), sizeof(data));
+   }
+   hash.wrapUp();
+
+   char *digest = hash.digestToString();
+
+   path = usergamepath;
+   path.pathConcatenate("cache");
+   I_CreateDirectory(path);
+   path.pathConcatenate(digest);
+   path += ".xnod";
+
+   efree(digest);
+}
+
+//
+// P_bspLoadCached
+//
+// Reads cached nodes if they were built for this many vertexes.
+//
+static byte *P_bspLoadCached(const char *path, size_t &length)
+{
+   byte *buffer = NULL;
+   int   size   = M_ReadFile(path, &buffer);
+
+   if(size >= 8 && !memcmp(buffer, "XNOD", 4))
+   {
+      byte *data = buffer + 4;
+
+      if(GetBinaryUDWord(&data) == uint32_t(numvertexes))
+      {
+         length = size_t(size);
+         return buffer;
+      }
+   }
+
+   if(buffer)
+      efree(buffer);
+   return NULL;
+}
+
+//=============================================================================
+//
+// Interface
+//
+
+//
+// P_ForceNodeBuild
+//
+// True if nodes should be built for every level, even those that have
+// them; -buildnodes.
+//
+bool P_ForceNodeBuild()
+{
+   return M_CheckParm("-buildnodes") != 0;
+}
+
+//
+// P_BuildNodes
+//
+// Builds nodes for the loaded vertexes, lines and sides, or takes them from
+// the cache. Returns them as an XNOD lump with XGL3 partition lines, to be
+// freed with efree, or NULL if no usable nodes could be built.
+//
+byte *P_BuildNodes(size_t &length)
+{
+   qstring path;
+   byte   *data;
+
+   // XNOD segs only have 16 bits for the line number
+   if(numlines > 0xffff)
+   {
+      C_Printf(FC_ERROR "P_BuildNodes: too many lines to build nodes\n");
+      return NULL;
+   }
+
+   P_bspCachePath(path);
+   if((data = P_bspLoadCached(path.constPtr(), length)))
+      return data;
+
+   C_Printf("P_BuildNodes: building nodes for level\n");
+
+   bspbuild_t         bsp;
+   PODCollection<int> set;
+   int16_t            bbox[4];
+
+   bsp.linestamp = ecalloc(int *, numlines, sizeof(int));
+   bsp.stamp     = 0;
+   bsp.nonconvex = false;
+
+   P_bspInitSegs(bsp, set);
+   if(set.isEmpty())
+   {
+      efree(bsp.linestamp);
+      C_Printf(FC_ERROR "P_BuildNodes: no lines to build nodes from\n");
+      return NULL;
+   }
+
+   P_bspBuild(bsp, set, 0, bbox);
+   efree(bsp.linestamp);
+
+   // a non-convex subsector would break rendering and point lookups
+   if(bsp.nonconvex)
+   {
+      C_Printf(FC_ERROR "P_BuildNodes: could not divide the level into convex "
+               "subsectors\n");
+      return NULL;
+   }
+
+   data = P_bspWriteNodes(bsp, length);
+
+   if(!M_WriteFile(path.constPtr(), data, length))
+      C_Printf(FC_ERROR "P_BuildNodes: could not write %s\n", path.constPtr());
+
+   return data;
+}
+
+// EOF
+
@@ -347,157 +347,173 @@ void P_InitParticleEffects(void)
 }
 
 //
-// P_UnsetParticlePosition
+// P_locateParticle
 //
-// haleyjd 02/20/04: maintenance of particle sector links,
-// necessitated by portals.
+// Finds the subsector a moved particle is in, and handles what it runs into
+// there: the void, the floor, and floor or ceiling portals.
 //
-static void P_UnsetParticlePosition(particle_t *ptcl)
+static void P_locateParticle(particlestore_t &ps, int i)
 {
-   ptcl->seclinks.remove();
-   ptcl->subsector = NULL;
-}
+   const sector_t *psec;
+   fixed_t floorheight;
+   subsector_t *ss = R_PointInSubsector(ps.x[i], ps.y[i]);
 
-//
-// P_SetParticlePosition
-//
-// haleyjd 02/20/04: maintenance of particle sector links,
-// necessitated by portals. Maintaining a subsector_t
-// field in the particle_t will be useful in the future,
-// I am sure.
-//
-static void P_SetParticlePosition(particle_t *ptcl)
-{
-   subsector_t *ss = R_PointInSubsector(ptcl->x, ptcl->y);
+   ps.subsector[i] = ss;
+   if(P_IsInVoid(ps.x[i], ps.y[i], *ss))
+   {
+      ps.ttl[i] = 1;
+      ps.trans[i] = 0;
+   }
 
-   ptcl->seclinks.insert(ptcl, &(ss->sector->ptcllist));
-   ptcl->subsector = ss;
-}
+   psec = ss->sector;
 
-void P_ParticleThinker(void)
-{
-   int i;
-   particle_t *particle, *prev;
-   const sector_t *psec;
-   fixed_t floorheight;
-   
-   i = activeParticles;
-   prev = NULL;
-   while(i != -1) 
+   // haleyjd 09/04/05: use deep water floor if it is higher
+   // than the real floor.
+   floorheight = 
+      (psec->heightsec != -1 && 
+       sectors[psec->heightsec].floorheight > psec->floorheight) ?
+       sectors[psec->heightsec].floorheight :
+       psec->floorheight; 
+
+   // did particle hit ground, but is now no longer on it?
+   if(ps.styleflags[i] & PS_HITGROUND && ps.z[i] != floorheight)
+      ps.z[i] = floorheight;
+
+   // floor clipping
+   if(ps.z[i] < floorheight && psec->f_pflags & PS_PASSABLE)
    {
-      particle = Particles + i;
-      i = particle->next;
+      const linkdata_t *ldata = R_FPLink(psec);
 
-      // haleyjd: unlink the particle from the world
-      P_UnsetParticlePosition(particle);
+      ps.x[i] += ldata->deltax;
+      ps.y[i] += ldata->deltay;
+      ps.z[i] += ldata->deltaz;
+      ps.subsector[i] = R_PointInSubsector(ps.x[i], ps.y[i]);
+   }
+   else if(ps.z[i] < floorheight)
+   {
+      // particles with fall to ground style start ticking now
+      if(ps.styleflags[i] & PS_FALLTOGROUND)
+         ps.styleflags[i] &= ~PS_FALLTOGROUND;
 
-      // haleyjd: particles with fall to ground style don't start
-      // fading or counting down their TTL until they hit the floor
-      if(!(particle->styleflags & PS_FALLTOGROUND))
+      // particles with floor clipping may need to stop
+      if(ps.styleflags[i] & PS_FLOORCLIP)
       {
-         // perform fading
-         unsigned oldtrans = particle->trans;
-         particle->trans -= particle->fade;
+         ps.z[i] = floorheight;
+         ps.accz[i] = ps.velz[i] = 0;
+         ps.styleflags[i] |= PS_HITGROUND;
          
-         // is it time to kill this particle?
-         if(oldtrans < particle->trans || --particle->ttl == 0)
-         {
-            memset(particle, 0, sizeof(particle_t));
-            if(prev)
-               prev->next = i;
-            else
-               activeParticles = i;
-            particle->next = inactiveParticles;
-            inactiveParticles = eindex(particle - Particles);
-            continue;
-         }
+         // some particles make splashes
+         if(ps.styleflags[i] & PS_SPLASH)
+            E_PtclTerrainHit(psec, ps.x[i], ps.y[i], ps.z[i]);
       }
+   }
+   else if(ps.z[i] > psec->ceilingheight && psec->c_pflags & PS_PASSABLE)
+   {
+      const linkdata_t *ldata = R_CPLink(psec);
 
-      // Check for wall portals
-      if(gMapHasLinePortals && particle->velx | particle->vely)
-      {
-         v2fixed_t destination = P_LinePortalCrossing(particle->x, particle->y, 
-            particle->velx, particle->vely);
-         particle->x = destination.x;
-         particle->y = destination.y;
-      }
-      else
-      {
-         // update and link to new position
-         particle->x += particle->velx;
-         particle->y += particle->vely;
-      }
-      particle->z += particle->velz;
-      P_SetParticlePosition(particle);
-      if(P_IsInVoid(particle->x, particle->y, *particle->subsector))
-      {
-         particle->ttl = 1;
-         particle->trans = 0;
-      }
+      ps.x[i] += ldata->deltax;
+      ps.y[i] += ldata->deltay;
+      ps.z[i] += ldata->deltaz;
+      ps.subsector[i] = R_PointInSubsector(ps.x[i], ps.y[i]);
+   }
+}
+
+//
+// P_ParticleThinker
+//
+// Runs all live particles. Each field is updated in its own loop with no
+// branches where possible, so that the compiler can vectorize them; only
+// the final pass that locates particles in the map is done one at a time.
+//
+void P_ParticleThinker(void)
+{
+   particlestore_t &ps = Particles;
+   static byte *dead;
+   static int   numdead;
+   int i, count;
 
-      // apply accelerations
-      particle->velx += particle->accx;
-      particle->vely += particle->accy;
-      particle->velz += particle->accz;
+   // pick up particles spawned since the last tic
+   R_CommitParticles();
 
-      // handle special movement flags (post-position-set)
+   if(!ps.count)
+      return;
 
-      psec = particle->subsector->sector;
+   if(numdead < ps.capacity)
+   {
+      numdead = ps.capacity;
+      dead = erealloc(byte *, dead, numdead);
+   }
 
-      // haleyjd 09/04/05: use deep water floor if it is higher
-      // than the real floor.
-      floorheight = 
-         (psec->heightsec != -1 && 
-          sectors[psec->heightsec].floorheight > psec->floorheight) ?
-          sectors[psec->heightsec].floorheight :
-          psec->floorheight; 
+   count = ps.count;
 
-      // did particle hit ground, but is now no longer on it?
-      if(particle->styleflags & PS_HITGROUND && particle->z != floorheight)
-         particle->z = floorheight;
+   // haleyjd: particles with fall to ground style don't start
+   // fading or counting down their TTL until they hit the floor
+   for(i = 0; i < count; i++)
+   {
+      unsigned int ticking  = !(ps.styleflags[i] & PS_FALLTOGROUND);
+      unsigned int oldtrans = ps.trans[i];
+      unsigned int newtrans = oldtrans - (ps.fade[i] & (0u - ticking));
 
-      // floor clipping
-      if(particle->z < floorheight && psec->f_pflags & PS_PASSABLE)
-      {
-         const linkdata_t *ldata = R_FPLink(psec);
+      // perform fading and count down
+      ps.trans[i] = newtrans;
+      ps.ttl[i]   = byte(ps.ttl[i] - ticking);
 
-         P_UnsetParticlePosition(particle);
-         particle->x += ldata->deltax;
-         particle->y += ldata->deltay;
-         particle->z += ldata->deltaz;
-         P_SetParticlePosition(particle);
-      }
-      else if(particle->z < floorheight)
+      // is it time to kill this particle?
+      dead[i] = byte(ticking & ((oldtrans < newtrans) | (ps.ttl[i] == 0)));
+   }
+
+   // remove the dead by moving the last live particle into their place
+   for(i = 0; i < count; )
+   {
+      if(dead[i])
       {
-         // particles with fall to ground style start ticking now
-         if(particle->styleflags & PS_FALLTOGROUND)
-            particle->styleflags &= ~PS_FALLTOGROUND;
+         --count;
+         ps.move(i, count);
+         dead[i] = dead[count];
+      }
+      else
+         ++i;
+   }
+   ps.count = count;
 
-         // particles with floor clipping may need to stop
-         if(particle->styleflags & PS_FLOORCLIP)
+   // update positions
+   if(gMapHasLinePortals)
+   {
+      // Check for wall portals
+      for(i = 0; i < count; i++)
+      {
+         if(ps.velx[i] | ps.vely[i])
          {
-            particle->z = floorheight;
-            particle->accz = particle->velz = 0;
-            particle->styleflags |= PS_HITGROUND;
-            
-            // some particles make splashes
-            if(particle->styleflags & PS_SPLASH)
-               E_PtclTerrainHit(particle);
+            v2fixed_t destination = 
+               P_LinePortalCrossing(ps.x[i], ps.y[i], ps.velx[i], ps.vely[i]);
+            ps.x[i] = destination.x;
+            ps.y[i] = destination.y;
          }
       }
-      else if(particle->z > psec->ceilingheight && psec->c_pflags & PS_PASSABLE)
-      {
-         const linkdata_t *ldata = R_CPLink(psec);
-
-         P_UnsetParticlePosition(particle);
-         particle->x += ldata->deltax;
-         particle->y += ldata->deltay;
-         particle->z += ldata->deltaz;
-         P_SetParticlePosition(particle);
-      }
-      
-      prev = particle;
    }
+   else
+   {
+      for(i = 0; i < count; i++)
+         ps.x[i] += ps.velx[i];
+      for(i = 0; i < count; i++)
+         ps.y[i] += ps.vely[i];
+   }
+   for(i = 0; i < count; i++)
+      ps.z[i] += ps.velz[i];
+
+   // apply accelerations
+   for(i = 0; i < count; i++)
+      ps.velx[i] += ps.accx[i];
+   for(i = 0; i < count; i++)
+      ps.vely[i] += ps.accy[i];
+   for(i = 0; i < count; i++)
+      ps.velz[i] += ps.accz[i];
+
+   // link to new positions and handle special movement flags
+   for(i = 0; i < count; i++)
+      P_locateParticle(ps, i);
+
+   R_InvalidateParticleBins();
 }
 
 void P_RunEffects(void)
@@ -582,7 +598,6 @@ static void MakeFountain(Mobj *actor, byte color1, byte color2)
       particle->x = actor->x + FixedMul(out, finecosine[an]);
       particle->y = actor->y + FixedMul(out, finesine[an]);
       particle->z = actor->z + actor->height + FRACUNIT;
-      P_SetParticlePosition(particle);
       
       if(out < actor->radius/8)
          particle->velz += FRACUNIT*10/3;
@@ -642,7 +657,6 @@ static void P_RunEffect(Mobj *actor, unsigned int effects)
          particle->x = backx - FixedMul(actor->momx, pathdist);
          particle->y = backy - FixedMul(actor->momy, pathdist);
          particle->z = backz - FixedMul(actor->momz, pathdist);
-         P_SetParticlePosition(particle);
 
          speed = (M_Random () - 128) * (FRACUNIT/200);
          particle->velx += FixedMul(speed, finecosine[an]);
@@ -664,7 +678,6 @@ static void P_RunEffect(Mobj *actor, unsigned int effects)
             iparticle->y = backy - FixedMul(actor->momy, pathdist);
             iparticle->z = backz - FixedMul(actor->momz, pathdist) + 
                              (M_Random() << 10);
-            P_SetParticlePosition(iparticle);
 
             speed = (M_Random() - 128) * (FRACUNIT/200);
             iparticle->velx += FixedMul(speed, finecosine[an]);
@@ -752,7 +765,6 @@ void P_DrawSplash(int count, fixed_t x, fixed_t y, fixed_t z,
       an = (angle + (M_Random() << 21)) >> ANGLETOFINESHIFT;
       p->x = x + (M_Random() & 15)*finecosine[an];
       p->y = y + (M_Random() & 15)*finesine[an];
-      P_SetParticlePosition(p);
    }
 }
 
@@ -787,7 +799,6 @@ static void P_BloodDrop(int count, fixed_t x, fixed_t y, fixed_t z,
       an = (angle + ((M_Random() - 128) << 22)) >> ANGLETOFINESHIFT;
       p->x = x + (M_Random() & 10) * finecosine[an];
       p->y = y + (M_Random() & 10) * finesine[an];
-      P_SetParticlePosition(p);
    }
 }
 
@@ -873,7 +884,6 @@ void P_SmokePuff(int count, fixed_t x, fixed_t y, fixed_t z, angle_t angle,
       an = (angle + ((M_Random() - 128) << 22)) >> ANGLETOFINESHIFT;
       p->x = x + (M_Random() & 14) * finecosine[an];
       p->y = y + (M_Random() & 14) * finesine[an];
-      P_SetParticlePosition(p);
    }
 
    if(!hitwater) // no sparks on liquids
@@ -891,7 +901,6 @@ void P_SmokePuff(int count, fixed_t x, fixed_t y, fixed_t z, angle_t angle,
          p->x = x - pathdist;
          p->y = y - pathdist;
          p->z = z - pathdist;
-         P_SetParticlePosition(p);
          
          speed = (M_Random() - 128) * (FRACUNIT / 200);
          an = angle >> ANGLETOFINESHIFT;
@@ -991,7 +1000,6 @@ void P_BloodSpray(Mobj *mo, int count, fixed_t x, fixed_t y, fixed_t z,
       p->velz = (M_Random() < 32) ? M_Random() * 140 : M_Random() * -128;
       p->accz = -FRACUNIT/16;
       
-      P_SetParticlePosition(p);
    }
 }
 
@@ -1043,7 +1051,6 @@ void P_DrawSplash2(int count, fixed_t x, fixed_t y, fixed_t z,
       an = (angle + ((M_Random() - 128) << 22)) >> ANGLETOFINESHIFT;
       p->x = x + (M_Random() & 31) * finecosine[an];
       p->y = y + (M_Random() & 31) * finesine[an];
-      P_SetParticlePosition(p);
    }
 }
 
@@ -1063,7 +1070,6 @@ void P_DisconnectEffect(Mobj *actor)
       p->y = actor->y + 
              ((M_Random()-128)<<9) * (actor->radius>>FRACBITS);
       p->z = actor->z + (M_Random()<<8) * (actor->height>>FRACBITS);
-      P_SetParticlePosition(p);
 
       p->accz -= FRACUNIT/4096;
       p->color = M_Random() < 128 ? maroon1 : maroon2;
@@ -1120,7 +1126,6 @@ static void P_FlyEffect(Mobj *actor)
       p->x = actor->x + (int)((bytedirs[i][0]*dist + forward[0]*BEAMLENGTH)*FRACUNIT);
       p->y = actor->y + (int)((bytedirs[i][1]*dist + forward[1]*BEAMLENGTH)*FRACUNIT);
       p->z = actor->z + (int)((bytedirs[i][2]*dist + forward[2]*BEAMLENGTH)*FRACUNIT);
-      P_SetParticlePosition(p);
 
       p->velx = p->vely = p->velz = 0;
       p->accx = p->accy = p->accz = 0;
@@ -1170,7 +1175,6 @@ static void P_BFGEffect(Mobj *actor)
       p->x = actor->x + (int)((bytedirs[i][0]*dist + forward[0]*BEAMLENGTH)*FRACUNIT);
       p->y = actor->y + (int)((bytedirs[i][1]*dist + forward[1]*BEAMLENGTH)*FRACUNIT);
       p->z = actor->z + (15*FRACUNIT) + (int)((bytedirs[i][2]*dist + forward[2]*BEAMLENGTH)*FRACUNIT);
-      P_SetParticlePosition(p);
 
       p->velx = p->vely = p->velz = 0;
       p->accx = p->accy = p->accz = 0;
@@ -1230,7 +1234,6 @@ static void P_DripEffect(Mobj *actor)
    p->x = actor->x;
    p->y = actor->y;
    p->z = actor->subsector->sector->ceilingheight;
-   P_SetParticlePosition(p);
 }
 
 //
@@ -1310,7 +1313,6 @@ static void P_ExplosionParticles(fixed_t x, fixed_t y, fixed_t z,
       p->x = x + (((M_Random() % 32) - 16)*4096);
       p->y = y + (((M_Random() % 32) - 16)*4096);
       p->z = z + (((M_Random() % 32) - 16)*4096);
-      P_SetParticlePosition(p);
 
       // note: was (rand() % 384) - 192 in Q2, but DOOM's RNG
       // only outputs numbers from 0 to 255, so it has to be
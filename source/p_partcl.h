@@ -24,8 +24,7 @@
 #ifndef P_PARTCL_H__
 #define P_PARTCL_H__
 
-// Required for: DLListItem, fixed_t, angle_t
-#include "m_dllist.h"
+// Required for: fixed_t, angle_t
 #include "m_fixed.h"
 #include "tables.h"
 
@@ -41,28 +40,53 @@ struct subsector_t;
 #define PS_HITGROUND    0x0008
 #define PS_SPLASH       0x0010 
 
+//
+// particle_t
+//
+// A particle waiting to be added to the particle store. Effects fill these
+// in through newParticle; they are moved into the store in one batch before
+// the particles next think or are drawn.
+//
 struct particle_t
 {
-   // haleyjd 02/20/04: particles now need sector links
-   // haleyjd 08/05/05: use generalized dbl-linked list code
-   DLListItem<particle_t> seclinks;         // sector links
-   subsector_t *subsector;
-
    fixed_t x, y, z;
    fixed_t velx, vely, velz;
    fixed_t accx, accy, accz;
    unsigned int trans;
    unsigned int fade;
-   byte	ttl;
-   byte	size;
+   byte ttl;
+   byte size;
    byte color;
-   int  next;
    int  styleflags; // haleyjd 07/03/03
 };
 
-extern int activeParticles;
-extern int inactiveParticles;
-extern particle_t *Particles;
+//
+// particlestore_t
+//
+// Live particles, kept as one array per field so that the thinker can run
+// over each field in tight loops. Live particles are always packed into
+// [0, count); dead ones are removed by moving the last particle into their
+// slot.
+//
+struct particlestore_t
+{
+   int           count;     // number of live particles
+   int           capacity;  // maximum number of live particles
+   fixed_t      *x, *y, *z;
+   fixed_t      *velx, *vely, *velz;
+   fixed_t      *accx, *accy, *accz;
+   unsigned int *trans;
+   unsigned int *fade;
+   byte         *ttl;
+   byte         *size;
+   byte         *color;
+   int          *styleflags;
+   subsector_t **subsector; // subsector the particle is in
+
+   void move(int dst, int src);
+};
+
+extern particlestore_t Particles;
 extern int particle_trans;
 
 #define FX_ROCKET		0x00000001
@@ -30,10 +30,13 @@
 #include "doomstat.h"
 #include "e_exdata.h"
 #include "ev_specials.h"
+#include "p_enemy.h"
 #include "p_chase.h"
+#include "p_map.h"
 #include "polyobj.h"
 #include "p_portal.h"
 #include "p_portalblockmap.h"
+#include "p_sector.h"
 #include "p_setup.h"
 #include "p_user.h"
 #include "r_main.h"
@@ -1036,6 +1039,9 @@ void P_SetFloorHeight(sector_t *sec, fixed_t h)
    // set new value
    sec->floorheight = h;
    sec->floorheightf = M_FixedToFloat(sec->floorheight);
+   P_InvalidateSightCache();
+   P_UpdateSoundLines(sec);
+   P_MarkSectorMoved(*sec);
 
    // check floor portal state
    P_CheckFPortalState(sec);
@@ -1052,6 +1058,9 @@ void P_SetCeilingHeight(sector_t *sec, fixed_t h)
    // set new value
    sec->ceilingheight = h;
    sec->ceilingheightf = M_FixedToFloat(sec->ceilingheight);
+   P_InvalidateSightCache();
+   P_UpdateSoundLines(sec);
+   P_MarkSectorMoved(*sec);
 
    // check ceiling portal state
    P_CheckCPortalState(sec);
@@ -1062,6 +1071,7 @@ void P_SetPortalBehavior(portal_t *portal, int newbehavior)
    int   i;
    
    portal->flags = newbehavior & PF_FLAGMASK;
+   P_InvalidateSightCache();
    for(i = 0; i < numsectors; i++)
    {
       sector_t *sec = sectors + i;
@@ -1104,6 +1114,7 @@ void P_SetLPortalBehavior(line_t *line, int newbehavior)
       
    line->pflags = newbehavior;
    P_CheckLPortalState(line);
+   P_InvalidateSightCache();
 }
 
 //
@@ -0,0 +1,617 @@
+//
+// The Eternity Engine
+// Copyright (C) 2018 James Haley et al.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see http://www.gnu.org/licenses/
+//
+// Additional terms and conditions compatible with the GPLv3 apply. See the
+// file COPYING-EE for details.
+//
+// Purpose: Generation of REJECT sight tables for levels that lack one.
+//
+//  Many node builders write an empty or all-zero REJECT lump, which turns
+//  off the cheap rejection step of every sight check. This module builds a
+//  conservative table instead: two sectors are marked as unable to see each
+//  other only if no straight line in the map's plan can get from one to the
+//  other while passing solely through two-sided lines. Heights are ignored,
+//  since doors and lifts can change them at any time, so the result never
+//  rejects a sight check that could succeed.
+//
+//  For every sector, visibility is flooded out through its two-sided lines.
+//  Each line reached is clipped to the part of it that a straight line
+//  through both the line the flood left the source by and the last line
+//  passed can reach. Sectors are treated as open cells, which can only
+//  overestimate what is visible. Sectors are independent, so they are
+//  spread over the worker threads, and the finished table is cached on disk
+//  under a hash of the level's geometry.
+//
+
+#include "z_zone.h"
+
+#include "c_io.h"
+#include "d_gi.h"
+#include "doomstat.h"
+#include "hal/i_directory.h"
+#include "m_compare.h"
+#include "m_hash.h"
+#include "m_parallel.h"
+#include "m_qstr.h"
+#include "m_utils.h"
+#include "p_reject.h"
+#include "p_setup.h"
+#include "r_defs.h"
+#include "p_portal.h"
+#include "r_state.h"
+#include "v_misc.h"
+
+// bump when the generator changes, to invalidate cached tables
+#define REJECT_VERSION 1
+
+// most lines the flood from one sector may try before giving up on clipping
+// and marking its whole connected area as visible
+#define REJECT_BUDGET 16384
+
+// tolerance in map units; errs on the side of keeping lines visible
+#define REJECT_EPSILON 1.0
+
+// distance below which a point is taken to lie on a line when choosing
+// separating lines; one fixed-point unit
+#define REJECT_ONLINE (1.0 / 65536.0)
+
+static const char rejectMagic[8] = { 'E', 'E', 'R', 'E', 'J', 'E', 'C', 'T' };
+
+//
+// rejseg_t
+//
+// A line segment, oriented so that the side the flood is moving into is
+// on its left.
+//
+struct rejseg_t
+{
+   double x1, y1, x2, y2;
+};
+
+//
+// rejportal_t
+//
+// A two-sided line as seen from one of its sectors.
+//
+struct rejportal_t
+{
+   rejseg_t seg;    // oriented with the other sector on the left
+   int      line;   // line number
+   int      sector; // sector on the other side
+};
+
+//
+// rejframe_t
+//
+// One step of the flood out of a source sector.
+//
+struct rejframe_t
+{
+   rejseg_t pass;   // clipped line the flood entered the sector by
+   int      sector; // sector being flooded
+   int      line;   // line that was passed
+   int      next;   // next portal of the sector to try
+};
+
+//
+// rejscratch_t
+//
+// Per-worker state for the flood.
+//
+struct rejscratch_t
+{
+   byte       *onstack; // sectors on the current flood path
+   rejframe_t *stack;
+};
+
+//
+// rejectgen_t
+//
+// Everything a worker needs to flood from one source sector.
+//
+struct rejectgen_t
+{
+   rejportal_t  *portals;     // portals of each sector, grouped by sector
+   int          *firstportal; // first portal of sector i; numsectors + 1 long
+   int          *component;   // connected area each sector belongs to
+   byte         *visible;     // one row of bits per source sector
+   int           rowbytes;
+   rejscratch_t *scratch;     // one per worker
+};
+
+//=============================================================================
+//
+// Geometry
+//
+
+//
+// P_rejSide
+//
+// Returns the distance of (x, y) from the infinite line through (ax, ay) and
+// (bx, by), positive on its left.
+//
+static double P_rejSide(double ax, double ay, double bx, double by, 
+                        double x, double y)
+{
+   double dx  = bx - ax;
+   double dy  = by - ay;
+   double len = sqrt(dx * dx + dy * dy);
+
+   if(len == 0.0)
+      return 0.0;
+
+   return (dx * (y - ay) - dy * (x - ax)) / len;
+}
+
+//
+// P_rejClip
+//
+// Clips seg to the side of the line through (ax, ay) and (bx, by) given by
+// sign, allowing the tolerance. Returns false if nothing is left.
+//
+static bool P_rejClip(rejseg_t &seg, double ax, double ay, double bx, double by,
+                      double sign)
+{
+   double f1 = sign * P_rejSide(ax, ay, bx, by, seg.x1, seg.y1) + REJECT_EPSILON;
+   double f2 = sign * P_rejSide(ax, ay, bx, by, seg.x2, seg.y2) + REJECT_EPSILON;
+
+   if(f1 >= 0.0 && f2 >= 0.0)
+      return true;
+   if(f1 < 0.0 && f2 < 0.0)
+      return false;
+
+   double t  = f1 / (f1 - f2);
+   double ix = seg.x1 + (seg.x2 - seg.x1) * t;
+   double iy = seg.y1 + (seg.y2 - seg.y1) * t;
+
+   if(f1 < 0.0)
+   {
+      seg.x1 = ix;
+      seg.y1 = iy;
+   }
+   else
+   {
+      seg.x2 = ix;
+      seg.y2 = iy;
+   }
+   return true;
+}
+
+//
+// P_rejClipToSeparators
+//
+// Clips target to the region that straight lines passing through both src
+// and pass can reach beyond pass. That region is bounded by the lines
+// through an end point of each which have src and pass on opposite sides.
+//
+static bool P_rejClipToSeparators(const rejseg_t &src, const rejseg_t &pass,
+                                  rejseg_t &target)
+{
+   const double sx[2] = { src.x1,  src.x2  }, sy[2] = { src.y1,  src.y2  };
+   const double px[2] = { pass.x1, pass.x2 }, py[2] = { pass.y1, pass.y2 };
+
+   for(int i = 0; i < 2; i++)
+   {
+      for(int j = 0; j < 2; j++)
+      {
+         double sside = P_rejSide(sx[i], sy[i], px[j], py[j], sx[i^1], sy[i^1]);
+         double pside = P_rejSide(sx[i], sy[i], px[j], py[j], px[j^1], py[j^1]);
+         double sign;
+
+         // src and pass on the same side: not a separating line
+         if((sside > REJECT_ONLINE && pside > REJECT_ONLINE) ||
+            (sside < -REJECT_ONLINE && pside < -REJECT_ONLINE))
+            continue;
+
+         if(fabs(pside) > REJECT_ONLINE)
+            sign = pside > 0.0 ? 1.0 : -1.0;
+         else if(fabs(sside) > REJECT_ONLINE)
+            sign = sside > 0.0 ? -1.0 : 1.0;
+         else
+            continue; // all collinear; nothing to clip against
+
+         if(!P_rejClip(target, sx[i], sy[i], px[j], py[j], sign))
+            return false;
+      }
+   }
+
+   return true;
+}
+
+//=============================================================================
+//
+// Flood
+//
+
+#define REJ_SETBIT(row, i) ((row)[(i) >> 3] |= byte(1 << ((i) & 7)))
+
+//
+// P_rejFloodSector
+//
+// Marks every sector visible from one source sector in its row of the
+// visibility table. Run on the worker threads.
+//
+static void P_rejFloodSector(int source, int worker, void *data)
+{
+   const rejectgen_t &gen = *static_cast<rejectgen_t *>(data);
+   rejscratch_t &scratch  = gen.scratch[worker];
+   byte *row = gen.visible + size_t(source) * gen.rowbytes;
+   int visits = 0;
+
+   REJ_SETBIT(row, source);
+   scratch.onstack[source] = 1;
+
+   for(int p = gen.firstportal[source]; p < gen.firstportal[source + 1]; p++)
+   {
+      const rejportal_t &start = gen.portals[p];
+      int depth = 0;
+
+      // everything in the neighbouring sector is visible through the line
+      REJ_SETBIT(row, start.sector);
+      if(scratch.onstack[start.sector])
+         continue;
+
+      rejframe_t *frame = &scratch.stack[depth++];
+      frame->pass   = start.seg;
+      frame->sector = start.sector;
+      frame->line   = start.line;
+      frame->next   = gen.firstportal[start.sector];
+      scratch.onstack[start.sector] = 1;
+
+      while(depth)
+      {
+         frame = &scratch.stack[depth - 1];
+
+         if(frame->next == gen.firstportal[frame->sector + 1])
+         {
+            scratch.onstack[frame->sector] = 0;
+            --depth;
+            continue;
+         }
+
+         const rejportal_t &portal = gen.portals[frame->next++];
+
+         if(portal.line == frame->line || scratch.onstack[portal.sector])
+            continue;
+
+         if(++visits > REJECT_BUDGET)
+         {
+            // too complex to clip; everything connected might be visible
+            for(int i = 0; i < depth; i++)
+               scratch.onstack[scratch.stack[i].sector] = 0;
+            scratch.onstack[source] = 0;
+
+            int comp = gen.component[source];
+            for(int i = 0; i < numsectors; i++)
+            {
+               if(gen.component[i] == comp)
+                  REJ_SETBIT(row, i);
+            }
+            return;
+         }
+
+         // the line must lie beyond both the start and the last line passed
+         const rejseg_t &pass = frame->pass;
+         rejseg_t seg = portal.seg;
+
+         if(!P_rejClip(seg, pass.x1, pass.y1, pass.x2, pass.y2, 1.0) ||
+            !P_rejClip(seg, start.seg.x1, start.seg.y1, start.seg.x2, start.seg.y2, 1.0))
+            continue;
+
+         if(depth > 1)
+         {
+            if(!P_rejClipToSeparators(start.seg, pass, seg))
+               continue;
+         }
+
+         REJ_SETBIT(row, portal.sector);
+
+         rejframe_t *next = &scratch.stack[depth++];
+         next->pass   = seg;
+         next->sector = portal.sector;
+         next->line   = portal.line;
+         next->next   = gen.firstportal[portal.sector];
+         scratch.onstack[portal.sector] = 1;
+      }
+   }
+
+   scratch.onstack[source] = 0;
+}
+
+//
+// P_rejBuildPortals
+//
+// Collects the two-sided lines of every sector, and numbers the connected
+// areas they form.
+//
+static void P_rejBuildPortals(rejectgen_t &gen)
+{
+   int count = 0;
+
+   gen.firstportal = ecalloc(int *, numsectors + 1, sizeof(int));
+   gen.component   = ecalloc(int *, numsectors, sizeof(int));
+
+   // count, then place, both sides of every line joining two sectors;
+   // polyobject lines move, so they are never counted as openings
+   for(int pass = 0; pass < 2; pass++)
+   {
+      for(int i = 0; i < numlines; i++)
+      {
+         const line_t &line = lines[i];
+
+         if(!line.backsector || line.frontsector == line.backsector ||
+            line.intflags & MLI_DYNASEGLINE)
+            continue;
+
+         int fs = eindex(line.frontsector - sectors);
+         int bs = eindex(line.backsector  - sectors);
+
+         if(!pass)
+         {
+            ++gen.firstportal[fs + 1];
+            ++gen.firstportal[bs + 1];
+            count += 2;
+            continue;
+         }
+
+         double x1 = M_FixedToDouble(line.v1->x), y1 = M_FixedToDouble(line.v1->y);
+         double x2 = M_FixedToDouble(line.v2->x), y2 = M_FixedToDouble(line.v2->y);
+
+         // the back sector is on the left of v1 -> v2
+         rejportal_t &tofront = gen.portals[gen.firstportal[bs]++];
+         tofront.seg    = { x2, y2, x1, y1 };
+         tofront.line   = i;
+         tofront.sector = fs;
+
+         rejportal_t &toback = gen.portals[gen.firstportal[fs]++];
+         toback.seg    = { x1, y1, x2, y2 };
+         toback.line   = i;
+         toback.sector = bs;
+      }
+
+      if(!pass)
+      {
+         for(int i = 1; i <= numsectors; i++)
+            gen.firstportal[i] += gen.firstportal[i - 1];
+         gen.portals = ecalloc(rejportal_t *, emax(count, 1), sizeof(rejportal_t));
+      }
+      else
+      {
+         // filling advanced each start to the next sector's; shift back
+         for(int i = numsectors; i > 0; i--)
+            gen.firstportal[i] = gen.firstportal[i - 1];
+         gen.firstportal[0] = 0;
+      }
+   }
+
+   // number the connected areas with a flood fill
+   int *queue = ecalloc(int *, numsectors, sizeof(int));
+
+   for(int i = 0; i < numsectors; i++)
+      gen.component[i] = -1;
+
+   for(int i = 0; i < numsectors; i++)
+   {
+      int head = 0, tail = 0;
+
+      if(gen.component[i] != -1)
+         continue;
+
+      gen.component[i] = i;
+      queue[tail++] = i;
+      while(head < tail)
+      {
+         int s = queue[head++];
+
+         for(int p = gen.firstportal[s]; p < gen.firstportal[s + 1]; p++)
+         {
+            int other = gen.portals[p].sector;
+            if(gen.component[other] == -1)
+            {
+               gen.component[other] = i;
+               queue[tail++] = other;
+            }
+         }
+      }
+   }
+
+   efree(queue);
+}
+
+//=============================================================================
+//
+// Cache
+//
+
+//
+// P_rejCachePath
+//
+// Works out the file a table for the current level is cached in, keyed by a
+// hash of the geometry it was generated from.
+//
+static void P_rejCachePath(qstring &path)
+{
+   HashData hash(HashData::SHA1);
+   int32_t header[3] = { REJECT_VERSION, numsectors, numlines };
+
+   hash.addData(reinterpret_cast<const uint8_t *>(header), sizeof(header));
+
+   for(int i = 0; i < numlines; i++)
+   {
+      const line_t &line = lines[i];
+      int32_t data[7] =
+      {
+         line.v1->x, line.v1->y, line.v2->x, line.v2->y,
+         eindex(line.frontsector - sectors),
+         line.backsector ? eindex(line.backsector - sectors) : -1,
+         line.intflags & MLI_DYNASEGLINE
+      };
+
+      hash.addData(reinterpret_cast<const uint8_t *>(data), sizeof(data));
+   }
+   hash.wrapUp();
+
+   char *digest = hash.digestToString();
+
+   path = usergamepath;
+   path.pathConcatenate("cache");
+   I_CreateDirectory(path);
+   path.pathConcatenate(digest);
+   path += ".rej";
+
+   efree(digest);
+}
+
+//
+// P_rejLoadCached
+//
+// Reads a cached table into rejectmatrix if there is a valid one.
+//
+static bool P_rejLoadCached(const char *path, int size)
+{
+   byte *buffer = NULL;
+   int   length = M_ReadFile(path, &buffer);
+   bool  result = false;
+
+   if(length == int(sizeof(rejectMagic) + sizeof(int32_t)) + size &&
+      !memcmp(buffer, rejectMagic, sizeof(rejectMagic)))
+   {
+      int32_t cachedsectors;
+
+      memcpy(&cachedsectors, buffer + sizeof(rejectMagic), sizeof(cachedsectors));
+      if(cachedsectors == numsectors)
+      {
+         memcpy(rejectmatrix, buffer + sizeof(rejectMagic) + sizeof(int32_t), size);
+         result = true;
+      }
+   }
+
+   if(buffer)
+      efree(buffer);
+   return result;
+}
+
+//
+// P_rejSaveCached
+//
+static void P_rejSaveCached(const char *path, int size)
+{
+   size_t length = sizeof(rejectMagic) + sizeof(int32_t) + size;
+   byte  *buffer = emalloc(byte *, length);
+   int32_t count = numsectors;
+
+   memcpy(buffer, rejectMagic, sizeof(rejectMagic));
+   memcpy(buffer + sizeof(rejectMagic), &count, sizeof(count));
+   memcpy(buffer + sizeof(rejectMagic) + sizeof(int32_t), rejectmatrix, size);
+
+   if(!M_WriteFile(path, buffer, length))
+      C_Printf(FC_ERROR "P_GenerateReject: could not write %s\n", path);
+
+   efree(buffer);
+}
+
+//=============================================================================
+//
+// Interface
+//
+
+//
+// P_RejectIsEmpty
+//
+// Returns true if a REJECT lump rejects nothing at all.
+//
+bool P_RejectIsEmpty(const byte *reject, int size)
+{
+   for(int i = 0; i < size; i++)
+   {
+      if(reject[i])
+         return false;
+   }
+   return true;
+}
+
+//
+// P_GenerateReject
+//
+// Replaces rejectmatrix with a generated table, taken from the cache if
+// this level has been seen before. Levels with linked portals are left
+// alone, since sight can pass between groups in ways a flat plan of the
+// level does not show.
+//
+void P_GenerateReject()
+{
+   int size = (((numsectors * numsectors) + 7) & ~7) / 8;
+   qstring path;
+
+   if(numsectors < 2 || useportalgroups || gMapHasLinePortals)
+      return;
+
+   rejectmatrix = static_cast<byte *>(Z_Calloc(1, size, PU_LEVEL, NULL));
+
+   P_rejCachePath(path);
+   if(P_rejLoadCached(path.constPtr(), size))
+      return;
+
+   rejectgen_t gen;
+   int numworkers = M_WorkerCount();
+
+   P_rejBuildPortals(gen);
+
+   gen.rowbytes = (numsectors + 7) / 8;
+   gen.visible  = ecalloc(byte *, numsectors, gen.rowbytes);
+   gen.scratch  = ecalloc(rejscratch_t *, numworkers, sizeof(rejscratch_t));
+   for(int i = 0; i < numworkers; i++)
+   {
+      gen.scratch[i].onstack = ecalloc(byte *, numsectors, 1);
+      gen.scratch[i].stack   = ecalloc(rejframe_t *, numsectors, sizeof(rejframe_t));
+   }
+
+   M_ParallelFor(numsectors, P_rejFloodSector, &gen);
+
+   // reject every pair that neither sector can see the other from
+   for(int i = 0; i < numsectors; i++)
+   {
+      const byte *row = gen.visible + size_t(i) * gen.rowbytes;
+
+      for(int j = 0; j < numsectors; j++)
+      {
+         const byte *other = gen.visible + size_t(j) * gen.rowbytes;
+
+         if(!(row[j >> 3] & (1 << (j & 7))) && !(other[i >> 3] & (1 << (i & 7))))
+         {
+            int pnum = i * numsectors + j;
+            rejectmatrix[pnum >> 3] |= byte(1 << (pnum & 7));
+         }
+      }
+   }
+
+   for(int i = 0; i < numworkers; i++)
+   {
+      efree(gen.scratch[i].onstack);
+      efree(gen.scratch[i].stack);
+   }
+   efree(gen.scratch);
+   efree(gen.visible);
+   efree(gen.portals);
+   efree(gen.firstportal);
+   efree(gen.component);
+
+   P_rejSaveCached(path.constPtr(), size);
+}
+
+// EOF
+
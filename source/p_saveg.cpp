@@ -25,6 +25,10 @@
 
 #include "z_zone.h"
 #include "i_system.h"
+#include "../zlib/zlib.h"
+
+#include <atomic>
+#include <thread>
 
 #include "a_small.h"
 #include "acs_intr.h"
@@ -44,6 +48,7 @@
 #include "g_game.h"
 #include "m_argv.h"
 #include "m_buffer.h"
+#include "m_qstr.h"
 #include "m_random.h"
 #include "p_info.h"
 #include "p_maputl.h"
@@ -68,6 +73,11 @@
 #include "w_levels.h"
 #include "w_wad.h"
 
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#endif
+
 // Pads save_p to a 4-byte boundary
 //  so that the load/save works on SGI&Gecko.
 // #define PADSAVEP()    do { save_p += (4 - ((int) save_p & 3)) & 3; } while (0)
@@ -1248,355 +1258,865 @@ static void P_ArchiveACS(SaveArchive &arc)
 
 //============================================================================
 //
-// Saving - Main Routine
+// Link Order
+//
+// Loading a game relinks every thing into the thinker class lists, its
+// sector lists and its blockmap cell in thinker order, which is not the order
+// they were in when the game was saved. Savegames get away with that, but
+// snapshots have to stay in sync with the demo being played back, so they
+// also record the order of those lists and put it back. A list which doesn't
+// hold what was recorded for it is left as it is.
 //
 
-#define SAVESTRINGSIZE 24
+//
+// P_archiveThinkerClasses
+//
+static void P_archiveThinkerClasses(SaveArchive &arc)
+{
+   for(int tclass = th_misc; tclass < NUMTHCLASS; tclass++)
+   {
+      Thinker      *cap   = &thinkerclasscap[tclass];
+      unsigned int  count = 0;
+      unsigned int  num;
 
-void P_SaveCurrentLevel(char *filename, char *description)
+      if(arc.isSaving())
+      {
+         for(Thinker *th = cap->cnext; th != cap; th = th->cnext)
+         {
+            if(th->getOrdinal())
+               ++count;
+         }
+         arc << count;
+         for(Thinker *th = cap->cnext; th != cap; th = th->cnext)
+         {
+            if((num = th->getOrdinal()))
+               arc << num;
+         }
+         continue;
+      }
+
+      arc << count;
+      while(count--)
+      {
+         Thinker *th;
+
+         arc << num;
+         if(!(th = P_ThinkerForNum(num)))
+            continue;
+
+         // move it to the end of the list
+         (th->cnext->cprev = th->cprev)->cnext = th->cnext;
+         cap->cprev->cnext = th;
+         th->cnext = cap;
+         th->cprev = cap->cprev;
+         cap->cprev = th;
+      }
+   }
+}
+
+//
+// P_loadMobjList
+//
+// Reads a count and that many thinker numbers. Returns false if any of them
+// isn't a Mobj.
+//
+static bool P_loadMobjList(SaveArchive &arc, PODCollection<Mobj *> &things)
 {
-   int i;
-   char name2[VERSIONSIZE];
-   const char *fn;
-   OutBuffer savefile;
-   SaveArchive arc(&savefile);
+   unsigned int count, num;
+   bool         valid = true;
+
+   things.makeEmpty();
 
-   if(!savefile.createFile(filename, 512*1024, OutBuffer::NENDIAN))
+   arc << count;
+   while(count--)
    {
-      const char *str =
-         errno ? strerror(errno) : FC_ERROR "Could not save game: Error unknown";
-      doom_printf("%s", str);
-      return;
+      Mobj *mo;
+
+      arc << num;
+      if(!(mo = thinker_cast<Mobj *>(P_ThinkerForNum(num))))
+         valid = false;
+      things.add(mo);
    }
 
-   // Enable buffered IO exceptions
-   savefile.setThrowing(true);
+   return valid;
+}
 
-   try
+//
+// P_saveMobjNum
+//
+static void P_saveMobjNum(SaveArchive &arc, Mobj *mo)
+{
+   unsigned int num = P_NumForThinker(mo);
+   arc << num;
+}
+
+//
+// P_archiveSectorLists
+//
+// Each thing's list of touched sectors, then each sector's lists of things
+// in it and touching it.
+//
+static void P_archiveSectorLists(SaveArchive &arc)
+{
+   PODCollection<Mobj *>       things;
+   PODCollection<msecnode_t *> nodes;
+   unsigned int                count, num;
+   msecnode_t                 *node;
+
+   if(arc.isSaving())
    {
-      arc.archiveCString(description, SAVESTRINGSIZE);
-      
-      // killough 2/22/98: "proprietary" version string :-)
-      memset(name2, 0, sizeof(name2));
-      sprintf(name2, VERSIONID, version);
-   
-      arc.archiveCString(name2, VERSIONSIZE);
-   
-      // killough 2/14/98: save old compatibility flag:
-      // haleyjd 06/16/10: save "inmasterlevels" state
-      int tempskill = (int)gameskill;
-      
-      arc << compatibility << tempskill << inmanageddir;
-      arc << vanilla_mode;
-   
-      // sf: use string rather than episode, map
-      for(i = 0; i < 8; i++)
+      for(Thinker *th = thinkercap.next; th != &thinkercap; th = th->next)
       {
-         int8_t lvc = levelmapname[i];
-         arc << lvc;
+         Mobj *mo;
+
+         if(!(num = th->getOrdinal()) || !(mo = thinker_cast<Mobj *>(th)))
+            continue;
+
+         count = 0;
+         for(node = mo->touching_sectorlist; node; node = node->m_tnext)
+            ++count;
+         arc << num << count;
+         for(node = mo->touching_sectorlist; node; node = node->m_tnext)
+            arc << node->m_sector;
+      }
+      num = 0;
+      arc << num;
+   }
+   else
+   {
+      for(;;)
+      {
+         Mobj     *mo;
+         sector_t *sector;
+         size_t    length = 0;
+         bool      valid;
+
+         arc << num;
+         if(!num)
+            break;
+
+         mo    = thinker_cast<Mobj *>(P_ThinkerForNum(num));
+         valid = (mo != nullptr);
+         nodes.makeEmpty();
+
+         arc << count;
+         while(count--)
+         {
+            arc << sector;
+            for(node = valid ? mo->touching_sectorlist : nullptr; node; node = node->m_tnext)
+            {
+               if(node->m_sector == sector)
+                  break;
+            }
+            if(!node)
+               valid = false;
+            nodes.add(node);
+         }
+         if(!valid)
+            continue;
+
+         for(node = mo->touching_sectorlist; node; node = node->m_tnext)
+            ++length;
+         if(length != nodes.getLength())
+            continue;
+
+         mo->touching_sectorlist = nodes.isEmpty() ? nullptr : nodes[0];
+         for(size_t i = 0; i < nodes.getLength(); i++)
+         {
+            nodes[i]->m_tprev = i ? nodes[i - 1] : nullptr;
+            nodes[i]->m_tnext = i + 1 < nodes.getLength() ? nodes[i + 1] : nullptr;
+         }
       }
+   }
 
-      // haleyjd 06/16/10: support for saving/loading levels in managed wad
-      // directories.
+   for(int i = 0; i < numsectors; i++)
+   {
+      sector_t *sec = &sectors[i];
 
-      if((fn = W_GetManagedDirFN(g_dir))) // returns null if g_dir == &w_GlobalDir
+      if(arc.isSaving())
       {
-         // save length of managed directory filename string and
-         // managed directory filename string
-         arc.writeLString(fn);
+         count = 0;
+         for(Mobj *mo = sec->thinglist; mo; mo = mo->snext)
+            ++count;
+         arc << count;
+         for(Mobj *mo = sec->thinglist; mo; mo = mo->snext)
+            P_saveMobjNum(arc, mo);
+
+         count = 0;
+         for(node = sec->touching_thinglist; node; node = node->m_snext)
+            ++count;
+         arc << count;
+         for(node = sec->touching_thinglist; node; node = node->m_snext)
+            P_saveMobjNum(arc, node->m_thing);
+         continue;
       }
-      else
+
+      // things in the sector
+      bool valid = P_loadMobjList(arc, things);
+
+      count = 0;
+      for(Mobj *mo = sec->thinglist; mo; mo = mo->snext)
+         ++count;
+      for(size_t j = 0; valid && j < things.getLength(); j++)
       {
-         // just save 0; there is no name to save
-         size_t len = 0;
-         arc.archiveSize(len);
+         if((things[j]->flags & MF_NOSECTOR) || things[j]->subsector->sector != sec)
+            valid = false;
       }
-  
-      // killough 3/16/98, 12/98: store lump name checksum
-      // FIXME/TODO: Will be simple with future save format
-      /*
-      uint64_t checksum = G_Signature(g_dir);
-      savefile.Write(&checksum, sizeof(checksum));
-
-      // killough 3/16/98: store pwad filenames in savegame  
-      for(wfileadd_t *file = wadfiles; file->filename; ++file)
+      if(valid && count == things.getLength())
       {
-         const char *fn = file->filename;
-         savefile.Write(fn, strlen(fn));
-         savefile.WriteUint8((uint8_t)'\n');
+         Mobj **link = &sec->thinglist;
+
+         for(Mobj *mo : things)
+         {
+            *link = mo;
+            mo->sprev = link;
+            link = &mo->snext;
+         }
+         *link = nullptr;
       }
-      savefile.WriteUint8(0);
-      */
-  
-      for(i = 0; i < MAXPLAYERS; i++)
-         arc << playeringame[i];
 
-      for(; i < MIN_MAXPLAYERS; i++)         // killough 2/28/98
+      // things touching the sector
+      valid = P_loadMobjList(arc, things);
+      nodes.makeEmpty();
+
+      for(size_t j = 0; valid && j < things.getLength(); j++)
       {
-         bool dummy = 0;
-         arc << dummy;
+         for(node = things[j]->touching_sectorlist; node; node = node->m_tnext)
+         {
+            if(node->m_sector == sec)
+               break;
+         }
+         if(!node)
+            valid = false;
+         nodes.add(node);
       }
 
-      // jff 3/17/98 save idmus state
-      int tempGameType = (int)GameType;
-      arc << idmusnum << tempGameType;
+      count = 0;
+      for(node = sec->touching_thinglist; node; node = node->m_snext)
+         ++count;
+      if(valid && count == nodes.getLength())
+      {
+         sec->touching_thinglist = nodes.isEmpty() ? nullptr : nodes[0];
+         for(size_t j = 0; j < nodes.getLength(); j++)
+         {
+            nodes[j]->m_sprev = j ? nodes[j - 1] : nullptr;
+            nodes[j]->m_snext = j + 1 < nodes.getLength() ? nodes[j + 1] : nullptr;
+         }
+      }
+   }
+}
 
-      byte options[GAME_OPTION_SIZE];
-      G_WriteOptions(options);    // killough 3/1/98: save game options
-      savefile.write(options, sizeof(options));
-   
-      //killough 11/98: save entire word
-      arc << leveltime;
-   
-      // killough 11/98: save revenant tracer state
-      uint8_t tracerState = (uint8_t)((gametic-basetic) & 255);
-      arc << tracerState;
+//
+// P_archiveBlockCells
+//
+// Only cells holding more than one thing are recorded, without their empty
+// entries. On loading, the entries already hold the things' restored
+// positions and radii, which is what they held when saved, since every
+// change to a linked thing refreshes its entry.
+//
+static void P_archiveBlockCells(SaveArchive &arc)
+{
+   PODCollection<Mobj *> things;
+   int                   cellnum;
+   int                   numcells = bmapwidth * bmapheight;
 
-      arc << dmflags;
-   
-      // killough 3/22/98: add Z_CheckHeap after each call to ensure consistency
-      // haleyjd 07/06/09: just Z_CheckHeap after the end. This stuff works by now.
-   
-      P_NumberThinkers();    // turn ptrs to numbers
-
-      P_ArchivePlayers(arc);
-      P_ArchiveWorld(arc);
-      P_ArchiveLevelInfo(arc);
-      P_ArchivePolyObjects(arc); // haleyjd 03/27/06
-      P_ArchiveThinkers(arc);
-      P_ArchiveRNG(arc);    // killough 1/18/98: save RNG information
-      P_ArchiveMap(arc);    // killough 1/22/98: save automap information
-      P_ArchiveSoundSequences(arc);
-      P_ArchiveButtons(arc);
-      P_ArchiveACS(arc);            // davidph 05/30/12
-
-      P_DeNumberThinkers();
-
-      uint8_t cmarker = 0xE6; // consistency marker
-      arc << cmarker; 
-   }
-   catch(BufferedIOException)
-   {
-      // An IO error occurred while trying to save.
-      const char *str =
-         errno ? strerror(errno) : FC_ERROR "Could not save game: Error unknown";
-      doom_printf("%s", str);
-
-      // Close the file and remove it
-      savefile.setThrowing(false);
-      savefile.close();
-      remove(filename);
+   if(arc.isSaving())
+   {
+      for(cellnum = 0; cellnum < numcells; cellnum++)
+      {
+         blockcell_t  &cell  = blockthings[cellnum];
+         unsigned int  count = cell.numthings - cell.numremoved;
+
+         if(count < 2)
+            continue;
+
+         arc << cellnum << count;
+         for(int i = 0; i < cell.numthings; i++)
+         {
+            if(cell.things[i].mo)
+               P_saveMobjNum(arc, cell.things[i].mo);
+         }
+      }
+      cellnum = -1;
+      arc << cellnum;
       return;
    }
 
-   // Close the save file
-   savefile.close();
+   PODCollection<blockthing_t> entries;
 
-   // Check the heap.
-   Z_CheckHeap();
+   for(;;)
+   {
+      arc << cellnum;
+      if(cellnum < 0)
+         break;
 
-   if(!hub_changelevel) // sf: no 'game saved' message for hubs
-      doom_printf("%s", DEH_String("GGSAVED"));  // Ty 03/27/98 - externalized
+      bool valid = P_loadMobjList(arc, things);
+
+      if(cellnum >= numcells || !valid)
+         continue;
+
+      blockcell_t &cell = blockthings[cellnum];
+
+      if(size_t(cell.numthings - cell.numremoved) != things.getLength())
+         continue;
+
+      entries.makeEmpty();
+      for(Mobj *mo : things)
+      {
+         if(mo->blockcell != cellnum + 1)
+            break;
+         entries.add(cell.things[mo->blockindex]);
+      }
+
+      if(entries.getLength() == things.getLength())
+      {
+         // store them compacted, in the saved order
+         for(size_t i = 0; i < entries.getLength(); i++)
+         {
+            cell.things[i] = entries[i];
+            cell.things[i].mo->blockindex = int(i);
+         }
+         cell.numthings  = int(entries.getLength());
+         cell.numremoved = 0;
+      }
+   }
+}
+
+//
+// P_ArchiveLinkOrder
+//
+// Must be called while thinkers are numbered.
+//
+static void P_ArchiveLinkOrder(SaveArchive &arc)
+{
+   P_archiveThinkerClasses(arc);
+   P_archiveSectorLists(arc);
+   P_archiveBlockCells(arc);
 }
 
 //============================================================================
-// 
-// Loading -- Main Routine
+//
+// Saving - Main Routine
 //
 
-void P_LoadGame(const char *filename)
+#define SAVESTRINGSIZE 24
+
+//
+// P_SaveGameState
+//
+// Writes the game state to an archive. Snapshots also record the link order
+// of things and thinkers; see P_ArchiveLinkOrder. Buffered IO exceptions are
+// left for the caller to handle.
+//
+void P_SaveGameState(SaveArchive &arc, char *description, bool snapshot)
 {
    int i;
-   char vcheck[VERSIONSIZE], vread[VERSIONSIZE];
-   //uint64_t checksum, rchecksum;
-   InBuffer loadfile;
-   SaveArchive arc(&loadfile);
+   char name2[VERSIONSIZE];
+   const char *fn;
 
-   if(!loadfile.openFile(filename, InBuffer::NENDIAN))
+   if(description)
+      arc.archiveCString(description, SAVESTRINGSIZE);
+   else
    {
-      C_Printf(FC_ERROR "Failed to load savegame %s\n", filename);
-      C_SetConsole();
+      char blank[SAVESTRINGSIZE] = { 0 };
+      arc.archiveCString(blank, SAVESTRINGSIZE);
+   }
+   
+   // killough 2/22/98: "proprietary" version string :-)
+   memset(name2, 0, sizeof(name2));
+   sprintf(name2, VERSIONID, version);
+
+   arc.archiveCString(name2, VERSIONSIZE);
+
+   // killough 2/14/98: save old compatibility flag:
+   // haleyjd 06/16/10: save "inmasterlevels" state
+   int tempskill = (int)gameskill;
+   
+   arc << compatibility << tempskill << inmanageddir;
+   arc << vanilla_mode;
+
+   // sf: use string rather than episode, map
+   for(i = 0; i < 8; i++)
+   {
+      int8_t lvc = levelmapname[i];
+      arc << lvc;
+   }
+
+   // haleyjd 06/16/10: support for saving/loading levels in managed wad
+   // directories.
+
+   if((fn = W_GetManagedDirFN(g_dir))) // returns null if g_dir == &w_GlobalDir
+   {
+      // save length of managed directory filename string and
+      // managed directory filename string
+      arc.writeLString(fn);
+   }
+   else
+   {
+      // just save 0; there is no name to save
+      size_t len = 0;
+      arc.archiveSize(len);
+   }
+  
+   // killough 3/16/98, 12/98: store lump name checksum
+   // FIXME/TODO: Will be simple with future save format
+   /*
+   uint64_t checksum = G_Signature(g_dir);
+   savefile.Write(&checksum, sizeof(checksum));
+
+   // killough 3/16/98: store pwad filenames in savegame  
+   for(wfileadd_t *file = wadfiles; file->filename; ++file)
+   {
+      const char *fn = file->filename;
+      savefile.Write(fn, strlen(fn));
+      savefile.WriteUint8((uint8_t)'\n');
+   }
+   savefile.WriteUint8(0);
+   */
+  
+   for(i = 0; i < MAXPLAYERS; i++)
+      arc << playeringame[i];
+
+   for(; i < MIN_MAXPLAYERS; i++)         // killough 2/28/98
+   {
+      bool dummy = 0;
+      arc << dummy;
+   }
+
+   // jff 3/17/98 save idmus state
+   int tempGameType = (int)GameType;
+   arc << idmusnum << tempGameType;
+
+   byte options[GAME_OPTION_SIZE];
+   G_WriteOptions(options);    // killough 3/1/98: save game options
+   arc.getSaveFile()->write(options, sizeof(options));
+
+   //killough 11/98: save entire word
+   arc << leveltime;
+
+   // killough 11/98: save revenant tracer state
+   uint8_t tracerState = (uint8_t)((gametic-basetic) & 255);
+   arc << tracerState;
+
+   arc << dmflags;
+
+   // killough 3/22/98: add Z_CheckHeap after each call to ensure consistency
+   // haleyjd 07/06/09: just Z_CheckHeap after the end. This stuff works by now.
+
+   P_NumberThinkers();    // turn ptrs to numbers
+
+   P_ArchivePlayers(arc);
+   P_ArchiveWorld(arc);
+   P_ArchiveLevelInfo(arc);
+   P_ArchivePolyObjects(arc); // haleyjd 03/27/06
+   P_ArchiveThinkers(arc);
+   P_ArchiveRNG(arc);    // killough 1/18/98: save RNG information
+   P_ArchiveMap(arc);    // killough 1/22/98: save automap information
+   P_ArchiveSoundSequences(arc);
+   P_ArchiveButtons(arc);
+   P_ArchiveACS(arc);            // davidph 05/30/12
+   if(snapshot)
+      P_ArchiveLinkOrder(arc);
+
+   P_DeNumberThinkers();
+
+   uint8_t cmarker = 0xE6; // consistency marker
+   arc << cmarker; 
+}
+
+//============================================================================
+//
+// Background Writer
+//
+// Saving only serializes the game into memory on the game thread. The
+// compression and the file write are left to a background thread, which
+// writes to a temporary file and renames it over the savegame once it is
+// complete, so that a crash or a full disk can't leave a half-written save.
+// The old savegame is only ever replaced, never deleted first; if that
+// fails, the new one is kept in the temporary file.
+//
+
+enum
+{
+   SAVEWRITE_IDLE,
+   SAVEWRITE_BUSY,
+   SAVEWRITE_DONE,
+   SAVEWRITE_FAILED
+};
+
+struct savewrite_t
+{
+   std::thread      thread;
+   std::atomic<int> status;
+   char            *filename;
+   char            *tempname;
+   byte            *data;
+   size_t           size;
+   int              error;    // errno of a failed write
+   bool             kepttemp; // written, but left in tempname
+   bool             quiet;    // no message when done, for hub levels
+};
+
+static savewrite_t savewrite;
+
+//
+// P_writeSaveFile
+//
+// Runs on the writer thread. Must not touch the zone heap or anything else
+// belonging to the game.
+//
+static void P_writeSaveFile()
+{
+   gzFile gz;
+   bool   ok = false;
+
+   errno = 0;
+
+   // level 1 compresses savegames well enough, at a fraction of the cost
+   if((gz = gzopen(savewrite.tempname, "wb1")))
+   {
+      ok = (gzwrite(gz, savewrite.data, unsigned(savewrite.size)) ==
+            int(savewrite.size));
+      if(gzclose(gz) != Z_OK)
+         ok = false;
+   }
+
+   if(!ok)
+   {
+      // only the half-written temporary file goes
+      savewrite.error = errno;
+      remove(savewrite.tempname);
+      savewrite.status = SAVEWRITE_FAILED;
       return;
    }
 
-   // Enable buffered IO exceptions
-   loadfile.setThrowing(true);
+#ifdef _WIN32
+   // Windows won't rename over an existing file, but can replace it
+   errno = 0;
+   ok = !!MoveFileExA(savewrite.tempname, savewrite.filename,
+                      MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH);
+#else
+   ok = !rename(savewrite.tempname, savewrite.filename);
+#endif
 
-   try
+   if(!ok)
    {
-      // skip description
-      char throwaway[SAVESTRINGSIZE];
+      savewrite.error    = errno;
+      savewrite.kepttemp = true;
+   }
 
-      arc.archiveCString(throwaway, SAVESTRINGSIZE);
-      
-      // killough 2/22/98: "proprietary" version string :-)
-      sprintf(vcheck, VERSIONID, version);
+   savewrite.status = ok ? SAVEWRITE_DONE : SAVEWRITE_FAILED;
+}
 
-      arc.archiveCString(vread, VERSIONSIZE);
-   
-      // killough 2/22/98: Friendly savegame version difference message
-      // FIXME/TODO: restore proper version verification
-      if(strncmp(vread, vcheck, VERSIONSIZE))
-         C_Printf(FC_ERROR "Warning: save version mismatch!\a"); // blah...
+//
+// P_FinishSaveWrite
+//
+// Reports a save whose write has finished. If wait is set, waits for one
+// still being written first. Must be called before reading a savegame back.
+//
+void P_FinishSaveWrite(bool wait)
+{
+   int status = savewrite.status;
 
-      // killough 2/14/98: load compatibility mode
-      // haleyjd 06/16/10: reload "inmasterlevels" state
-      int tempskill;
-      arc << compatibility << tempskill << inmanageddir;
+   if(status == SAVEWRITE_IDLE || (status == SAVEWRITE_BUSY && !wait))
+      return;
 
-      gameskill = (skill_t)tempskill;
-  
-      arc << vanilla_mode;  // -vanilla setting
-      if(vanilla_mode)      // use UDoom version (no point for longtics now).
+   savewrite.thread.join();
+
+   if(!savewrite.quiet && savewrite.status == SAVEWRITE_FAILED)
+   {
+      const char *str = savewrite.error ? strerror(savewrite.error) : "Error unknown";
+
+      if(savewrite.kepttemp)
       {
-         // All the other settings (save longtics) are stored in the save
-         demo_version = 109;
-         demo_subversion = 0;
+         doom_printf(FC_ERROR "Could not replace savegame: %s\nNew save kept in %s", str,
+                     savewrite.tempname);
       }
+      else if(savewrite.error)
+         doom_printf("%s", str);
       else
-      {
-         demo_version    = version;    // killough 7/19/98: use this version's id
-         demo_subversion = subversion; // haleyjd 06/17/01
-      }
+         doom_printf(FC_ERROR "Could not save game: %s", str);
+   }
+   else if(!savewrite.quiet)
+      doom_printf("%s", DEH_String("GGSAVED"));  // Ty 03/27/98 - externalized
 
-      // sf: use string rather than episode, map
-      for(i = 0; i < 8; i++)
-      {
-         int8_t lvc;
-         arc << lvc;
-         gamemapname[i] = (char)lvc;
-      }
-      gamemapname[8] = '\0'; // ending NULL
+   efree(savewrite.filename);
+   efree(savewrite.tempname);
+   efree(savewrite.data);
+   savewrite.filename = savewrite.tempname = nullptr;
+   savewrite.data     = nullptr;
+   savewrite.status   = SAVEWRITE_IDLE;
+}
+
+//
+// P_finishSaveWriteAtExit
+//
+static void P_finishSaveWriteAtExit()
+{
+   savewrite.quiet = true;
+   P_FinishSaveWrite(true);
+}
 
-      G_SetGameMap(); // get gameepisode, map
+//
+// P_SaveGameToMemory
+//
+// Serializes the game into a new block of memory, which the caller must
+// free with efree.
+//
+byte *P_SaveGameToMemory(char *description, size_t &size)
+{
+   OutBuffer   savefile;
+   SaveArchive arc(&savefile);
 
-      // start out g_dir pointing at wGlobalDir again
-      g_dir = &wGlobalDir;
+   savefile.createMemory(512*1024, OutBuffer::NENDIAN);
+   P_SaveGameState(arc, description, false);
 
-      // haleyjd 06/16/10: if the level was saved in a map loaded under a managed
-      // directory, we need to restore the managed directory to g_dir when loading
-      // the game here. When this is the case, the file name of the managed directory
-      // has been saved into the save game.
-      size_t len;
-      arc.archiveSize(len);
+   return savefile.releaseMemory(size);
+}
 
-      if(len)
-      {
-         WadDirectory *dir;
-
-         // read a name of len bytes 
-         char *fn = ecalloc(char *, 1, len);
-         arc.archiveCString(fn, len);
-
-         // Try to get an existing managed wad first. If none such exists, try
-         // adding it now. If that doesn't work, the normal error message appears
-         // for a missing wad.
-         // Note: set d_dir as well, so G_InitNew won't overwrite with wGlobalDir!
-         if((dir = W_GetManagedWad(fn)) || (dir = W_AddManagedWad(fn)))
-            g_dir = d_dir = dir;
-
-         // done with temporary file name
-         efree(fn);
-
-         // 11/04/12: Since we loaded a managed directory wad, initialize the
-         // mission. This will take care of any special data loading 
-         // requirements, such as metadata for NR4TL.
-         W_InitManagedMission(inmanageddir);
-      }
+void P_SaveCurrentLevel(char *filename, char *description)
+{
+   static bool atexitset;
+   qstring     tempname(filename);
+
+   // one save at a time, so that two to the same slot land in order
+   P_FinishSaveWrite(true);
+
+   if(!atexitset)
+   {
+      atexit(P_finishSaveWriteAtExit);
+      atexitset = true;
+   }
+
+   tempname += ".tmp";
+
+   savewrite.data     = P_SaveGameToMemory(description, savewrite.size);
+   savewrite.filename = estrdup(filename);
+   savewrite.tempname = tempname.duplicate();
+   savewrite.error    = 0;
+   savewrite.kepttemp = false;
+   savewrite.quiet    = hub_changelevel; // sf: no 'game saved' message for hubs
+   savewrite.status   = SAVEWRITE_BUSY;
+   savewrite.thread   = std::thread(P_writeSaveFile);
+
+   // Check the heap.
+   Z_CheckHeap();
+}
+
+//============================================================================
+// 
+// Loading -- Main Routine
+//
+
+//
+// P_LoadGameState
+//
+// Reads the game state back from an archive written by P_SaveGameState,
+// loading the level first. Buffered IO exceptions are left for the caller.
+//
+void P_LoadGameState(SaveArchive &arc, bool snapshot)
+{
+   int i;
+   char vcheck[VERSIONSIZE], vread[VERSIONSIZE];
+   //uint64_t checksum, rchecksum;
+
+   // skip description
+   char throwaway[SAVESTRINGSIZE];
+
+   arc.archiveCString(throwaway, SAVESTRINGSIZE);
    
-      // killough 3/16/98, 12/98: check lump name checksum
-      // FIXME/TODO: advanced savegame verification is needed
-      /*
-      checksum = G_Signature(g_dir);
+   // killough 2/22/98: "proprietary" version string :-)
+   sprintf(vcheck, VERSIONID, version);
 
-      loadfile.Read(&rchecksum, sizeof(rchecksum));
+   arc.archiveCString(vread, VERSIONSIZE);
 
-      if(memcmp(&checksum, &rchecksum, sizeof checksum))
-      {
-         char *msg = ecalloc(char *, 1, strlen((const char *)(save_p + sizeof checksum)) + 128);
-         strcpy(msg,"Incompatible Savegame!!!\n");
-         if(save_p[sizeof checksum])
-            strcat(strcat(msg,"Wads expected:\n\n"), (char *)(save_p + sizeof checksum));
-         strcat(msg, "\nAre you sure?");
-         C_Puts(msg);
-         G_LoadGameErr(msg);
-         efree(msg);
-         return;
-      }
-      */
+   // killough 2/22/98: Friendly savegame version difference message
+   // FIXME/TODO: restore proper version verification
+   if(strncmp(vread, vcheck, VERSIONSIZE))
+      C_Printf(FC_ERROR "Warning: save version mismatch!\a"); // blah...
 
-      for(i = 0; i < MAXPLAYERS; ++i)
-         arc << playeringame[i];
+   // killough 2/14/98: load compatibility mode
+   // haleyjd 06/16/10: reload "inmasterlevels" state
+   int tempskill;
+   arc << compatibility << tempskill << inmanageddir;
 
-      for(; i < MIN_MAXPLAYERS; i++) // killough 2/28/98
-      {
-         bool dummy = 0;
-         arc << dummy;
-      }
+   gameskill = (skill_t)tempskill;
+  
+   arc << vanilla_mode;  // -vanilla setting
+   if(snapshot)
+   {
+      // snapshots keep the version of the demo being played back, which the
+      // caller has already put back
+   }
+   else if(vanilla_mode) // use UDoom version (no point for longtics now).
+   {
+      // All the other settings (save longtics) are stored in the save
+      demo_version = 109;
+      demo_subversion = 0;
+   }
+   else
+   {
+      demo_version    = version;    // killough 7/19/98: use this version's id
+      demo_subversion = subversion; // haleyjd 06/17/01
+   }
+
+   // sf: use string rather than episode, map
+   for(i = 0; i < 8; i++)
+   {
+      int8_t lvc;
+      arc << lvc;
+      gamemapname[i] = (char)lvc;
+   }
+   gamemapname[8] = '\0'; // ending NULL
+
+   G_SetGameMap(); // get gameepisode, map
+
+   // start out g_dir pointing at wGlobalDir again
+   g_dir = &wGlobalDir;
+
+   // haleyjd 06/16/10: if the level was saved in a map loaded under a managed
+   // directory, we need to restore the managed directory to g_dir when loading
+   // the game here. When this is the case, the file name of the managed directory
+   // has been saved into the save game.
+   size_t len;
+   arc.archiveSize(len);
+
+   if(len)
+   {
+      WadDirectory *dir;
+
+      // read a name of len bytes 
+      char *fn = ecalloc(char *, 1, len);
+      arc.archiveCString(fn, len);
+
+      // Try to get an existing managed wad first. If none such exists, try
+      // adding it now. If that doesn't work, the normal error message appears
+      // for a missing wad.
+      // Note: set d_dir as well, so G_InitNew won't overwrite with wGlobalDir!
+      if((dir = W_GetManagedWad(fn)) || (dir = W_AddManagedWad(fn)))
+         g_dir = d_dir = dir;
+
+      // done with temporary file name
+      efree(fn);
+
+      // 11/04/12: Since we loaded a managed directory wad, initialize the
+      // mission. This will take care of any special data loading 
+      // requirements, such as metadata for NR4TL.
+      W_InitManagedMission(inmanageddir);
+   }
+
+   // killough 3/16/98, 12/98: check lump name checksum
+   // FIXME/TODO: advanced savegame verification is needed
+   /*
+   checksum = G_Signature(g_dir);
+
+   loadfile.Read(&rchecksum, sizeof(rchecksum));
+
+   if(memcmp(&checksum, &rchecksum, sizeof checksum))
+   {
+      char *msg = ecalloc(char *, 1, strlen((const char *)(save_p + sizeof checksum)) + 128);
+      strcpy(msg,"Incompatible Savegame!!!\n");
+      if(save_p[sizeof checksum])
+         strcat(strcat(msg,"Wads expected:\n\n"), (char *)(save_p + sizeof checksum));
+      strcat(msg, "\nAre you sure?");
+      C_Puts(msg);
+      G_LoadGameErr(msg);
+      efree(msg);
+      return;
+   }
+   */
+
+   for(i = 0; i < MAXPLAYERS; ++i)
+      arc << playeringame[i];
+
+   for(; i < MIN_MAXPLAYERS; i++) // killough 2/28/98
+   {
+      bool dummy = 0;
+      arc << dummy;
+   }
 
-      // jff 3/17/98 restore idmus music
-      // jff 3/18/98 account for unsigned byte
-      // killough 11/98: simplify
-      // haleyjd 04/14/03: game type
-      // note: don't set DefaultGameType from save games
-      int tempGameType;
-      arc << idmusnum << tempGameType;
+   // jff 3/17/98 restore idmus music
+   // jff 3/18/98 account for unsigned byte
+   // killough 11/98: simplify
+   // haleyjd 04/14/03: game type
+   // note: don't set DefaultGameType from save games
+   int tempGameType;
+   arc << idmusnum << tempGameType;
 
-      GameType = (gametype_t)tempGameType;
+   GameType = (gametype_t)tempGameType;
 
-      /* cph 2001/05/23 - Must read options before we set up the level */
-      byte options[GAME_OPTION_SIZE];
-      loadfile.read(options, sizeof(options));
+   /* cph 2001/05/23 - Must read options before we set up the level */
+   byte options[GAME_OPTION_SIZE];
+   arc.getLoadFile()->read(options, sizeof(options));
 
-      G_ReadOptions(options);
+   G_ReadOptions(options);
  
-      // load a base level
-      // sf: in hubs, use g_doloadlevel instead of g_initnew
-      if(hub_changelevel)
-         G_DoLoadLevel();
-      else
-         G_InitNew(gameskill, gamemapname);
+   // load a base level
+   // sf: in hubs, use g_doloadlevel instead of g_initnew
+   if(hub_changelevel)
+      G_DoLoadLevel();
+   else
+      G_InitNew(gameskill, gamemapname);
+
+   // killough 3/1/98: Read game options
+   // killough 11/98: move down to here
+
+   // cph - MBF needs to reread the savegame options because 
+   // G_InitNew rereads the WAD options. The demo playback code does 
+   // this too.
+   G_ReadOptions(options);
+
+   // get the times
+   arc << leveltime;
+
+   // killough 11/98: load revenant tracer state
+   uint8_t tracerState;
+   arc << tracerState;
+   basetic = gametic - tracerState;
+
+   // haleyjd 04/14/03: load dmflags
+   arc << dmflags;
+
+   // dearchive all the modifications
+   P_ArchivePlayers(arc);
+   P_ArchiveWorld(arc);
+   P_ArchiveLevelInfo(arc);
+   P_ArchivePolyObjects(arc);    // haleyjd 03/27/06
+   P_ArchiveThinkers(arc);
+   P_ArchiveRNG(arc);            // killough 1/18/98: load RNG information
+   P_ArchiveMap(arc);            // killough 1/22/98: load automap information
+   P_UnArchiveSoundSequences(arc);
+   P_ArchiveButtons(arc);
+   P_ArchiveACS(arc);            // davidph 05/30/12
+   if(snapshot)
+      P_ArchiveLinkOrder(arc);
+
+   P_FreeThinkerTable();
+
+   uint8_t cmarker;
+   arc << cmarker;
+   if(cmarker != 0xE6)
+      I_Error("Bad savegame: last byte is 0x%x\n", cmarker);
+
+   // haleyjd: move up Z_CheckHeap to before Z_Free (safer)
+   Z_CheckHeap(); 
+}
 
-      // killough 3/1/98: Read game options
-      // killough 11/98: move down to here
-   
-      // cph - MBF needs to reread the savegame options because 
-      // G_InitNew rereads the WAD options. The demo playback code does 
-      // this too.
-      G_ReadOptions(options);
-
-      // get the times
-      arc << leveltime;
-
-      // killough 11/98: load revenant tracer state
-      uint8_t tracerState;
-      arc << tracerState;
-      basetic = gametic - tracerState;
-
-      // haleyjd 04/14/03: load dmflags
-      arc << dmflags;
-
-      // dearchive all the modifications
-      P_ArchivePlayers(arc);
-      P_ArchiveWorld(arc);
-      P_ArchiveLevelInfo(arc);
-      P_ArchivePolyObjects(arc);    // haleyjd 03/27/06
-      P_ArchiveThinkers(arc);
-      P_ArchiveRNG(arc);            // killough 1/18/98: load RNG information
-      P_ArchiveMap(arc);            // killough 1/22/98: load automap information
-      P_UnArchiveSoundSequences(arc);
-      P_ArchiveButtons(arc);
-      P_ArchiveACS(arc);            // davidph 05/30/12
-
-      P_FreeThinkerTable();
-
-      uint8_t cmarker;
-      arc << cmarker;
-      if(cmarker != 0xE6)
-         I_Error("Bad savegame: last byte is 0x%x\n", cmarker);
-
-      // haleyjd: move up Z_CheckHeap to before Z_Free (safer)
-      Z_CheckHeap(); 
+//
+// P_loadGameFrom
+//
+// Loads a game from an opened buffer and wakes everything up again.
+//
+static void P_loadGameFrom(InBuffer &loadfile)
+{
+   SaveArchive arc(&loadfile);
+
+   // Enable buffered IO exceptions
+   loadfile.setThrowing(true);
+
+   try
+   {
+      P_LoadGameState(arc, false);
    }
    catch(...)
    {
@@ -1633,6 +2153,37 @@ void P_LoadGame(const char *filename)
       P_RestorePlayerPosition();
 }
 
+void P_LoadGame(const char *filename)
+{
+   InBuffer loadfile;
+
+   // the file may still be being written
+   P_FinishSaveWrite(true);
+
+   // reads both compressed and old uncompressed saves
+   if(!loadfile.openCompressed(filename, InBuffer::NENDIAN))
+   {
+      C_Printf(FC_ERROR "Failed to load savegame %s\n", filename);
+      C_SetConsole();
+      return;
+   }
+
+   P_loadGameFrom(loadfile);
+}
+
+//
+// P_LoadGameFromMemory
+//
+// Loads a game from uncompressed data written by P_SaveGameToMemory.
+//
+void P_LoadGameFromMemory(const byte *data, size_t size)
+{
+   InBuffer loadfile;
+
+   loadfile.openMemory(data, size, InBuffer::NENDIAN);
+   P_loadGameFrom(loadfile);
+}
+
 //----------------------------------------------------------------------------
 //
 // $Log: p_saveg.c,v $
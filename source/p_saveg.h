@@ -113,8 +113,16 @@ Thinker *P_ThinkerForNum(unsigned int n);
 void P_SetNewTarget(Mobj **mop, Mobj *targ);
 
 void P_SaveCurrentLevel(char *filename, char *description);
+void P_FinishSaveWrite(bool wait);
 void P_LoadGame(const char *filename);
 
+byte *P_SaveGameToMemory(char *description, size_t &size);
+void  P_LoadGameFromMemory(const byte *data, size_t size);
+
+// game state to and from any archive, for in-memory snapshots
+void P_SaveGameState(SaveArchive &arc, char *description, bool snapshot);
+void P_LoadGameState(SaveArchive &arc, bool snapshot);
+
 #endif
 
 //----------------------------------------------------------------------------
@@ -178,6 +178,27 @@ void ScrollThinker::serialize(SaveArchive &arc)
       addScroller();
 }
 
+//
+// ScrollThinker::isIsolated
+//
+// Texture scrollers only move the offsets of their own side or sector.
+// Carrying scrollers push things around, and stay in list order.
+//
+bool ScrollThinker::isIsolated() const
+{
+   return type == sc_side || type == sc_floor || type == sc_ceiling;
+}
+
+//
+// ScrollThinker::isolationKey
+//
+// Sides are keyed after all sectors, so the two never share a key.
+//
+int ScrollThinker::isolationKey() const
+{
+   return type == sc_side ? numsectors + affectee : affectee;
+}
+
 //
 // Adds a scroll thinker to the list
 //
@@ -43,6 +43,8 @@ protected:
 public:
    // Overridden Methods
    virtual void serialize(SaveArchive &arc) override;
+   virtual bool isIsolated() const override;
+   virtual int  isolationKey() const override;
 
    // Methods
    void addScroller();
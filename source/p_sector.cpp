@@ -47,6 +47,16 @@
 
 IMPLEMENT_THINKER_TYPE(SectorThinker)
 
+//
+// SectorThinker::isolationKey
+//
+// Isolated sector effects are keyed on their sector.
+//
+int SectorThinker::isolationKey() const
+{
+   return int(sector - sectors);
+}
+
 //
 // SectorThinker::serialize
 //
@@ -228,24 +238,49 @@ int EV_SectorSoundChange(int tag, int sndSeqID)
 // Sector Interpolation
 //
 
+//
+// P_MarkSectorMoved
+//
+// Lists a sector whose floor or ceiling height has just changed. Only the
+// listed sectors can differ from their saved positions, so they are all
+// that interpolation and P_SaveSectorPositions need to look at.
+//
+void P_MarkSectorMoved(const sector_t &sec)
+{
+   if(!movedsectors) // not set up yet for this level
+      return;
+
+   int   secnum = eindex(&sec - sectors);
+   auto &si     = sectorinterps[secnum];
+
+   if(!si.moved)
+   {
+      si.moved = true;
+      movedsectors[nummovedsectors++] = secnum;
+   }
+}
+
 //
 // P_SaveSectorPositions
 //
 // Backup current sector floor and ceiling heights to the sector interpolation
-// structures at the beginning of a frame.
+// structures at the beginning of a frame. Sectors that haven't moved since
+// the last save still hold their saved heights and are skipped.
 //
 void P_SaveSectorPositions()
 {
-   for(int i = 0; i < numsectors; i++)
+   for(int i = 0; i < nummovedsectors; i++)
    {
-      auto &si  = sectorinterps[i];
-      auto &sec = sectors[i];
+      auto &si  = sectorinterps[movedsectors[i]];
+      auto &sec = sectors[movedsectors[i]];
 
       si.prevfloorheight    = sec.floorheight;
       si.prevfloorheightf   = sec.floorheightf;
       si.prevceilingheight  = sec.ceilingheight;
       si.prevceilingheightf = sec.ceilingheightf;
+      si.moved = false;
    }
+   nummovedsectors = 0;
 }
 
 //
@@ -29,6 +29,7 @@
 class Mobj;
 struct sector_t;
 
+void P_MarkSectorMoved(const sector_t &sec);
 void P_SaveSectorPositions();
 void P_SaveSectorPosition(const sector_t &sec);
 void P_SetSectorZoneFromMobj(Mobj *actor);
@@ -29,6 +29,7 @@
 
 #include "a_small.h"
 #include "acs_intr.h"
+#include "am_index.h"
 #include "am_map.h"
 #include "c_io.h"
 #include "c_runcmd.h"
@@ -50,22 +51,30 @@
 #include "m_argv.h"
 #include "m_bbox.h"
 #include "m_binary.h"
+#include "m_compare.h"
+#include "m_parallel.h"
 #include "p_anim.h"  // haleyjd: lightning
 #include "p_chase.h"
 #include "p_enemy.h"
 #include "p_hubs.h"
 #include "p_info.h"
+#include "p_levelcache.h"
 #include "p_maputl.h"
 #include "p_map.h"
 #include "p_mobjcol.h"
+#include "p_mobjpool.h"
+#include "p_nodebuild.h"
 #include "p_partcl.h"
 #include "p_portal.h"
+#include "p_reject.h"
 #include "p_scroll.h"
 #include "p_setup.h"
 #include "p_skin.h"
 #include "p_slopes.h"
 #include "p_spec.h"
+#include "p_thinkprof.h"
 #include "p_tick.h"
+#include "p_visit.h"
 #include "polyobj.h"
 #include "r_data.h"
 #include "r_defs.h"
@@ -81,6 +90,7 @@
 #include "w_levels.h"
 #include "w_wad.h"
 #include "z_auto.h"
+#include "../zlib/zlib.h"
 
 extern const char *level_error;
 extern void R_DynaSegOffset(seg_t *lseg, const line_t *line, int side);
@@ -108,6 +118,7 @@ enum ZNodeType
    ZNodeType_GL,
    ZNodeType_GL2,
    ZNodeType_GL3,
+   ZNodeType_Built, // XNOD segs with XGL3 partitions, from P_BuildNodes
 };
 
 //
@@ -122,6 +133,11 @@ char     levelmapname[10];
 int      numvertexes;
 vertex_t *vertexes;
 
+// lines using each vertex: those of vertex i are vertexlines[vertexlineoffs[i]]
+// up to vertexlines[vertexlineoffs[i + 1]]
+int      *vertexlineoffs;
+line_t   **vertexlines;
+
 int      numsegs;
 seg_t    *segs;
 
@@ -131,6 +147,10 @@ sector_t *sectors;
 // haleyjd 01/05/14: sector interpolation data
 sectorinterp_t *sectorinterps;
 
+// sectors whose heights changed since their positions were last saved
+int *movedsectors;
+int  nummovedsectors;
+
 // ioanch: list of sector bounding boxes for sector portal seg rejection (coarse)
 // length: numsectors * 4
 sectorbox_t *pSectorBoxes;
@@ -173,7 +193,7 @@ int       *blockmaplump;          // was short -- killough
 
 fixed_t   bmaporgx, bmaporgy;     // origin of block map
 
-Mobj    **blocklinks;             // for thing chains
+blockcell_t *blockthings;         // for things in each block
 
 byte     *portalmap;              // haleyjd: for portals
 
@@ -721,6 +741,10 @@ static void P_CreateSectorInterps()
 {
    sectorinterps = estructalloctag(sectorinterp_t, numsectors, PU_LEVEL);
 
+   movedsectors = (int *)(Z_Malloc(emax(numsectors, 1) * sizeof(int), PU_LEVEL,
+                                   (void **)&movedsectors));
+   nummovedsectors = 0;
+
    for(int i = 0; i < numsectors; i++)
    {
       sectorinterps[i].prevfloorheight    = sectors[i].floorheight;
@@ -733,10 +757,10 @@ static void P_CreateSectorInterps()
 //
 // Setup sector bounding boxes
 //
+// pSectorBoxes must already be allocated, since this runs as a setup job.
+//
 static void P_createSectorBoundingBoxes()
 {
-   pSectorBoxes = estructalloctag(sectorbox_t, numsectors, PU_LEVEL);
-
    for(int i = 0; i < numsectors; ++i)
    {
       const sector_t &sector = sectors[i];
@@ -754,33 +778,42 @@ static void P_createSectorBoundingBoxes()
 //
 // P_propagateSoundZone
 //
-// haleyjd 01/12/14: Recursive routine to propagate a sound zone from a
-// sector to all its neighboring sectors which border it by a 2S line which
-// is not marked as a sound boundary.
+// haleyjd 01/12/14: Routine to propagate a sound zone from a sector to all
+// its neighboring sectors which border it by a 2S line which is not marked
+// as a sound boundary. Uses an explicit stack of at least numsectors entries
+// rather than recursion, as this may run on a worker thread whose stack is
+// too small for one call per sector in a long chain.
 //
-static void P_propagateSoundZone(sector_t *sector, int zoneid)
+static void P_propagateSoundZone(sector_t *sector, int zoneid, sector_t **stack)
 {
-   // if we already touched this sector somehow, return immediately
-   if(sector->soundzone == zoneid)
-      return;
+   int top = 0;
 
-   // set the zone to the sector
+   // a sector gets its zone when pushed, so none is pushed twice
    sector->soundzone = zoneid;
+   stack[top++] = sector;
 
-   // iterate on the sector linedef list to find neighboring sectors
-   for(int ln = 0; ln < sector->linecount; ln++)
+   while(top)
    {
-      auto line = sector->lines[ln];
+      sector = stack[--top];
 
-      // must be 2S and not a zone boundary line
-      if(!line->backsector || (line->extflags & EX_ML_ZONEBOUNDARY))
-         continue;
+      // iterate on the sector linedef list to find neighboring sectors
+      for(int ln = 0; ln < sector->linecount; ln++)
+      {
+         auto line = sector->lines[ln];
+
+         // must be 2S and not a zone boundary line
+         if(!line->backsector || (line->extflags & EX_ML_ZONEBOUNDARY))
+            continue;
 
-      auto next = ((line->backsector != sector) ? line->backsector : line->frontsector);
+         auto next = ((line->backsector != sector) ? line->backsector : line->frontsector);
 
-      // if not already in the same sound zone, propagate recursively.
-      if(next->soundzone != zoneid)
-         P_propagateSoundZone(next, zoneid);
+         // if not already in the same sound zone, propagate to it
+         if(next->soundzone != zoneid)
+         {
+            next->soundzone = zoneid;
+            stack[top++] = next;
+         }
+      }
    }
 }
 
@@ -790,7 +823,7 @@ static void P_propagateSoundZone(sector_t *sector, int zoneid)
 // haleyjd 01/12/14: create sound environment zones for the map by using an
 // alert-like propagation method.
 //
-static void P_CreateSoundZones()
+static void P_CreateSoundZones(sector_t **stack)
 {
    numsoundzones = 0;
 
@@ -800,9 +833,18 @@ static void P_CreateSoundZones()
       
       // if the sector hasn't become part of a zone yet, do propagation for it
       if(sec->soundzone == -1)
-         P_propagateSoundZone(sec, numsoundzones++);
+         P_propagateSoundZone(sec, numsoundzones++, stack);
    }
+}
 
+//
+// P_InitSoundZones
+//
+// Allocates the soundzones found by P_CreateSoundZones or read from the
+// level cache.
+//
+static void P_InitSoundZones()
+{
    // allocate soundzones
    soundzones = estructalloctag(soundzone_t, numsoundzones, PU_LEVEL);
    
@@ -822,40 +864,34 @@ static void P_CreateSoundZones()
 // haleyjd 06/14/10: Separated from P_LoadNodes, this routine precalculates
 // general line equation coefficients for a node, which are used during the
 // process of dynaseg generation.
+// Works from the fixed-point partition line, so it serves every node format,
+// including high-resolution XGL3 nodes.
 //
-static void P_CalcNodeCoefficients(node_t *node, fnode_t *fnode)
+static void P_CalcNodeCoefficients(const node_t &node, fnode_t &fnode)
 {
    // haleyjd 05/16/08: keep floating point versions as well for dynamic
    // seg splitting operations
-   fnode->fx  = (double)node->x;
-   fnode->fy  = (double)node->y;
-   fnode->fdx = (double)node->dx;
-   fnode->fdy = (double)node->dy;
+   fnode.fx  = M_FixedToDouble(node.x);
+   fnode.fy  = M_FixedToDouble(node.y);
+   fnode.fdx = M_FixedToDouble(node.dx);
+   fnode.fdy = M_FixedToDouble(node.dy);
 
    // haleyjd 05/20/08: precalculate general line equation coefficients
-   fnode->a   = -fnode->fdy;
-   fnode->b   =  fnode->fdx;
-   fnode->c   =  fnode->fdy * fnode->fx - fnode->fdx * fnode->fy;
-   fnode->len = sqrt(fnode->fdx * fnode->fdx + fnode->fdy * fnode->fdy);
+   fnode.a   = -fnode.fdy;
+   fnode.b   =  fnode.fdx;
+   fnode.c   =  fnode.fdy * fnode.fx - fnode.fdx * fnode.fy;
+   fnode.len = sqrt(fnode.fdx * fnode.fdx + fnode.fdy * fnode.fdy);
 }
 
 //
-// P_CalcNodeCoefficients2
+// P_CalcAllNodeCoefficients
 //
-// IOANCH 20151217: high-resolution nodes (from XGL3 ZDBSP nodes)
+// Fills in fnodes once the nodes are loaded, whatever format they came in.
 //
-static void P_CalcNodeCoefficients2(const node_t &node, fnode_t &fnode)
+static void P_CalcAllNodeCoefficients()
 {
-   fnode.fx = M_FixedToDouble(node.x);
-   fnode.fy = M_FixedToDouble(node.y);
-   fnode.fdx = M_FixedToDouble(node.dx);
-   fnode.fdy = M_FixedToDouble(node.dy);
-   
-   // IOANCH: same as code above
-   fnode.a   = -fnode.fdy;
-   fnode.b   =  fnode.fdx;
-   fnode.c   =  fnode.fdy * fnode.fx - fnode.fdx * fnode.fy;
-   fnode.len = sqrt(fnode.fdx * fnode.fdx + fnode.fdy * fnode.fdy);
+   for(int i = 0; i < numnodes; i++)
+      P_CalcNodeCoefficients(nodes[i], fnodes[i]);
 }
 
 //
@@ -900,9 +936,6 @@ static void P_LoadNodes(int lump)
       no->dx = SwapShort(mn->dx);
       no->dy = SwapShort(mn->dy);
 
-      // haleyjd: calculate floating-point data
-      P_CalcNodeCoefficients(no, &fnodes[i]);
-
       no->x  <<= FRACBITS;
       no->y  <<= FRACBITS;
       no->dx <<= FRACBITS;
@@ -964,9 +997,6 @@ static void P_LoadNodes_V4(int lump)
       no->dx = SwapShort(mn->dx);
       no->dy = SwapShort(mn->dy);
 
-      // haleyjd: calculate floating-point data
-      P_CalcNodeCoefficients(no, &fnodes[i]);
-
       no->x  <<= FRACBITS;
       no->y  <<= FRACBITS;
       no->dx <<= FRACBITS;
@@ -1007,20 +1037,22 @@ static bool P_CheckForDeePBSPv4Nodes(int lumpnum)
 //=============================================================================
 //
 // haleyjd 06/14/10: ZDoom uncompressed nodes support
+// Compressed nodes are read as well, inflating them as they are loaded.
 //
 
 //
-// P_CheckForZDoomUncompressedNodes
+// P_CheckForZDoomNodes
 //
 // http://zdoom.org/wiki/ZDBSP#Compressed_Nodes
 // IOANCH 20151213: modified to use the NODES lump num and return the signature
 // Also added actual node lump, if it's SSECTORS in a classic map
+// Sets *compressed for the ZNOD, ZGLN, ZGL2 and ZGL3 signatures.
 //
-static ZNodeType P_CheckForZDoomUncompressedNodes(int nodelumpnum, 
-                                                  int *actualNodeLump, 
-                                                  bool udmf)
+static ZNodeType P_CheckForZDoomNodes(int nodelumpnum, int *actualNodeLump, 
+                                      bool udmf, bool *compressed)
 {
-   const void *data;
+   const char *data;
+   const char *kind;
    
    *actualNodeLump = nodelumpnum;
    bool glNodesFallback = false;
@@ -1041,31 +1073,37 @@ static ZNodeType P_CheckForZDoomUncompressedNodes(int nodelumpnum,
    }
 
    // haleyjd: load at PU_CACHE and it may stick around for later.
-   data = setupwad->cacheLumpNum(*actualNodeLump, PU_CACHE);
+   data = static_cast<const char *>(setupwad->cacheLumpNum(*actualNodeLump, PU_CACHE));
 
-   if(!udmf && !glNodesFallback && !memcmp(data, "XNOD", 4))
+   // X signatures are uncompressed, Z ones are the same data deflated
+   if(data[0] != 'X' && data[0] != 'Z')
+      return ZNodeType_Invalid;
+   *compressed = data[0] == 'Z';
+   kind = *compressed ? "compressed" : "uncompressed";
+
+   if(!udmf && !glNodesFallback && !memcmp(data + 1, "NOD", 3))
    {
       // only classic maps with NODES having XNOD
-      C_Printf("ZDoom uncompressed normal nodes detected\n");
+      C_Printf("ZDoom %s normal nodes detected\n", kind);
       return ZNodeType_Normal;
    }
 
 
    if(glNodesFallback || udmf)
    {
-      if(!memcmp(data, "XGLN", 4))
+      if(!memcmp(data + 1, "GLN", 3))
       {
-         C_Printf("ZDoom uncompressed GL nodes version 1 detected\n");
+         C_Printf("ZDoom %s GL nodes version 1 detected\n", kind);
          return ZNodeType_GL;
       }
-      if(!memcmp(data, "XGL2", 4))
+      if(!memcmp(data + 1, "GL2", 3))
       {
-         C_Printf("ZDoom uncompressed GL nodes version 2 detected\n");
+         C_Printf("ZDoom %s GL nodes version 2 detected\n", kind);
          return ZNodeType_GL2;
       }
-      if(!memcmp(data, "XGL3", 4))
+      if(!memcmp(data + 1, "GL3", 3))
       {
-         C_Printf("ZDoom uncompressed GL nodes version 3 detected\n");
+         C_Printf("ZDoom %s GL nodes version 3 detected\n", kind);
          return ZNodeType_GL3;
       }
    }
@@ -1074,17 +1112,207 @@ static ZNodeType P_CheckForZDoomUncompressedNodes(int nodelumpnum,
    return ZNodeType_Invalid;
 }
 
+// Compressed nodes are inflated through a window of this size
+#define ZNODE_WINDOW 16384
+
+// Deflate never expands a byte of input into more than this many bytes
+#define ZNODE_MAXRATIO 1032
+
+//
+// ZNodeStream
+//
+// Reads the body of a ZDoom nodes lump, after its signature. Uncompressed
+// nodes are read straight from the cached lump. Compressed ones are inflated
+// a window at a time as they are read, so that there's never a complete
+// decompressed copy of them in memory. Nodes built by P_BuildNodes are read
+// from the buffer they were built in.
+//
+// Reading past the end returns zeroes and sets level_error.
+//
+class ZNodeStream
+{
+public:
+   ZNodeStream(int lump, bool compressed);
+   ZNodeStream(byte *buffer, size_t length);
+   ~ZNodeStream();
+
+   bool has(size_t count);
+
+   byte readByte()
+   {
+      byte *data = get(1);
+      return data ? *data : 0;
+   }
+   int16_t readWord()
+   {
+      byte *data = get(2);
+      return data ? GetBinaryWord(&data) : 0;
+   }
+   uint16_t readUWord()
+   {
+      byte *data = get(2);
+      return data ? GetBinaryUWord(&data) : 0;
+   }
+   int32_t readDWord()
+   {
+      byte *data = get(4);
+      return data ? GetBinaryDWord(&data) : 0;
+   }
+   uint32_t readUDWord()
+   {
+      byte *data = get(4);
+      return data ? GetBinaryUDWord(&data) : 0;
+   }
+
+private:
+   byte    *lumpptr;
+   byte    *pos;       // next unread byte
+   byte    *end;       // end of the lump, or of the inflated part of the window
+   byte    *window;    // only for compressed nodes
+   z_stream zstream;
+   bool     finished;  // inflated to the end of the stream
+
+   byte *get(size_t count)
+   {
+      if(size_t(end - pos) < count && !refill(count))
+         return nullptr;
+
+      byte *data = pos;
+      pos += count;
+      return data;
+   }
+
+   bool refill(size_t count);
+   void fail(const char *message);
+};
+
+//
+// ZNodeStream::ZNodeStream
+//
+ZNodeStream::ZNodeStream(int lump, bool compressed) : window(NULL), finished(true)
+{
+   lumpptr = static_cast<byte *>(setupwad->cacheLumpNum(lump, PU_STATIC));
+
+   // skip header
+   pos = lumpptr + 4;
+   end = lumpptr + setupwad->lumpLength(lump);
+
+   if(compressed)
+   {
+      memset(&zstream, 0, sizeof(zstream));
+      zstream.next_in  = pos;
+      zstream.avail_in = uInt(end - pos);
+
+      window   = ecalloc(byte *, 1, ZNODE_WINDOW);
+      pos      = end = window;
+      finished = false;
+
+      if(inflateInit(&zstream) != Z_OK)
+         fail("Could not inflate compressed ZDoom nodes");
+   }
+}
+
+//
+// ZNodeStream::ZNodeStream
+//
+// Takes over an uncompressed nodes lump in memory, which must have come from
+// the zone heap.
+//
+ZNodeStream::ZNodeStream(byte *buffer, size_t length)
+   : lumpptr(buffer), window(NULL), finished(true)
+{
+   // skip header
+   pos = lumpptr + 4;
+   end = lumpptr + length;
+}
+
+//
+// ZNodeStream::~ZNodeStream
+//
+ZNodeStream::~ZNodeStream()
+{
+   if(window)
+   {
+      inflateEnd(&zstream);
+      efree(window);
+   }
+   Z_Free(lumpptr);
+}
+
+//
+// ZNodeStream::fail
+//
+// Flags an error, keeping the first one if there's more.
+//
+void ZNodeStream::fail(const char *message)
+{
+   if(!level_error)
+      level_error = message;
+   finished = true;
+   pos = end;
+}
+
 //
-// CheckZNodesOverflow
+// ZNodeStream::has
 //
-// For safe reading of ZDoom nodes lump.
+// Checks that count more bytes can be there, which is done before trusting
+// a count from the lump with an allocation. This is exact for uncompressed
+// nodes. For compressed ones it's only a bound from what input is left.
 //
-static void CheckZNodesOverflowFN(int *size, int count)
+bool ZNodeStream::has(size_t count)
 {
-   (*size) -= count;
+   uint64_t avail = uint64_t(end - pos);
 
-   if((*size) < 0)
-      level_error = "Overflow in ZDoom XNOD lump";
+   if(!finished)
+      avail += uint64_t(zstream.avail_in) * ZNODE_MAXRATIO + ZNODE_WINDOW;
+
+   if(count > avail || level_error)
+   {
+      fail("Overflow in ZDoom nodes lump");
+      return false;
+   }
+   return true;
+}
+
+//
+// ZNodeStream::refill
+//
+// Moves what's left of the window to its start and inflates behind it until
+// there are at least count bytes to read.
+//
+bool ZNodeStream::refill(size_t count)
+{
+   if(!finished && count <= ZNODE_WINDOW)
+   {
+      size_t left = size_t(end - pos);
+
+      memmove(window, pos, left);
+      pos = window;
+      end = window + left;
+
+      while(size_t(end - pos) < count && !finished)
+      {
+         zstream.next_out  = end;
+         zstream.avail_out = uInt(window + ZNODE_WINDOW - end);
+
+         int result = inflate(&zstream, Z_SYNC_FLUSH);
+         end = zstream.next_out;
+
+         if(result == Z_STREAM_END)
+            finished = true;
+         else if(result != Z_OK)
+         {
+            fail("Malformed compressed ZDoom nodes");
+            return false;
+         }
+      }
+
+      if(size_t(end - pos) >= count)
+         return true;
+   }
+
+   fail("Overflow in ZDoom nodes lump");
+   return false;
 }
 
 // IOANCH 20151217: updated for XGLN and XGL2
@@ -1129,10 +1357,10 @@ typedef struct mapnode_znod_s
 //
 // P_LoadZSegs
 //
-// Loads segs from ZDoom uncompressed nodes
+// Loads segs from ZDoom nodes
 // IOANCH 20151217: use signature
 //
-static void P_LoadZSegs(byte *data, ZNodeType signature)
+static void P_LoadZSegs(ZNodeStream &data, ZNodeType signature)
 {
    // IOANCH TODO: read the segs according to signature
    int i;
@@ -1166,9 +1394,9 @@ static void P_LoadZSegs(byte *data, ZNodeType signature)
       }
 
       // haleyjd: FIXME - see no verification of vertex indices
-      v1 = ml.v1 = GetBinaryUDWord(&data);
+      v1 = ml.v1 = data.readUDWord();
       if(signature == ZNodeType_Normal)   // IOANCH: only set directly for nonGL
-         v2 = ml.v2 = GetBinaryUDWord(&data);
+         v2 = ml.v2 = data.readUDWord();
       else
       {
          if(actualSegIndex == ss->firstline && !firstV1) // only set it once
@@ -1181,15 +1409,15 @@ static void P_LoadZSegs(byte *data, ZNodeType signature)
             prevSegToSet = nullptr;   // consume it
          }
          
-         ml.partner = GetBinaryUDWord(&data);   // IOANCH: not used in EE
+         ml.partner = data.readUDWord();   // IOANCH: not used in EE
       }
       
       // IOANCH
       if(signature == ZNodeType_Normal || signature == ZNodeType_GL)
-         ml.linedef = GetBinaryUWord(&data);
+         ml.linedef = data.readUWord();
       else
-         ml.linedef = GetBinaryUDWord(&data);
-      ml.side    = *data++;
+         ml.linedef = data.readUDWord();
+      ml.side    = data.readByte();
       
       if((signature == ZNodeType_GL && ml.linedef == 0xffff)
          || ((signature == ZNodeType_GL2 || signature == ZNodeType_GL3) 
@@ -1251,27 +1479,21 @@ static void P_LoadZSegs(byte *data, ZNodeType signature)
    ::numsegs = actualSegIndex;
 }
 
-#define CheckZNodesOverflow(size, count) \
-   CheckZNodesOverflowFN(&(size), (count)); \
-   if(level_error) \
-   { \
-      Z_Free(lumpptr); \
-      return; \
-   }
+#define CheckZNodesOverflow(data, count) \
+   if(!(data).has(count)) \
+      return
 
 //
 // P_LoadZNodes
 //
-// Loads ZDoom uncompressed nodes.
+// Loads ZDoom nodes, compressed or not.
 // IOANCH 20151217: check signature and use different gl nodes if needed
 // ioanch: 20151221: fixed some memory leaks. Also moved the bounds checks 
 // before attempting to allocate memory, so the app won't terminate.
 //
-static void P_LoadZNodes(int lump, ZNodeType signature)
+static void P_LoadZNodes(ZNodeStream &data, ZNodeType signature)
 {
-   byte *data, *lumpptr;
    unsigned int i;
-   int len;
 
    uint32_t orgVerts, newVerts;
    uint32_t numSubs, currSeg;
@@ -1279,22 +1501,15 @@ static void P_LoadZNodes(int lump, ZNodeType signature)
    uint32_t numNodes;
    vertex_t *newvertarray = NULL;
 
-   data = lumpptr = (byte *)(setupwad->cacheLumpNum(lump, PU_STATIC));
-   len  = setupwad->lumpLength(lump);
-
-   // skip header
-   CheckZNodesOverflow(len, 4);
-   data += 4;
-
    // Read extra vertices added during node building
-   CheckZNodesOverflow(len, sizeof(orgVerts));  
-   orgVerts = GetBinaryUDWord(&data);
+   CheckZNodesOverflow(data, sizeof(orgVerts));  
+   orgVerts = data.readUDWord();
 
-   CheckZNodesOverflow(len, sizeof(newVerts));
-   newVerts = GetBinaryUDWord(&data);
+   CheckZNodesOverflow(data, sizeof(newVerts));
+   newVerts = data.readUDWord();
 
    // ioanch: moved before the potential allocation
-   CheckZNodesOverflow(len, newVerts * 2 * sizeof(int32_t));
+   CheckZNodesOverflow(data, newVerts * 2 * sizeof(int32_t));
    if(orgVerts + newVerts == (unsigned int)numvertexes)
    {
       newvertarray = vertexes;
@@ -1310,8 +1525,8 @@ static void P_LoadZNodes(int lump, ZNodeType signature)
    {
       int vindex = i + orgVerts;
 
-      newvertarray[vindex].x = (fixed_t)GetBinaryDWord(&data);
-      newvertarray[vindex].y = (fixed_t)GetBinaryDWord(&data);
+      newvertarray[vindex].x = (fixed_t)data.readDWord();
+      newvertarray[vindex].y = (fixed_t)data.readDWord();
 
       // SoM: Cardboard stores float versions of vertices.
       newvertarray[vindex].fx = M_FixedToFloat(newvertarray[vindex].x);
@@ -1332,61 +1547,61 @@ static void P_LoadZNodes(int lump, ZNodeType signature)
    }
 
    // Read the subsectors
-   CheckZNodesOverflow(len, sizeof(numSubs));
-   numSubs = GetBinaryUDWord(&data);
+   CheckZNodesOverflow(data, sizeof(numSubs));
+   numSubs = data.readUDWord();
 
    numsubsectors = (int)numSubs;
    if(numsubsectors <= 0)
    {
       level_error = "no subsectors in level";
-      Z_Free(lumpptr);
       return;
    }
 
-   CheckZNodesOverflow(len, numSubs * sizeof(uint32_t));
+   CheckZNodesOverflow(data, numSubs * sizeof(uint32_t));
    subsectors = estructalloctag(subsector_t, numsubsectors, PU_LEVEL);
 
    for(i = currSeg = 0; i < numSubs; i++)
    {
       subsectors[i].firstline = (int)currSeg;
-      subsectors[i].numlines  = (int)(GetBinaryUDWord(&data));
+      subsectors[i].numlines  = (int)(data.readUDWord());
       currSeg += subsectors[i].numlines;
    }
 
    // Read the segs
-   CheckZNodesOverflow(len, sizeof(numSegs));
-   numSegs = GetBinaryUDWord(&data);
+   CheckZNodesOverflow(data, sizeof(numSegs));
+   numSegs = data.readUDWord();
 
    // The number of segs stored should match the number of
    // segs used by subsectors.
    if(numSegs != currSeg)
    {
       level_error = "incorrect number of segs in nodes";
-      Z_Free(lumpptr);
       return;
    }
 
    numsegs = (int)numSegs;
 
+   // built nodes have the segs of normal ones
+   ZNodeType segtype = signature == ZNodeType_Built ? ZNodeType_Normal : signature;
+
    // IOANCH 20151217: set reading size
    int totalSegSize;
-   if(signature == ZNodeType_Normal || signature == ZNodeType_GL)
+   if(segtype == ZNodeType_Normal || segtype == ZNodeType_GL)
       totalSegSize = numsegs * 11; // haleyjd: hardcoded original structure size
    else
       totalSegSize = numsegs * 13; // IOANCH: DWORD linedef
    
-   CheckZNodesOverflow(len, totalSegSize);
+   CheckZNodesOverflow(data, totalSegSize);
    segs = estructalloctag(seg_t, numsegs, PU_LEVEL);
-   P_LoadZSegs(data, signature);
-   
-   data += totalSegSize;
+   P_LoadZSegs(data, segtype);
    
    // Read nodes
-   CheckZNodesOverflow(len, sizeof(numNodes));
-   numNodes = GetBinaryUDWord(&data);
+   CheckZNodesOverflow(data, sizeof(numNodes));
+   numNodes = data.readUDWord();
 
    numnodes = numNodes;
-   CheckZNodesOverflow(len, numNodes * 32);
+   bool fixedparts = (signature == ZNodeType_GL3 || signature == ZNodeType_Built);
+   CheckZNodesOverflow(data, numNodes * (fixedparts ? 40 : 32));
    nodes  = estructalloctag(node_t,  numNodes, PU_LEVEL);
    fnodes = estructalloctag(fnode_t, numNodes, PU_LEVEL);
 
@@ -1396,36 +1611,34 @@ static void P_LoadZNodes(int lump, ZNodeType signature)
       node_t *no = nodes + i;
       mapnode_znod_t mn;
 
-      if(signature == ZNodeType_GL3)
+      if(fixedparts)
       {
-         mn.x32  = GetBinaryDWord(&data);
-         mn.y32  = GetBinaryDWord(&data);
-         mn.dx32 = GetBinaryDWord(&data);
-         mn.dy32 = GetBinaryDWord(&data);
+         mn.x32  = data.readDWord();
+         mn.y32  = data.readDWord();
+         mn.dx32 = data.readDWord();
+         mn.dy32 = data.readDWord();
       }
       else
       {
-         mn.x  = GetBinaryWord(&data);
-         mn.y  = GetBinaryWord(&data);
-         mn.dx = GetBinaryWord(&data);
-         mn.dy = GetBinaryWord(&data);
+         mn.x  = data.readWord();
+         mn.y  = data.readWord();
+         mn.dx = data.readWord();
+         mn.dy = data.readWord();
       }
 
       for(j = 0; j < 2; j++)
          for(k = 0; k < 4; k++)
-            mn.bbox[j][k] = GetBinaryWord(&data);
+            mn.bbox[j][k] = data.readWord();
 
       for(j = 0; j < 2; j++)
-         mn.children[j] = GetBinaryDWord(&data);
+         mn.children[j] = data.readDWord();
 
-      if(signature == ZNodeType_GL3)
+      if(fixedparts)
       {
          no->x = mn.x32;
          no->y = mn.y32;
          no->dx = mn.dx32;
          no->dy = mn.dy32;
-         
-         P_CalcNodeCoefficients2(*no, fnodes[i]);
       }
       else
       {
@@ -1434,8 +1647,6 @@ static void P_LoadZNodes(int lump, ZNodeType signature)
          no->dx = mn.dx;
          no->dy = mn.dy;
 
-         P_CalcNodeCoefficients(no, &fnodes[i]);
-
          no->x  <<= FRACBITS;
          no->y  <<= FRACBITS;
          no->dx <<= FRACBITS;
@@ -1450,8 +1661,6 @@ static void P_LoadZNodes(int lump, ZNodeType signature)
             no->bbox[j][k] = (fixed_t)mn.bbox[j][k] << FRACBITS;
       }
    }
-
-   Z_Free(lumpptr);
 }
 
 //
@@ -2084,8 +2293,124 @@ static void P_LoadSideDefs2(int lumpnum)
    Z_Free(lump);
 }
 
-// haleyjd 10/10/11: externalized structure due to pre-C++11 template limitations
-typedef struct bmap_s { int n, nalloc, *list; } bmap_t; // blocklist structure
+//
+// Blockmap generation
+//
+// The map is cut into bands of block rows, and every band is handled by one
+// worker, so that no two threads ever touch the same block. Each band walks
+// the lines through the grid twice: once to count the lines in its blocks,
+// and again to write them out once every list has been given its place in
+// blockmaplump.
+//
+
+// bands of block rows for each worker, to even out busy parts of the map
+#define BMAP_BANDSPERWORKER 4
+
+struct bmapbuild_t
+{
+   int  minx, miny; // map origin in whole units
+   int  numbands;   // bands of rows the map is cut into
+   bool fill;       // false while counting, true while writing lists
+   int *blocks;     // per block: line count, then next free slot in its list
+};
+
+//
+// P_bmapLine
+//
+// killough 10/98: Bresenham-like walk of a linedef through the grid,
+// visiting each block from the beginning to the end of the linedef. Only
+// blocks in rows rowlo to rowhi - 1 are counted or filled.
+//
+static void P_bmapLine(bmapbuild_t &bb, int i, int rowlo, int rowhi)
+{
+   const unsigned tot = bmapwidth * bmapheight;
+
+   // starting coordinates
+   int x = (lines[i].v1->x >> FRACBITS) - bb.minx;
+   int y = (lines[i].v1->y >> FRACBITS) - bb.miny;
+
+   // ending block row; skip lines that never enter this band
+   int row    = y >> MAPBTOFRAC;
+   int rowend = ((lines[i].v2->y >> FRACBITS) - bb.miny) >> MAPBTOFRAC;
+
+   if(emax(row, rowend) < rowlo || emin(row, rowend) >= rowhi)
+      return;
+
+   // x-y deltas
+   int adx = lines[i].dx >> FRACBITS, dx = adx < 0 ? -1 : 1;
+   int ady = lines[i].dy >> FRACBITS, dy = ady < 0 ? -1 : 1;
+
+   // difference in preferring to move across y (>0)
+   // instead of x (<0)
+   int diff = !adx ? 1 : !ady ? -1 :
+    (((x >> MAPBTOFRAC) << MAPBTOFRAC) +
+     (dx > 0 ? MAPBLOCKUNITS-1 : 0) - x) * (ady = D_abs(ady)) * dx -
+    (((y >> MAPBTOFRAC) << MAPBTOFRAC) +
+     (dy > 0 ? MAPBLOCKUNITS-1 : 0) - y) * (adx = D_abs(adx)) * dy;
+
+   // starting block
+   int b = row * bmapwidth + (x >> MAPBTOFRAC);
+
+   // ending block
+   int bend = rowend * bmapwidth +
+      (((lines[i].v2->x >> FRACBITS) - bb.minx) >> MAPBTOFRAC);
+
+   // delta for block index when moving across y
+   dy *= bmapwidth;
+
+   // deltas for diff inside the loop
+   adx <<= MAPBTOFRAC;
+   ady <<= MAPBTOFRAC;
+
+   // Now we simply iterate block-by-block until we reach the end block.
+   while((unsigned int)b < tot)    // failsafe -- should ALWAYS be true
+   {
+      row = b / bmapwidth;
+      if(row >= rowlo && row < rowhi)
+      {
+         if(bb.fill)
+            blockmaplump[bb.blocks[b]++] = i;
+         else
+            ++bb.blocks[b];
+      }
+
+      // If we have reached the last block, exit
+      if(b == bend)
+         break;
+
+      // Move in either the x or y direction to the next block
+      if(diff < 0)
+      {
+         diff += ady;
+         b += dx;
+      }
+      else
+      {
+         diff -= adx;
+         b += dy;
+      }
+   }
+}
+
+//
+// P_bmapBand
+//
+// M_ParallelFor callback; counts or fills the blocks of one band of rows.
+// Lines are taken from the last to the first, which is the order the lists
+// have always been stored in.
+//
+static void P_bmapBand(int band, int worker, void *data)
+{
+   bmapbuild_t &bb = *static_cast<bmapbuild_t *>(data);
+   int rowlo = int(int64_t(bmapheight) * band / bb.numbands);
+   int rowhi = int(int64_t(bmapheight) * (band + 1) / bb.numbands);
+
+   if(rowlo == rowhi)
+      return;
+
+   for(int i = numlines; i--; )
+      P_bmapLine(bb, i, rowlo, rowhi);
+}
 
 //
 // P_CreateBlockMap
@@ -2100,13 +2425,17 @@ typedef struct bmap_s { int n, nalloc, *list; } bmap_t; // blocklist structure
 // Please note: This section of code is not interchangable with TeamTNT's
 // code which attempts to fix the same problem.
 //
+// The lists are now counted first and then written straight into place by
+// the worker threads; see P_bmapBand.
+//
 static void P_CreateBlockMap()
 {
    unsigned int i;
    fixed_t minx = INT_MAX, miny = INT_MAX,
            maxx = INT_MIN, maxy = INT_MIN;
 
-   C_Printf("P_CreateBlockMap: rebuilding blockmap for level\n");
+   if(devparm)
+      C_Printf("P_CreateBlockMap: rebuilding blockmap for level\n");
 
    // First find limits of map
    
@@ -2130,144 +2459,67 @@ static void P_CreateBlockMap()
    bmapwidth  = ((maxx - minx) >> MAPBTOFRAC) + 1;
    bmapheight = ((maxy - miny) >> MAPBTOFRAC) + 1;
 
-   // Compute blockmap, which is stored as a 2d array of variable-sized 
-   // lists.
-   //
-   // Pseudocode:
-   //
-   // For each linedef:
-   //
-   //   Map the starting and ending vertices to blocks.
-   //
-   //   Starting in the starting vertex's block, do:
-   //
-   //     Add linedef to current block's list, dynamically resizing it.
-   //
-   //     If current block is the same as the ending vertex's block,
-   //     exit loop.
-   //
-   //     Move to an adjacent block by moving towards the ending block
-   //     in either the x or y direction, to the block which contains 
-   //     the linedef.
+   unsigned    tot = bmapwidth * bmapheight;             // size of blockmap
+   bmapbuild_t bb;
 
-   {
-      unsigned tot = bmapwidth * bmapheight;                  // size of blockmap
-      bmap_t *bmap = ecalloc(bmap_t *, sizeof *bmap, tot);    // array of blocklists
+   bb.minx     = minx;
+   bb.miny     = miny;
+   bb.numbands = emin(M_WorkerCount() * BMAP_BANDSPERWORKER, bmapheight);
+   bb.fill     = false;
+   bb.blocks   = ecalloc(int *, tot, sizeof(int));
 
-      for(i = 0; i < (unsigned int)numlines; i++)
-      {
-         // starting coordinates
-         int x = (lines[i].v1->x >> FRACBITS) - minx;
-         int y = (lines[i].v1->y >> FRACBITS) - miny;
-         
-         // x-y deltas
-         int adx = lines[i].dx >> FRACBITS, dx = adx < 0 ? -1 : 1;
-         int ady = lines[i].dy >> FRACBITS, dy = ady < 0 ? -1 : 1; 
-
-         // difference in preferring to move across y (>0) 
-         // instead of x (<0)
-         int diff = !adx ? 1 : !ady ? -1 :
-          (((x >> MAPBTOFRAC) << MAPBTOFRAC) + 
-           (dx > 0 ? MAPBLOCKUNITS-1 : 0) - x) * (ady = D_abs(ady)) * dx -
-          (((y >> MAPBTOFRAC) << MAPBTOFRAC) + 
-           (dy > 0 ? MAPBLOCKUNITS-1 : 0) - y) * (adx = D_abs(adx)) * dy;
-
-         // starting block, and pointer to its blocklist structure
-         int b = (y >> MAPBTOFRAC) * bmapwidth + (x >> MAPBTOFRAC);
-
-         // ending block
-         int bend = (((lines[i].v2->y >> FRACBITS) - miny) >> MAPBTOFRAC) *
-            bmapwidth + (((lines[i].v2->x >> FRACBITS) - minx) >> MAPBTOFRAC);
-
-         // delta for pointer when moving across y
-         dy *= bmapwidth;
-
-         // deltas for diff inside the loop
-         adx <<= MAPBTOFRAC;
-         ady <<= MAPBTOFRAC;
-
-         // Now we simply iterate block-by-block until we reach the end block.
-         while((unsigned int) b < tot)    // failsafe -- should ALWAYS be true
-         {
-            // Increase size of allocated list if necessary
-            if(bmap[b].n >= bmap[b].nalloc)
-            {
-               bmap[b].nalloc = bmap[b].nalloc ? bmap[b].nalloc * 2 : 8;
-               bmap[b].list = erealloc(int *, bmap[b].list,
-                                       bmap[b].nalloc*sizeof*bmap->list);
-            }
+   // Count the lines in every block.
+   M_ParallelFor(bb.numbands, P_bmapBand, &bb);
 
-            // Add linedef to end of list
-            bmap[b].list[bmap[b].n++] = i;
+   // Compute the total size of the blockmap.
+   //
+   // Compression of empty blocks is performed by reserving two
+   // offset words at tot and tot+1.
+   //
+   // 4 words, unused if this routine is called, are reserved at
+   // the start.
 
-            // If we have reached the last block, exit
-            if(b == bend)
-               break;
+   // we need at least 1 word per block, plus reserved's
+   int count = tot + 6;
 
-            // Move in either the x or y direction to the next block
-            if(diff < 0)
-            {
-               diff += ady;
-               b += dx;
-            }
-            else
-            {
-               diff -= adx;
-               b += dy;
-            }
-         }
-      }
+   for(i = 0; i < tot; i++)
+   {
+      // 1 header word + 1 trailer word + blocklist
+      if(bb.blocks[i])
+         count += bb.blocks[i] + 2;
+   }
 
-      // Compute the total size of the blockmap.
-      //
-      // Compression of empty blocks is performed by reserving two 
-      // offset words at tot and tot+1.
-      //
-      // 4 words, unused if this routine is called, are reserved at 
-      // the start.
+   // Allocate blockmap lump with computed count
+   blockmaplump = (int *)(Z_Malloc(sizeof(*blockmaplump) * count, PU_LEVEL, 0));
 
-      {
-         // we need at least 1 word per block, plus reserved's
-         int count = tot + 6;
+   // Lay out the compressed blockmap, leaving each block's list to be filled
+   // in, and point its counter at the list.
+   int ndx = tot + 4;         // Advance index to start of linedef lists
 
-         for(i = 0; i < tot; i++)
-         {
-            // 1 header word + 1 trailer word + blocklist
-            if(bmap[i].n)
-               count += bmap[i].n + 2; 
-         }
+   blockmaplump[ndx++] = 0;   // Store an empty blockmap list at start
+   blockmaplump[ndx++] = -1;  // (Used for compression)
 
-         // Allocate blockmap lump with computed count
-         blockmaplump = (int *)(Z_Malloc(sizeof(*blockmaplump) * count, 
-                                         PU_LEVEL, 0));
+   for(i = 0; i < tot; i++)
+   {
+      if(bb.blocks[i])                       // Non-empty blocklist
+      {
+         blockmaplump[blockmaplump[i + 4] = ndx++] = 0;  // Store index & header
+         int n = bb.blocks[i];
+         bb.blocks[i] = ndx;                             // Where lines go
+         ndx += n;
+         blockmaplump[ndx++] = -1;                       // Store trailer
       }
+      else     // Empty blocklist: point to reserved empty blocklist
+         blockmaplump[i + 4] = tot + 4;
+   }
 
-      // Now compress the blockmap.
-      {
-         int ndx = tot += 4;      // Advance index to start of linedef lists
-         bmap_t *bp = bmap;       // Start of uncompressed blockmap
+   // Write the lines into their lists.
+   bb.fill = true;
+   M_ParallelFor(bb.numbands, P_bmapBand, &bb);
 
-         blockmaplump[ndx++] = 0;  // Store an empty blockmap list at start
-         blockmaplump[ndx++] = -1; // (Used for compression)
+   efree(bb.blocks);
 
-         for(i = 4; i < tot; i++, bp++)
-         {
-            if(bp->n)                          // Non-empty blocklist
-            {
-               blockmaplump[blockmaplump[i] = ndx++] = 0;  // Store index & header
-               do
-                  blockmaplump[ndx++] = bp->list[--bp->n]; // Copy linedef list
-               while (bp->n);
-               blockmaplump[ndx++] = -1;                   // Store trailer
-               efree(bp->list);                             // Free linedef list
-            }
-            else     // Empty blocklist: point to reserved empty blocklist
-               blockmaplump[i] = tot;
-         }
-         
-         efree(bmap);    // Free uncompressed blockmap
-      }
-   }
+   P_CacheBlockMap(ndx);
 
    skipblstart = true;
 }
@@ -2371,7 +2623,8 @@ static void P_LoadBlockMap(int lump)
    // haleyjd 03/04/10: blockmaps of less than 8 bytes cannot be valid
    if(r_blockmap || len < 8 || count >= 0x10000)
    {
-      P_CreateBlockMap();
+      if(!P_CachedBlockMap())
+         P_CreateBlockMap();
    }
    else
    {
@@ -2409,13 +2662,14 @@ static void P_LoadBlockMap(int lump)
          C_Printf(FC_ERROR "Blockmap error: %s\a\n", bmaperrormsg);
          Z_Free(blockmaplump);
          blockmaplump = NULL;
-         P_CreateBlockMap();
+         if(!P_CachedBlockMap())
+            P_CreateBlockMap();
       }
    }
 
-   // clear out mobj chains
-   count      = sizeof(*blocklinks) * bmapwidth * bmapheight;
-   blocklinks = ecalloctag(Mobj **, 1, count, PU_LEVEL, NULL);
+   // clear out mobj cells
+   count       = sizeof(*blockthings) * bmapwidth * bmapheight;
+   blockthings = ecalloctag(blockcell_t *, 1, count, PU_LEVEL, NULL);
    blockmap   = blockmaplump + 4;
 
    // haleyjd 2/22/06: setup polyobject blockmap
@@ -2440,11 +2694,103 @@ static void AddLineToSector(sector_t *s, line_t *l)
    *s->lines++ = l;
 }
 
+//
+// P_groupNeighbors
+//
+// Lists the sectors across each sector's 2S lines, without repeats, in
+// one buffer for the whole level. These are the sectors getNextSector
+// finds outside of comp_model.
+//
+static void P_groupNeighbors()
+{
+   int *stamp = ecalloc(int *, emax(numsectors, 1), sizeof(int));
+   int  total = 0;
+
+   // count first, then fill the same way into each sector's slice
+   for(int pass = 0; pass < 2; pass++)
+   {
+      sector_t **buffer = nullptr;
+
+      if(pass)
+      {
+         buffer = (sector_t **)(Z_Malloc(emax(total, 1) * sizeof(*buffer), PU_LEVEL, 0));
+         memset(stamp, 0, numsectors * sizeof(int));
+      }
+
+      for(int i = 0; i < numsectors; i++)
+      {
+         sector_t *sec = &sectors[i];
+
+         if(pass)
+         {
+            sec->neighbors = buffer;
+            buffer += sec->neighborcount;
+            sec->neighborcount = 0;
+         }
+
+         for(int j = 0; j < sec->linecount; j++)
+         {
+            const line_t *line = sec->lines[j];
+            sector_t *other = line->frontsector == sec ? line->backsector : line->frontsector;
+
+            if(!other || other == sec || stamp[other - sectors] == i + 1)
+               continue;
+
+            stamp[other - sectors] = i + 1;
+            if(pass)
+               sec->neighbors[sec->neighborcount] = other;
+            ++sec->neighborcount;
+         }
+
+         if(!pass)
+            total += sec->neighborcount;
+      }
+   }
+
+   efree(stamp);
+}
+
+//
+// P_groupVertexLines
+//
+// Lists the lines using each vertex, in one buffer for the whole level.
+//
+static void P_groupVertexLines()
+{
+   vertexlineoffs = (int *)(Z_Calloc(numvertexes + 1, sizeof(int), PU_LEVEL, nullptr));
+
+   for(int i = 0; i < numlines; i++)
+   {
+      ++vertexlineoffs[lines[i].v1 - vertexes + 1];
+      if(lines[i].v2 != lines[i].v1)
+         ++vertexlineoffs[lines[i].v2 - vertexes + 1];
+   }
+
+   for(int i = 0; i < numvertexes; i++)
+      vertexlineoffs[i + 1] += vertexlineoffs[i];
+
+   vertexlines = (line_t **)(Z_Malloc(emax(vertexlineoffs[numvertexes], 1) *
+                                      sizeof(*vertexlines), PU_LEVEL, 0));
+
+   // fill using the next free slot of each vertex, then shift them back
+   for(int i = 0; i < numlines; i++)
+   {
+      vertexlines[vertexlineoffs[lines[i].v1 - vertexes]++] = &lines[i];
+      if(lines[i].v2 != lines[i].v1)
+         vertexlines[vertexlineoffs[lines[i].v2 - vertexes]++] = &lines[i];
+   }
+
+   for(int i = numvertexes; i > 0; i--)
+      vertexlineoffs[i] = vertexlineoffs[i - 1];
+   vertexlineoffs[0] = 0;
+}
+
 //
 // P_GroupLines
 //
 // Builds sector line lists and subsector sector numbers.
 // Finds block bounding boxes for sectors.
+// Also lists each sector's neighbors and each vertex's lines.
 //
 // killough 5/3/98: reformatted, cleaned up
 // killough 8/24/98: rewrote to use faster algorithm
@@ -2541,6 +2887,9 @@ static void P_GroupLines()
       block = block < 0 ? 0 : block;
       sector->blockbox[BOXLEFT]=block;
    }
+
+   P_groupNeighbors();
+   P_groupVertexLines();
 }
 
 //
@@ -2588,17 +2937,17 @@ static void P_GroupLines()
 //
 // Firelines (TM) is a Rezistered Trademark of MBF Productions
 //
-static void P_RemoveSlimeTrails()             // killough 10/98
+// hit is a zeroed list with a byte per vertex, allocated by the caller since
+// this runs as a setup job.
+//
+static void P_RemoveSlimeTrails(byte *hit)    // killough 10/98
 {
-   byte *hit; 
    int i;
    
    // haleyjd: don't mess with vertices in old demos, for safety.
    if(demo_version < 203)
       return;
 
-   hit = ecalloc(byte *, 1, numvertexes); // Hitlist for vertices
-
    for(i = 0; i < numsegs; i++)            // Go through each seg
    {
       const line_t *l = segs[i].linedef;   // The parent linedef
@@ -2643,9 +2992,6 @@ static void P_RemoveSlimeTrails()             // killough 10/98
          while((v != segs[i].v2) && (v = segs[i].v2));
       }
    }
-
-   // free hit list
-   efree(hit);
 }
 
 //
@@ -2695,6 +3041,9 @@ static void P_padRejectArray(byte *array, unsigned int len)
    }
 }
 
+// set by P_LoadReject when the level has no usable reject
+static bool rejectgenerate;
+
 //
 // P_LoadReject
 //
@@ -2703,8 +3052,9 @@ static void P_padRejectArray(byte *array, unsigned int len)
 // length reject lumps. This function will test to see if the reject
 // lump is zero in size, and if so, will generate a reject with all
 // zeroes. This is preferable to adding checks to see if a reject
-// matrix exists, in my opinion. This could be improved by actually
-// generating a meaningful reject, but that will have to wait.
+// matrix exists, in my opinion. Missing and all-zero rejects are flagged
+// so that P_SetupLevel can generate a meaningful one once the level is
+// fully loaded.
 //
 static void P_LoadReject(int lump)
 {
@@ -2749,6 +3099,10 @@ static void P_LoadReject(int lump)
    // warn on too-large rejects, but do nothing special.
    if(size > expectedsize)
       C_Printf(FC_ERROR "P_LoadReject: warning - reject is too large\a\n");
+
+   // only generate a reject where one would do nothing at all
+   rejectgenerate = (size == 0 || P_RejectIsEmpty(rejectmatrix, expectedsize)) &&
+                    !M_CheckParm("-reject_pad_with_ff");
 }
 
 //
@@ -2856,8 +3210,8 @@ int P_CheckLevel(WadDirectory *dir, int lumpnum, maplumpindex_t *mgla,
             break;
          }
       }
-      if(!foundEndMap || (mgla && mgla->nodes < 0))
-         return LEVEL_FORMAT_INVALID;  // must have ENDMAP
+      if(!foundEndMap)
+         return LEVEL_FORMAT_INVALID;  // must have ENDMAP; ZNODES can be built
       // Found ENDMAP. This may be a valid UDMF lump. Return it
       if(udmf)
          *udmf = true;
@@ -3058,6 +3412,9 @@ static void P_PreZoneFreeLevel()
    // haleyjd: stop particle engine
    R_ClearParticles();
 
+   // forget sight checks made on the previous level
+   P_ClearSightCache();
+
    // SoM: initialize portals
    R_InitPortals();
 
@@ -3072,6 +3429,9 @@ static void P_PreZoneFreeLevel()
 
    // sf: free the psecnode_t linked list in p_map.c
    P_FreeSecNodeList(); 
+
+   // destroy the map objects, which Z_FreeTags can't see
+   P_MobjPoolFreeLevel();
 }
 
 //
@@ -3116,6 +3476,7 @@ static void P_InitNewLevel(int lumpnum, WadDirectory *waddir)
 
    // haleyjd 01/21/14: clear marks here along with everything else
    AM_clearMarks();
+   AM_ClearLineIndex();
 
    // wake up heads-up display
    HU_Start();
@@ -3192,6 +3553,133 @@ void P_InitThingLists()
       } \
    } while(0)
 
+//
+// Setup jobs
+//
+// Stages of P_SetupLevel that only fill in or adjust the level's arrays,
+// without allocating, can run at the same time as each other. Each job
+// lists the jobs it has to follow, and every round runs all the jobs that
+// are ready on the worker threads. Jobs must not touch the zone heap, which
+// is not thread safe, so whatever they need is allocated beforehand.
+//
+
+enum
+{
+   SJ_NODECOEFFS,
+   SJ_SECTORBOXES,
+   SJ_SOUNDZONES,
+   SJ_SLIMETRAILS,
+   NUMSETUPJOBS
+};
+
+#define SJ_BIT(job) (1u << (job))
+
+struct setupjob_t
+{
+   const char *name;
+   unsigned    after; // SJ_BITs of the jobs that must finish first
+   bool        run;   // false if this level doesn't need the job
+   int64_t     time;  // nanoseconds, for -devparm
+};
+
+static setupjob_t setupjobs[NUMSETUPJOBS] =
+{
+   { "node coefficients",     0,                      false, 0 },
+   { "sector bounding boxes", 0,                      false, 0 },
+   { "sound zones",           0,                      false, 0 },
+   { "slime trails",          SJ_BIT(SJ_SECTORBOXES), false, 0 }, // boxes use the old vertexes
+};
+
+static byte      *slimehits;      // vertex hit list for P_RemoveSlimeTrails
+static sector_t **soundzonestack; // sector stack for P_CreateSoundZones
+
+//
+// P_runSetupJob
+//
+// M_ParallelFor callback. data is the list of jobs being run this round.
+//
+static void P_runSetupJob(int index, int worker, void *data)
+{
+   int     job   = static_cast<const int *>(data)[index];
+   int64_t start = P_ProfileClock();
+
+   switch(job)
+   {
+   case SJ_NODECOEFFS:
+      P_CalcAllNodeCoefficients();
+      break;
+   case SJ_SECTORBOXES:
+      P_createSectorBoundingBoxes();
+      break;
+   case SJ_SOUNDZONES:
+      P_CreateSoundZones(soundzonestack);
+      break;
+   case SJ_SLIMETRAILS:
+      P_RemoveSlimeTrails(slimehits);
+      break;
+   }
+
+   setupjobs[job].time = P_ProfileClock() - start;
+}
+
+//
+// P_runSetupJobs
+//
+// Runs every job marked to run, once all the jobs it follows are done.
+//
+static void P_runSetupJobs()
+{
+   unsigned done = 0;
+   int      ready[NUMSETUPJOBS];
+
+   for(int i = 0; i < NUMSETUPJOBS; i++)
+   {
+      setupjobs[i].time = 0;
+      if(!setupjobs[i].run)
+         done |= SJ_BIT(i);
+   }
+
+   while(done != SJ_BIT(NUMSETUPJOBS) - 1)
+   {
+      int numready = 0;
+
+      for(int i = 0; i < NUMSETUPJOBS; i++)
+      {
+         if(!(done & SJ_BIT(i)) && !(setupjobs[i].after & ~done))
+            ready[numready++] = i;
+      }
+
+      M_ParallelFor(numready, P_runSetupJob, ready);
+
+      for(int i = 0; i < numready; i++)
+         done |= SJ_BIT(ready[i]);
+   }
+
+   if(devparm)
+   {
+      for(const setupjob_t &job : setupjobs)
+      {
+         if(job.run)
+            C_Printf("  %s: %.2f ms\n", job.name, job.time / 1000000.0);
+      }
+   }
+}
+
+//
+// P_setupTime
+//
+// With -devparm, prints how long the stage of P_SetupLevel that just ended
+// took, and starts timing the next one.
+//
+static void P_setupTime(const char *stage, int64_t &start)
+{
+   int64_t now = P_ProfileClock();
+
+   if(devparm)
+      C_Printf("P_SetupLevel: %s: %.2f ms\n", stage, (now - start) / 1000000.0);
+   start = now;
+}
+
 //
 // P_SetupLevel
 //
@@ -3202,6 +3690,7 @@ void P_SetupLevel(WadDirectory *dir, const char *mapname, int playermask,
 {
    lumpinfo_t **lumpinfo;
    int lumpnum, acslumpnum = -1;
+   int64_t stagestart = P_ProfileClock();
 
    G_DemoLog("%d\tSetup %s\n", gametic, mapname);
    G_DemoLogSetExited(false);
@@ -3249,6 +3738,13 @@ void P_SetupLevel(WadDirectory *dir, const char *mapname, int playermask,
    // perform post-Z_FreeTags actions
    P_InitNewLevel(lumpnum, dir);
 
+   P_setupTime("freeing old level", stagestart);
+
+   // look up derived data saved by an earlier load of this level
+   P_OpenLevelCache(*setupwad, lumpnum, mgla);
+
+   P_setupTime("level cache lookup", stagestart);
+
    // note: most of this ordering is important
    
    // killough 3/1/98: P_LoadBlockMap call moved down to below
@@ -3344,22 +3840,31 @@ void P_SetupLevel(WadDirectory *dir, const char *mapname, int playermask,
       P_LoadSideDefs2(lumpnum + ML_SIDEDEFS);
    
    P_LoadLineDefs2();                      // killough 4/4/98
+
+   P_setupTime("map lumps", stagestart);
    
    // IOANCH 20151213: use mgla here and elsewhere
    
    P_LoadBlockMap (mgla.blockmap); // killough 3/1/98
+
+   P_setupTime("blockmap", stagestart);
    
-   // IOANCH: at this point, mgla.nodes is valid. Check ZDoom node signature too
+   // IOANCH: check ZDoom node signature too
+   // Nodes are built instead if the level has none, or if asked to.
    ZNodeType znodeSignature;
    int actualNodeLump = -1;
-   if((znodeSignature = P_CheckForZDoomUncompressedNodes(mgla.nodes, 
-      &actualNodeLump, isUdmf)) != ZNodeType_Invalid && actualNodeLump >= 0)
+   bool znodeCompressed = false;
+   bool buildNodes = P_ForceNodeBuild();
+   if(!buildNodes && mgla.nodes >= 0 &&
+      (znodeSignature = P_CheckForZDoomNodes(mgla.nodes, &actualNodeLump, isUdmf,
+      &znodeCompressed)) != ZNodeType_Invalid && actualNodeLump >= 0)
    {
-      P_LoadZNodes(actualNodeLump, znodeSignature);
+      ZNodeStream data(actualNodeLump, znodeCompressed);
+      P_LoadZNodes(data, znodeSignature);
 
       CHECK_ERROR();
    }
-   else if(P_CheckForDeePBSPv4Nodes(lumpnum))   // ioanch 20160204: also DeePBSP
+   else if(!buildNodes && P_CheckForDeePBSPv4Nodes(lumpnum))   // ioanch 20160204
    {
       P_LoadSubsectors_V4(lumpnum + ML_SSECTORS);
       CHECK_ERROR();
@@ -3368,16 +3873,26 @@ void P_SetupLevel(WadDirectory *dir, const char *mapname, int playermask,
       P_LoadSegs_V4(lumpnum + ML_SEGS);
       CHECK_ERROR();
    }
-   else
+   else if(buildNodes || mgla.ssectors < 0 || mgla.segs < 0 ||
+           !setupwad->lumpLength(mgla.ssectors) || !setupwad->lumpLength(mgla.segs))
    {
-      // IOANCH 20151215: make sure everything is valid. Can happen if UDMF has
-      // invalid ZNODES entry
-      if(mgla.ssectors < 0 || mgla.segs < 0)
+      // IOANCH 20151215: UDMF without a valid ZNODES entry also ends up here
+      size_t length;
+      byte *builtNodes = P_BuildNodes(length);
+
+      if(!builtNodes)
       {
-         P_SetupLevelError("UDMF levels don't support vanilla BSP", mapname);
+         P_SetupLevelError("Could not build nodes", mapname);
          return;
       }
 
+      ZNodeStream data(builtNodes, length);
+      P_LoadZNodes(data, ZNodeType_Built);
+
+      CHECK_ERROR();
+   }
+   else
+   {
       // IOANCH: at this point, it's not a UDMF map so mgla will be valid
       P_LoadSubsectors(mgla.ssectors);
       P_LoadNodes     (mgla.nodes);
@@ -3391,19 +3906,56 @@ void P_SetupLevel(WadDirectory *dir, const char *mapname, int playermask,
       CHECK_ERROR();
    }
 
+   P_setupTime("nodes", stagestart);
+
    // ioanch 20160309: reversed P_GroupLines with P_LoadReject to fix the
    // overrun
    P_GroupLines();
    P_LoadReject(mgla.reject); // haleyjd 01/26/04
 
-   // Create bounding boxes now
-   P_createSectorBoundingBoxes();
+   // size the visit marks used by searches for this level's lines and sectors
+   P_InitVisitContexts();
+
+   P_setupTime("grouping lines", stagestart);
+
+   // Work out node coefficients, sector bounding boxes, sound environment
+   // zones (haleyjd 01/12/14) and remove slime trails from wad (killough
+   // 10/98), unless the level cache already has the results
+   setupjobs[SJ_NODECOEFFS].run  = true;
+   setupjobs[SJ_SECTORBOXES].run = !P_CachedSectorData();
+   setupjobs[SJ_SOUNDZONES].run  = setupjobs[SJ_SECTORBOXES].run;
+   setupjobs[SJ_SLIMETRAILS].run = !P_CachedVertexes();
+
+   if(setupjobs[SJ_SECTORBOXES].run)
+      pSectorBoxes = estructalloctag(sectorbox_t, numsectors, PU_LEVEL);
+   if(setupjobs[SJ_SOUNDZONES].run)
+      soundzonestack = ecalloc(sector_t **, numsectors, sizeof(sector_t *));
+   if(setupjobs[SJ_SLIMETRAILS].run)
+      slimehits = ecalloc(byte *, 1, numvertexes);
+
+   P_runSetupJobs();
+
+   if(soundzonestack)
+   {
+      efree(soundzonestack);
+      soundzonestack = NULL;
+   }
+   if(slimehits)
+   {
+      efree(slimehits);
+      slimehits = NULL;
+   }
+
+   if(setupjobs[SJ_SECTORBOXES].run)
+      P_CacheSectorData();
+   if(setupjobs[SJ_SLIMETRAILS].run)
+      P_CacheVertexes();
+   P_InitSoundZones();
 
-   // haleyjd 01/12/14: build sound environment zones
-   P_CreateSoundZones();
+   // that was the last of the cached data
+   P_CloseLevelCache();
 
-   // killough 10/98: remove slime trails from wad
-   P_RemoveSlimeTrails(); 
+   P_setupTime("derived data", stagestart);
 
    // haleyjd 08/19/13: call new function to handle bodyque
    G_ClearPlayerCorpseQueue();
@@ -3436,6 +3988,8 @@ void P_SetupLevel(WadDirectory *dir, const char *mapname, int playermask,
    // possible error: missing player or deathmatch spots
    CHECK_ERROR();
 
+   P_setupTime("things", stagestart);
+
    // haleyjd: init all thing lists (boss brain spots, etc)
    P_InitThingLists(); 
 
@@ -3448,12 +4002,28 @@ void P_SetupLevel(WadDirectory *dir, const char *mapname, int playermask,
    // SoM: Deferred specials that need to be spawned after P_SpawnSpecials
    P_SpawnDeferredSpecials(setupSettings);
 
+   // cache which lines let sound through, now that portals are set up
+   P_InitSoundLines();
+
+   P_setupTime("specials", stagestart);
+
+   // build a reject for levels without a real one, now that polyobjects and
+   // portals are known
+   if(rejectgenerate && full_demo_version >= make_full_version(401, 1))
+   {
+      P_GenerateReject();
+      P_setupTime("reject generation", stagestart);
+   }
+
    // haleyjd
    P_InitLightning();
 
    // preload graphics
    if(precache)
+   {
       R_PrecacheLevel();
+      P_setupTime("precache", stagestart);
+   }
 
    R_SetViewSize(screenSize+3); //sf
 
@@ -3492,6 +4062,7 @@ void P_Init()
    R_InitSprites(spritelist);
    P_InitHubs();
    E_InitTerrainTypes();     // haleyjd 07/03/99
+   P_InitThinkerProfile();
 }
 
 //
@@ -31,6 +31,7 @@
 #include "m_fixed.h"  // for fixed_t
 
 class  Mobj;
+struct blockcell_t;
 struct seg_t;
 
 // haleyjd 10/03/05: let P_CheckLevel determine the map format
@@ -83,7 +84,7 @@ extern int      bmapwidth;
 extern int      bmapheight;      // in mapblocks
 extern fixed_t  bmaporgx;
 extern fixed_t  bmaporgy;        // origin of block map
-extern Mobj   **blocklinks;      // for thing chains
+extern blockcell_t *blockthings; // for things in each block
 extern byte    *portalmap;       // haleyjd: for fast linked portal checks
 extern bool     skipblstart;     // MaxW: Skip initial blocklist short
 
@@ -26,12 +26,15 @@
 #include "z_zone.h"
 #include "i_system.h"
 
+#include "c_io.h"
+#include "c_runcmd.h"
 #include "cam_sight.h"
 #include "doomstat.h"
 #include "e_exdata.h"
 #include "m_bbox.h"
 #include "p_maputl.h"
 #include "p_setup.h"
+#include "p_visit.h"
 #include "r_dynseg.h"
 #include "r_main.h"
 #include "r_state.h"
@@ -48,6 +51,7 @@ typedef struct los_s
    divline_t strace;                // from t1 to t2
    fixed_t topslope, bottomslope;   // slopes to top and bottom of target
    fixed_t bbox[4];
+   VisitContext *visit;             // lines and polyobjects already checked
 } los_t;
 
 //
@@ -135,10 +139,8 @@ static bool P_CrossSubsecPolyObj(polyobj_t *po, los_t *los)
       const vertex_t *v1,*v2;
       
       // already checked other side?
-      if(line->validcount == validcount)
+      if(!los->visit->visitLine(eindex(line - lines)))
          continue;
-
-      line->validcount = validcount;
       
       // OPTIMIZE: killough 4/20/98: Added quick bounding-box rejection test
       if(line->bbox[BOXLEFT  ] > los->bbox[BOXRIGHT ] ||
@@ -198,9 +200,8 @@ static bool P_CrossSubsector(int num, los_t *los)
       {
          polyobj_t *po = (*link)->polyobj;
 
-         if(po->validcount != validcount)
+         if(los->visit->visitPoly(eindex(po - PolyObjects)))
          {
-            po->validcount = validcount;
             if(!P_CrossSubsecPolyObj(po, los))
                return false;
          }
@@ -218,10 +219,8 @@ static bool P_CrossSubsector(int num, los_t *los)
       fixed_t frac;
       
       // already checked other side?
-      if(line->validcount == validcount)
+      if(!los->visit->visitLine(eindex(line - lines)))
          continue;
-
-      line->validcount = validcount;
       
       // OPTIMIZE: killough 4/20/98: Added quick bounding-box rejection test
       // haleyjd: another demo compatibility fix by cph -- who knows
@@ -330,15 +329,89 @@ static bool P_CrossBSPNode(int bspnum, los_t *los)
       P_CrossSubsector((bspnum == -1 ? 0 : bspnum & ~NF_SUBSECTOR), los);
 }
 
+//=============================================================================
+//
+// Sight Cache
+//
+// Monsters ask the same sight questions many times a tic, and the answer
+// only depends on where both things are and on the state of the level. The
+// last result for each pair is kept in a small hash table, stamped with the
+// tic and the level's sight epoch. Anything that can change the outcome of
+// a sight check without moving a thing (sector heights, polyobjects, portal
+// and blocking line states) bumps the epoch, which invalidates every entry
+// at once. Since a hit returns exactly what the full check would, demo sync
+// is unaffected.
+//
+
+#define SIGHTCACHE_SIZE 4096 // must be a power of two
+
+struct sightcache_t
+{
+   const Mobj *t1, *t2;          // looker and target
+   fixed_t     x1, y1, z1, h1;   // looker position and height when checked
+   fixed_t     x2, y2, z2, h2;   // target position and height when checked
+   int         tic;              // gametic the entry was made on
+   unsigned    epoch;            // sight epoch the entry was made in
+   bool        result;
+};
+
+static sightcache_t sightcache[SIGHTCACHE_SIZE];
+static unsigned     sightepoch = 1; // 0 marks unused entries
+static unsigned     sighthits;
+static unsigned     sightmisses;
+
+//
+// P_InvalidateSightCache
+//
+// Call when anything other than a thing's own position changes what it can
+// see.
+//
+void P_InvalidateSightCache()
+{
+   if(!++sightepoch)
+   {
+      // wrapped around; clear out entries that could now match by accident
+      memset(sightcache, 0, sizeof(sightcache));
+      sightepoch = 1;
+   }
+}
+
+//
+// P_ClearSightCache
+//
+// Called at level start. Also resets the hit rate statistics.
+//
+void P_ClearSightCache()
+{
+   P_InvalidateSightCache();
+   sighthits = sightmisses = 0;
+}
+
+//
+// P_sightCacheSlot
+//
+static sightcache_t &P_sightCacheSlot(const Mobj *t1, const Mobj *t2)
+{
+   uintptr_t hash = reinterpret_cast<uintptr_t>(t1) * 31 + 
+                    reinterpret_cast<uintptr_t>(t2);
+
+   hash ^= hash >> 13;
+   hash *= 0x9E3779B1u;
+   hash ^= hash >> 16;
+
+   return sightcache[hash & (SIGHTCACHE_SIZE - 1)];
+}
+
+//
+// P_checkSight
 //
-// P_CheckSight
 // Returns true
 //  if a straight line between t1 and t2 is unobstructed.
 // Uses REJECT.
 //
 // killough 4/20/98: cleaned up, made to use new LOS struct
 //
-bool P_CheckSight(Mobj *t1, Mobj *t2)
+static bool P_checkSight(Mobj *t1, Mobj *t2)
 {
    if(full_demo_version >= make_full_version(340, 24))
    {
@@ -389,7 +462,8 @@ bool P_CheckSight(Mobj *t1, Mobj *t2)
    // An unobstructed LOS is possible.
    // Now look from eyes of t1 to any part of t2.
    
-   validcount++;
+   los.visit = &P_SearchVisit();
+   los.visit->begin();
 
    los.topslope = 
       (los.bottomslope = t2->z - (los.sightzstart =
@@ -424,6 +498,59 @@ bool P_CheckSight(Mobj *t1, Mobj *t2)
    return P_CrossBSPNode(numnodes-1, &los);
 }
 
+//
+// P_CheckSight
+//
+// Returns true if a straight line between t1 and t2 is unobstructed,
+// answering repeated questions within a tic from the sight cache.
+//
+bool P_CheckSight(Mobj *t1, Mobj *t2)
+{
+   sightcache_t &entry = P_sightCacheSlot(t1, t2);
+
+   if(entry.epoch == sightepoch && entry.tic == gametic &&
+      entry.t1 == t1 && entry.t2 == t2 &&
+      entry.x1 == t1->x && entry.y1 == t1->y && 
+      entry.z1 == t1->z && entry.h1 == t1->height &&
+      entry.x2 == t2->x && entry.y2 == t2->y && 
+      entry.z2 == t2->z && entry.h2 == t2->height)
+   {
+      ++sighthits;
+      return entry.result;
+   }
+
+   ++sightmisses;
+
+   entry.t1     = t1;
+   entry.t2     = t2;
+   entry.x1     = t1->x;
+   entry.y1     = t1->y;
+   entry.z1     = t1->z;
+   entry.h1     = t1->height;
+   entry.x2     = t2->x;
+   entry.y2     = t2->y;
+   entry.z2     = t2->z;
+   entry.h2     = t2->height;
+   entry.tic    = gametic;
+   entry.epoch  = sightepoch;
+   entry.result = P_checkSight(t1, t2);
+
+   return entry.result;
+}
+
+//
+// p_sightstats
+//
+// Reports how many sight checks the cache has answered this level.
+//
+CONSOLE_COMMAND(p_sightstats, 0)
+{
+   unsigned total = sighthits + sightmisses;
+
+   C_Printf("Sight checks: %u, cached: %u (%.1f%%)\n", total, sighthits,
+            total ? 100.0 * sighthits / total : 0.0);
+}
+
 //----------------------------------------------------------------------------
 //
 // $Log: p_sight.c,v $
@@ -0,0 +1,458 @@
+//
+// The Eternity Engine
+// Copyright (C) 2018 James Haley et al.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see http://www.gnu.org/licenses/
+//
+// Additional terms and conditions compatible with the GPLv3 apply. See the
+// file COPYING-EE for details.
+//
+// Purpose: In-memory game state snapshots, for rewinding and demo seeking.
+//
+//  Every p_snapinterval tics the whole level is written through the savegame
+//  archivers into memory, compressed, and kept in a history sorted by time.
+//  Time here is counted in tics run since the history was started, which for
+//  demos is the start of playback. Once the history holds p_snapmax
+//  snapshots every other one is dropped and the interval doubles, so that
+//  it always covers the whole demo however long it runs.
+//
+//  Seeking restores the nearest snapshot at or before the target, then runs
+//  the game forward to it without drawing anything. Demos play back the same
+//  way every time, so later snapshots stay valid after rewinding and are used
+//  when seeking forward. In a game being played there's nothing to run
+//  forward with: rewinding goes back to a snapshot and play continues from
+//  there, dropping every snapshot after it.
+//
+
+#include "z_zone.h"
+#include "i_system.h"
+#include "../zlib/zlib.h"
+
+#include "c_io.h"
+#include "c_runcmd.h"
+#include "d_event.h"
+#include "d_main.h"
+#include "d_net.h"
+#include "doomstat.h"
+#include "g_game.h"
+#include "m_buffer.h"
+#include "p_chase.h"
+#include "p_saveg.h"
+#include "p_snapshot.h"
+#include "r_draw.h"
+#include "s_sound.h"
+#include "st_stuff.h"
+#include "v_misc.h"
+
+int p_snapshots    = SNAPSHOTS_DEMOS;
+int p_snapinterval = 5 * TICRATE;
+int p_snapmax      = 128;
+
+//
+// snapshot_t
+//
+// One compressed game state, plus the globals the savegame format doesn't
+// keep, or keeps in a form that only suits loading from the menu.
+//
+struct snapshot_t
+{
+   int     time;            // tics run since the history was started
+   size_t  demooffset;      // next ticcmd in the demo being played back
+   int     basetics;        // gametic - basetic
+   int     levelstarttics;  // gametic - levelstarttic
+   int     demoversion;
+   int     demosubversion;
+   int     insurance;       // demo_insurance
+   bool    playback;        // demoplayback
+   bool    user;            // usergame
+   bool    net;             // netgame
+   int     console;         // consoleplayer
+   int     display;         // displayplayer
+   byte   *data;            // compressed archive
+   size_t  size;
+   size_t  rawsize;         // uncompressed size of the archive
+};
+
+static snapshot_t *snapshots; // sorted by time
+static int         numsnapshots;
+static int         maxsnapshots;
+static int         snaptime;    // tics run since the history was started
+
+// current interval, which doubles each time the history is thinned
+static int snapspacing = 5 * TICRATE;
+
+//
+// P_freeSnapshot
+//
+static void P_freeSnapshot(snapshot_t &snap)
+{
+   efree(snap.data);
+   snap.data = nullptr;
+}
+
+//
+// P_ClearSnapshots
+//
+// Drops the whole history and starts counting time from zero. Called
+// whenever the game is replaced by an unrelated one.
+//
+void P_ClearSnapshots()
+{
+   for(int i = 0; i < numsnapshots; i++)
+      P_freeSnapshot(snapshots[i]);
+
+   numsnapshots = 0;
+   snaptime     = 0;
+   snapspacing  = p_snapinterval;
+}
+
+//
+// P_snapshotsActive
+//
+// True if snapshots should be kept of the game being run.
+//
+static bool P_snapshotsActive()
+{
+   if(p_snapshots == SNAPSHOTS_OFF || timingdemo || demorecording)
+      return false;
+   if(demoplayback)
+      return true;
+
+   return p_snapshots == SNAPSHOTS_ALWAYS && !netgame;
+}
+
+//
+// P_findSnapshot
+//
+// Returns the index of the last snapshot taken at or before the given time,
+// or -1 if there isn't one.
+//
+static int P_findSnapshot(int time)
+{
+   int low = 0, high = numsnapshots;
+
+   while(low < high)
+   {
+      int mid = (low + high) / 2;
+
+      if(snapshots[mid].time <= time)
+         low = mid + 1;
+      else
+         high = mid;
+   }
+
+   return low - 1;
+}
+
+//
+// P_thinSnapshots
+//
+// Drops every other snapshot, keeping the first, and doubles the interval.
+//
+static void P_thinSnapshots()
+{
+   int kept = 1;
+
+   snapspacing *= 2;
+
+   for(int i = 1; i < numsnapshots; i++)
+   {
+      if(snapshots[i].time % snapspacing)
+         P_freeSnapshot(snapshots[i]);
+      else
+         snapshots[kept++] = snapshots[i];
+   }
+
+   numsnapshots = kept;
+}
+
+//
+// P_takeSnapshot
+//
+// Archives the current game state and inserts it into the history.
+//
+static void P_takeSnapshot()
+{
+   OutBuffer   buffer;
+   SaveArchive arc(&buffer);
+   snapshot_t  snap;
+   byte       *raw;
+   uLongf      size;
+
+   buffer.createMemory(256 * 1024, OutBuffer::NENDIAN);
+   P_SaveGameState(arc, nullptr, true);
+   raw = buffer.releaseMemory(snap.rawsize);
+
+   size      = compressBound(uLong(snap.rawsize));
+   snap.data = emalloc(byte *, size);
+   if(compress2(snap.data, &size, raw, uLong(snap.rawsize), Z_BEST_SPEED) != Z_OK)
+   {
+      C_Printf(FC_ERROR "P_takeSnapshot: could not compress game state\n");
+      efree(snap.data);
+      efree(raw);
+      return;
+   }
+   efree(raw);
+
+   snap.data           = erealloc(byte *, snap.data, size);
+   snap.size           = size;
+   snap.time           = snaptime;
+   snap.demooffset     = demoplayback ? G_DemoOffset() : 0;
+   snap.basetics       = gametic - basetic;
+   snap.levelstarttics = gametic - levelstarttic;
+   snap.demoversion    = demo_version;
+   snap.demosubversion = demo_subversion;
+   snap.insurance      = demo_insurance;
+   snap.playback       = demoplayback;
+   snap.user           = usergame;
+   snap.net            = netgame;
+   snap.console        = consoleplayer;
+   snap.display        = displayplayer;
+
+   if(numsnapshots == maxsnapshots)
+   {
+      maxsnapshots = maxsnapshots ? maxsnapshots * 2 : 32;
+      snapshots = erealloc(snapshot_t *, snapshots, maxsnapshots * sizeof(snapshot_t));
+   }
+
+   int index = P_findSnapshot(snaptime) + 1;
+
+   memmove(snapshots + index + 1, snapshots + index,
+           (numsnapshots - index) * sizeof(snapshot_t));
+   snapshots[index] = snap;
+   ++numsnapshots;
+
+   while(numsnapshots > p_snapmax && numsnapshots > 2)
+      P_thinSnapshots();
+}
+
+//
+// P_SnapshotTicker
+//
+// Called at the end of every G_Ticker. Takes a snapshot when one is due.
+//
+void P_SnapshotTicker()
+{
+   int last;
+
+   if(!P_snapshotsActive())
+      return;
+
+   ++snaptime;
+
+   if(gamestate != GS_LEVEL || gameaction != ga_nothing)
+      return;
+
+   // the first level tic always gets one, so there's somewhere to go back to
+   last = P_findSnapshot(snaptime);
+   if(last >= 0 && (snapshots[last].time == snaptime || snaptime % snapspacing))
+      return;
+
+   P_takeSnapshot();
+}
+
+//
+// P_restoreSnapshot
+//
+// Loads the level back as it was when the snapshot was taken.
+//
+static bool P_restoreSnapshot(const snapshot_t &snap)
+{
+   InBuffer    buffer;
+   SaveArchive arc(&buffer);
+   byte       *raw  = emalloc(byte *, snap.rawsize);
+   uLongf      size = uLongf(snap.rawsize);
+
+   if(uncompress(raw, &size, snap.data, uLong(snap.size)) != Z_OK || size != snap.rawsize)
+   {
+      C_Printf(FC_ERROR "Snapshot is corrupt\n");
+      efree(raw);
+      return false;
+   }
+
+   // the level must be set up as the demo being played back would have it;
+   // leaving demoplayback off also stops G_InitNew from resetting players
+   demo_version    = snap.demoversion;
+   demo_subversion = snap.demosubversion;
+   demoplayback    = false;
+   netgame         = snap.net;
+   consoleplayer   = snap.console;
+
+   buffer.openMemory(raw, size, InBuffer::NENDIAN);
+   buffer.setThrowing(true);
+
+   try
+   {
+      P_LoadGameState(arc, true);
+   }
+   catch(...)
+   {
+      I_Error("P_restoreSnapshot: snapshot read error\n");
+   }
+
+   buffer.close();
+   efree(raw);
+
+   demoplayback   = snap.playback;
+   usergame       = snap.user;
+   demo_insurance = snap.insurance;
+   basetic        = gametic - snap.basetics;
+   levelstarttic  = gametic - snap.levelstarttics;
+   snaptime       = snap.time;
+
+   if(demoplayback)
+      G_SetDemoOffset(snap.demooffset);
+
+   if(displayplayer != snap.display)
+   {
+      displayplayer = snap.display;
+      P_ResetChasecam();
+   }
+
+   // no wipe, it's the same level
+   wipegamestate = GS_LEVEL;
+
+   R_FillBackScreen(scaledwindow);
+   ST_Start();
+
+   return true;
+}
+
+//
+// P_SeekSnapshot
+//
+// Goes to the given time in the history: as close as possible in a game
+// being played, or exactly during demo playback. Returns false if there's no
+// snapshot to go to.
+//
+bool P_SeekSnapshot(int time)
+{
+   int index;
+
+   if(!P_snapshotsActive() || gameaction != ga_nothing)
+      return false;
+
+   if(time < 0)
+      time = 0;
+
+   if((index = P_findSnapshot(time)) < 0)
+      index = 0;
+   if(index >= numsnapshots)
+      return false;
+
+   const snapshot_t &snap = snapshots[index];
+
+   if(!demoplayback)
+   {
+      if(!P_restoreSnapshot(snap))
+         return false;
+
+      // whatever happens next is a different game
+      for(int i = index + 1; i < numsnapshots; i++)
+         P_freeSnapshot(snapshots[i]);
+      numsnapshots = index + 1;
+
+      return true;
+   }
+
+   // running forward from where we are is quicker, if it's closer
+   if(time < snaptime || snap.time > snaptime)
+   {
+      if(!P_restoreSnapshot(snap))
+         return false;
+   }
+
+   if(time > snaptime)
+   {
+      bool wasnosfx = nosfxparm;
+
+      nosfxparm = true;
+      D_RunHeadlessTics(time - snaptime);
+      nosfxparm = wasnosfx;
+
+      S_StopSounds(true);
+   }
+
+   return true;
+}
+
+static const char *snapshot_strs[] = { "off", "demos", "always" };
+
+VARIABLE_INT(p_snapshots, NULL, SNAPSHOTS_OFF, SNAPSHOTS_ALWAYS, snapshot_strs);
+CONSOLE_VARIABLE(p_snapshots, p_snapshots, 0)
+{
+   P_ClearSnapshots();
+}
+
+VARIABLE_INT(p_snapinterval, NULL, 1, 60 * TICRATE, NULL);
+CONSOLE_VARIABLE(p_snapinterval, p_snapinterval, 0)
+{
+   P_ClearSnapshots();
+}
+
+VARIABLE_INT(p_snapmax, NULL, 4, 4096, NULL);
+CONSOLE_VARIABLE(p_snapmax, p_snapmax, 0) {}
+
+//
+// p_rewind
+//
+// Goes back the given number of seconds, 5 by default.
+//
+CONSOLE_COMMAND(p_rewind, 0)
+{
+   int seconds = Console.argc ? Console.argv[0]->toInt() : 5;
+
+   if(!P_SeekSnapshot(snaptime - seconds * TICRATE))
+      C_Printf(FC_ERROR "Can't rewind here\n");
+}
+
+//
+// p_seek
+//
+// Goes to the given tic, counted from the start of the demo.
+//
+CONSOLE_COMMAND(p_seek, 0)
+{
+   if(!Console.argc)
+   {
+      C_Printf("usage: p_seek tic\n");
+      return;
+   }
+
+   if(!P_SeekSnapshot(Console.argv[0]->toInt()))
+      C_Printf(FC_ERROR "Can't seek here\n");
+}
+
+//
+// p_snapinfo
+//
+// Reports the state of the history.
+//
+CONSOLE_COMMAND(p_snapinfo, 0)
+{
+   size_t size = 0, rawsize = 0;
+
+   for(int i = 0; i < numsnapshots; i++)
+   {
+      size    += snapshots[i].size;
+      rawsize += snapshots[i].rawsize;
+   }
+
+   C_Printf("At tic %d; %d snapshots every %d tics\n"
+            "%u KB compressed from %u KB\n", snaptime, numsnapshots, snapspacing,
+            unsigned(size / 1024), unsigned(rawsize / 1024));
+}
+
+// EOF
+
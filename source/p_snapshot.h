@@ -0,0 +1,44 @@
+//
+// The Eternity Engine
+// Copyright (C) 2018 James Haley et al.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see http://www.gnu.org/licenses/
+//
+// Additional terms and conditions compatible with the GPLv3 apply. See the
+// file COPYING-EE for details.
+//
+// Purpose: In-memory game state snapshots, for rewinding and demo seeking.
+//
+
+#ifndef P_SNAPSHOT_H__
+#define P_SNAPSHOT_H__
+
+// p_snapshots cvar values
+enum
+{
+   SNAPSHOTS_OFF,
+   SNAPSHOTS_DEMOS,  // only while playing back demos
+   SNAPSHOTS_ALWAYS
+};
+
+extern int p_snapshots;
+
+void P_SnapshotTicker();
+void P_ClearSnapshots();
+bool P_SeekSnapshot(int tic);
+
+#endif
+
+// EOF
+
@@ -430,6 +430,33 @@ sector_t *getNextSector(const line_t *line, const sector_t *sec)
             line->frontsector;
 }
 
+//
+// P_forEachSurrounding
+//
+// Calls func for every sector getNextSector finds around sec. Outside of
+// comp_model that is just the sector's neighbor list, built at level setup,
+// which names each surrounding sector once.
+//
+template<typename F>
+static void P_forEachSurrounding(const sector_t *sec, F &&func)
+{
+   if(!comp[comp_model])
+   {
+      for(int i = 0; i < sec->neighborcount; i++)
+         func(sec->neighbors[i]);
+   }
+   else
+   {
+      sector_t *other;
+
+      for(int i = 0; i < sec->linecount; i++)
+      {
+         if((other = getNextSector(sec->lines[i], sec)))
+            func(other);
+      }
+   }
+}
+
 //
 // P_FindLowestFloorSurrounding()
 //
@@ -441,16 +468,12 @@ sector_t *getNextSector(const line_t *line, const sector_t *sec)
 fixed_t P_FindLowestFloorSurrounding(const sector_t* sec)
 {
    fixed_t floor = sec->floorheight;
-   const sector_t *other;
-   int i;
-   
-   for(i = 0; i < sec->linecount; i++)
-   {
-      if((other = getNextSector(sec->lines[i], sec)) &&
-         other->floorheight < floor)
+
+   P_forEachSurrounding(sec, [&floor](const sector_t *other) {
+      if(other->floorheight < floor)
          floor = other->floorheight;
-   }
-   
+   });
+
    return floor;
 }
 
@@ -468,8 +491,6 @@ fixed_t P_FindLowestFloorSurrounding(const sector_t* sec)
 fixed_t P_FindHighestFloorSurrounding(const sector_t *sec)
 {
    fixed_t floor = -500*FRACUNIT;
-   const sector_t *other;
-   int i;
 
    //jff 1/26/98 Fix initial value for floor to not act differently
    //in sections of wad that are below -500 units
@@ -477,12 +498,10 @@ fixed_t P_FindHighestFloorSurrounding(const sector_t *sec)
    if(!comp[comp_model])          //jff 3/12/98 avoid ovf
       floor = -32000*FRACUNIT;      // in height calculations
 
-   for(i = 0; i < sec->linecount; i++)
-   {
-      if((other = getNextSector(sec->lines[i],sec)) &&
-         other->floorheight > floor)
+   P_forEachSurrounding(sec, [&floor](const sector_t *other) {
+      if(other->floorheight > floor)
          floor = other->floorheight;
-   }
+   });
    
    return floor;
 }
@@ -499,26 +518,15 @@ fixed_t P_FindHighestFloorSurrounding(const sector_t *sec)
 //
 fixed_t P_FindNextHighestFloor(const sector_t *sec, int currentheight)
 {
-   sector_t *other;
-   int i;
-   
-   for(i=0; i < sec->linecount; i++)
-   {
-      if((other = getNextSector(sec->lines[i],sec)) &&
-         other->floorheight > currentheight)
-      {
-         int height = other->floorheight;
-         while (++i < sec->linecount)
-         {
-            if((other = getNextSector(sec->lines[i],sec)) &&
-               other->floorheight < height &&
-               other->floorheight > currentheight)
-               height = other->floorheight;
-         }
-         return height;
-      }
-   }
-   return currentheight;
+   fixed_t height = currentheight;
+
+   P_forEachSurrounding(sec, [&height, currentheight](const sector_t *other) {
+      if(other->floorheight > currentheight &&
+         (height == currentheight || other->floorheight < height))
+         height = other->floorheight;
+   });
+
+   return height;
 }
 
 //
@@ -533,26 +541,15 @@ fixed_t P_FindNextHighestFloor(const sector_t *sec, int currentheight)
 //
 fixed_t P_FindNextLowestFloor(const sector_t *sec, int currentheight)
 {
-   sector_t *other;
-   int i;
-   
-   for(i=0; i < sec->linecount; i++)
-   {
-      if((other = getNextSector(sec->lines[i],sec)) &&
-         other->floorheight < currentheight)
-      {
-         int height = other->floorheight;
-         while (++i < sec->linecount)
-         {
-            if((other = getNextSector(sec->lines[i],sec)) &&
-               other->floorheight > height &&
-               other->floorheight < currentheight)
-               height = other->floorheight;
-         }
-         return height;
-      }
-   }
-   return currentheight;
+   fixed_t height = currentheight;
+
+   P_forEachSurrounding(sec, [&height, currentheight](const sector_t *other) {
+      if(other->floorheight < currentheight &&
+         (height == currentheight || other->floorheight > height))
+         height = other->floorheight;
+   });
+
+   return height;
 }
 
 //
@@ -567,26 +564,15 @@ fixed_t P_FindNextLowestFloor(const sector_t *sec, int currentheight)
 //
 fixed_t P_FindNextLowestCeiling(const sector_t *sec, int currentheight)
 {
-   sector_t *other;
-   int i;
-   
-   for(i=0 ;i < sec->linecount ; i++)
-   {
-      if((other = getNextSector(sec->lines[i],sec)) &&
-         other->ceilingheight < currentheight)
-      {
-         int height = other->ceilingheight;
-         while (++i < sec->linecount)
-         {
-            if((other = getNextSector(sec->lines[i],sec)) &&
-               other->ceilingheight > height &&
-               other->ceilingheight < currentheight)
-               height = other->ceilingheight;
-         }
-        return height;
-      }
-   }
-   return currentheight;
+   fixed_t height = currentheight;
+
+   P_forEachSurrounding(sec, [&height, currentheight](const sector_t *other) {
+      if(other->ceilingheight < currentheight &&
+         (height == currentheight || other->ceilingheight > height))
+         height = other->ceilingheight;
+   });
+
+   return height;
 }
 
 //
@@ -601,26 +587,15 @@ fixed_t P_FindNextLowestCeiling(const sector_t *sec, int currentheight)
 //
 fixed_t P_FindNextHighestCeiling(const sector_t *sec, int currentheight)
 {
-   sector_t *other;
-   int i;
-   
-   for(i=0; i < sec->linecount; i++)
-   {
-      if((other = getNextSector(sec->lines[i],sec)) &&
-         other->ceilingheight > currentheight)
-      {
-         int height = other->ceilingheight;
-         while (++i < sec->linecount)
-         {
-            if((other = getNextSector(sec->lines[i],sec)) &&
-               other->ceilingheight < height &&
-               other->ceilingheight > currentheight)
-               height = other->ceilingheight;
-         }
-         return height;
-      }
-   }
-   return currentheight;
+   fixed_t height = currentheight;
+
+   P_forEachSurrounding(sec, [&height, currentheight](const sector_t *other) {
+      if(other->ceilingheight > currentheight &&
+         (height == currentheight || other->ceilingheight < height))
+         height = other->ceilingheight;
+   });
+
+   return height;
 }
 
 //
@@ -636,40 +611,29 @@ fixed_t P_FindNextHighestCeiling(const sector_t *sec, int currentheight)
 //
 fixed_t P_FindLowestCeilingSurrounding(const sector_t* sec)
 {
-   const sector_t *other;
    fixed_t height = D_MAXINT;
-   int i;
 
    if(!comp[comp_model])
       height = 32000*FRACUNIT; //jff 3/12/98 avoid ovf in height calculations
 
-   if(demo_version >= 333)
-   {
-      // SoM: ignore attached sectors.
-      for(i = 0; i < sec->linecount; i++)
+   // SoM: ignore attached sectors.
+   const bool skipattached = demo_version >= 333;
+
+   P_forEachSurrounding(sec, [&height, sec, skipattached](const sector_t *other) {
+      if(other->ceilingheight >= height)
+         return;
+
+      if(skipattached)
       {
-         if((other = getNextSector(sec->lines[i],sec)) &&
-            other->ceilingheight < height)
+         for(int j = 0; j < sec->c_asurfacecount; j++)
          {
-            int j;
-
-            for(j = 0; j < sec->c_asurfacecount; j++)
-               if(sec->c_asurfaces[j].sector == other)
-                  break;
-            
-            if(j == sec->c_asurfacecount)
-               height = other->ceilingheight;
+            if(sec->c_asurfaces[j].sector == other)
+               return;
          }
       }
-   }
-   else
-   {      
-      for(i = 0; i < sec->linecount; i++)
-      {
-         if((other = getNextSector(sec->lines[i],sec)) && other->ceilingheight < height)
-            height = other->ceilingheight;
-      }
-   }
+
+      height = other->ceilingheight;
+   });
 
    return height;
 }
@@ -687,9 +651,7 @@ fixed_t P_FindLowestCeilingSurrounding(const sector_t* sec)
 //
 fixed_t P_FindHighestCeilingSurrounding(const sector_t* sec)
 {
-   const sector_t *other;
    fixed_t height = 0;
-   int i;
 
    //jff 1/26/98 Fix initial value for floor to not act differently
    //in sections of wad that are below 0 units
@@ -698,10 +660,10 @@ fixed_t P_FindHighestCeilingSurrounding(const sector_t* sec)
       height = -32000*FRACUNIT; //jff 3/12/98 avoid ovf in
    
    // height calculations
-   for(i=0; i < sec->linecount; i++)
-      if((other = getNextSector(sec->lines[i],sec)) &&
-         other->ceilingheight > height)
+   P_forEachSurrounding(sec, [&height](const sector_t *other) {
+      if(other->ceilingheight > height)
          height = other->ceilingheight;
+   });
       
    return height;
 }
@@ -979,14 +941,10 @@ static void P_InitTagLists()
 //
 int P_FindMinSurroundingLight(const sector_t *sector, int min)
 {
-   const sector_t *check;
-
-   for(int i = 0; i < sector->linecount; i++)
-   {
-      if((check = getNextSector(sector->lines[i], sector)) &&
-         check->lightlevel < min)
+   P_forEachSurrounding(sector, [&min](const sector_t *check) {
+      if(check->lightlevel < min)
          min = check->lightlevel;
-   }
+   });
 
    return min;
 }
@@ -650,6 +650,7 @@ public:
    // Methods
    virtual void serialize(SaveArchive &arc) override;
    virtual bool reTriggerVerticalDoor(bool player) { return false; }
+   virtual int  isolationKey() const override;
 
    // Data Members
    sector_t *sector;
@@ -742,6 +743,7 @@ protected:
 public:
    // Methods
    virtual void serialize(SaveArchive &arc) override;
+   virtual bool isIsolated() const override { return true; }
    virtual bool reTriggerVerticalDoor(bool player) override;
 
    // Data Members
@@ -762,6 +764,7 @@ protected:
 public:
    // Methods
    virtual void serialize(SaveArchive &arc) override;
+   virtual bool isIsolated() const override { return true; }
    
    // Data Members
    int     minlight;
@@ -780,6 +783,7 @@ protected:
 public:
    // Methods
    virtual void serialize(SaveArchive &arc) override;
+   virtual bool isIsolated() const override { return true; }
    
    // Data Members
    int     minlight;
@@ -826,6 +830,7 @@ protected:
 public:
    // Methods
    virtual void serialize(SaveArchive &arc) override;
+   virtual bool isIsolated() const override { return true; }
 
    // Statics
    static void Spawn(sector_t *sector, int base, int index);
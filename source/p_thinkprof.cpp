@@ -0,0 +1,335 @@
+//
+// The Eternity Engine
+// Copyright (C) 2018 James Haley et al.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see http://www.gnu.org/licenses/
+//
+// Additional terms and conditions compatible with the GPLv3 apply. See the
+// file COPYING-EE for details.
+//
+// Purpose: Thinker profiler. Times thinkers and action functions, grouped
+//  by thinker class, thing type and codepointer.
+//
+//  While p_thinkprof is on, every Think call is timed and added to the
+//  totals of its RTTI class, and, for Mobjs, of its thing type. Action
+//  functions called from P_SetMobjState are timed separately, by
+//  codepointer. Times are inclusive: an action function's time also counts
+//  towards the thing that was thinking when it ran.
+//
+//  -thinkprof turns profiling on from the start. During -timedemo it also
+//  writes every tic's totals to a CSV file, named by the parameter's
+//  argument, or thinkprof.csv in the user game directory.
+//
+
+#include "z_zone.h"
+
+#include <chrono>
+
+#include "c_io.h"
+#include "c_runcmd.h"
+#include "d_dehtbl.h"
+#include "doomstat.h"
+#include "info.h"
+#include "m_argv.h"
+#include "m_qstr.h"
+#include "p_mobj.h"
+#include "p_thinkprof.h"
+#include "p_tick.h"
+#include "v_misc.h"
+
+bool p_thinkprof;
+
+enum
+{
+   PROF_CLASS,      // thinker class
+   PROF_MOBJTYPE,   // thing type of Mobj thinkers
+   PROF_CODEPOINTER,
+   NUMPROFCATEGORIES
+};
+
+static const char *profCategoryNames[NUMPROFCATEGORIES] =
+{
+   "class", "thingtype", "codepointer"
+};
+
+//
+// profentry_t
+//
+// Totals for one class, thing type or codepointer.
+//
+struct profentry_t
+{
+   int          category;
+   uintptr_t    key;
+   const char  *name;
+   uint64_t     calls;    // since the last reset
+   int64_t      time;     // nanoseconds since the last reset
+   uint64_t     ticcalls; // during the current tic
+   int64_t      tictime;
+   profentry_t *next;     // next on hash chain
+};
+
+#define PROF_NUMCHAINS 257
+
+static profentry_t  *profchains[PROF_NUMCHAINS];
+static profentry_t **profentries; // every entry, for listing
+static int           numprofentries;
+static int           maxprofentries;
+
+static char  *profcsvname; // CSV file for -timedemo, if requested
+static FILE  *profcsv;
+
+//
+// P_ProfileClock
+//
+// Returns a timestamp in nanoseconds. The HAL timer only has microsecond
+// resolution, which is coarser than most Think calls.
+//
+int64_t P_ProfileClock()
+{
+   using namespace std::chrono;
+
+   return duration_cast<nanoseconds>(steady_clock::now().time_since_epoch()).count();
+}
+
+//
+// P_getProfEntry
+//
+// Finds or adds the entry for a key. name is only evaluated for new ones.
+//
+static profentry_t *P_getProfEntry(int category, uintptr_t key, const char *name)
+{
+   unsigned int chain = unsigned((key ^ (key >> 9)) * 3 + category) % PROF_NUMCHAINS;
+
+   for(profentry_t *entry = profchains[chain]; entry; entry = entry->next)
+   {
+      if(entry->category == category && entry->key == key)
+         return entry;
+   }
+
+   profentry_t *entry = estructalloc(profentry_t, 1);
+   entry->category = category;
+   entry->key      = key;
+   entry->name     = name;
+   entry->next     = profchains[chain];
+   profchains[chain] = entry;
+
+   if(numprofentries == maxprofentries)
+   {
+      maxprofentries = maxprofentries ? maxprofentries * 2 : 128;
+      profentries = erealloc(profentry_t **, profentries,
+                             maxprofentries * sizeof(*profentries));
+   }
+   profentries[numprofentries++] = entry;
+
+   return entry;
+}
+
+//
+// P_addProfTime
+//
+static void P_addProfTime(profentry_t *entry, int64_t time)
+{
+   ++entry->calls;
+   ++entry->ticcalls;
+   entry->time    += time;
+   entry->tictime += time;
+}
+
+//
+// P_ProfileThinker
+//
+// Adds a finished Think call which started at the given time.
+//
+void P_ProfileThinker(const Thinker *th, int64_t start)
+{
+   int64_t time = P_ProfileClock() - start;
+   auto    type = th->getDynamicType();
+
+   P_addProfTime(P_getProfEntry(PROF_CLASS, uintptr_t(type), type->getName()), time);
+
+   if(type == &Mobj::StaticType)
+   {
+      mobjtype_t mobjtype = static_cast<const Mobj *>(th)->type;
+
+      P_addProfTime(P_getProfEntry(PROF_MOBJTYPE, uintptr_t(mobjtype),
+                                   mobjinfo[mobjtype]->name), time);
+   }
+}
+
+//
+// P_codepointerName
+//
+// Returns the BEX mnemonic of an action function.
+//
+static const char *P_codepointerName(actionptr_t action)
+{
+   for(int i = 0; i < num_bexptrs; i++)
+   {
+      if(deh_bexptrs[i].cptr == action)
+         return deh_bexptrs[i].lookup;
+   }
+   return "(unknown)";
+}
+
+//
+// P_ProfileAction
+//
+// Adds a finished action function call which started at the given time.
+//
+void P_ProfileAction(actionptr_t action, int64_t start)
+{
+   int64_t      time  = P_ProfileClock() - start;
+   uintptr_t    key   = reinterpret_cast<uintptr_t>(action);
+   profentry_t *entry = P_getProfEntry(PROF_CODEPOINTER, key, nullptr);
+
+   if(!entry->name)
+      entry->name = P_codepointerName(action);
+
+   P_addProfTime(entry, time);
+}
+
+//
+// P_ProfileEndTic
+//
+// Called at the end of each profiled tic. Writes the tic's totals to the
+// CSV file during timed demos, then clears them.
+//
+void P_ProfileEndTic()
+{
+   if(profcsvname && timingdemo && !profcsv)
+   {
+      if((profcsv = fopen(profcsvname, "w")))
+         fputs("gametic,category,name,calls,microseconds\n", profcsv);
+      else
+         C_Printf(FC_ERROR "Could not open %s\n", profcsvname);
+      efree(profcsvname);
+      profcsvname = nullptr;
+   }
+
+   for(int i = 0; i < numprofentries; i++)
+   {
+      profentry_t *entry = profentries[i];
+
+      if(!entry->ticcalls)
+         continue;
+      if(profcsv)
+      {
+         fprintf(profcsv, "%d,%s,%s,%llu,%.3f\n", gametic,
+                 profCategoryNames[entry->category], entry->name,
+                 (unsigned long long)entry->ticcalls, entry->tictime / 1000.0);
+      }
+      entry->ticcalls = 0;
+      entry->tictime  = 0;
+   }
+
+   // timed demos end with I_Error, so don't leave anything buffered
+   if(profcsv)
+      fflush(profcsv);
+}
+
+//
+// P_InitThinkerProfile
+//
+// Handles -thinkprof.
+//
+void P_InitThinkerProfile()
+{
+   int p;
+
+   if(!(p = M_CheckParm("-thinkprof")))
+      return;
+
+   p_thinkprof = true;
+
+   if(p < myargc - 1 && *myargv[p + 1] != '-')
+      profcsvname = estrdup(myargv[p + 1]);
+   else
+   {
+      qstring path(usergamepath);
+      path.pathConcatenate("thinkprof.csv");
+      profcsvname = path.duplicate();
+   }
+}
+
+//
+// P_compareProfEntries
+//
+// qsort callback putting the most expensive entries first.
+//
+static int P_compareProfEntries(const void *a, const void *b)
+{
+   const profentry_t *ea = *static_cast<profentry_t * const *>(a);
+   const profentry_t *eb = *static_cast<profentry_t * const *>(b);
+
+   if(ea->time != eb->time)
+      return ea->time > eb->time ? -1 : 1;
+   return 0;
+}
+
+VARIABLE_TOGGLE(p_thinkprof, NULL, onoff);
+CONSOLE_VARIABLE(p_thinkprof, p_thinkprof, 0) {}
+
+//
+// p_profdump
+//
+// Lists the top N (default 10) entries of each category by total time.
+//
+CONSOLE_COMMAND(p_profdump, 0)
+{
+   int count = Console.argc ? Console.argv[0]->toInt() : 10;
+
+   if(numprofentries > 1)
+   {
+      qsort(profentries, numprofentries, sizeof(*profentries),
+            P_compareProfEntries);
+   }
+
+   for(int category = 0; category < NUMPROFCATEGORIES; category++)
+   {
+      int shown = 0;
+
+      C_Printf(FC_HI "By %s:\n", profCategoryNames[category]);
+
+      for(int i = 0; i < numprofentries && shown < count; i++)
+      {
+         const profentry_t *entry = profentries[i];
+
+         if(entry->category != category || !entry->calls)
+            continue;
+
+         C_Printf("%-24s %9llu calls %10.2f ms %8.3f us/call\n", entry->name,
+                  (unsigned long long)entry->calls, entry->time / 1000000.0,
+                  entry->time / 1000.0 / entry->calls);
+         ++shown;
+      }
+   }
+}
+
+//
+// p_profreset
+//
+// Clears all totals.
+//
+CONSOLE_COMMAND(p_profreset, 0)
+{
+   for(int i = 0; i < numprofentries; i++)
+   {
+      profentries[i]->calls = 0;
+      profentries[i]->time  = 0;
+   }
+}
+
+// EOF
+
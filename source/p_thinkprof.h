@@ -0,0 +1,44 @@
+//
+// The Eternity Engine
+// Copyright (C) 2018 James Haley et al.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see http://www.gnu.org/licenses/
+//
+// Additional terms and conditions compatible with the GPLv3 apply. See the
+// file COPYING-EE for details.
+//
+// Purpose: Thinker profiler. Times thinkers and action functions, grouped
+//  by thinker class, thing type and codepointer.
+//
+
+#ifndef P_THINKPROF_H__
+#define P_THINKPROF_H__
+
+class Thinker;
+struct actionargs_t;
+
+typedef void (*actionptr_t)(actionargs_t *);
+
+extern bool p_thinkprof; // cvar: profiling is on
+
+int64_t P_ProfileClock();
+void    P_ProfileThinker(const Thinker *th, int64_t start);
+void    P_ProfileAction(actionptr_t action, int64_t start);
+void    P_ProfileEndTic();
+void    P_InitThinkerProfile();
+
+#endif
+
+// EOF
+
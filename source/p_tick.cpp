@@ -32,11 +32,13 @@
 #include "d_main.h"
 #include "doomstat.h"
 #include "i_system.h"
+#include "m_parallel.h"
 #include "p_anim.h"
 #include "p_chase.h"
 #include "p_saveg.h"
 #include "p_sector.h"
 #include "p_spec.h"
+#include "p_thinkprof.h"
 #include "p_tick.h"
 #include "p_user.h"
 #include "p_partcl.h"
@@ -64,6 +66,9 @@ Thinker thinkercap;
 
 Thinker thinkerclasscap[NUMTHCLASS];
 
+// set when a thinker joins or leaves the th_isolated list
+static bool isolatedchanged;
+
 // 
 // Thinker::StaticType
 //
@@ -80,6 +85,8 @@ void Thinker::InitThinkers(void)
       thinker.cprev = thinker.cnext = &thinker;
 
    thinkercap.prev = thinkercap.next  = &thinkercap;
+
+   isolatedchanged = true;
 }
 
 //
@@ -96,6 +103,10 @@ void Thinker::addToThreadedList(int tclass)
    if((th = this->cnext) != NULL)
       (th->cprev = this->cprev)->cnext = th;
 
+   if(isolated || tclass == th_isolated)
+      isolatedchanged = true;
+   isolated = (tclass == th_isolated);
+
    // Add to appropriate thread
    th = &thinkerclasscap[tclass];
    th->cprev->cnext = this;
@@ -119,7 +130,14 @@ void Thinker::addToThreadedList(int tclass)
 //
 void Thinker::updateThinker()
 {
-   addToThreadedList(this->removed ? th_delete : th_misc);
+   int tclass = th_misc;
+
+   if(this->removed)
+      tclass = th_delete;
+   else if(isIsolated())
+      tclass = th_isolated;
+
+   addToThreadedList(tclass);
 }
 
 //
@@ -204,6 +222,153 @@ void Thinker::remove()
    updateThinker();
 }
 
+//=============================================================================
+//
+// Isolated thinkers
+//
+// The th_isolated list is sorted into groups of thinkers sharing a key, and
+// the groups are packed into batches of roughly equal size, one work item
+// each. Within a group, thinkers run in their order in the list, so the
+// result is the same no matter how many threads there are. The batches are
+// only rebuilt when the list changes.
+//
+
+// thinkers per parallel work item
+#define ISOLATED_BATCHSIZE 256
+
+struct isothinker_t
+{
+   Thinker *thinker;
+   int      key;   // from isolationKey
+   int      order; // position in the th_isolated list
+};
+
+static isothinker_t *isothinkers;
+static int           numisothinkers;
+static int           maxisothinkers;
+
+// first thinker of each batch, plus one past the end of the last
+static int *isobatches;
+static int  numisobatches;
+static int  maxisobatches;
+
+//
+// P_compareIsoThinkers
+//
+// qsort callback ordering isolated thinkers by key, then list position.
+//
+static int P_compareIsoThinkers(const void *a, const void *b)
+{
+   const isothinker_t *ta = static_cast<const isothinker_t *>(a);
+   const isothinker_t *tb = static_cast<const isothinker_t *>(b);
+
+   if(ta->key != tb->key)
+      return ta->key < tb->key ? -1 : 1;
+   return ta->order - tb->order;
+}
+
+//
+// P_addIsolatedBatch
+//
+// Records the start of a batch.
+//
+static void P_addIsolatedBatch(int first)
+{
+   if(numisobatches == maxisobatches)
+   {
+      maxisobatches = maxisobatches ? maxisobatches * 2 : 64;
+      isobatches = erealloc(int *, isobatches, maxisobatches * sizeof(*isobatches));
+   }
+   isobatches[numisobatches++] = first;
+}
+
+//
+// P_buildIsolatedBatches
+//
+// Gathers the th_isolated list and splits it into batches on key
+// boundaries.
+//
+static void P_buildIsolatedBatches()
+{
+   Thinker *cap = &thinkerclasscap[th_isolated];
+
+   numisothinkers = 0;
+   for(Thinker *th = cap->cnext; th != cap; th = th->cnext)
+   {
+      if(numisothinkers == maxisothinkers)
+      {
+         maxisothinkers = maxisothinkers ? maxisothinkers * 2 : 256;
+         isothinkers = erealloc(isothinker_t *, isothinkers,
+                                maxisothinkers * sizeof(*isothinkers));
+      }
+      isothinker_t &it = isothinkers[numisothinkers];
+      it.thinker = th;
+      it.key     = th->isolationKey();
+      it.order   = numisothinkers++;
+   }
+
+   if(numisothinkers > 1)
+      qsort(isothinkers, numisothinkers, sizeof(*isothinkers), P_compareIsoThinkers);
+
+   numisobatches = 0;
+   for(int i = 0; i < numisothinkers; i++)
+   {
+      // start a new batch once the current one is full, but never split a group
+      if(i && (i - isobatches[numisobatches - 1] < ISOLATED_BATCHSIZE ||
+               isothinkers[i].key == isothinkers[i - 1].key))
+         continue;
+      P_addIsolatedBatch(i);
+   }
+   P_addIsolatedBatch(numisothinkers);
+   --numisobatches; // the last entry only marks the end
+
+   isolatedchanged = false;
+}
+
+//
+// Thinker::RunIsolatedBatch
+//
+// Work function running one batch of isolated thinkers.
+//
+void Thinker::RunIsolatedBatch(int index, int worker, void *data)
+{
+   for(int i = isobatches[index]; i < isobatches[index + 1]; i++)
+      isothinkers[i].thinker->Think();
+}
+
+//
+// Thinker::RunIsolatedThinkers
+//
+// Runs every thinker in the th_isolated list, spread across the workers.
+//
+void Thinker::RunIsolatedThinkers()
+{
+   if(isolatedchanged)
+      P_buildIsolatedBatches();
+
+   // the profiler isn't thread-safe; the batches may as well run in order
+   if(p_thinkprof)
+   {
+      for(int i = 0; i < numisothinkers; i++)
+         isothinkers[i].thinker->profiledThink();
+   }
+   else
+      M_ParallelFor(numisobatches, RunIsolatedBatch, nullptr);
+}
+
+//
+// Thinker::profiledThink
+//
+// Think, with the time taken going to the thinker profiler.
+//
+void Thinker::profiledThink()
+{
+   int64_t start = P_ProfileClock();
+
+   Think();
+   P_ProfileThinker(this, start);
+}
+
 //
 // P_RunThinkers
 //
@@ -226,14 +391,25 @@ void Thinker::remove()
 // Rewritten to delete nodes implicitly, by making currentthinker
 // external and using P_RemoveThinkerDelayed() implicitly.
 //
+// Isolated thinkers run in a batch first, except in old demos.
+//
 void Thinker::RunThinkers(void)
 {
+   bool phased = (full_demo_version >= make_full_version(401, 1));
+
+   if(phased)
+      RunIsolatedThinkers();
+
    for(currentthinker = thinkercap.next; 
        currentthinker != &thinkercap;
        currentthinker = currentthinker->next)
    {
       if(currentthinker->removed)
          currentthinker->removeDelayed();
+      else if(phased && currentthinker->isolated)
+         continue;
+      else if(p_thinkprof)
+         currentthinker->profiledThink();
       else
          currentthinker->Think();
    }
@@ -308,6 +484,9 @@ void P_Ticker()
    leveltime++;                       // for par times
 
    P_RunEffects(); // haleyjd: run particle effects
+
+   if(p_thinkprof)
+      P_ProfileEndTic();
 }
 
 //----------------------------------------------------------------------------
@@ -39,6 +39,11 @@ private:
    // Private implementation details - Methods
    void removeDelayed(); 
 
+   void profiledThink();
+
+   static void RunIsolatedThinkers();
+   static void RunIsolatedBatch(int index, int worker, void *data);
+
    // Data members
    // killough 11/98: count of how many other objects reference
    // this one using pointers. Used for garbage collection.
@@ -57,6 +62,7 @@ protected:
 
    // Data Members
    bool removed;
+   bool isolated; // in the th_isolated list
 
    // haleyjd 12/22/2010: for savegame enumeration
    unsigned int ordinal;
@@ -64,8 +70,8 @@ protected:
 public:
    // Constructor
    Thinker() 
-      : Super(), references(0), removed(false), ordinal(0), prev(NULL),
-        next(NULL), cprev(NULL), cnext(NULL)
+      : Super(), references(0), removed(false), isolated(false), ordinal(0),
+        prev(NULL), next(NULL), cprev(NULL), cnext(NULL)
    {
    }
 
@@ -101,6 +107,15 @@ public:
    // De-swizzling should restore pointers to other thinkers.
    virtual void deSwizzle() {}
    virtual bool shouldSerialize() const { return !removed;  }
+
+   // Isolation
+   // Thinkers which only ever change state owned by one sector or side, and
+   // don't use the RNG, may say so here. In new demos they then run at the
+   // start of each tic, split across worker threads, rather than in thinker
+   // list order. Isolated thinkers with the same key are never run
+   // concurrently with each other.
+   virtual bool isIsolated() const { return false; }
+   virtual int  isolationKey() const { return 0; }
    
    // Data Members
 
@@ -197,6 +212,7 @@ typedef enum
   th_misc,
   th_friends,
   th_enemies,
+  th_isolated, // see Thinker::isIsolated
   NUMTHCLASS
 } th_class;
 
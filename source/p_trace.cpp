@@ -40,6 +40,7 @@
 #include "p_setup.h"
 #include "p_skin.h"
 #include "p_spec.h"
+#include "p_visit.h"
 #include "r_defs.h"
 #include "r_main.h"
 #include "r_sky.h"
@@ -952,7 +953,7 @@ bool P_PathTraverse(fixed_t x1, fixed_t y1, fixed_t x2, fixed_t y2,
    int     mapxstep, mapystep;
    int     count;
 
-   validcount++;
+   P_SearchVisit().begin();
    intercept_p = intercepts;
    
    if(!((x1-bmaporgx)&(MAPBLOCKSIZE-1)))
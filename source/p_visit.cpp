@@ -0,0 +1,132 @@
+//
+// The Eternity Engine
+// Copyright (C) 2018 James Haley et al.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see http://www.gnu.org/licenses/
+//
+// Additional terms and conditions compatible with the GPLv3 apply. See the
+// file COPYING-EE for details.
+//
+// Purpose: Per-query visit marks for blockmap and BSP searches.
+//
+//  These replace the single global validcount stamp that searches used to
+//  store in every line, polyobject and sector. With it, no two searches
+//  could be in progress at the same time on different threads. Each worker
+//  thread now owns its contexts, so read-only queries can run on any of
+//  them.
+//
+//  Every thread has two contexts. The search context is shared by the
+//  blockmap iterators, the movement code, old-style sight checks and path
+//  traversal. Those searches can start one another from inside callbacks,
+//  and demos depend on what the inner search does to the outer one's
+//  marks, so they keep sharing the one stamp exactly as they shared
+//  validcount. The traverse context belongs to PathTraverser, which gathers
+//  all of its lines before calling back into anything. It used to keep a
+//  private bit array per query for that reason; reusing one context per
+//  thread gives the same result without clearing memory for every query.
+//
+
+#include "z_zone.h"
+
+#include "m_compare.h"
+#include "m_parallel.h"
+#include "p_setup.h"
+#include "p_visit.h"
+#include "polyobj.h"
+#include "r_state.h"
+
+static VisitContext searchvisit[M_MAXWORKERS];
+static VisitContext traversevisit[M_MAXWORKERS];
+
+//
+// VisitContext::clear
+//
+// Removes every mark. Needed when the epoch wraps around, so that objects
+// stamped 4 billion searches ago don't count as visited.
+//
+void VisitContext::clear()
+{
+   if(numlines)
+      memset(lines, 0, numlines * sizeof(*lines));
+   if(numpolys)
+      memset(polys, 0, numpolys * sizeof(*polys));
+   if(numsectors)
+      memset(sectors, 0, numsectors * sizeof(*sectors));
+   epoch = 1;
+}
+
+//
+// VisitContext::resize
+//
+// Makes room for the given number of objects and clears all marks.
+//
+void VisitContext::resize(int pNumLines, int pNumPolys, int pNumSectors)
+{
+   if(lines)
+      efree(lines);
+   if(polys)
+      efree(polys);
+   if(sectors)
+      efree(sectors);
+
+   numlines   = pNumLines;
+   numpolys   = pNumPolys;
+   numsectors = pNumSectors;
+
+   lines   = ecalloc(unsigned int *, emax(numlines,   1), sizeof(*lines));
+   polys   = ecalloc(unsigned int *, emax(numpolys,   1), sizeof(*polys));
+   sectors = ecalloc(unsigned int *, emax(numsectors, 1), sizeof(*sectors));
+   epoch   = 1;
+}
+
+//
+// P_InitVisitContexts
+//
+// Sizes the contexts of every thread for the current level. Called once the
+// lines and sectors are loaded, and again once polyobjects are spawned.
+//
+void P_InitVisitContexts()
+{
+   int count = M_WorkerCount();
+
+   for(int i = 0; i < count; i++)
+   {
+      searchvisit[i].resize(numlines, numPolyObjects, numsectors);
+      traversevisit[i].resize(numlines, numPolyObjects, numsectors);
+   }
+}
+
+//
+// P_SearchVisit
+//
+// Returns the running thread's context for blockmap searches, movement
+// clipping, sound propagation and old-style sight checks.
+//
+VisitContext &P_SearchVisit()
+{
+   return searchvisit[M_CurrentWorker()];
+}
+
+//
+// P_TraverseVisit
+//
+// Returns the running thread's context for PathTraverser.
+//
+VisitContext &P_TraverseVisit()
+{
+   return traversevisit[M_CurrentWorker()];
+}
+
+// EOF
+
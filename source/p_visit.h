@@ -0,0 +1,97 @@
+//
+// The Eternity Engine
+// Copyright (C) 2018 James Haley et al.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see http://www.gnu.org/licenses/
+//
+// Additional terms and conditions compatible with the GPLv3 apply. See the
+// file COPYING-EE for details.
+//
+// Purpose: Per-query visit marks for blockmap and BSP searches.
+//
+
+#ifndef P_VISIT_H__
+#define P_VISIT_H__
+
+//
+// VisitContext
+//
+// Remembers which lines, polyobjects and sectors a search has already
+// looked at. Each search calls begin(), which moves the context to a new
+// epoch and so forgets every earlier mark without clearing anything. Every
+// thread has its own contexts, so searches on different threads never see
+// each other's marks.
+//
+class VisitContext
+{
+protected:
+   unsigned int *lines;
+   unsigned int *polys;
+   unsigned int *sectors;
+   int numlines, numpolys, numsectors;
+   unsigned int epoch;
+
+   void clear();
+
+public:
+   VisitContext() 
+      : lines(nullptr), polys(nullptr), sectors(nullptr), numlines(0), 
+        numpolys(0), numsectors(0), epoch(0)
+   {
+   }
+
+   void resize(int pNumLines, int pNumPolys, int pNumSectors);
+
+   //
+   // begin
+   //
+   // Starts a new search. Marks made by the previous one are forgotten.
+   //
+   void begin()
+   {
+      if(!++epoch)
+         clear();
+   }
+
+   // Each visit function marks the object and returns true if the current
+   // search had not visited it yet.
+   bool visitLine(int linenum)
+   {
+      if(lines[linenum] == epoch)
+         return false;
+      lines[linenum] = epoch;
+      return true;
+   }
+
+   bool visitPoly(int polynum)
+   {
+      if(polys[polynum] == epoch)
+         return false;
+      polys[polynum] = epoch;
+      return true;
+   }
+
+   bool sectorVisited(int secnum) const { return sectors[secnum] == epoch; }
+   void markSector(int secnum)          { sectors[secnum] = epoch;         }
+};
+
+void P_InitVisitContexts();
+
+VisitContext &P_SearchVisit();
+VisitContext &P_TraverseVisit();
+
+#endif
+
+// EOF
+
@@ -51,6 +51,7 @@
 #include "p_slopes.h"
 #include "p_spec.h"
 #include "p_tick.h"
+#include "p_visit.h"
 #include "polyobj.h"
 #include "r_main.h"
 #include "r_portal.h"
@@ -920,12 +921,13 @@ static bool Polyobj_clipThings(polyobj_t *po, line_t *line,
       {
          if(!(x < 0 || y < 0 || x >= bmapwidth || y >= bmapheight))
          {
-            Mobj *mo = blocklinks[y * bmapwidth + x];
-
             // haleyjd 08/14/10: use modification-safe traversal
-            while(mo)
+            BlockThingCursor cursor(x, y);
+            const blockthing_t *bt;
+
+            while((bt = cursor.next()))
             {
-               Mobj *next = mo->bnext;
+               Mobj *mo = bt->mo;
 
                // always push players even if not solid
                if(((mo->flags & MF_SOLID) || mo->player) && 
@@ -958,7 +960,6 @@ static bool Polyobj_clipThings(polyobj_t *po, line_t *line,
                      hitthing = true;
                   }
                }
-               mo = next; // demo compatibility is not a factor here
             }
          } // end if
       } // end for(x)
@@ -1088,6 +1089,9 @@ static bool Polyobj_moveXY(polyobj_t *po, fixed_t x, fixed_t y, bool onload = fa
       Polyobj_updateAnchoredPortals(*po);
    }
 
+   // sight through the polyobject may have changed, even if it moved back
+   P_InvalidateSightCache();
+
    return !hitthing;
 }
 
@@ -1249,6 +1253,9 @@ static bool Polyobj_rotate(polyobj_t *po, angle_t delta, bool onload = false)
       Polyobj_updateAnchoredPortals(*po);
    }
 
+   // sight through the polyobject may have changed, even if it moved back
+   P_InvalidateSightCache();
+
    return !hitthing;
 }
 
@@ -1393,6 +1400,9 @@ void Polyobj_InitLevel(void)
          Polyobj_linkToBlockmap(&PolyObjects[i]);
    }
 
+   // make room for the polyobjects in search visit marks
+   P_InitVisitContexts();
+
    // done with mobj queues
    M_QueueFree(&spawnqueue);
    M_QueueFree(&anchorqueue);
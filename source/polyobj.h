@@ -94,7 +94,6 @@ typedef struct polyobj_s
 
    fixed_t blockbox[4];        // bounding box for clipping
    polymaplink_t *linkhead;    // haleyjd 05/18/06: unlink optimization
-   int validcount;             // for clipping: prevents multiple checks
    int damage;                 // damage to inflict on stuck things
    fixed_t thrust;             // amount of thrust to put on blocking objects
 
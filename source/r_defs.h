@@ -36,7 +36,6 @@
 #include "p_mobj.h"
 
 struct line_t;
-struct particle_t;
 struct planehash_t;
 struct portal_t;
 struct sector_t;
@@ -191,6 +190,7 @@ struct sectoraction_t
 struct sectorinterp_t
 {
    bool    interpolated;       // if true, interpolated
+   bool    moved;              // listed in movedsectors
 
    fixed_t prevfloorheight;    // previous values, stored for interpolation
    fixed_t prevceilingheight;
@@ -301,6 +301,10 @@ struct sector_t
    int linecount;
    line_t **lines;
 
+   // sectors across this one's 2S lines, each listed once
+   int neighborcount;
+   sector_t **neighbors;
+
    // SoM 9/19/02: Better way to move 3dsides with a sector.
    // SoM 11/09/04: Improved yet again!
    int f_numattached;
@@ -338,8 +342,6 @@ struct sector_t
    // haleyjd 09/24/06: sound sequence id
    int sndSeqID;
 
-   DLListItem<particle_t> *ptcllist; // haleyjd 02/20/04: list of particles in sector
-
    // haleyjd 07/04/07: Happy July 4th :P
    // Angles for flat rotation!
    float floorangle, ceilingangle, floorbaseangle, ceilingbaseangle;
@@ -33,9 +33,11 @@
 #include "e_lib.h"
 #include "mn_engin.h"
 #include "r_draw.h"
+#include "r_drawt.h"
 #include "r_main.h"
 #include "st_stuff.h"
 #include "v_alloc.h"
+#include "v_dirty.h"
 #include "v_misc.h"
 #include "v_patchfmt.h"
 #include "v_video.h"
@@ -63,6 +65,7 @@ rrect_t viewwindow;   // haleyjd 05/02/13
 rrect_t scaledwindow; // haleyjd 05/02/13
 
 int   linesize = SCREENWIDTH;  // killough 11/98
+int   columnstep = 1;          // 1 unless drawing into a transposed buffer
 byte *renderscreen;            // haleyjd
 
 // Color tables for different players,
@@ -1048,6 +1051,8 @@ columndrawer_t r_normal_drawer =
    CB_DrawAddColumn_8,
    CB_DrawAddTRColumn_8,
 
+   NULL,
+   NULL,
    NULL,
 
    {
@@ -1061,6 +1066,41 @@ columndrawer_t r_normal_drawer =
    },
 };
 
+//
+// Transposed Column Drawer Object
+//
+// Draws walls through the normal drawers into a column-major buffer, which
+// is transposed onto the screen before planes are drawn. Sky columns, masked
+// textures and sprites are drawn after planes, straight onto the screen.
+//
+columndrawer_t r_transposed_drawer =
+{
+   CB_DrawColumn_8,
+   CB_DrawNewSkyColumn_8,
+   CB_DrawTLColumn_8,
+   CB_DrawTRColumn_8,
+   CB_DrawTLTRColumn_8,
+   CB_DrawFuzzColumn_8,
+   CB_DrawFlexColumn_8,
+   CB_DrawFlexTRColumn_8,
+   CB_DrawAddColumn_8,
+   CB_DrawAddTRColumn_8,
+
+   NULL,
+   R_TBeginWalls,
+   R_TEndWalls,
+
+   {
+      // Normal              Translated
+      { CB_DrawColumn_8,     CB_DrawTRColumn_8     }, // NORMAL
+      { CB_DrawFuzzColumn_8, CB_DrawFuzzColumn_8   }, // SHADOW
+      { CB_DrawFlexColumn_8, CB_DrawFlexTRColumn_8 }, // ALPHA
+      { CB_DrawAddColumn_8,  CB_DrawAddTRColumn_8  }, // ADD
+      { CB_DrawTLColumn_8,   CB_DrawTLTRColumn_8   }, // SUB
+      { CB_DrawTLColumn_8,   CB_DrawTLTRColumn_8   }, // TRANMAP
+   },
+};
+
 //
 // R_InitTranslationTables
 // Creates the translation tables to map
@@ -1256,6 +1296,7 @@ void R_InitBuffer(int width, int height)
 { 
    // SoM: use pitch damn you!
    linesize     = video.pitch;      // killough 11/98
+   columnstep   = 1;
    renderscreen = video.screens[0]; // haleyjd 07/02/14
 } 
 
@@ -1324,6 +1365,9 @@ void R_FillBackScreen(const rrect_t &window)
                window.y+window.height,     // killough 11/98
                &backscreen1,
                PatchLoader::CacheName(wGlobalDir, border->c_br, PU_CACHE));
+
+   // everything copied from the old back screen is now stale
+   V_MarkAllDirty();
 } 
 
 //
@@ -1364,6 +1408,18 @@ void R_VideoEraseScaled(unsigned int x, unsigned int y, unsigned int w, unsigned
    V_BlitVBuffer(&vbscreen, x, y, &backscreen1, x, y, w, h);
 }
 
+//
+// R_eraseBorderIfDirty
+//
+// Restores one view border rect from the back screen, unless nothing has been
+// drawn over it since it was last restored.
+//
+static void R_eraseBorderIfDirty(int x, int y, int w, int h)
+{
+   if(w > 0 && h > 0 && V_IsDirty(&vbscreen, x, y, w, h))
+      R_VideoErase(x, y, w, h);
+}
+
 //
 // R_DrawViewBorder
 // Draws the border around the view
@@ -1380,15 +1436,16 @@ void R_DrawViewBorder()
 
    // copy top
    // SoM: ANYRES
-   R_VideoErase(0, 0, SCREENWIDTH, scaledwindow.y);
+   R_eraseBorderIfDirty(0, 0, SCREENWIDTH, scaledwindow.y);
 
    // copy sides
    side = scaledwindow.x;
-   R_VideoErase(0, scaledwindow.y, side, scaledwindow.height);
-   R_VideoErase(SCREENWIDTH - side, scaledwindow.y, side, scaledwindow.height);
+   R_eraseBorderIfDirty(0, scaledwindow.y, side, scaledwindow.height);
+   R_eraseBorderIfDirty(SCREENWIDTH - side, scaledwindow.y, side, scaledwindow.height);
 
    // copy bottom 
-   R_VideoErase(0, scaledwindow.y + scaledwindow.height, SCREENWIDTH, scaledwindow.y);
+   R_eraseBorderIfDirty(0, scaledwindow.y + scaledwindow.height, SCREENWIDTH, 
+                        scaledwindow.y);
 }
 
 //----------------------------------------------------------------------------
@@ -77,15 +77,19 @@ struct columndrawer_t
    void (*DrawAddTRColumn)();  // additive flextran/translated
 
    void (*ResetBuffer)();      // reset function (may be null)
+   void (*BeginWalls)();       // called before walls are drawn (may be null)
+   void (*EndWalls)();         // called after walls are drawn (may be null)
    
    void (*ByVisSpriteStyle[VS_NUMSTYLES][2])();
 };
 
 extern columndrawer_t r_normal_drawer;
+extern columndrawer_t r_transposed_drawer;
 
 #define TRANSLATIONCOLOURS 14
 
 extern int   linesize;     // killough 11/98
+extern int   columnstep;   // distance between horizontally adjacent pixels
 extern byte *renderscreen; // haleyjd 07/02/14
 
 void R_VideoErase(unsigned int x, unsigned int y, unsigned int w, unsigned int h);
@@ -152,7 +156,7 @@ extern byte  *main_tranmap;  // killough 4/11/98
 extern byte  *main_submap;   // haleyjd 11/30/13
 
 #define R_ADDRESS(px, py) \
-   (renderscreen + (viewwindow.y + (py)) * linesize + (viewwindow.x + (px)))
+   (renderscreen + (viewwindow.y + (py)) * linesize + (viewwindow.x + (px)) * columnstep)
 
 #define FUZZTABLE 50 
 #define FUZZOFF (SCREENWIDTH)
@@ -1798,6 +1798,8 @@ columndrawer_t r_quad_drawer =
    R_QDrawAddTRColumn,
 
    R_QResetColumnBuffer,
+   NULL,
+   NULL,
 
    {
       // Normal            Translated
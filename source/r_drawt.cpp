@@ -0,0 +1,335 @@
+//
+// The Eternity Engine
+// Copyright (C) 2018 James Haley et al.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see http://www.gnu.org/licenses/
+//
+// Additional terms and conditions compatible with the GPLv3 apply. See the
+// file COPYING-EE for details.
+//
+// Purpose: Column engine that draws walls into a transposed buffer.
+//
+//  Column drawers walk down the screen, so in a row-major framebuffer each
+//  pixel they write lands on a different cache line, and at high resolutions
+//  on a different page as well. This engine points the column drawers at a
+//  column-major buffer while the BSP walls are drawn, so that each column is
+//  written sequentially, and then transposes the view back into the screen
+//  in cache-sized tiles before planes and sprites are drawn over it.
+//
+
+#include "z_zone.h"
+
+#include "c_io.h"
+#include "c_runcmd.h"
+#include "m_compare.h"
+#include "r_draw.h"
+#include "r_drawt.h"
+#include "r_main.h"
+#include "r_state.h"
+#include "v_misc.h"
+#include "z_auto.h"
+#include "hal/i_timer.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define R_DRAWT_SSE2
+#include <emmintrin.h>
+#endif
+
+// the transposed buffer: pixel (x, y) lives at tbuffer[x * tpitch + y]
+static byte *tbuffer;
+static int   tpitch;
+static int   twidth, theight;
+
+// screen target saved while walls are being drawn
+static byte *tsavedscreen;
+static int   tsavedlinesize;
+
+//
+// R_tColumnPitch
+//
+// Returns a column pitch for the given height that is a multiple of the
+// transpose tile size, but not of a large power of two, so that walking
+// across columns does not keep hitting the same cache sets.
+//
+static int R_tColumnPitch(int height)
+{
+   return ((height + 63) & ~63) + 64;
+}
+
+//
+// R_transposeTile
+//
+// Transposes a 16x16 tile from column-major src to row-major dest.
+//
+#ifdef R_DRAWT_SSE2
+static inline void R_transposeTile(byte *dest, int destpitch, const byte *src, 
+                                   int srcpitch)
+{
+   __m128i r[16], t[16];
+   int i;
+
+   for(i = 0; i < 16; i++)
+      r[i] = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i * srcpitch));
+
+   // four rounds of interleaving rows i and i+8 leave the tile transposed
+   for(i = 0; i < 8; i++)
+   {
+      t[2*i]     = _mm_unpacklo_epi8(r[i], r[i+8]);
+      t[2*i + 1] = _mm_unpackhi_epi8(r[i], r[i+8]);
+   }
+   for(i = 0; i < 8; i++)
+   {
+      r[2*i]     = _mm_unpacklo_epi8(t[i], t[i+8]);
+      r[2*i + 1] = _mm_unpackhi_epi8(t[i], t[i+8]);
+   }
+   for(i = 0; i < 8; i++)
+   {
+      t[2*i]     = _mm_unpacklo_epi8(r[i], r[i+8]);
+      t[2*i + 1] = _mm_unpackhi_epi8(r[i], r[i+8]);
+   }
+   for(i = 0; i < 8; i++)
+   {
+      r[2*i]     = _mm_unpacklo_epi8(t[i], t[i+8]);
+      r[2*i + 1] = _mm_unpackhi_epi8(t[i], t[i+8]);
+   }
+
+   for(i = 0; i < 16; i++)
+      _mm_storeu_si128(reinterpret_cast<__m128i *>(dest + i * destpitch), r[i]);
+}
+#else
+static inline void R_transposeTile(byte *dest, int destpitch, const byte *src, 
+                                   int srcpitch)
+{
+   for(int y = 0; y < 16; y++)
+   {
+      for(int x = 0; x < 16; x++)
+         dest[y * destpitch + x] = src[x * srcpitch + y];
+   }
+}
+#endif
+
+//
+// R_TransposeBlock
+//
+// Copies a width by height block from a column-major source, where pixel
+// (x, y) is src[x * srcpitch + y], into a row-major destination, where it
+// is dest[y * destpitch + x]. Whole 16x16 tiles are transposed in registers
+// and the ragged edges a pixel at a time.
+//
+void R_TransposeBlock(byte *dest, int destpitch, const byte *src, int srcpitch,
+                      int width, int height)
+{
+   int tilew = width  & ~15;
+   int tileh = height & ~15;
+   int x, y;
+
+   for(y = 0; y < tileh; y += 16)
+   {
+      for(x = 0; x < tilew; x += 16)
+      {
+         R_transposeTile(dest + y * destpitch + x, destpitch, 
+                         src + x * srcpitch + y, srcpitch);
+      }
+   }
+
+   // right edge, all rows
+   for(x = tilew; x < width; x++)
+   {
+      const byte *s = src + x * srcpitch;
+      byte *d = dest + x;
+
+      for(y = 0; y < height; y++, d += destpitch)
+         *d = s[y];
+   }
+
+   // bottom edge, tiled columns only
+   for(y = tileh; y < height; y++)
+   {
+      byte *d = dest + y * destpitch;
+
+      for(x = 0; x < tilew; x++)
+         d[x] = src[x * srcpitch + y];
+   }
+}
+
+//
+// R_TBeginWalls
+//
+// Points the column drawers at the transposed buffer, reallocating it if the
+// video mode has changed.
+//
+void R_TBeginWalls()
+{
+   if(twidth != video.width || theight != video.height)
+   {
+      twidth  = video.width;
+      theight = video.height;
+      tpitch  = R_tColumnPitch(theight);
+      tbuffer = erealloc(byte *, tbuffer, size_t(tpitch) * twidth);
+      memset(tbuffer, 0, size_t(tpitch) * twidth);
+   }
+
+   tsavedscreen   = renderscreen;
+   tsavedlinesize = linesize;
+
+   renderscreen = tbuffer;
+   linesize     = 1;
+   columnstep   = tpitch;
+}
+
+//
+// R_TEndWalls
+//
+// Restores the screen as the column target and transposes the walls drawn
+// into the view window onto it. Pixels not covered by a wall are copied as
+// well, but planes are drawn over all of them afterward.
+//
+void R_TEndWalls()
+{
+   renderscreen = tsavedscreen;
+   linesize     = tsavedlinesize;
+   columnstep   = 1;
+
+   R_TransposeBlock(R_ADDRESS(0, 0), linesize, 
+                    tbuffer + viewwindow.x * tpitch + viewwindow.y, tpitch,
+                    viewwindow.width, viewwindow.height);
+}
+
+//=============================================================================
+//
+// Benchmark
+//
+
+//
+// R_tDrawBenchWalls
+//
+// Draws one frame of synthetic walls covering the middle of a view of the
+// given size through the normal column drawer, into whatever target is set.
+//
+static void R_tDrawBenchWalls(int width, int height, int frame)
+{
+   for(int x = 0; x < width; x++)
+   {
+      // walls between a third and all of the view tall, varying across it
+      int half = height / 6 + ((x * 7 + frame * 13) % (height / 3 + 1));
+
+      column.x    = x;
+      column.y1   = emax(height / 2 - half, 0);
+      column.y2   = emin(height / 2 + half, height - 1);
+      column.step = FRACUNIT / 2 + ((x & 63) << 10);
+      r_normal_drawer.DrawColumn();
+   }
+}
+
+//
+// R_tTimeWalls
+//
+// Times drawing the synthetic walls into a row-major screen, and into the
+// transposed buffer plus the transpose back, at the given resolution.
+// Returns the average frame times in microseconds.
+//
+static void R_tTimeWalls(int width, int height, int iterations, double times[3])
+{
+   int spitch = R_tColumnPitch(height);
+   ZAutoBuffer screen(size_t(width) * height, true);
+   ZAutoBuffer transposed(size_t(spitch) * width, true);
+   byte *scr = screen.getAs<byte *>();
+   byte *tb  = transposed.getAs<byte *>();
+   uint64_t start, mid;
+   int i;
+
+   viewwindow.x      = 0;
+   viewwindow.y      = 0;
+   viewwindow.width  = width;
+   viewwindow.height = height;
+
+   renderscreen = scr;
+   linesize     = width;
+   columnstep   = 1;
+
+   start = i_haltimer.GetMicroseconds();
+   for(i = 0; i < iterations; i++)
+      R_tDrawBenchWalls(width, height, i);
+   times[0] = double(i_haltimer.GetMicroseconds() - start) / iterations;
+
+   times[1] = times[2] = 0.0;
+   for(i = 0; i < iterations; i++)
+   {
+      renderscreen = tb;
+      linesize     = 1;
+      columnstep   = spitch;
+
+      start = i_haltimer.GetMicroseconds();
+      R_tDrawBenchWalls(width, height, i);
+      mid = i_haltimer.GetMicroseconds();
+      R_TransposeBlock(scr, width, tb, spitch, width, height);
+      times[1] += double(mid - start);
+      times[2] += double(i_haltimer.GetMicroseconds() - mid);
+   }
+   times[1] /= iterations;
+   times[2] /= iterations;
+}
+
+//
+// r_colbench
+//
+// Compares drawing walls straight into the screen with drawing them into a
+// transposed buffer and transposing it back, at common resolutions.
+//
+CONSOLE_COMMAND(r_colbench, 0)
+{
+   static const int resolutions[][2] = 
+   { 
+      { 1920, 1080 }, { 2560, 1440 }, { 3840, 2160 } 
+   };
+   static byte texture[128];
+   int iterations = 50;
+
+   if(Console.argc >= 1)
+      iterations = eclamp(Console.argv[0]->toInt(), 1, 1000);
+
+   cb_column_t savedcolumn   = column;
+   rrect_t     savedwindow   = viewwindow;
+   byte       *savedscreen   = renderscreen;
+   int         savedlinesize = linesize;
+   int         savedstep     = columnstep;
+
+   for(int i = 0; i < 128; i++)
+      texture[i] = byte(i * 37);
+
+   column.source    = texture;
+   column.colormap  = fullcolormap ? fullcolormap : colormaps[0];
+   column.texheight = 128;
+   column.texmid    = 0;
+
+   C_Printf("Wall columns, %d frames:\n", iterations);
+   for(const auto &res : resolutions)
+   {
+      double times[3];
+
+      R_tTimeWalls(res[0], res[1], iterations, times);
+      C_Printf("%dx%d: %8.1f us direct, %8.1f + %6.1f us transposed (%.2fx)\n",
+               res[0], res[1], times[0], times[1], times[2],
+               times[1] + times[2] > 0.0 ? times[0] / (times[1] + times[2]) : 0.0);
+   }
+
+   column       = savedcolumn;
+   viewwindow   = savedwindow;
+   renderscreen = savedscreen;
+   linesize     = savedlinesize;
+   columnstep   = savedstep;
+}
+
+// EOF
+
@@ -0,0 +1,38 @@
+//
+// The Eternity Engine
+// Copyright (C) 2018 James Haley et al.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see http://www.gnu.org/licenses/
+//
+// Additional terms and conditions compatible with the GPLv3 apply. See the
+// file COPYING-EE for details.
+//
+// Purpose: Column engine that draws walls into a transposed buffer.
+//
+
+#ifndef R_DRAWT_H__
+#define R_DRAWT_H__
+
+#include "doomtype.h"
+
+void R_TBeginWalls();
+void R_TEndWalls();
+
+void R_TransposeBlock(byte *dest, int destpitch, const byte *src, int srcpitch,
+                      int width, int height);
+
+#endif
+
+// EOF
+
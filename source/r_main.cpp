@@ -153,8 +153,9 @@ int r_column_engine_num;
 
 static columndrawer_t *r_column_engines[NUMCOLUMNENGINES] =
 {
-   &r_normal_drawer, // normal engine
-   &r_quad_drawer,   // quad cache engine
+   &r_normal_drawer,     // normal engine
+   &r_quad_drawer,       // quad cache engine
+   &r_transposed_drawer, // transposed wall engine
 };
 
 //
@@ -846,7 +847,8 @@ enum secinterpstate_e
 //
 // If passed SEC_INTERPOLATE, current floor and ceiling heights are backed up
 // and then replaced with interpolated values. If passed SEC_NORMAL, backed up
-// sector heights are restored.
+// sector heights are restored. Only sectors that moved during the last tic
+// can need either, so just those in movedsectors are looked at.
 //
 static void R_setSectorInterpolationState(secinterpstate_e state)
 {
@@ -855,10 +857,10 @@ static void R_setSectorInterpolationState(secinterpstate_e state)
    switch(state)
    {
    case SEC_INTERPOLATE:
-      for(i = 0; i < numsectors; i++)
+      for(i = 0; i < nummovedsectors; i++)
       {
-         auto &si  = sectorinterps[i];
-         auto &sec = sectors[i];
+         auto &si  = sectorinterps[movedsectors[i]];
+         auto &sec = sectors[movedsectors[i]];
          
          if(si.prevfloorheight   != sec.floorheight ||
             si.prevceilingheight != sec.ceilingheight)
@@ -882,10 +884,10 @@ static void R_setSectorInterpolationState(secinterpstate_e state)
       }
       break;
    case SEC_NORMAL:
-      for(i = 0; i < numsectors; i++)
+      for(i = 0; i < nummovedsectors; i++)
       {
-         auto &si  = sectorinterps[i];
-         auto &sec = sectors[i];
+         auto &si  = sectorinterps[movedsectors[i]];
+         auto &sec = sectors[movedsectors[i]];
          
          // restore backed up heights
          if(si.interpolated)
@@ -1154,6 +1156,10 @@ void R_RenderPlayerView(player_t* player, camera_t *camerapoint)
    R_ClearPortals();
    R_ClearSprites();
 
+   // walls may be drawn into a buffer of the column engine's own
+   if(r_column_engine->BeginWalls)
+      r_column_engine->BeginWalls();
+
    if(autodetect_hom)
       R_HOMdrawer();
    
@@ -1188,6 +1194,10 @@ void R_RenderPlayerView(player_t* player, camera_t *camerapoint)
    // SoM 12/9/03: render the portals.
    R_RenderPortals();
 
+   // all walls are done; everything else draws directly to the screen
+   if(r_column_engine->EndWalls)
+      r_column_engine->EndWalls();
+
    R_DrawPlanes(NULL);
    
    // Check for new console commands.
@@ -1222,9 +1232,14 @@ void R_HOMdrawer()
    
    colour = !flashing_hom || (gametic % 20) < 9 ? 0xb0 : 0;
 
-   V_ColorBlock(&vbscreen, (byte)colour, viewwindow.x, viewwindow.y, 
-                viewwindow.width,
-                viewwindow.height);
+   // fill through the column target, which may be a transposed buffer
+   for(int x = 0; x < viewwindow.width; x++)
+   {
+      byte *dest = R_ADDRESS(x, 0);
+
+      for(int y = 0; y < viewwindow.height; y++, dest += linesize)
+         *dest = (byte)colour;
+   }
 }
 
 //
@@ -1380,7 +1395,7 @@ void R_DoomTLStyle()
 
 static const char *handedstr[]  = { "right", "left" };
 static const char *ptranstr[]   = { "none", "smooth", "general" };
-static const char *coleng[]     = { "normal", "quad" };
+static const char *coleng[]     = { "normal", "quad", "transposed" };
 static const char *spaneng[]    = { "highprecision" };
 static const char *tlstylestr[] = { "none", "boom", "new" };
 
@@ -89,6 +89,8 @@ extern spritedef_t      *sprites;
 
 extern int              numvertexes;
 extern vertex_t         *vertexes;
+extern int              *vertexlineoffs;
+extern line_t           **vertexlines;
 
 extern int              numsegs;
 extern seg_t            *segs;
@@ -96,6 +98,8 @@ extern seg_t            *segs;
 extern int              numsectors;
 extern sector_t         *sectors;
 extern sectorinterp_t   *sectorinterps;
+extern int              *movedsectors;
+extern int              nummovedsectors;
 extern sectorbox_t      *pSectorBoxes;
 
 extern int              numsoundzones;
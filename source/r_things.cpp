@@ -117,10 +117,8 @@ int numsprites;
 
 // haleyjd: global particle system state
 
-int        activeParticles;
-int        inactiveParticles;
-particle_t *Particles;
-int        particle_trans;
+particlestore_t Particles;
+int             particle_trans;
 
 float *mfloorclip, *mceilingclip;
 
@@ -226,6 +224,20 @@ static int maxframe;
 // Max number of particles
 static int numParticles;
 
+// particles spawned since the last R_CommitParticles
+#define PTCL_MAXSPAWN 4096
+
+static particle_t *spawnQueue;
+static int         numSpawned;
+static int         maxSpawned;
+
+// live particles sorted by sector; sector i owns the indices of ptclBinOrder
+// in [ptclBinStart[i], ptclBinStart[i+1])
+static int  *ptclBinStart;
+static int  *ptclBinOrder;
+static int   numPtclBins;
+static bool  ptclBinsValid;
+
 static vissprite_t *vissprites, **vissprite_ptrs;  // killough
 static size_t num_vissprite, num_vissprite_alloc, num_vissprite_ptrs;
 
@@ -290,7 +302,9 @@ VALLOCATION(clipbot)
 
 // Forward declarations:
 static void R_DrawParticle(vissprite_t *vis);
-static void R_ProjectParticle(particle_t *particle);
+static void R_ProjectParticle(int ptcl);
+static void R_projectParticles(const sector_t *sec);
+static void R_binParticles();
 
 //
 // R_SetMaskedSilhouette
@@ -538,6 +552,14 @@ void R_InitSprites(char **namelist)
 void R_ClearSprites()
 {
    num_vissprite = 0; // killough
+
+   // bring the particle bins up to date for this frame
+   if(drawparticles)
+   {
+      R_CommitParticles();
+      if(!ptclBinsValid)
+         R_binParticles();
+   }
 }
 
 //
@@ -1203,12 +1225,7 @@ void R_AddSprites(sector_t* sec, int lightlevel)
    // haleyjd 02/20/04: Handle all particles in sector.
 
    if(drawparticles)
-   {
-      DLListItem<particle_t> *link;
-
-      for(link = sec->ptcllist; link; link = link->dllNext)
-         R_ProjectParticle(*link);
-   }
+      R_projectParticles(sec);
 }
 
 //
@@ -2174,33 +2191,142 @@ void R_CheckMobjProjections(Mobj *mobj, bool checklines)
 // THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 //
 
+//
+// particlestore_t::move
+//
+// Copies the particle in slot src over the one in slot dst.
+//
+void particlestore_t::move(int dst, int src)
+{
+   x[dst]          = x[src];
+   y[dst]          = y[src];
+   z[dst]          = z[src];
+   velx[dst]       = velx[src];
+   vely[dst]       = vely[src];
+   velz[dst]       = velz[src];
+   accx[dst]       = accx[src];
+   accy[dst]       = accy[src];
+   accz[dst]       = accz[src];
+   trans[dst]      = trans[src];
+   fade[dst]       = fade[src];
+   ttl[dst]        = ttl[src];
+   size[dst]       = size[src];
+   color[dst]      = color[src];
+   styleflags[dst] = styleflags[src];
+   subsector[dst]  = subsector[src];
+}
+
 //
 // newParticle
 //
-// Tries to find an inactive particle in the Particles list
-// Returns NULL on failure
+// Returns a cleared particle to be filled in by an effect, or NULL if the
+// particle store is full. The particle goes live at the next call to
+// R_CommitParticles.
 //
 particle_t *newParticle()
 {
-   particle_t *result = NULL;
-   if(inactiveParticles != -1)
+   if(numSpawned >= maxSpawned || Particles.count + numSpawned >= Particles.capacity)
+      return NULL;
+
+   particle_t *result = &spawnQueue[numSpawned++];
+   memset(result, 0, sizeof(particle_t));
+   return result;
+}
+
+//
+// R_CommitParticles
+//
+// Moves all particles spawned since the last call into the particle store.
+//
+void R_CommitParticles()
+{
+   particlestore_t &ps = Particles;
+   int n = ps.count;
+
+   for(int i = 0; i < numSpawned; i++, n++)
    {
-      result = Particles + inactiveParticles;
-      inactiveParticles = result->next;
-      result->next = activeParticles;
-      activeParticles = int(result - Particles);
+      const particle_t &p = spawnQueue[i];
+
+      ps.x[n]          = p.x;
+      ps.y[n]          = p.y;
+      ps.z[n]          = p.z;
+      ps.velx[n]       = p.velx;
+      ps.vely[n]       = p.vely;
+      ps.velz[n]       = p.velz;
+      ps.accx[n]       = p.accx;
+      ps.accy[n]       = p.accy;
+      ps.accz[n]       = p.accz;
+      ps.trans[n]      = p.trans;
+      ps.fade[n]       = p.fade;
+      ps.ttl[n]        = p.ttl;
+      ps.size[n]       = p.size;
+      ps.color[n]      = p.color;
+      ps.styleflags[n] = p.styleflags;
+      ps.subsector[n]  = R_PointInSubsector(p.x, p.y);
    }
 
-   return result;
+   if(numSpawned)
+   {
+      ps.count   = n;
+      numSpawned = 0;
+      R_InvalidateParticleBins();
+   }
+}
+
+//
+// R_InvalidateParticleBins
+//
+// Must be called whenever particles are added, removed, or change sector.
+//
+void R_InvalidateParticleBins()
+{
+   ptclBinsValid = false;
+}
+
+//
+// R_binParticles
+//
+// Sorts the live particles by sector with a counting sort, so that each
+// sector's particles can be projected together as one contiguous run.
+//
+static void R_binParticles()
+{
+   const particlestore_t &ps = Particles;
+
+   if(numsectors + 1 > numPtclBins)
+   {
+      numPtclBins = numsectors + 1;
+      ptclBinStart = erealloc(int *, ptclBinStart, numPtclBins * sizeof(int));
+   }
+
+   memset(ptclBinStart, 0, (numsectors + 1) * sizeof(int));
+
+   for(int i = 0; i < ps.count; i++)
+      ++ptclBinStart[ps.subsector[i]->sector - sectors + 1];
+
+   for(int i = 1; i <= numsectors; i++)
+      ptclBinStart[i] += ptclBinStart[i - 1];
+
+   // fill the bins, leaving each bin's start pointing at the following bin
+   for(int i = 0; i < ps.count; i++)
+      ptclBinOrder[ptclBinStart[ps.subsector[i]->sector - sectors]++] = i;
+
+   // shift the starts back into place
+   for(int i = numsectors; i > 0; i--)
+      ptclBinStart[i] = ptclBinStart[i - 1];
+   ptclBinStart[0] = 0;
+
+   ptclBinsValid = true;
 }
 
 //
 // R_InitParticles
 //
-// Allocate the particle list and initialize it
+// Allocate the particle store and initialize it
 //
 void R_InitParticles()
 {
+   particlestore_t &ps = Particles;
    int i;
 
    numParticles = 0;
@@ -2208,37 +2334,56 @@ void R_InitParticles()
    if((i = M_CheckParm("-numparticles")) && i < myargc - 1)
       numParticles = atoi(myargv[i+1]);
    
-   if(numParticles == 0) // assume default
-      numParticles = 4000;
+   if(numParticles <= 0) // assume default
+      numParticles = 32768;
    else if(numParticles < 100)
       numParticles = 100;
-   
-   Particles = (particle_t *)(Z_Malloc(numParticles*sizeof(particle_t), PU_STATIC, NULL));
+
+   ps.capacity   = numParticles;
+   ps.x          = ecalloc(fixed_t *,       numParticles, sizeof(fixed_t));
+   ps.y          = ecalloc(fixed_t *,       numParticles, sizeof(fixed_t));
+   ps.z          = ecalloc(fixed_t *,       numParticles, sizeof(fixed_t));
+   ps.velx       = ecalloc(fixed_t *,       numParticles, sizeof(fixed_t));
+   ps.vely       = ecalloc(fixed_t *,       numParticles, sizeof(fixed_t));
+   ps.velz       = ecalloc(fixed_t *,       numParticles, sizeof(fixed_t));
+   ps.accx       = ecalloc(fixed_t *,       numParticles, sizeof(fixed_t));
+   ps.accy       = ecalloc(fixed_t *,       numParticles, sizeof(fixed_t));
+   ps.accz       = ecalloc(fixed_t *,       numParticles, sizeof(fixed_t));
+   ps.trans      = ecalloc(unsigned int *,  numParticles, sizeof(unsigned int));
+   ps.fade       = ecalloc(unsigned int *,  numParticles, sizeof(unsigned int));
+   ps.ttl        = ecalloc(byte *,          numParticles, sizeof(byte));
+   ps.size       = ecalloc(byte *,          numParticles, sizeof(byte));
+   ps.color      = ecalloc(byte *,          numParticles, sizeof(byte));
+   ps.styleflags = ecalloc(int *,           numParticles, sizeof(int));
+   ps.subsector  = ecalloc(subsector_t **,  numParticles, sizeof(subsector_t *));
+
+   ptclBinOrder = ecalloc(int *, numParticles, sizeof(int));
+
+   // a single tic rarely spawns more than a few hundred particles
+   maxSpawned = emin(numParticles, PTCL_MAXSPAWN);
+   spawnQueue = ecalloc(particle_t *, maxSpawned, sizeof(particle_t));
+
    R_ClearParticles();
 }
 
 //
 // R_ClearParticles
 //
-// set up the particle list
+// Empty the particle store
 //
 void R_ClearParticles()
 {
-   int i;
-   
-   memset(Particles, 0, numParticles*sizeof(particle_t));
-   activeParticles = -1;
-   inactiveParticles = 0;
-   for(i = 0; i < numParticles - 1; i++)
-      Particles[i].next = i + 1;
-   Particles[i].next = -1;
+   Particles.count = 0;
+   numSpawned      = 0;
+   R_InvalidateParticleBins();
 }
 
 //
 // R_ProjectParticle
 //
-static void R_ProjectParticle(particle_t *particle)
+static void R_ProjectParticle(int ptcl)
 {
+   const particlestore_t &ps = Particles;
    fixed_t gzt;
    int x1, x2;
    vissprite_t *vis;
@@ -2250,8 +2395,8 @@ static void R_ProjectParticle(particle_t *particle)
    float y1, y2;
 
    // SoM: Cardboard translate the mobj coords and just project the sprite.
-   tempx = M_FixedToFloat(particle->x) - view.x;
-   tempy = M_FixedToFloat(particle->y) - view.y;
+   tempx = M_FixedToFloat(ps.x[ptcl]) - view.x;
+   tempy = M_FixedToFloat(ps.y[ptcl]) - view.y;
    ty1   = (tempy * view.cos) + (tempx * view.sin);
 
    // lies in front of the front view plane
@@ -2259,7 +2404,7 @@ static void R_ProjectParticle(particle_t *particle)
       return;
 
    // invisible?
-   if(!particle->trans)
+   if(!ps.trans[ptcl])
       return;
 
    tx1 = (tempx * view.cos) - (tempy * view.sin);
@@ -2280,7 +2425,7 @@ static void R_ProjectParticle(particle_t *particle)
    if(x1 >= viewwindow.width || x2 < 0)
       return;
 
-   tz = M_FixedToFloat(particle->z) - view.z;
+   tz = M_FixedToFloat(ps.z[ptcl]) - view.z;
 
    y1 = (view.ycenter - (tz * yscale));
    y2 = (view.ycenter - ((tz - 1.0f) * yscale));
@@ -2288,7 +2433,7 @@ static void R_ProjectParticle(particle_t *particle)
    if(y2 < 0.0f || y1 >= view.height)
       return;
    
-   gzt = particle->z + 1;
+   gzt = ps.z[ptcl] + 1;
    
    // killough 3/27/98: exclude things totally separated
    // from the viewer, by either water or fake ceilings
@@ -2296,12 +2441,12 @@ static void R_ProjectParticle(particle_t *particle)
    
    {
       // haleyjd 02/20/04: use subsector now stored in particle
-      subsector_t *subsector = particle->subsector;
+      const subsector_t *subsector = ps.subsector[ptcl];
       sector = subsector->sector;
       heightsec = sector->heightsec;
 
-      if(particle->z < sector->floorheight || 
-	 particle->z > sector->ceilingheight)
+      if(ps.z[ptcl] < sector->floorheight || 
+	 ps.z[ptcl] > sector->ceilingheight)
 	 return;
    }
    
@@ -2312,7 +2457,7 @@ static void R_ProjectParticle(particle_t *particle)
       
       if(phs != -1 && 
 	 viewz < sectors[phs].floorheight ?
-	 particle->z >= sectors[heightsec].floorheight :
+	 ps.z[ptcl] >= sectors[heightsec].floorheight :
          gzt < sectors[heightsec].floorheight)
          return;
 
@@ -2320,23 +2465,23 @@ static void R_ProjectParticle(particle_t *particle)
 	 viewz > sectors[phs].ceilingheight ?
 	 gzt < sectors[heightsec].ceilingheight &&
 	 viewz >= sectors[heightsec].ceilingheight :
-         particle->z >= sectors[heightsec].ceilingheight)
+         ps.z[ptcl] >= sectors[heightsec].ceilingheight)
          return;
    }
    
    // store information in a vissprite
    vis = R_NewVisSprite();
    vis->heightsec = heightsec;
-   vis->gx = particle->x;
-   vis->gy = particle->y;
-   vis->gz = particle->z;
+   vis->gx = ps.x[ptcl];
+   vis->gy = ps.y[ptcl];
+   vis->gz = ps.z[ptcl];
    vis->gzt = gzt;
    vis->texturemid = vis->gzt - viewz;
    vis->x1 = x1 < 0 ? 0 : x1;
    vis->x2 = x2 >= viewwindow.width ? viewwindow.width-1 : x2;
-   vis->colour = particle->color;
+   vis->colour = ps.color[ptcl];
    vis->patch = -1;
-   vis->translucency = static_cast<uint16_t>(particle->trans - 1);
+   vis->translucency = static_cast<uint16_t>(ps.trans[ptcl] - 1);
    vis->tranmaplump = -1;
    // Cardboard
    vis->dist = idist;
@@ -2355,7 +2500,7 @@ static void R_ProjectParticle(particle_t *particle)
    {
       R_SectorColormap(sector);
 
-      if(LevelInfo.useFullBright && (particle->styleflags & PS_FULLBRIGHT))
+      if(LevelInfo.useFullBright && (ps.styleflags[ptcl] & PS_FULLBRIGHT))
       {
          vis->colormap = fullcolormap;
       }
@@ -2387,6 +2532,19 @@ static void R_ProjectParticle(particle_t *particle)
    }
 }
 
+//
+// R_projectParticles
+//
+// Projects all of the particles binned into a sector.
+//
+static void R_projectParticles(const sector_t *sec)
+{
+   int secnum = eindex(sec - sectors);
+
+   for(int i = ptclBinStart[secnum]; i < ptclBinStart[secnum + 1]; i++)
+      R_ProjectParticle(ptclBinOrder[i]);
+}
+
 //
 // R_DrawParticle
 //
@@ -76,6 +76,8 @@ void R_ClearSprites(void);
 void R_DrawPostBSP(void);
 void R_ClearParticles(void);
 void R_InitParticles(void);
+void R_CommitParticles(void);
+void R_InvalidateParticleBins(void);
 particle_t *newParticle(void);
 
 typedef struct cb_maskedcolumn_s
@@ -84,6 +84,21 @@ static unsigned int I_SDLGetTicks()
    return SDL_GetTicks();
 }
 
+//
+// I_SDLGetMicroseconds
+//
+// Return time in microseconds from the high-resolution performance counter,
+// for profiling and benchmarking.
+//
+static uint64_t I_SDLGetMicroseconds()
+{
+   static Uint64 freq = SDL_GetPerformanceFrequency();
+   Uint64 count = SDL_GetPerformanceCounter();
+
+   // split to avoid overflowing on counters with a high frequency
+   return (count / freq) * 1000000 + (count % freq) * 1000000 / freq;
+}
+
 //
 // I_SDLSleep
 //
@@ -196,13 +211,14 @@ void I_SDLInitTimer()
    I_SDLSetMSec();
 
    // initialize constant methods
-   i_haltimer.GetRealTime  = I_SDLGetTime_RealTime;
-   i_haltimer.GetTicks     = I_SDLGetTicks;
-   i_haltimer.Sleep        = I_SDLSleep;
-   i_haltimer.StartDisplay = I_SDLStartDisplay;
-   i_haltimer.EndDisplay   = I_SDLEndDisplay;
-   i_haltimer.GetFrac      = I_SDLGetTimeFrac;
-   i_haltimer.SaveMS       = I_SDLSaveMS;
+   i_haltimer.GetRealTime     = I_SDLGetTime_RealTime;
+   i_haltimer.GetTicks        = I_SDLGetTicks;
+   i_haltimer.GetMicroseconds = I_SDLGetMicroseconds;
+   i_haltimer.Sleep           = I_SDLSleep;
+   i_haltimer.StartDisplay    = I_SDLStartDisplay;
+   i_haltimer.EndDisplay      = I_SDLEndDisplay;
+   i_haltimer.GetFrac         = I_SDLGetTimeFrac;
+   i_haltimer.SaveMS          = I_SDLSaveMS;
 }
 
 //
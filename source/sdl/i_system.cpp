@@ -40,6 +40,7 @@
 #include "../i_video.h"
 #include "../doomstat.h"
 #include "../m_misc.h"
+#include "../m_parallel.h"
 #include "../m_syscfg.h"
 #include "../g_demolog.h"
 #include "../g_game.h"
@@ -131,6 +132,9 @@ static bool speedyexit = false;
 void I_Quit(void)
 {
    has_exited = 1;   /* Prevent infinitely recursive exits -- killough */
+
+   // helper threads must be gone before the statics they wait on
+   M_StopWorkers();
    
    // haleyjd 06/05/10: not in fatal error situations; causes heap calls
    if(error_exitcode < I_ERRORLEVEL_FATAL && demorecording)
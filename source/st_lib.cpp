@@ -27,11 +27,13 @@
 
 #include "doomdef.h"
 #include "doomstat.h"
+#include "m_compare.h"
 #include "m_swap.h"
 #include "r_main.h"
 #include "r_patch.h"
 #include "st_lib.h"
 #include "st_stuff.h"
+#include "v_dirty.h"
 #include "v_patchfmt.h"
 #include "v_video.h"
 #include "w_wad.h"
@@ -41,6 +43,12 @@ int sts_pct_always_gray; // killough 2/21/98: always gray %'s? bug or feature?
 
 patch_t*    sttminus;
 
+// background the widgets erase themselves with, if any
+static VBackingStore *stlib_backing;
+
+// bumped whenever the background is redrawn underneath the widgets
+static unsigned int stlib_generation = 1;
+
 //
 // STlib_init()
 //
@@ -53,6 +61,76 @@ void STlib_init()
    sttminus = PatchLoader::CacheName(wGlobalDir, "STTMINUS", PU_STATIC);
 }
 
+//
+// STlib_SetBackingStore
+//
+// Sets the saved status bar background for subsequent widget updates. If
+// refresh is true, the background has just been redrawn, and every widget
+// must be drawn again.
+//
+void STlib_SetBackingStore(VBackingStore *store, bool refresh)
+{
+   stlib_backing = store;
+
+   if(refresh && ++stlib_generation == 0)
+      stlib_generation = 1;
+}
+
+//
+// STlib_beginDraw
+//
+// Returns true if a widget in the given state must be drawn. In that case,
+// whatever the widget drew last time is erased, and its bounds are reset so
+// that STlib_drawPatch can record the new ones.
+//
+static bool STlib_beginDraw(vwidgetcache_t &cache, unsigned int signature)
+{
+   // no saved background: always draw
+   if(!stlib_backing)
+   {
+      cache.generation = 0;
+      return true;
+   }
+
+   if(cache.generation == stlib_generation)
+   {
+      if(cache.signature == signature)
+         return false;
+
+      if(cache.x1 <= cache.x2)
+      {
+         stlib_backing->restore(cache.x1, cache.y1, 
+                                cache.x2 - cache.x1 + 1, cache.y2 - cache.y1 + 1);
+      }
+   }
+
+   cache.signature  = signature;
+   cache.generation = stlib_generation;
+   cache.x1 = cache.y1 = D_MAXINT;
+   cache.x2 = cache.y2 = D_MININT;
+
+   return true;
+}
+
+//
+// STlib_drawPatch
+//
+// Draws one of a widget's patches and grows its recorded bounds to cover it.
+//
+static void STlib_drawPatch(vwidgetcache_t &cache, int x, int y, patch_t *patch,
+                            byte *outrng, int alpha)
+{
+   V_DrawPatchTL(x, y, &subscreen43, patch, outrng, alpha);
+
+   x -= patch->leftoffset;
+   y -= patch->topoffset;
+
+   cache.x1 = emin(cache.x1, x);
+   cache.y1 = emin(cache.y1, y);
+   cache.x2 = emax(cache.x2, x + patch->width  - 1);
+   cache.y2 = emax(cache.y2, y + patch->height - 1);
+}
+
 //
 // STlib_initNum()
 //
@@ -86,7 +164,8 @@ void STlib_initNum(st_number_t *n, int x, int y, patch_t **pl, int num,
 //
 // jff 2/16/98 add color translation to digit output
 //
-static void STlib_drawNum(st_number_t *n, byte *outrng, int alpha)
+static void STlib_drawNum(st_number_t *n, vwidgetcache_t &cache, byte *outrng, 
+                          int alpha)
 {
    int   numdigits = n->width;
    int   num = n->num;
@@ -118,8 +197,8 @@ static void STlib_drawNum(st_number_t *n, byte *outrng, int alpha)
    if(!num)
    {
       //jff 2/18/98 allow use of faster draw routine from config
-      V_DrawPatchTL(x - w, n->y, &subscreen43, n->p[0], 
-                    sts_always_red ? NULL : outrng, alpha);
+      STlib_drawPatch(cache, x - w, n->y, n->p[0], 
+                      sts_always_red ? NULL : outrng, alpha);
    }
 
    // draw the new number
@@ -128,8 +207,8 @@ static void STlib_drawNum(st_number_t *n, byte *outrng, int alpha)
    {
       x -= w;
       //jff 2/18/98 allow use of faster draw routine from config
-      V_DrawPatchTL(x, n->y, &subscreen43, n->p[ num % 10 ],
-                    sts_always_red ? NULL : outrng, alpha);
+      STlib_drawPatch(cache, x, n->y, n->p[ num % 10 ],
+                      sts_always_red ? NULL : outrng, alpha);
       num /= 10;
    }
 
@@ -138,8 +217,8 @@ static void STlib_drawNum(st_number_t *n, byte *outrng, int alpha)
    if(neg)
    {
       //jff 2/18/98 allow use of faster draw routine from config
-      V_DrawPatchTL(x - 8, n->y, &subscreen43, sttminus,
-                    sts_always_red ? NULL : outrng, alpha);
+      STlib_drawPatch(cache, x - 8, n->y, sttminus,
+                      sts_always_red ? NULL : outrng, alpha);
    }
 }
 
@@ -155,8 +234,20 @@ static void STlib_drawNum(st_number_t *n, byte *outrng, int alpha)
 //
 void STlib_updateNum(st_number_t *n, byte *outrng, int alpha)
 {
+   unsigned int sig = V_HASHSEED;
+
+   sig = V_HashState(sig, *n->on);
+   sig = V_HashState(sig, n->num);
+   sig = V_HashState(sig, n->x);
+   sig = V_HashState(sig, n->y);
+   sig = V_HashState(sig, sts_always_red ? NULL : outrng);
+   sig = V_HashState(sig, alpha);
+
+   if(!STlib_beginDraw(n->cache, sig))
+      return;
+
    if(*n->on)
-      STlib_drawNum(n, outrng, alpha);
+      STlib_drawNum(n, n->cache, outrng, alpha);
 }
 
 //
@@ -188,19 +279,31 @@ void STlib_initPercent(st_percent_t *p, int x, int y, patch_t **pl, int num,
 //
 void STlib_updatePercent(st_percent_t *per, byte *outrng, int alpha)
 {
-   if(*per->n.on) // killough 2/21/98: fix percents not updated
-   {
-      byte *tlate = NULL;
+   byte *tlate = NULL;
+   unsigned int sig = V_HASHSEED;
+
+   // jff 2/18/98 allow use of faster draw routine from config
+   // also support gray-only percents
+   if(!sts_always_red)
+      tlate = sts_pct_always_gray ? cr_gray : outrng;
 
-      // jff 2/18/98 allow use of faster draw routine from config
-      // also support gray-only percents
-      if(!sts_always_red)
-         tlate = sts_pct_always_gray ? cr_gray : outrng;
+   // the sign and the number share one cache, as erasing one erases both
+   sig = V_HashState(sig, *per->n.on);
+   sig = V_HashState(sig, per->n.num);
+   sig = V_HashState(sig, per->n.x);
+   sig = V_HashState(sig, per->n.y);
+   sig = V_HashState(sig, tlate);
+   sig = V_HashState(sig, sts_always_red ? NULL : outrng);
+   sig = V_HashState(sig, alpha);
 
-      V_DrawPatchTL(per->n.x, per->n.y, &subscreen43, per->p, tlate, alpha);
+   if(!STlib_beginDraw(per->n.cache, sig))
+      return;
+
+   if(*per->n.on) // killough 2/21/98: fix percents not updated
+   {
+      STlib_drawPatch(per->n.cache, per->n.x, per->n.y, per->p, tlate, alpha);
+      STlib_drawNum(&per->n, per->n.cache, outrng, alpha);
    }
-   
-   STlib_updateNum(&per->n, outrng, alpha);
 }
 
 //
@@ -235,11 +338,23 @@ void STlib_initMultIcon(st_multicon_t *i, int x, int y, patch_t **il, int *inum,
 //
 void STlib_updateMultIcon(st_multicon_t *mi, int alpha)
 {
+   unsigned int sig = V_HASHSEED;
+
+   sig = V_HashState(sig, *mi->on);
+   sig = V_HashState(sig, *mi->inum);
+   sig = V_HashState(sig, mi->p);
+   sig = V_HashState(sig, mi->x);
+   sig = V_HashState(sig, mi->y);
+   sig = V_HashState(sig, alpha);
+
+   if(!STlib_beginDraw(mi->cache, sig))
+      return;
+
    if(*mi->on)
    {
       // killough 2/16/98: redraw only if != -1
       if(*mi->inum != -1)
-         V_DrawPatchTL(mi->x, mi->y, &subscreen43, mi->p[*mi->inum], NULL, alpha);
+         STlib_drawPatch(mi->cache, mi->x, mi->y, mi->p[*mi->inum], NULL, alpha);
    }
 }
 
@@ -275,10 +390,21 @@ void STlib_initBinIcon(st_binicon_t *b, int x, int y, patch_t *i,
 //
 void STlib_updateBinIcon(st_binicon_t *bi)
 {
+   unsigned int sig = V_HASHSEED;
+
+   sig = V_HashState(sig, *bi->on);
+   sig = V_HashState(sig, *bi->val);
+   sig = V_HashState(sig, bi->p);
+   sig = V_HashState(sig, bi->x);
+   sig = V_HashState(sig, bi->y);
+
+   if(!STlib_beginDraw(bi->cache, sig))
+      return;
+
    if(*bi->on)
    {
       if(*bi->val)
-         V_DrawPatch(bi->x, bi->y, &subscreen43, bi->p);
+         STlib_drawPatch(bi->cache, bi->x, bi->y, bi->p, NULL, FRACUNIT);
    }
 }
 
@@ -26,6 +26,8 @@
 #ifndef ST_LIB_H__
 #define ST_LIB_H__
 
+#include "v_dirty.h"
+
 struct patch_t;
 
 //
@@ -44,6 +46,7 @@ typedef struct st_number_s
    int       max;    // max value
    bool     *on;     // pointer to bool stating whether to update number
    patch_t **p;      // list of patches for 0-9
+   vwidgetcache_t cache; // last drawn state, if a backing store is set
 } st_number_t;
 
 //
@@ -65,6 +68,7 @@ typedef struct st_multicon_s
    bool     *on;      // pointer to bool stating whether to update icon
    patch_t **p;       // list of icons
    int       data;    // user data
+   vwidgetcache_t cache; // last drawn state, if a backing store is set
 } st_multicon_t;
 
 //
@@ -78,6 +82,7 @@ typedef struct st_binicon_s
    bool    *on;     // pointer to bool stating whether to update icon
    patch_t *p;      // icon
    int      data;   // user data
+   vwidgetcache_t cache; // last drawn state, if a backing store is set
 } st_binicon_t;
 
 //
@@ -89,6 +94,11 @@ typedef struct st_binicon_s
 //  everything else is done somewhere else.
 void STlib_init();
 
+// Sets the saved background that widgets erase themselves with. While one is
+// set, widgets are only redrawn when their state changes. Pass refresh as
+// true after the background has been redrawn, and NULL to always draw.
+void STlib_SetBackingStore(VBackingStore *store, bool refresh);
+
 // Number widget routines
 void STlib_initNum(st_number_t *n, int x, int y, patch_t **pl, int num, 
                    int max, bool *on, int width);
@@ -48,6 +48,7 @@
 #include "sounds.h"
 #include "st_lib.h"
 #include "st_stuff.h"
+#include "v_dirty.h"
 #include "v_misc.h"
 #include "v_patchfmt.h"
 #include "v_video.h"
@@ -206,8 +207,13 @@ stbarfns_t DoomStatusBar =
 //              amazing that this code from the _betas_ was still here
 
 // ST_Start() has just been called
-// haleyjd 04/16/11: no more status bar caching
-//static bool st_firsttime;
+static bool st_firsttime;
+
+// saved status bar background, used to erase widgets that change
+static VBackingStore st_backing;
+
+// state the saved background was drawn for
+static unsigned int st_backsig;
 
 // lump number for PLAYPAL
 static int lu_palette;
@@ -903,7 +909,36 @@ static void ST_DoomDrawer()
    // possibly update widget positions
    ST_moveWidgets(false);
 
-   ST_doRefresh();     // If just after ST_Start(), refresh all
+   if(!v_dirtyrects)
+   {
+      STlib_SetBackingStore(NULL, false);
+      ST_doRefresh();
+      return;
+   }
+
+   unsigned int sig = V_HASHSEED;
+   sig = V_HashState(sig, displayplayer);
+   sig = V_HashState(sig, plyr->colormap);
+   sig = V_HashState(sig, GameType);
+
+   // Redraw the background only if just after ST_Start(), if something has
+   // been drawn over it, or if what it shows has changed. Otherwise, only
+   // widgets whose values have changed are redrawn.
+   bool refresh = st_firsttime || sig != st_backsig || 
+                  !st_backing.isValidFor(&subscreen43) ||
+                  V_IsDirty(&subscreen43, ST_X, ST_Y, ST_WIDTH, ST_HEIGHT);
+
+   if(refresh)
+   {
+      ST_refreshBackground();
+      st_backing.save(&subscreen43, ST_Y, ST_HEIGHT);
+      st_backsig   = sig;
+      st_firsttime = false;
+   }
+
+   STlib_SetBackingStore(&st_backing, refresh);
+   ST_updateWidgets();
+   ST_drawWidgets();
 }
 
 #define ST_ALPHA (st_fsalpha * FRACUNIT / 100)
@@ -918,6 +953,9 @@ static void ST_DoomFSDrawer()
    // possibly update widget positions
    ST_moveWidgets(true);
 
+   // no background to erase with; widgets are drawn every frame
+   STlib_SetBackingStore(NULL, false);
+
    // draw graphics
 
    // health
@@ -1404,7 +1442,8 @@ void ST_Start()
    if(!st_stopped)
       ST_Stop();
    GameModeInfo->StatusBar->Start();
-   st_stopped = false;
+   st_stopped   = false;
+   st_firsttime = true;
 }
 
 //
@@ -25,9 +25,153 @@
 
 #include "z_zone.h"
 
+#include "c_io.h"
+#include "c_runcmd.h"
 #include "i_system.h"
 #include "m_compare.h"
 #include "v_video.h"
+#include "z_auto.h"
+#include "hal/i_timer.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define V_BLOCK_SSE2
+#include <emmintrin.h>
+#endif
+
+//==============================================================================
+//
+// Horizontal scaling kernels
+//
+// All of the scaled block drawers spend nearly all of their time expanding a
+// row of source pixels across the width of a high-resolution buffer. These
+// kernels do that through the VBuffer's precomputed x-step lookup, which
+// holds the source column for every destination column, so that there is no
+// fixed-point stepping left in the inner loops.
+//
+
+typedef void (*scalerowfunc_t)(byte *, const byte *, const int *, int);
+typedef void (*scalerowmaskedfunc_t)(byte *, const byte *, const int *, int, 
+                                     const byte *);
+
+//
+// V_scaleRowScalar
+//
+// Reference kernel: one pixel at a time.
+//
+static void V_scaleRowScalar(byte *dest, const byte *src, const int *xidx, 
+                             int count)
+{
+   while(count--)
+      *dest++ = src[*xidx++];
+}
+
+//
+// V_scaleRowMaskedScalar
+//
+// Reference kernel for masked drawing: color 0 is transparent, and opaque
+// pixels are remapped through cmap.
+//
+static void V_scaleRowMaskedScalar(byte *dest, const byte *src, const int *xidx,
+                                   int count, const byte *cmap)
+{
+   while(count--)
+   {
+      byte c = src[*xidx++];
+      if(c)
+         *dest = cmap[c];
+      ++dest;
+   }
+}
+
+#ifdef V_BLOCK_SSE2
+
+//
+// V_gather16
+//
+// Fetch 16 source pixels through the x-step lookup into one vector.
+//
+static inline __m128i V_gather16(const byte *src, const int *xidx)
+{
+   return _mm_setr_epi8(char(src[xidx[ 0]]), char(src[xidx[ 1]]), 
+                        char(src[xidx[ 2]]), char(src[xidx[ 3]]),
+                        char(src[xidx[ 4]]), char(src[xidx[ 5]]), 
+                        char(src[xidx[ 6]]), char(src[xidx[ 7]]),
+                        char(src[xidx[ 8]]), char(src[xidx[ 9]]), 
+                        char(src[xidx[10]]), char(src[xidx[11]]),
+                        char(src[xidx[12]]), char(src[xidx[13]]), 
+                        char(src[xidx[14]]), char(src[xidx[15]]));
+}
+
+//
+// V_scaleRowSSE2
+//
+// Writes 16 destination pixels per iteration.
+//
+static void V_scaleRowSSE2(byte *dest, const byte *src, const int *xidx, 
+                           int count)
+{
+   while(count >= 16)
+   {
+      _mm_storeu_si128(reinterpret_cast<__m128i *>(dest), V_gather16(src, xidx));
+      dest  += 16;
+      xidx  += 16;
+      count -= 16;
+   }
+
+   V_scaleRowScalar(dest, src, xidx, count);
+}
+
+//
+// V_scaleRowMaskedSSE2
+//
+// Translates 16 pixels at a time and merges them with the destination under a
+// transparency mask, so there are no per-pixel branches.
+//
+static void V_scaleRowMaskedSSE2(byte *dest, const byte *src, const int *xidx,
+                                 int count, const byte *cmap)
+{
+   const __m128i zero = _mm_setzero_si128();
+
+   while(count >= 16)
+   {
+      __m128i pix = V_gather16(src, xidx);
+      __m128i clear = _mm_cmpeq_epi8(pix, zero);
+
+      // skip wholly transparent runs entirely
+      if(_mm_movemask_epi8(clear) != 0xffff)
+      {
+         alignas(16) byte in[16];
+         alignas(16) byte out[16];
+
+         _mm_store_si128(reinterpret_cast<__m128i *>(in), pix);
+         for(int i = 0; i < 16; i++)
+            out[i] = cmap[in[i]];
+
+         __m128i mapped = _mm_load_si128(reinterpret_cast<const __m128i *>(out));
+         __m128i old    = _mm_loadu_si128(reinterpret_cast<const __m128i *>(dest));
+
+         _mm_storeu_si128(reinterpret_cast<__m128i *>(dest), 
+                          _mm_or_si128(_mm_and_si128(clear, old), 
+                                       _mm_andnot_si128(clear, mapped)));
+      }
+
+      dest  += 16;
+      xidx  += 16;
+      count -= 16;
+   }
+
+   V_scaleRowMaskedScalar(dest, src, xidx, count, cmap);
+}
+
+static scalerowfunc_t       scaleRow       = V_scaleRowSSE2;
+static scalerowmaskedfunc_t scaleRowMasked = V_scaleRowMaskedSSE2;
+
+#else
+
+static scalerowfunc_t       scaleRow       = V_scaleRowScalar;
+static scalerowmaskedfunc_t scaleRowMasked = V_scaleRowMaskedScalar;
+
+#endif
 
 //==============================================================================
 //
@@ -87,9 +231,9 @@ static void V_BlockDrawer(int x, int y, VBuffer *buffer,
 static void V_BlockDrawerS(int x, int y, VBuffer *buffer, 
                            int width, int height, byte *source)
 {
-   byte *src, *dest, *row;
-   fixed_t xstep, ystep, xfrac, yfrac;
-   int xtex, ytex, w, h, i, realx, realy;
+   byte *src, *dest, *prev;
+   fixed_t ystep, yfrac;
+   int ytex, lastytex, w, h, realx, realy;
    int cx1, cy1, cx2, cy2, cw, ch;
    int dx, dy;
    
@@ -126,12 +270,13 @@ static void V_BlockDrawerS(int x, int y, VBuffer *buffer,
    realy = buffer->y1lookup[cy1];
    w     = buffer->x2lookup[cx2] - realx + 1;
    h     = buffer->y2lookup[cy2] - realy + 1;
-   xstep = buffer->ixscale;
    ystep = buffer->iyscale;
    yfrac = 0;
 
    src  = source + dy * width + dx;
    dest = VBADDRESS(buffer, realx, realy);
+   prev = NULL;
+   lastytex = -1;
 
 #ifdef RANGECHECK
    // sanity check
@@ -144,18 +289,17 @@ static void V_BlockDrawerS(int x, int y, VBuffer *buffer,
 
    while(h--)
    {
-      row = dest;
-      i = w;
-      xfrac = 0;
-      ytex = (yfrac >> FRACBITS) * width;
-      
-      while(i--)
-      {
-         xtex = (xfrac >> FRACBITS);
-         *row++ = src[ytex + xtex];
-         xfrac += xstep;
-      }
+      ytex = yfrac >> FRACBITS;
+
+      // rows which sample the same source row are identical, so only the
+      // first of them needs to be scaled
+      if(ytex == lastytex)
+         memcpy(dest, prev, w);
+      else
+         scaleRow(dest, src + ytex * width, buffer->xsteplookup, w);
 
+      prev = dest;
+      lastytex = ytex;
       dest += buffer->pitch;
       yfrac += ystep;
    }
@@ -224,9 +368,9 @@ static void V_MaskedBlockDrawerS(int x, int y, VBuffer *buffer,
                                  int width, int height, int srcpitch,
                                  byte *source, byte *cmap)
 {
-   byte *src, *dest, *row;
-   fixed_t xstep, ystep, xfrac, yfrac;
-   int xtex, ytex, w, h, i, realx, realy;
+   byte *src, *dest;
+   fixed_t ystep, yfrac;
+   int w, h, realx, realy;
    int cx1, cy1, cx2, cy2, cw, ch;
    int dx, dy;
    
@@ -263,7 +407,6 @@ static void V_MaskedBlockDrawerS(int x, int y, VBuffer *buffer,
    realy = buffer->y1lookup[cy1];
    w     = buffer->x2lookup[cx2] - realx + 1;
    h     = buffer->y2lookup[cy2] - realy + 1;
-   xstep = buffer->ixscale;
    ystep = buffer->iyscale;
    yfrac = 0;
 
@@ -279,22 +422,12 @@ static void V_MaskedBlockDrawerS(int x, int y, VBuffer *buffer,
    }
 #endif
 
+   // masked rows can't be replicated, since the destination differs under
+   // each one
    while(h--)
    {
-      row = dest;
-      i = w;
-      xfrac = 0;
-      ytex = (yfrac >> FRACBITS) * srcpitch;
-      
-      while(i--)
-      {
-         xtex = (xfrac >> FRACBITS);
-         if(src[ytex + xtex])
-            *row = cmap[src[ytex + xtex]];
-         ++row;
-         xfrac += xstep;
-      }
-
+      scaleRowMasked(dest, src + (yfrac >> FRACBITS) * srcpitch, 
+                     buffer->xsteplookup, w, cmap);
       dest += buffer->pitch;
       yfrac += ystep;
    }
@@ -536,29 +669,42 @@ static void V_TileBlock64(VBuffer *buffer, byte *src)
 //
 static void V_TileBlock64S(VBuffer *buffer, byte *src)
 {
-   byte *dest, *row;
-   fixed_t xstep, ystep, xfrac, yfrac = 0;
-   int xtex, ytex, w, h;
+   byte *dest, *tilerow;
+   fixed_t ystep, yfrac = 0;
+   int ytex, w, h, x;
+   int rowcount = buffer->unscaledw + 1;
    
    w = buffer->width;
    h = buffer->height;
-   xstep = buffer->ixscale;
    ystep = buffer->iyscale;
    
    dest = buffer->data;
 
+   // Lay out each of the 64 tile rows repeated across the unscaled width,
+   // so that the tiled buffer can be drawn with the ordinary scaling kernel
+   // and each distinct scaled row only needs to be built once.
+   ZAutoBuffer tiles(64 * rowcount + 64 * sizeof(byte *), false);
+   byte  *tilerows = tiles.getAs<byte *>();
+   byte **scaled   = reinterpret_cast<byte **>(tilerows + 64 * rowcount);
+
+   for(ytex = 0; ytex < 64; ytex++)
+   {
+      tilerow = tilerows + ytex * rowcount;
+      for(x = 0; x < rowcount; x += 64)
+         memcpy(tilerow + x, src + (ytex << 6), emin(64, rowcount - x));
+      scaled[ytex] = NULL;
+   }
+
    while(h--)
    {
-      int i = w;
-      row = dest;
-      xfrac = 0;
-      ytex = ((yfrac >> FRACBITS) & 63) << 6;
-      
-      while(i--)
+      ytex = (yfrac >> FRACBITS) & 63;
+
+      if(scaled[ytex])
+         memcpy(dest, scaled[ytex], w);
+      else
       {
-         xtex = (xfrac >> FRACBITS) & 63;
-         *row++ = src[ytex + xtex];
-         xfrac += xstep;
+         scaleRow(dest, tilerows + ytex * rowcount, buffer->xsteplookup, w);
+         scaled[ytex] = dest;
       }
       
       yfrac += ystep;
@@ -632,5 +778,92 @@ void V_SetBlockFuncs(VBuffer *buffer, int drawtype)
    }
 }
 
+//=============================================================================
+//
+// Console Commands
+//
+
+//
+// V_timeBlockDrawers
+//
+// Draws a full-screen block, masked block, and tiled background into the
+// given buffer the requested number of times with the current row kernels,
+// returning the average time of each in microseconds.
+//
+static void V_timeBlockDrawers(VBuffer *buffer, byte *source, byte *cmap,
+                               int iterations, double times[3])
+{
+   uint64_t start;
+   int i;
+
+   start = i_haltimer.GetMicroseconds();
+   for(i = 0; i < iterations; i++)
+      buffer->BlockDrawer(0, 0, buffer, SCREENWIDTH, SCREENHEIGHT, source);
+   times[0] = double(i_haltimer.GetMicroseconds() - start) / iterations;
+
+   start = i_haltimer.GetMicroseconds();
+   for(i = 0; i < iterations; i++)
+   {
+      buffer->MaskedBlockDrawer(0, 0, buffer, SCREENWIDTH, SCREENHEIGHT, 
+                                SCREENWIDTH, source, cmap);
+   }
+   times[1] = double(i_haltimer.GetMicroseconds() - start) / iterations;
+
+   start = i_haltimer.GetMicroseconds();
+   for(i = 0; i < iterations; i++)
+      buffer->TileBlock64(buffer, source);
+   times[2] = double(i_haltimer.GetMicroseconds() - start) / iterations;
+}
+
+//
+// v_blitbench
+//
+// Benchmarks the scaled block drawers at the current resolution, comparing
+// the vectorized row kernels with the scalar reference path.
+//
+CONSOLE_COMMAND(v_blitbench, 0)
+{
+   static const char *names[3] = { "block", "masked", "tile64" };
+   VBuffer bench;
+   byte    cmap[256];
+   double  vtimes[3], stimes[3];
+   int     iterations = 100;
+
+   if(Console.argc >= 1)
+      iterations = eclamp(Console.argv[0]->toInt(), 1, 10000);
+
+   V_InitVBuffer(&bench, vbscreen.width, vbscreen.height, 8);
+   V_SetScaling(&bench, SCREENWIDTH, SCREENHEIGHT);
+
+   // source data with scattered transparent pixels for the masked drawer
+   ZAutoBuffer source(SCREENWIDTH * SCREENHEIGHT, false);
+   byte *src = source.getAs<byte *>();
+   for(int i = 0; i < SCREENWIDTH * SCREENHEIGHT; i++)
+      src[i] = (i % 7) ? byte(i * 31) : 0;
+   for(int i = 0; i < 256; i++)
+      cmap[i] = byte(i);
+
+   V_timeBlockDrawers(&bench, src, cmap, iterations, vtimes);
+
+   scalerowfunc_t       oldRow       = scaleRow;
+   scalerowmaskedfunc_t oldRowMasked = scaleRowMasked;
+
+   scaleRow       = V_scaleRowScalar;
+   scaleRowMasked = V_scaleRowMaskedScalar;
+   V_timeBlockDrawers(&bench, src, cmap, iterations, stimes);
+   scaleRow       = oldRow;
+   scaleRowMasked = oldRowMasked;
+
+   V_FreeVBuffer(&bench);
+
+   C_Printf("Scaled block drawers at %dx%d, %d iterations:\n", 
+            vbscreen.width, vbscreen.height, iterations);
+   for(int i = 0; i < 3; i++)
+   {
+      C_Printf("%-6s: %8.1f us vector, %8.1f us scalar (%.2fx)\n", names[i],
+               vtimes[i], stimes[i], vtimes[i] > 0.0 ? stimes[i] / vtimes[i] : 0.0);
+   }
+}
+
 // EOF
 
@@ -291,6 +291,12 @@ void V_UnsetScaling(VBuffer *buffer)
    buffer->x1lookup = buffer->x2lookup 
       = buffer->y1lookup = buffer->y2lookup = NULL;
 
+   if(buffer->xsteplookup)
+   {
+      efree(buffer->xsteplookup);
+      buffer->xsteplookup = NULL;
+   }
+
    V_SetupBufferFuncs(buffer, DRAWTYPE_UNSCALED);
 }
 
@@ -358,6 +364,15 @@ void V_SetScaling(VBuffer *buffer, int unscaledw, int unscaledh)
    buffer->x2lookup[unscaledw - 1] = buffer->width - 1;
    buffer->x1lookup[unscaledw] = buffer->x2lookup[unscaledw] = buffer->width;
 
+   // x-step table used by the scaled block drawers' row kernels
+   buffer->xsteplookup = ecalloc(int *, buffer->width, sizeof(int));
+   frac = 0;
+   for(i = 0; i < buffer->width; i++)
+   {
+      buffer->xsteplookup[i] = frac >> FRACBITS;
+      frac += buffer->ixscale;
+   }
+
    buffer->y1lookup[0] = 0;
    lastfrac = frac = 0;
    for(i = 0; i < buffer->height; i++)
@@ -59,6 +59,7 @@ struct VBuffer
    int  *y2lookup;
    fixed_t ixscale;
    fixed_t iyscale;
+   int  *xsteplookup; // source column offset for each scaled column
 
    // Only change this if you want memory leaks and/or crashes :P
    bool needfree;
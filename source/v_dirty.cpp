@@ -0,0 +1,369 @@
+//
+// The Eternity Engine
+// Copyright (C) 2018 James Haley et al.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see http://www.gnu.org/licenses/
+//
+// Additional terms and conditions compatible with the GPLv3 apply. See the
+// file COPYING-EE for details.
+//
+// Purpose: Screen damage tracking and cached widget backgrounds, so that
+//  static parts of the screen (status bar, view border, console) are only
+//  redrawn when they change or something has been drawn over them.
+//
+
+#include "z_zone.h"
+
+#include "c_runcmd.h"
+#include "m_compare.h"
+#include "v_buffer.h"
+#include "v_dirty.h"
+
+// cvar: when off, every static layer is redrawn every frame as before
+bool v_dirtyrects = true;
+
+//=============================================================================
+//
+// Damage Tracking
+//
+
+// Damage is kept in real pixel coordinates of the primary surface, so rects
+// reported against different sub-buffers (vbscreen and subscreen43) can be
+// compared with each other.
+struct vdirtyrect_t
+{
+   int x1, y1, x2, y2; // inclusive
+};
+
+#define MAXDIRTYRECTS 32
+
+struct vdirtyframe_t
+{
+   vdirtyrect_t rects[MAXDIRTYRECTS];
+   int          numrects;
+   bool         all;     // entire screen is damaged
+};
+
+// damage from the frame being drawn and from the frame before it
+static vdirtyframe_t dirtyframes[2];
+static int           curdirtyframe;
+
+//
+// V_realRect
+//
+// Converts an unscaled rect on a VBuffer to an inclusive real pixel rect on
+// the buffer's parent surface. Returns false if the rect is clipped away.
+//
+static bool V_realRect(VBuffer *buffer, int x, int y, int w, int h, 
+                       vdirtyrect_t &r)
+{
+   int maxw = buffer->scaled ? buffer->unscaledw : buffer->width;
+   int maxh = buffer->scaled ? buffer->unscaledh : buffer->height;
+   int x2   = x + w - 1;
+   int y2   = y + h - 1;
+
+   if(x < 0)
+      x = 0;
+   if(y < 0)
+      y = 0;
+   if(x2 >= maxw)
+      x2 = maxw - 1;
+   if(y2 >= maxh)
+      y2 = maxh - 1;
+
+   if(x > x2 || y > y2)
+      return false;
+
+   if(buffer->scaled)
+   {
+      x  = buffer->x1lookup[x];
+      x2 = buffer->x2lookup[x2];
+      y  = buffer->y1lookup[y];
+      y2 = buffer->y2lookup[y2];
+   }
+
+   r.x1 = x  + buffer->subx;
+   r.x2 = x2 + buffer->subx;
+   r.y1 = y  + buffer->suby;
+   r.y2 = y2 + buffer->suby;
+
+   return true;
+}
+
+//
+// V_MarkDirty
+//
+// Records that something was drawn over the given unscaled rect of a buffer
+// during the current frame.
+//
+void V_MarkDirty(VBuffer *buffer, int x, int y, int w, int h)
+{
+   vdirtyframe_t &frame = dirtyframes[curdirtyframe];
+   vdirtyrect_t   r;
+
+   if(frame.all || !V_realRect(buffer, x, y, w, h, r))
+      return;
+
+   if(frame.numrects == MAXDIRTYRECTS)
+   {
+      // out of room; grow the last rect to cover this one too
+      vdirtyrect_t &last = frame.rects[MAXDIRTYRECTS - 1];
+
+      last.x1 = emin(last.x1, r.x1);
+      last.y1 = emin(last.y1, r.y1);
+      last.x2 = emax(last.x2, r.x2);
+      last.y2 = emax(last.y2, r.y2);
+   }
+   else
+      frame.rects[frame.numrects++] = r;
+}
+
+//
+// V_MarkAllDirty
+//
+// Records that the whole screen must be redrawn, ie. after a wipe, a video
+// mode change, or a full-screen menu.
+//
+void V_MarkAllDirty()
+{
+   dirtyframes[curdirtyframe].all = true;
+}
+
+//
+// V_IsDirty
+//
+// Returns true if the given unscaled rect of a buffer was drawn over since
+// the start of the previous frame, and so must be redrawn.
+//
+bool V_IsDirty(VBuffer *buffer, int x, int y, int w, int h)
+{
+   vdirtyrect_t r;
+
+   if(!v_dirtyrects)
+      return true;
+
+   if(!V_realRect(buffer, x, y, w, h, r))
+      return false;
+
+   for(const vdirtyframe_t &frame : dirtyframes)
+   {
+      if(frame.all)
+         return true;
+
+      for(int i = 0; i < frame.numrects; i++)
+      {
+         const vdirtyrect_t &d = frame.rects[i];
+
+         if(d.x1 <= r.x2 && d.x2 >= r.x1 && d.y1 <= r.y2 && d.y2 >= r.y1)
+            return true;
+      }
+   }
+
+   return false;
+}
+
+//
+// V_DirtyEndFrame
+//
+// Call once the frame has been presented. The damage from the frame just
+// finished remains visible to the next frame's checks.
+//
+void V_DirtyEndFrame()
+{
+   curdirtyframe ^= 1;
+   dirtyframes[curdirtyframe].numrects = 0;
+   dirtyframes[curdirtyframe].all      = false;
+}
+
+//=============================================================================
+//
+// VBackingStore
+//
+
+//
+// VBackingStore::clear
+//
+// Frees the saved pixels.
+//
+void VBackingStore::clear()
+{
+   if(data)
+      efree(data);
+
+   screen = NULL;
+   data   = NULL;
+   top    = height = width = 0;
+}
+
+//
+// VBackingStore::save
+//
+// Saves the band of unscaled rows [y, y + h) of a scaled buffer.
+//
+void VBackingStore::save(VBuffer *pScreen, int y, int h)
+{
+   int y2 = y + h - 1;
+
+   if(y < 0)
+      y = 0;
+   if(y2 >= pScreen->unscaledh)
+      y2 = pScreen->unscaledh - 1;
+
+   if(y > y2)
+   {
+      clear();
+      return;
+   }
+
+   int newtop    = pScreen->y1lookup[y];
+   int newheight = pScreen->y2lookup[y2] - newtop + 1;
+
+   if(!data || newheight != height || pScreen->width != width)
+   {
+      if(data)
+         efree(data);
+      data = emalloc(byte *, pScreen->width * newheight);
+   }
+
+   screen = pScreen;
+   top    = newtop;
+   height = newheight;
+   width  = pScreen->width;
+
+   byte *src  = VBADDRESS(screen, 0, top);
+   byte *dest = data;
+
+   for(int i = 0; i < height; i++)
+   {
+      memcpy(dest, src, width);
+      src  += screen->pitch;
+      dest += width;
+   }
+}
+
+//
+// VBackingStore::restore
+//
+// Copies the saved background back over an unscaled rect of the buffer.
+// Parts of the rect outside the saved band are left alone.
+//
+void VBackingStore::restore(int x, int y, int w, int h) const
+{
+   if(!data)
+      return;
+
+   int x2 = x + w - 1;
+   int y2 = y + h - 1;
+
+   if(x < 0)
+      x = 0;
+   if(x2 >= screen->unscaledw)
+      x2 = screen->unscaledw - 1;
+   if(y < 0)
+      y = 0;
+   if(y2 >= screen->unscaledh)
+      y2 = screen->unscaledh - 1;
+
+   if(x > x2 || y > y2)
+      return;
+
+   int rx1 = screen->x1lookup[x];
+   int rx2 = screen->x2lookup[x2];
+   int ry1 = emax(screen->y1lookup[y], top);
+   int ry2 = emin(screen->y2lookup[y2], top + height - 1);
+
+   if(ry1 > ry2)
+      return;
+
+   const byte *src  = data + (ry1 - top) * width + rx1;
+   byte       *dest = VBADDRESS(screen, rx1, ry1);
+
+   for(int i = ry1; i <= ry2; i++)
+   {
+      memcpy(dest, src, rx2 - rx1 + 1);
+      src  += width;
+      dest += screen->pitch;
+   }
+}
+
+//
+// VBackingStore::isValidFor
+//
+// True if the saved band came from the given buffer at its current size.
+//
+bool VBackingStore::isValidFor(const VBuffer *pScreen) const
+{
+   return data && screen == pScreen && width == pScreen->width && 
+          top + height <= pScreen->height;
+}
+
+//=============================================================================
+//
+// State Signatures
+//
+// Widgets hash whatever determines their appearance, and are redrawn only
+// when the hash changes. FNV-1a.
+//
+
+unsigned int V_HashState(unsigned int hash, int value)
+{
+   for(int i = 0; i < 4; i++)
+   {
+      hash ^= (unsigned int)(value >> (i * 8)) & 0xff;
+      hash *= 16777619u;
+   }
+
+   return hash;
+}
+
+unsigned int V_HashState(unsigned int hash, const void *ptr)
+{
+   uintptr_t value = reinterpret_cast<uintptr_t>(ptr);
+
+   for(size_t i = 0; i < sizeof(value); i++)
+   {
+      hash ^= (unsigned int)(value >> (i * 8)) & 0xff;
+      hash *= 16777619u;
+   }
+
+   return hash;
+}
+
+unsigned int V_HashString(unsigned int hash, const char *s)
+{
+   if(!s)
+      return V_HashState(hash, 0);
+
+   while(*s)
+   {
+      hash ^= (unsigned char)(*s++);
+      hash *= 16777619u;
+   }
+
+   return hash * 16777619u;
+}
+
+//=============================================================================
+//
+// Console Variables
+//
+
+VARIABLE_TOGGLE(v_dirtyrects, NULL, onoff);
+CONSOLE_VARIABLE(v_dirtyrects, v_dirtyrects, 0)
+{
+   V_MarkAllDirty();
+}
+
+// EOF
+
@@ -0,0 +1,100 @@
+//
+// The Eternity Engine
+// Copyright (C) 2018 James Haley et al.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see http://www.gnu.org/licenses/
+//
+// Additional terms and conditions compatible with the GPLv3 apply. See the
+// file COPYING-EE for details.
+//
+// Purpose: Screen damage tracking and cached widget backgrounds, so that
+//  static parts of the screen (status bar, view border, console) are only
+//  redrawn when they change or something has been drawn over them.
+//
+
+#ifndef V_DIRTY_H__
+#define V_DIRTY_H__
+
+#include "doomtype.h"
+
+struct VBuffer;
+
+extern bool v_dirtyrects; // cvar: enable dirty rectangle tracking
+
+//
+// Damage tracking
+//
+// Anything drawn on top of the static layers (menus, console, HUD, automap,
+// wipes) reports the rect it covered. Static layers then ask whether their
+// own area was covered during the current or previous frame, and redraw
+// themselves only in that case or when their contents change. Rects are in
+// the unscaled coordinate space of the given VBuffer.
+//
+
+void V_MarkDirty(VBuffer *buffer, int x, int y, int w, int h);
+void V_MarkAllDirty();
+bool V_IsDirty(VBuffer *buffer, int x, int y, int w, int h);
+void V_DirtyEndFrame();
+
+//
+// VBackingStore
+//
+// Keeps a copy of a horizontal band of a scaled VBuffer, so that widgets
+// drawn on top of a static background can be erased by copying the saved
+// background back, instead of redrawing it all.
+//
+class VBackingStore
+{
+protected:
+   VBuffer *screen; // buffer the band belongs to
+   byte    *data;   // saved pixels
+   int      top;    // first real row of the band
+   int      height; // real height of the band
+   int      width;  // real width of the band
+
+public:
+   VBackingStore() : screen(NULL), data(NULL), top(0), height(0), width(0) {}
+   ~VBackingStore() { clear(); }
+
+   void clear();
+   void save(VBuffer *pScreen, int y, int h);
+   void restore(int x, int y, int w, int h) const;
+   bool isValidFor(const VBuffer *pScreen) const;
+};
+
+//
+// vwidgetcache_t
+//
+// Records the state a cached widget was last drawn in and the unscaled area
+// it covered, so it can be skipped while unchanged and erased when it does
+// change. The owner of the background bumps its generation whenever it is
+// redrawn, which invalidates every cache drawn over the old one at once.
+//
+struct vwidgetcache_t
+{
+   unsigned int signature;  // hash of the state last drawn
+   unsigned int generation; // background generation drawn over; 0 if never
+   int x1, y1, x2, y2;      // unscaled bounds of the last draw
+};
+
+unsigned int V_HashState(unsigned int hash, int value);
+unsigned int V_HashState(unsigned int hash, const void *ptr);
+unsigned int V_HashString(unsigned int hash, const char *s);
+
+#define V_HASHSEED 2166136261u
+
+#endif
+
+// EOF
+
@@ -43,6 +43,7 @@
 #include "r_state.h"
 #include "v_alloc.h"
 #include "v_block.h"
+#include "v_dirty.h"
 #include "v_font.h"
 #include "v_misc.h"
 #include "v_patch.h"
@@ -457,6 +458,9 @@ static void V_InitScreenVBuffer()
 
    // Init subscreen43
    V_initSubScreen43();
+
+   // nothing on the new screen can be trusted
+   V_MarkAllDirty();
 }
 
 //
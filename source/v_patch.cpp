@@ -145,6 +145,109 @@ static void V_DrawPatchColumnTR()
    }
 } 
 
+//
+// V_fillRun
+//
+// Writes one pixel across a run of identical screen columns.
+//
+static inline void V_fillRun(byte *dest, byte color, int w)
+{
+   switch(w)
+   {
+   case 4:  dest[3] = color; // fall through
+   case 3:  dest[2] = color; // fall through
+   case 2:  dest[1] = color;
+            dest[0] = color;
+            break;
+   default:
+      memset(dest, color, w);
+      break;
+   }
+}
+
+//
+// V_DrawPatchColumnRun
+//
+// Draws a plain patch column across patchcol.w adjacent screen columns which
+// all map to the same texture column. At high resolutions each patch column 
+// is repeated several times horizontally, so this saves re-walking the posts
+// and re-stepping the texture for every one of them.
+//
+static void V_DrawPatchColumnRun()
+{
+   int      count;
+   byte    *dest;
+   fixed_t  frac;
+   fixed_t  fracstep;
+   int      pitch = patchcol.buffer->pitch;
+
+   if((count = patchcol.y2 - patchcol.y1 + 1) <= 0)
+      return;
+
+#ifdef RANGECHECK 
+   if((unsigned int)patchcol.x  >= (unsigned int)patchcol.buffer->width || 
+      patchcol.x + patchcol.w > patchcol.buffer->width ||
+      (unsigned int)patchcol.y1 >= (unsigned int)patchcol.buffer->height) 
+      I_Error("V_DrawPatchColumnRun: %i to %i at %i\n", patchcol.y1, patchcol.y2, patchcol.x); 
+#endif 
+
+   dest = VBADDRESS(patchcol.buffer, patchcol.x, patchcol.y1);
+
+   fracstep = patchcol.step;
+   frac = patchcol.frac + ((patchcol.y1 * fracstep) & 0xFFFF);
+
+   {
+      const byte *source = patchcol.source;
+
+      while(count--)
+      {
+         V_fillRun(dest, source[frac >> FRACBITS], patchcol.w);
+         dest += pitch;
+         frac += fracstep;
+      }
+   }
+}
+
+//
+// V_DrawPatchColumnTRRun
+//
+// As above, with color translation.
+//
+static void V_DrawPatchColumnTRRun()
+{
+   int      count;
+   byte    *dest;
+   fixed_t  frac;
+   fixed_t  fracstep;
+   int      pitch = patchcol.buffer->pitch;
+
+   if((count = patchcol.y2 - patchcol.y1 + 1) <= 0)
+      return;
+
+#ifdef RANGECHECK 
+   if((unsigned int)patchcol.x  >= (unsigned int)patchcol.buffer->width || 
+      patchcol.x + patchcol.w > patchcol.buffer->width ||
+      (unsigned int)patchcol.y1 >= (unsigned int)patchcol.buffer->height) 
+      I_Error("V_DrawPatchColumnTRRun: %i to %i at %i\n", patchcol.y1, patchcol.y2, patchcol.x); 
+#endif 
+
+   dest = VBADDRESS(patchcol.buffer, patchcol.x, patchcol.y1);
+
+   fracstep = patchcol.step;
+   frac = patchcol.frac + ((patchcol.y1 * fracstep) & 0xFFFF);
+
+   {
+      const byte *source = patchcol.source;
+
+      while(count--)
+      {
+         V_fillRun(dest, patchcol.translation[source[frac >> FRACBITS]], patchcol.w);
+         dest += pitch;
+         frac += fracstep;
+      }
+   }
+}
+
 //
 // V_DrawPatchColumnTRLit
 //
@@ -540,6 +643,19 @@ static patchcolfunc_t colfuncfordrawstyle[PSTYLE_NUMSTYLES] =
    V_DrawPatchColumnTRLit
 };
 
+// Column-run drawers for the styles which write each pixel independently of
+// what is already in the buffer; others are drawn one column at a time.
+static patchcolfunc_t runfuncfordrawstyle[PSTYLE_NUMSTYLES] =
+{
+   V_DrawPatchColumnRun,
+   V_DrawPatchColumnTRRun,
+   NULL,
+   NULL,
+   NULL,
+   NULL,
+   NULL
+};
+
 //
 // V_DrawPatchInt
 //
@@ -644,10 +760,13 @@ void V_DrawPatchInt(PatchInfo *pi, VBuffer *buffer)
          I_Error("V_DrawPatchInt: unknown patch drawstyle %d\n", pi->drawstyle);
 #endif
       patchcol.colfunc = colfuncfordrawstyle[pi->drawstyle];
+      patchcol.w       = 1;
 
       ytop = pi->y - patch->topoffset;
+
+      patchcolfunc_t runfunc = buffer->scaled ? runfuncfordrawstyle[pi->drawstyle] : NULL;
       
-      for(; patchcol.x <= x2; patchcol.x++, startfrac += xiscale)
+      for(; patchcol.x <= x2; patchcol.x += patchcol.w, startfrac += xiscale * patchcol.w)
       {
          texturecolumn = startfrac >> FRACBITS;
          
@@ -655,6 +774,18 @@ void V_DrawPatchInt(PatchInfo *pi, VBuffer *buffer)
          if(texturecolumn < 0 || texturecolumn >= w)
             I_Error("V_DrawPatchInt: bad texturecolumn %d\n", texturecolumn);
 #endif
+
+         // gather all following screen columns that sample the same texture
+         // column into a single run
+         if(runfunc)
+         {
+            patchcol.w = 1;
+            while(patchcol.x + patchcol.w <= x2 &&
+                  (startfrac + xiscale * patchcol.w) >> FRACBITS == texturecolumn)
+               patchcol.w++;
+
+            patchcol.colfunc = patchcol.w > 1 ? runfunc : colfuncfordrawstyle[pi->drawstyle];
+         }
          
          column = (column_t *)((byte *)patch + patch->columnofs[texturecolumn]);
          maskcolfunc(column);
@@ -77,6 +77,7 @@ struct cb_patch_column_t  // It's cardboard now, bitches!
 {
    int x;
    int y1, y2;
+   int w;        // number of identical screen columns drawn at once
 
    fixed_t frac; 
    fixed_t step;